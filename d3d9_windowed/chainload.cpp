@@ -0,0 +1,262 @@
+// =============================================================================
+// Chain-loading of additional DLLs (overlays, wrappers, other proxies).
+//
+// Configured in preferences.ini (the one next to this proxy):
+//   [ChainLoad]
+//     Load=                    -> ';'-separated DLLs, loaded in this order
+//     Parallel=1               -> prefetch all entries on worker threads first
+//
+// Relative paths resolve against the directory this proxy was loaded from.
+//
+// Runs inside the proxy's one-time init, so it is finished before the first
+// Direct3DCreate9 returns, and never under the loader lock. The expensive part
+// of loading a wrapper is cold I/O: paging its image and its app-local imports
+// in from disk. That part is order-independent, so each entry gets a worker
+// that maps those files as image resources and touches every page. Nothing is
+// loaded as code there; the real LoadLibrary calls run one at a time in config
+// order, so DllMain ordering between wrappers stays deterministic.
+// =============================================================================
+#include <windows.h>
+#include <cstdio>
+#include <cstring>
+
+static const int kMaxChainDlls = 16;
+
+struct ChainEntry {
+    char path[MAX_PATH];
+    char base[MAX_PATH];        // file name only, for import filtering
+    LONGLONG prefetchTicks;
+    int depsPrefetched;
+    LONGLONG loadTicks;
+    HMODULE module;
+    DWORD error;
+};
+
+static ChainEntry g_chain[kMaxChainDlls];
+static int g_chainCount = 0;
+static char g_selfBase[MAX_PATH];
+
+// Shared with d3d9_windowed.cpp.
+void DebugLog(const char* fmt, ...);
+LONGLONG QpcNow();
+double QpcToUs(LONGLONG ticks);
+
+static const char* BaseName(const char* path) {
+    const char* a = strrchr(path, '\\');
+    const char* b = strrchr(path, '/');
+    const char* s = a > b ? a : b;
+    return s ? s + 1 : path;
+}
+
+static void TrimInPlace(char* s) {
+    char* start = s;
+    while (*start == ' ' || *start == '\t') start++;
+    if (start != s) memmove(s, start, strlen(start) + 1);
+
+    size_t n = strlen(s);
+    while (n > 0 && (s[n - 1] == ' ' || s[n - 1] == '\t')) s[--n] = 0;
+}
+
+// Directory of this proxy, with trailing separator.
+static bool GetSelfDir(char* dir, DWORD cap) {
+    HMODULE self = nullptr;
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+        GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        reinterpret_cast<LPCSTR>(&GetSelfDir), &self)) return false;
+
+    DWORD len = GetModuleFileNameA(self, dir, cap);
+    if (len == 0 || len >= cap) return false;
+
+    lstrcpynA(g_selfBase, BaseName(dir), MAX_PATH);
+    char* slash = strrchr(dir, '\\');
+    if (!slash) return false;
+    slash[1] = 0;
+    return true;
+}
+
+static int ParseChainList(const char* cfgPath) {
+    char list[2048]{};
+    GetPrivateProfileStringA("ChainLoad", "Load", "", list, sizeof(list), cfgPath);
+    if (!list[0]) return 0;
+
+    char dir[MAX_PATH]{};
+    const bool haveDir = GetSelfDir(dir, MAX_PATH);
+
+    char* ctx = nullptr;
+    for (char* tok = strtok_s(list, ";", &ctx); tok; tok = strtok_s(nullptr, ";", &ctx)) {
+        TrimInPlace(tok);
+        if (!tok[0]) continue;
+
+        if (g_chainCount >= kMaxChainDlls) {
+            DebugLog("chain: more than %d entries, ignoring %s\n", kMaxChainDlls, tok);
+            continue;
+        }
+
+        // Loading ourselves again would recurse into this same init.
+        if (_stricmp(BaseName(tok), g_selfBase) == 0) {
+            DebugLog("chain: skipping %s (this proxy)\n", tok);
+            continue;
+        }
+
+        ChainEntry& e = g_chain[g_chainCount++];
+        ZeroMemory(&e, sizeof(e));
+
+        const bool relative = !(tok[0] == '\\' || (tok[0] && tok[1] == ':'));
+        if (relative && haveDir) snprintf(e.path, sizeof(e.path), "%s%s", dir, tok);
+        else lstrcpynA(e.path, tok, MAX_PATH);
+        lstrcpynA(e.base, BaseName(e.path), MAX_PATH);
+    }
+    return g_chainCount;
+}
+
+// Imports that are loaded in the final, ordered pass; mapping them early
+// gains nothing and api sets are not files.
+static bool IsOrderedImport(const char* name) {
+    if (_stricmp(name, g_selfBase) == 0) return true;
+    if (_strnicmp(name, "api-ms-", 7) == 0 || _strnicmp(name, "ext-ms-", 7) == 0) return true;
+    for (int i = 0; i < g_chainCount; i++) {
+        if (_stricmp(name, g_chain[i].base) == 0) return true;
+    }
+    return false;
+}
+
+// The NT headers of an image mapped at base, or nullptr unless the DOS header
+// points them inside the region the mapping starts with.
+static const IMAGE_NT_HEADERS* MappedNtHeaders(const BYTE* base) {
+    MEMORY_BASIC_INFORMATION mbi{};
+    if (!VirtualQuery(base, &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT) return nullptr;
+    const SIZE_T mapped = mbi.RegionSize - (SIZE_T)(base - static_cast<const BYTE*>(mbi.BaseAddress));
+    if (mapped < sizeof(IMAGE_DOS_HEADER)) return nullptr;
+
+    const IMAGE_DOS_HEADER* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    if (dos->e_magic != IMAGE_DOS_SIGNATURE || dos->e_lfanew < 0) return nullptr;
+    if ((SIZE_T)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) > mapped) return nullptr;
+
+    const IMAGE_NT_HEADERS* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+    return nt->Signature == IMAGE_NT_SIGNATURE ? nt : nullptr;
+}
+
+// Maps a file as an image resource and touches every page, so the real
+// mapping later only soft-faults. Image-resource mapping lays the file out like
+// the loader will without running any of its code; the low bits of the handle
+// tag it as a data file. Returns the mapped base, or nullptr.
+static HMODULE PrefetchImage(const char* path, const BYTE** base, DWORD* size) {
+    HMODULE h = LoadLibraryExA(path, nullptr, LOAD_LIBRARY_AS_IMAGE_RESOURCE);
+    if (!h) return nullptr;
+
+    const BYTE* b = reinterpret_cast<const BYTE*>(reinterpret_cast<ULONG_PTR>(h) & ~(ULONG_PTR)3);
+    const IMAGE_NT_HEADERS* nt = MappedNtHeaders(b);
+    const DWORD n = nt ? nt->OptionalHeader.SizeOfImage : 0;
+
+    volatile BYTE sink = 0;
+    for (DWORD off = 0; off < n; off += 4096) {
+        MEMORY_BASIC_INFORMATION pm{};
+        if (!VirtualQuery(b + off, &pm, sizeof(pm)) || pm.State != MEM_COMMIT) continue;
+        sink ^= b[off];
+    }
+    (void)sink;
+
+    *base = b;
+    *size = n;
+    return h;
+}
+
+// Prefetches the imports that sit next to the chained DLL and are not loaded
+// yet. System DLLs are left alone: they are shared sections the OS keeps warm.
+static int PrefetchLocalImports(const ChainEntry& e, const BYTE* base, DWORD imageSize) {
+    const IMAGE_NT_HEADERS* nt = MappedNtHeaders(base);
+    if (!nt) return 0;
+
+    // A DLL of the other bitness fails the real load anyway; don't walk its headers.
+    if (nt->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR_MAGIC) return 0;
+
+    const IMAGE_DATA_DIRECTORY& dir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+    if (dir.VirtualAddress == 0 || dir.VirtualAddress >= imageSize) return 0;
+
+    char folder[MAX_PATH];
+    lstrcpynA(folder, e.path, MAX_PATH);
+    folder[BaseName(folder) - folder] = 0;
+
+    int prefetched = 0;
+    const IMAGE_IMPORT_DESCRIPTOR* imp =
+        reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(base + dir.VirtualAddress);
+    for (; imp->Name != 0; imp++) {
+        if (imp->Name >= imageSize) break;
+        const char* name = reinterpret_cast<const char*>(base + imp->Name);
+        if (IsOrderedImport(name) || GetModuleHandleA(name)) continue;
+
+        char path[MAX_PATH];
+        if (snprintf(path, sizeof(path), "%s%s", folder, name) >= (int)sizeof(path)) continue;
+        if (GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES) continue;
+
+        const BYTE* b = nullptr;
+        DWORD n = 0;
+        if (HMODULE h = PrefetchImage(path, &b, &n)) {
+            FreeLibrary(h);
+            prefetched++;
+        }
+    }
+    return prefetched;
+}
+
+static DWORD WINAPI PrefetchThread(LPVOID param) {
+    ChainEntry& e = *static_cast<ChainEntry*>(param);
+    LONGLONG t0 = QpcNow();
+
+    const BYTE* base = nullptr;
+    DWORD size = 0;
+    if (HMODULE h = PrefetchImage(e.path, &base, &size)) {
+        if (size) e.depsPrefetched = PrefetchLocalImports(e, base, size);
+        FreeLibrary(h);
+    }
+
+    e.prefetchTicks = QpcNow() - t0;
+    return 0;
+}
+
+static void PrefetchChain() {
+    HANDLE threads[kMaxChainDlls]{};
+    DWORD started = 0;
+
+    for (int i = 0; i < g_chainCount; i++) {
+        HANDLE t = CreateThread(nullptr, 0, &PrefetchThread, &g_chain[i], 0, nullptr);
+        if (t) threads[started++] = t;
+        else PrefetchThread(&g_chain[i]);
+    }
+
+    if (started) WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+    for (DWORD i = 0; i < started; i++) CloseHandle(threads[i]);
+}
+
+void TryChainLoad_Entry(const char* cfgPath) {
+    if (ParseChainList(cfgPath) == 0) return;
+
+    const bool parallel = GetPrivateProfileIntA("ChainLoad", "Parallel", 1, cfgPath) != 0;
+
+    LONGLONG t0 = QpcNow();
+    if (parallel && g_chainCount > 1) PrefetchChain();
+    LONGLONG t1 = QpcNow();
+
+    for (int i = 0; i < g_chainCount; i++) {
+        ChainEntry& e = g_chain[i];
+        LONGLONG l0 = QpcNow();
+        e.module = LoadLibraryA(e.path);
+        e.error = e.module ? 0 : GetLastError();
+        e.loadTicks = QpcNow() - l0;
+    }
+    LONGLONG t2 = QpcNow();
+
+    DebugLog("chain: %d dlls, prefetch %.1f us, load %.1f us, total %.1f us\n",
+        g_chainCount, QpcToUs(t1 - t0), QpcToUs(t2 - t1), QpcToUs(t2 - t0));
+    for (int i = 0; i < g_chainCount; i++) {
+        const ChainEntry& e = g_chain[i];
+        if (e.module) {
+            DebugLog("chain:   %d. %s: prefetch %.1f us (%d imports), load %.1f us\n",
+                i + 1, e.base, QpcToUs(e.prefetchTicks), e.depsPrefetched, QpcToUs(e.loadTicks));
+        }
+        else {
+            DebugLog("chain:   %d. %s: load failed (%lu) after %.1f us\n",
+                i + 1, e.base, e.error, QpcToUs(e.loadTicks));
+        }
+    }
+}
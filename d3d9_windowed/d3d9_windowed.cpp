@@ -1,10 +1,39 @@
 // =============================================================================
 // d3d9.dll proxy for legacy DirectX 9 games.
 //
-// Features (controlled by .\preferences.ini):
+// Features (controlled by preferences.ini next to this d3d9.dll):
 //     StartWindowed=1          -> 0 = borderless fullscreen, 1 = windowed
 //     IgnoreDeactivate=1       -> don't pause game on focus lost (alt-tab)
 //     DisableClipCursor=1      -> prevent cursor confinement/capture
+//     FrameStats=0             -> log frame time percentiles every few seconds
+//     FlipEx=0                 -> create D3D9Ex devices with flip-model presentation
+//     HighPollMouse=0          -> coalesce WM_MOUSEMOVE per frame, scale raw mouse deltas
+//
+//   [Pacing]
+//     TargetFPS=0              -> 0 = off, otherwise cap Present to this rate
+//     Mode=hybrid              -> hybrid (timer + spin), timer, or spin
+//
+//   [Scaling]
+//     Mode=off                 -> off (Present src/dst rects), point, bilinear, integer
+//     Fit=stretch              -> stretch, aspect (letterbox/pillarbox), integer
+//
+//   [Latency]
+//     MaxFrameLatency=0        -> 0 = driver default, N = at most N frames queued
+//
+//   [Profiles]
+//     Enabled=1                -> install hooks up front from d3d9_profiles.bin
+//     Record=0                 -> write heuristic decisions back to d3d9_profiles.bin
+//
+//   [ChainLoad]                (see chainload.cpp)
+//     Load=                    -> ';'-separated DLLs to load after this proxy
+//     Parallel=1               -> prefetch them on worker threads first
+//
+//   [Trace]
+//     Enabled=0                -> record detour calls to d3d9_trace_<pid>.bin
+//     SizeMB=64                -> ring size; the oldest records are overwritten
+//
+// Edits to the ini are picked up while the game runs. StartWindowed applies on
+// the next device Reset, FlipEx on the next device creation.
 // =============================================================================
 #include <windows.h>
 #include <windowsx.h>
@@ -20,20 +49,60 @@
 #endif
 
 #include <dinput.h>
+#include <cstdarg>
+#include <cstdio>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 #include "MinHook.h"
 
 #pragma comment(lib, "dinput8.lib")
 #pragma comment(lib, "dxguid.lib")
+#pragma comment(lib, "winmm.lib")
 
 // =============================================================================
 // Config
 // =============================================================================
 
+enum PacingMode {
+    kPacingHybrid = 0,  // waitable timer until shortly before the deadline, then spin
+    kPacingTimer,       // waitable timer only; least CPU, most jitter
+    kPacingSpin,        // busy-wait only; burns a core
+};
+
+enum ScaleMode {
+    kScaleOff = 0,      // let Present stretch via src/dst rects
+    kScalePoint,        // StretchRect into a client-sized swapchain, nearest
+    kScaleBilinear,     // same, linear filter
+    kScaleInteger,      // largest whole-number factor, centered, nearest
+};
+
+enum FitMode {
+    kFitStretch = 0,    // fill the client area
+    kFitAspect,         // keep aspect ratio, black bars
+    kFitInteger,        // largest whole-number factor, black bars
+};
+
+static constexpr int kMaxFrameLatency = 16;
+
 struct Config {
     bool startWindowed = true;
     bool ignoreDeactivate = true;
     bool disableClip = true;
+    bool frameStats = false;
+    bool flipEx = false;
+    bool highPollMouse = false;
+    int pacingFps = 0;
+    PacingMode pacingMode = kPacingHybrid;
+    ScaleMode scaleMode = kScaleOff;
+    FitMode fit = kFitStretch;
+    int maxFrameLatency = 0;
+    bool profiles = true;
+    bool profileRecord = false;
+    bool trace = false;
+    int traceSizeMB = 64;
+    LONG generation = 0;       // set by PublishConfig, 0 for the defaults
 
     static bool ReadIniBool(const char* section, const char* key, bool def,
         const char* path = ".\\preferences.ini")
@@ -43,14 +112,108 @@ struct Config {
         return buf[0] != '0';
     }
 
+    static PacingMode ReadIniPacingMode(const char* path) {
+        char buf[32]{};
+        GetPrivateProfileStringA("Pacing", "Mode", "hybrid", buf, sizeof(buf), path);
+        if (_stricmp(buf, "timer") == 0) return kPacingTimer;
+        if (_stricmp(buf, "spin") == 0) return kPacingSpin;
+        return kPacingHybrid;
+    }
+
+    static ScaleMode ReadIniScaleMode(const char* path) {
+        char buf[32]{};
+        GetPrivateProfileStringA("Scaling", "Mode", "off", buf, sizeof(buf), path);
+        if (_stricmp(buf, "point") == 0) return kScalePoint;
+        if (_stricmp(buf, "bilinear") == 0) return kScaleBilinear;
+        if (_stricmp(buf, "integer") == 0) return kScaleInteger;
+        return kScaleOff;
+    }
+
+    static FitMode ReadIniFitMode(const char* path) {
+        char buf[32]{};
+        GetPrivateProfileStringA("Scaling", "Fit", "stretch", buf, sizeof(buf), path);
+        if (_stricmp(buf, "aspect") == 0) return kFitAspect;
+        if (_stricmp(buf, "integer") == 0) return kFitInteger;
+        return kFitStretch;
+    }
+
     void Load(const char* path = ".\\preferences.ini") {
         startWindowed = ReadIniBool("Preferences", "StartWindowed", true, path);
         ignoreDeactivate = ReadIniBool("Preferences", "IgnoreDeactivate", true, path);
         disableClip = ReadIniBool("Preferences", "DisableClipCursor", true, path);
+        frameStats = ReadIniBool("Preferences", "FrameStats", false, path);
+        flipEx = ReadIniBool("Preferences", "FlipEx", false, path);
+        highPollMouse = ReadIniBool("Preferences", "HighPollMouse", false, path);
+        pacingFps = (int)GetPrivateProfileIntA("Pacing", "TargetFPS", 0, path);
+        if (pacingFps < 0 || pacingFps > 1000) pacingFps = 0;
+        pacingMode = ReadIniPacingMode(path);
+        scaleMode = ReadIniScaleMode(path);
+        fit = ReadIniFitMode(path);
+        maxFrameLatency = (int)GetPrivateProfileIntA("Latency", "MaxFrameLatency", 0, path);
+        if (maxFrameLatency < 0) maxFrameLatency = 0;
+        if (maxFrameLatency > kMaxFrameLatency) maxFrameLatency = kMaxFrameLatency;
+        profiles = ReadIniBool("Profiles", "Enabled", true, path);
+        profileRecord = ReadIniBool("Profiles", "Record", false, path);
+        trace = ReadIniBool("Trace", "Enabled", false, path);
+        traceSizeMB = (int)GetPrivateProfileIntA("Trace", "SizeMB", 64, path);
+        if (traceSizeMB < 1) traceSizeMB = 1;
+        if (traceSizeMB > 1024) traceSizeMB = 1024;
     }
 };
 
-static Config g_cfg{};
+// The live configuration is an immutable snapshot behind one pointer. Readers
+// take a single acquire load per call; a reload builds a fresh Config and swaps
+// the pointer. Hooks hold no reference count, so a replaced snapshot is parked
+// in a small graveyard and only freed once it has been out of use for far
+// longer than any hook keeps a Config reference (one call, one paced frame).
+static Config g_cfgDefaults{};
+static PVOID volatile g_cfgSnapshot = &g_cfgDefaults;
+static char g_cfgPath[MAX_PATH] = ".\\preferences.ini";
+static LONG g_cfgGeneration = 0;
+
+static const int kRetiredConfigs = 8;
+static const ULONGLONG kConfigGraceMs = 10000;
+
+struct RetiredConfig {
+    Config* cfg;
+    ULONGLONG retiredMs;
+};
+
+// Touched by the publishing thread only: init, then the watcher thread.
+static RetiredConfig g_cfgRetired[kRetiredConfigs];
+static int g_cfgRetiredCount = 0;
+
+static inline const Config& Cfg() {
+    return *static_cast<const Config*>(ReadPointerAcquire(&g_cfgSnapshot));
+}
+
+static void RetireConfig(Config* cfg) {
+    if (cfg == &g_cfgDefaults) return;
+
+    // Free what is past its grace period. When the graveyard is still full,
+    // the ini is being saved faster than that; wait the oldest one out rather
+    // than free a snapshot a hook may still be reading.
+    for (;;) {
+        const ULONGLONG now = GetTickCount64();
+        int kept = 0;
+        for (int i = 0; i < g_cfgRetiredCount; i++) {
+            if (now - g_cfgRetired[i].retiredMs >= kConfigGraceMs) delete g_cfgRetired[i].cfg;
+            else g_cfgRetired[kept++] = g_cfgRetired[i];
+        }
+        g_cfgRetiredCount = kept;
+        if (kept < kRetiredConfigs) break;
+
+        Sleep((DWORD)(kConfigGraceMs - (now - g_cfgRetired[0].retiredMs)));
+    }
+
+    g_cfgRetired[g_cfgRetiredCount++] = { cfg, GetTickCount64() };
+}
+
+static void PublishConfig(Config* cfg) {
+    cfg->generation = ++g_cfgGeneration;
+    Config* old = static_cast<Config*>(InterlockedExchangePointer(&g_cfgSnapshot, cfg));
+    RetireConfig(old);
+}
 
 
 // =============================================================================
@@ -65,10 +228,6 @@ static RECT g_windowedRect{ 100, 100, 1380, 880 };
 
 static ULONGLONG g_processStartMs = 0;
 
-// Virtual Win32 client size exposed to the game (usually the backbuffer size).
-static volatile LONG g_virtualW = 0;
-static volatile LONG g_virtualH = 0;
-
 // Virtual Win32 sizing is only needed for titles that compute UI/input from Win32 client metrics
 static volatile LONG g_win32VirtEnabled = 0;
 static volatile LONG g_win32VirtHooksInstalled = 0;
@@ -76,7 +235,41 @@ static volatile LONG g_win32VirtHooksInstalled = 0;
 // --- IgnoreDeactivate v2 (GFW spoof) ---
 static volatile LONG g_deactivated = 0;   // set by WndProc
 static volatile LONG g_seenPresent = 0;   // set by any Present hook
-static unsigned long long g_presentTotal = 0;
+static volatile LONG64 g_presentTotal = 0; // Present calls across all hooks
+
+// DebugLog, QpcNow and QpcToUs are shared with chainload.cpp.
+void DebugLog(const char* fmt, ...) {
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf), "[d3d9_windowed] ");
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf + n, sizeof(buf) - n, fmt, ap);
+    va_end(ap);
+    OutputDebugStringA(buf);
+}
+
+LONGLONG QpcNow() {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+double QpcToUs(LONGLONG ticks) {
+    static LONGLONG freq = 0;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    return (double)ticks * 1000000.0 / (double)freq;
+}
+
+// Bumped whenever cached Present state (hwnd, backbuffer, client rect) may be stale.
+static volatile LONG g_presentEpoch = 1;
+
+static void InvalidatePresentState() {
+    InterlockedIncrement(&g_presentEpoch);
+}
 
 using GetForegroundWindow_t = HWND(WINAPI*)();
 static GetForegroundWindow_t Real_GetForegroundWindow = nullptr;
@@ -95,8 +288,6 @@ static bool IsGameForeground() {
 static BOOL GetClientRectRaw(HWND hwnd, RECT* rc);
 static BOOL ScreenToClientRaw(HWND hwnd, POINT* pt);
 static BOOL ClientToScreenRaw(HWND hwnd, POINT* pt);
-static bool ShouldVirtualizeWin32(HWND hwnd);
-static void GetVirtualSize(LONG& w, LONG& h);
 static bool GetActualClientSize(HWND hwnd, LONG& w, LONG& h);
 
 // Convert client rect -> screen-space rect. Useful for ClipCursor.
@@ -187,769 +378,3476 @@ static void ApplyWindowed(HWND hwnd) {
 }
 
 // =============================================================================
-// Mouse policy
+// View transform
 // =============================================================================
 
-static void ApplyMousePolicyNow() {
-    if (!g_hwnd) return;
-
-    if (g_cfg.disableClip || !IsGameForeground()) {
-        ClipCursor(nullptr);
-        ::ReleaseCapture();
-        return;
-    }
+// Set while the newest device is FLIPEX; DWM stretches those, so rects can't letterbox.
+static volatile LONG g_flipExActive = 0;
 
-    RECT clip = GetClientRectScreen(g_hwnd);
-    if (clip.right > clip.left && clip.bottom > clip.top) {
-        ClipCursor(&clip);
-    }
+static FitMode EffectiveFit() {
+    if (InterlockedCompareExchange(&g_flipExActive, 0, 0) != 0) return kFitStretch;
+    if (Cfg().scaleMode == kScaleInteger) return kFitInteger;
+    return Cfg().fit;
 }
 
-// =============================================================================
-// WndProc hook
-// =============================================================================
-
-static LRESULT CALLBACK Hook_WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+// Where a srcW x srcH image lands inside an outW x outH area. Pure.
+static RECT FitRect(FitMode fit, LONG srcW, LONG srcH, LONG outW, LONG outH) {
+    RECT r{ 0, 0, outW, outH };
+    if (fit == kFitStretch || srcW <= 0 || srcH <= 0 || outW <= 0 || outH <= 0) return r;
 
-    if (ShouldVirtualizeWin32(hwnd)) {
-        switch (msg) {
-        case WM_MOUSEMOVE:
-        case WM_LBUTTONDOWN: case WM_LBUTTONUP: case WM_LBUTTONDBLCLK:
-        case WM_RBUTTONDOWN: case WM_RBUTTONUP: case WM_RBUTTONDBLCLK:
-        case WM_MBUTTONDOWN: case WM_MBUTTONUP: case WM_MBUTTONDBLCLK:
-        case WM_XBUTTONDOWN: case WM_XBUTTONUP: case WM_XBUTTONDBLCLK:
-        {
-            LONG vw = 0, vh = 0;
-            GetVirtualSize(vw, vh);
+    LONG w = outW, h = outH;
+    const LONG k = (std::min)(outW / srcW, outH / srcH);
+    if (fit == kFitInteger && k >= 1) {
+        w = srcW * k;
+        h = srcH * k;
+    }
+    else if ((LONGLONG)outW * srcH > (LONGLONG)outH * srcW) {
+        w = (LONG)((LONGLONG)outH * srcW / srcH);   // pillarbox
+    }
+    else {
+        h = (LONG)((LONGLONG)outW * srcH / srcW);   // letterbox
+    }
 
-            LONG aw = 0, ah = 0;
-            GetActualClientSize(hwnd, aw, ah);
+    r.left = (outW - w) / 2;
+    r.top = (outH - h) / 2;
+    r.right = r.left + w;
+    r.bottom = r.top + h;
+    return r;
+}
 
-            if (vw > 0 && vh > 0 && aw > 0 && ah > 0) {
-                int x = GET_X_LPARAM(lParam);
-                int y = GET_Y_LPARAM(lParam);
+// Maps between real client coordinates and the virtual (backbuffer-sized)
+// space the game sees. Rebuilt only when either size changes; every
+// virtualized API and the Present dst rect go through the same instance, so
+// input and image always agree, including over the bars.
+struct ViewTransform {
+    LONG virtW = 0, virtH = 0;      // what the game sees
+    LONG clientW = 0, clientH = 0;  // real client area
+    RECT image{};                   // where the image lands inside the client
+    LONG imageW = 0, imageH = 0;
+
+    bool Valid() const { return virtW > 0 && virtH > 0 && imageW > 0 && imageH > 0; }
+
+    void Rebuild(FitMode fit) {
+        image = FitRect(fit, virtW, virtH, clientW, clientH);
+        imageW = image.right - image.left;
+        imageH = image.bottom - image.top;
+    }
 
-                int sx = MulDiv(x, (int)vw, (int)aw);
-                int sy = MulDiv(y, (int)vh, (int)ah);
+    static LONG FloorDiv(LONGLONG n, LONG d) {
+        LONGLONG q = n / d;
+        return (LONG)((n % d != 0 && n < 0) ? q - 1 : q);
+    }
 
-                lParam = MAKELPARAM((short)sx, (short)sy);
-            }
-        } break;
-        default:
-            break;
-        }
+    // Client pixel -> the virtual pixel it shows. Points over the bars map
+    // outside [0, virt) rather than being clamped.
+    POINT ToVirtual(POINT p) const {
+        return POINT{
+            FloorDiv((LONGLONG)(p.x - image.left) * virtW, imageW),
+            FloorDiv((LONGLONG)(p.y - image.top) * virtH, imageH) };
     }
 
-    switch (msg) {
-    case WM_SETCURSOR:
-        if (LOWORD(lParam) == HTCLIENT) break;
-        return DefWindowProc(hwnd, msg, wParam, lParam);
+    // Virtual pixel -> first client pixel showing it; ToVirtual(ToClient(v)) == v
+    // whenever the image isn't downscaled.
+    POINT ToClient(POINT p) const {
+        return POINT{
+            image.left - FloorDiv(-(LONGLONG)p.x * imageW, virtW),
+            image.top - FloorDiv(-(LONGLONG)p.y * imageH, virtH) };
+    }
+};
 
-    case WM_SIZE:
-        if (ShouldVirtualizeWin32(hwnd)) {
-            LONG vw = 0, vh = 0;
-            GetVirtualSize(vw, vh);
-            if (vw > 0 && vh > 0) {
-                lParam = MAKELPARAM((WORD)vw, (WORD)vh);
-            }
-        }
-        break;
+// Seqlock: odd while a writer is updating. Writers (WndProc, Present) also
+// serialize on it; readers copy and retry if they raced one.
+static ViewTransform g_view;
+static volatile LONG g_viewSeq = 0;
 
-    case WM_ACTIVATEAPP:
-        if (wParam == FALSE) {
-            InterlockedExchange(&g_deactivated, 1);
-            ClipCursor(nullptr);
-            ::ReleaseCapture();
-            if (g_cfg.ignoreDeactivate) return 0;
-        }
-        else {
-            InterlockedExchange(&g_deactivated, 0);
-            ApplyMousePolicyNow();
-        }
-        break;
+static LONG LockView() {
+    for (;;) {
+        const LONG seq = g_viewSeq;
+        if (!(seq & 1) && InterlockedCompareExchange(&g_viewSeq, seq + 1, seq) == seq) return seq;
+        YieldProcessor();
+    }
+}
 
-    case WM_ACTIVATE:
-        if (LOWORD(wParam) == WA_INACTIVE) {
-            InterlockedExchange(&g_deactivated, 1);
-            ClipCursor(nullptr);
-            ::ReleaseCapture();
-            if (g_cfg.ignoreDeactivate) return 0;
-        }
-        else {
-            InterlockedExchange(&g_deactivated, 0);
-            ApplyMousePolicyNow();
-        }
-        break;
+static void UnlockView(LONG seq) {
+    InterlockedExchange(&g_viewSeq, seq + 2);
+}
 
-    case WM_SETFOCUS:
-        InterlockedExchange(&g_deactivated, 0);
-        ApplyMousePolicyNow();
-        break;
+static ViewTransform ReadView() {
+    for (;;) {
+        const LONG seq = InterlockedCompareExchange(&g_viewSeq, 0, 0);
+        if (seq & 1) { YieldProcessor(); continue; }
+        ViewTransform v = *const_cast<const ViewTransform*>(&g_view);
+        MemoryBarrier();
+        if (InterlockedCompareExchange(&g_viewSeq, 0, 0) == seq) return v;
+    }
+}
 
-    case WM_KILLFOCUS:
-        InterlockedExchange(&g_deactivated, 1);
-        ClipCursor(nullptr);
-        ::ReleaseCapture();
-        if (g_cfg.ignoreDeactivate) return 0;
-        break;
+static void SetViewClientSize(LONG w, LONG h) {
+    if (w <= 0 || h <= 0) return;
+    const LONG seq = LockView();
+    if (g_view.clientW != w || g_view.clientH != h) {
+        g_view.clientW = w;
+        g_view.clientH = h;
+        g_view.Rebuild(EffectiveFit());
+    }
+    UnlockView(seq);
+}
 
-    case WM_EXITSIZEMOVE:
-        PostMessage(hwnd, WM_ACTIVATE, WA_ACTIVE, 0);
-        PostMessage(hwnd, WM_SETFOCUS, 0, 0);
-        break;
+static void SetViewVirtualSize(LONG w, LONG h) {
+    if (w <= 0 || h <= 0) return;
+    const LONG seq = LockView();
+    if (g_view.virtW != w || g_view.virtH != h) {
+        g_view.virtW = w;
+        g_view.virtH = h;
+        g_view.Rebuild(EffectiveFit());
     }
+    UnlockView(seq);
+}
 
-    return CallWindowProc(g_origWndProc, hwnd, msg, wParam, lParam);
+static void ForgetViewClient() {
+    const LONG seq = LockView();
+    g_view.clientW = g_view.clientH = 0;
+    g_view.Rebuild(EffectiveFit());
+    UnlockView(seq);
 }
 
-static void InstallWndProc(HWND hwnd) {
-    if (!hwnd) return;
-    if (hwnd == g_wndprocHwnd) return;
+// Fit changes (flip device appeared) without either size changing.
+static void RebuildView() {
+    const LONG seq = LockView();
+    g_view.Rebuild(EffectiveFit());
+    UnlockView(seq);
+}
 
-    g_origWndProc = reinterpret_cast<WNDPROC>(
-        SetWindowLongPtr(hwnd, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(Hook_WndProc))
-        );
-    g_wndprocHwnd = hwnd;
+// Called from every virtualized user32 hook, often thousands of times a frame:
+// only the enable flag, g_hwnd and one view snapshot, no user32 calls.
+static bool ShouldVirtualizeWin32(HWND hwnd, ViewTransform& view) {
+    if (InterlockedCompareExchange(&g_win32VirtEnabled, 0, 0) == 0) return false;
+    if (!hwnd || hwnd != g_hwnd) return false;
+
+    view = ReadView();
+    if (!view.Valid()) return false;
+
+    // If the real client already matches the backbuffer, do nothing.
+    return view.clientW != view.virtW || view.clientH != view.virtH;
+}
+
+// GDI fill for the bars around a letterboxed image; Present only writes the dst rect.
+static void PaintBars(HWND hwnd, const RECT& client, const RECT& image) {
+    if (EqualRect(&client, &image)) return;
+    HDC dc = GetDC(hwnd);
+    if (!dc) return;
+
+    HBRUSH black = (HBRUSH)GetStockObject(BLACK_BRUSH);
+    const RECT bars[4] = {
+        { client.left, client.top, client.right, image.top },
+        { client.left, image.bottom, client.right, client.bottom },
+        { client.left, image.top, image.left, image.bottom },
+        { image.right, image.top, client.right, image.bottom },
+    };
+    for (const RECT& r : bars) {
+        if (r.right > r.left && r.bottom > r.top) FillRect(dc, &r, black);
+    }
+    ReleaseDC(hwnd, dc);
 }
 
 // =============================================================================
-// user32 hooks
+// Mouse policy
 // =============================================================================
 
-using ClipCursor_t = BOOL(WINAPI*)(const RECT*);
-using SetCapture_t = HWND(WINAPI*)(HWND);
-using SetCursorPos_t = BOOL(WINAPI*)(int, int);
-using CDSExA_t = LONG(WINAPI*)(LPCSTR, DEVMODEA*, HWND, DWORD, LPVOID);
-using CDSExW_t = LONG(WINAPI*)(LPCWSTR, DEVMODEW*, HWND, DWORD, LPVOID);
-using GetClientRect_t = BOOL(WINAPI*)(HWND, LPRECT);
-using ScreenToClient_t = BOOL(WINAPI*)(HWND, LPPOINT);
-using ClientToScreen_t = BOOL(WINAPI*)(HWND, LPPOINT);
+// Cursor clip/capture is only touched on real transitions (activation, focus,
+// size/move) reported by Hook_WndProc, plus a rate-limited re-check from the
+// Present hooks in case one was missed. The old policy re-applied every frame.
+struct MousePolicyStats {
+    volatile LONG64 frames;         // Present calls that consulted the policy
+    volatile LONG64 evaluations;    // times the policy was actually re-evaluated
+    volatile LONG64 syscalls;       // user32 calls issued by the policy
+    volatile LONG64 syscallsSaved;  // calls the per-frame policy would have made on top
+};
+static MousePolicyStats g_mouseStats{};
+
+struct MousePolicyState {
+    volatile LONG dirty = 1;        // set on transitions; forces a re-apply
+    volatile LONG busy = 0;         // WndProc and render thread may both apply
+    HWND hwnd = nullptr;            // window the applied state refers to
+    bool clipped = false;           // last applied: clipped to `clip`, else released
+    RECT clip{};
+    ULONGLONG nextCheckMs = 0;
+};
+static MousePolicyState g_mouse{};
 
-static ClipCursor_t      Real_ClipCursor = nullptr;
-static SetCapture_t      Real_SetCapture = nullptr;
-static SetCursorPos_t    Real_SetCursorPos = nullptr;
-static CDSExA_t          Real_ChangeDisplaySettingsExA = nullptr;
-static CDSExW_t          Real_ChangeDisplaySettingsExW = nullptr;
-static GetClientRect_t   Real_GetClientRect = nullptr;
-static ScreenToClient_t  Real_ScreenToClient = nullptr;
-static ClientToScreen_t  Real_ClientToScreen = nullptr;
+static const ULONGLONG kMousePolicyRecheckMs = 250;
 
-static BOOL GetClientRectRaw(HWND hwnd, RECT* rc) {
-    if (Real_GetClientRect) return Real_GetClientRect(hwnd, rc);
-    return ::GetClientRect(hwnd, rc);
-}
-static BOOL ScreenToClientRaw(HWND hwnd, POINT* pt) {
-    if (Real_ScreenToClient) return Real_ScreenToClient(hwnd, pt);
-    return ::ScreenToClient(hwnd, pt);
-}
-static BOOL ClientToScreenRaw(HWND hwnd, POINT* pt) {
-    if (Real_ClientToScreen) return Real_ClientToScreen(hwnd, pt);
-    return ::ClientToScreen(hwnd, pt);
+static void MousePolicyNotify() {
+    InterlockedExchange(&g_mouse.dirty, 1);
 }
 
-static void GetVirtualSize(LONG& w, LONG& h) {
-    w = InterlockedCompareExchange(&g_virtualW, 0, 0);
-    h = InterlockedCompareExchange(&g_virtualH, 0, 0);
+// Evaluates foreground/clip and touches the cursor only if the result changed
+// (or a transition forced it). Returns the number of user32 calls made.
+static LONG ApplyMousePolicyNow() {
+    if (!g_hwnd) return 0;
+    if (InterlockedCompareExchange(&g_mouse.busy, 1, 0) != 0) return 0;
+
+    const bool force = InterlockedExchange(&g_mouse.dirty, 0) != 0 || g_mouse.hwnd != g_hwnd;
+    LONG calls = 0;
+
+    bool wantClip = false;
+    RECT clip{};
+    if (!Cfg().disableClip) {
+        calls++;
+        if (IsGameForeground()) {
+            clip = GetClientRectScreen(g_hwnd);
+            calls += 3;
+            wantClip = (clip.right > clip.left && clip.bottom > clip.top);
+        }
+    }
+
+    if (wantClip) {
+        if (force || !g_mouse.clipped || memcmp(&clip, &g_mouse.clip, sizeof(clip)) != 0) {
+            ClipCursor(&clip);
+            calls++;
+        }
+        g_mouse.clipped = true;
+        g_mouse.clip = clip;
+    }
+    else if (force || g_mouse.clipped) {
+        ClipCursor(nullptr);
+        ::ReleaseCapture();
+        calls += 2;
+        g_mouse.clipped = false;
+    }
+
+    g_mouse.hwnd = g_hwnd;
+    g_mouse.nextCheckMs = GetTickCount64() + kMousePolicyRecheckMs;
+
+    InterlockedIncrement64(&g_mouseStats.evaluations);
+    InterlockedExchangeAdd64(&g_mouseStats.syscalls, calls);
+    InterlockedExchange(&g_mouse.busy, 0);
+    return calls;
 }
 
-static bool GetActualClientSize(HWND hwnd, LONG& w, LONG& h) {
-    if (!hwnd || !IsWindow(hwnd)) return false;
-    RECT rc{};
-    if (!GetClientRectRaw(hwnd, &rc)) return false;
-    w = rc.right - rc.left;
-    h = rc.bottom - rc.top;
-    return (w > 0 && h > 0);
+// Deactivation: drop clip/capture immediately; the next evaluation settles the state.
+static void MousePolicyOnDeactivate() {
+    ClipCursor(nullptr);
+    ::ReleaseCapture();
+    InterlockedExchangeAdd64(&g_mouseStats.syscalls, 2);
+    MousePolicyNotify();
 }
 
-static bool ShouldVirtualizeWin32(HWND hwnd) {
-    if (InterlockedCompareExchange(&g_win32VirtEnabled, 0, 0) == 0) return false;
-    if (!hwnd) return false;
-    if (!g_hwnd || !IsWindow(g_hwnd)) return false;
-    if (hwnd != g_hwnd) return false;
+// Per-frame entry point from the Present hooks.
+static void UpdateMousePolicy() {
+    if (!g_hwnd) return;
+    InterlockedIncrement64(&g_mouseStats.frames);
 
-    LONG vw = 0, vh = 0;
-    GetVirtualSize(vw, vh);
-    if (vw <= 0 || vh <= 0) return false;
+    // What the per-frame policy cost: GetForegroundWindow, then either
+    // ClipCursor+ReleaseCapture or GetClientRect+2x ClientToScreen+ClipCursor.
+    const LONG legacyCalls = Cfg().disableClip ? 2 : (g_mouse.clipped ? 5 : 3);
 
-    // If the real client already matches the backbuffer, do nothing.
-    LONG aw = 0, ah = 0;
-    if (GetActualClientSize(hwnd, aw, ah) && aw == vw && ah == vh) {
-        return false;
+    LONG calls = 0;
+    const bool idle = (g_mouse.dirty == 0 && g_mouse.hwnd == g_hwnd);
+
+    // Released mode doesn't depend on foreground, so there is nothing to re-check.
+    if (!idle || (!Cfg().disableClip && GetTickCount64() >= g_mouse.nextCheckMs)) {
+        calls = ApplyMousePolicyNow();
     }
 
-    return true;
+    if (legacyCalls > calls) {
+        InterlockedExchangeAdd64(&g_mouseStats.syscallsSaved, legacyCalls - calls);
+    }
 }
 
-static BOOL WINAPI Hook_GetClientRect(HWND hwnd, LPRECT rc) {
-    BOOL ok = GetClientRectRaw(hwnd, rc);
-    if (!ok || !rc) return ok;
+static void LogMousePolicyStats() {
+    DebugLog("mouse policy: frames=%lld evaluations=%lld syscalls=%lld saved=%lld\n",
+        (long long)g_mouseStats.frames, (long long)g_mouseStats.evaluations,
+        (long long)g_mouseStats.syscalls, (long long)g_mouseStats.syscallsSaved);
+}
 
-    if (ShouldVirtualizeWin32(hwnd)) {
-        LONG vw = 0, vh = 0;
-        GetVirtualSize(vw, vh);
-        if (vw > 0 && vh > 0) {
-            rc->left = 0;
-            rc->top = 0;
-            rc->right = vw;
-            rc->bottom = vh;
-        }
+// =============================================================================
+// Frame timing
+// =============================================================================
+
+// Which Present route a frame took; reported alongside the percentiles.
+enum FramePath : LONG {
+    kPathDeviceFast = 0,   // Hook_Present with current cached DeviceState
+    kPathDeviceSlow,       // Hook_Present re-deriving window/rects
+    kPathSwapChain,        // Hook_SwapChainPresent
+    kPathScaled,           // either hook, via the GPU scaling swapchain
+    kPathCount
+};
+
+// Filled on the Present thread; only published to the ring when FrameStats=1.
+struct FrameSample {
+    LONGLONG start = 0;      // hook entry
+    LONGLONG realStart = 0;  // around Real_Present / Real_SwapChainPresent
+    LONGLONG realEnd = 0;
+    FramePath path = kPathDeviceSlow;
+};
+
+// Each slot is a tiny seqlock: seq is zeroed while the producer writes and set
+// to (index + 1) once the record is complete, so the reader can spot torn or
+// overwritten slots without the Present path ever blocking.
+struct FrameRecord {
+    volatile LONG64 seq;
+    LONGLONG start;
+    LONGLONG end;
+    LONGLONG realTicks;
+    LONG path;
+};
+
+static constexpr LONG64 kFrameRingSize = 2048;  // power of two
+static constexpr DWORD kFrameDrainMs = 250;     // ring covers 8k fps at this rate
+static constexpr DWORD kFrameReportMs = 5000;
+
+static FrameRecord g_frameRing[kFrameRingSize];
+static volatile LONG64 g_frameHead = 0;
+static volatile LONG g_frameStatsThread = 0;   // 1 while FrameStatsThread runs
+static HANDLE g_frameStatsStop = nullptr;       // manual-reset; set to end the thread
+
+static DWORD WINAPI FrameStatsThread(void*);
+
+// The first recorded frame starts the aggregator, so FrameStats turned on by
+// a reload needs no extra hook-up.
+static void RecordFrame(FrameSample& fs) {
+    if (!Cfg().frameStats) return;
+
+    if (InterlockedCompareExchange(&g_frameStatsThread, 1, 0) == 0) {
+        if (!g_frameStatsStop) g_frameStatsStop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        else ResetEvent(g_frameStatsStop);
+
+        HANDLE th = g_frameStatsStop ? CreateThread(nullptr, 0, &FrameStatsThread, nullptr, 0, nullptr) : nullptr;
+        if (th) CloseHandle(th);
     }
-    return ok;
+
+    const LONG64 idx = InterlockedIncrement64(&g_frameHead) - 1;
+    FrameRecord& r = g_frameRing[idx & (kFrameRingSize - 1)];
+
+    InterlockedExchange64(&r.seq, 0);
+    r.start = fs.start;
+    r.end = QpcNow();
+    r.realTicks = fs.realEnd - fs.realStart;
+    r.path = fs.path;
+    InterlockedExchange64(&r.seq, idx + 1);
 }
 
-static BOOL WINAPI Hook_ScreenToClient(HWND hwnd, LPPOINT pt) {
-    BOOL ok = ScreenToClientRaw(hwnd, pt);
-    if (!ok || !pt) return ok;
+// Aggregator-side state; only touched by FrameStatsThread.
+struct FrameWindow {
+    std::vector<double> frameMs;      // start-to-start intervals
+    double presentUsSum = 0.0;        // time spent in the real Present
+    double hookUsSum = 0.0;           // hook entry to exit
+    LONG64 paths[kPathCount]{};
+    LONG64 dropped = 0;
+    LONGLONG lastStart = 0;
+    LONG64 tail = 0;
+};
 
-    if (ShouldVirtualizeWin32(hwnd)) {
-        LONG vw = 0, vh = 0;
-        GetVirtualSize(vw, vh);
+static void DrainFrameRing(FrameWindow& w) {
+    const LONG64 head = InterlockedCompareExchange64(&g_frameHead, 0, 0);
 
-        LONG aw = 0, ah = 0;
-        if (vw > 0 && vh > 0 && GetActualClientSize(hwnd, aw, ah)) {
-            pt->x = MulDiv(pt->x, vw, aw);
-            pt->y = MulDiv(pt->y, vh, ah);
-        }
+    // Fell a full lap behind: everything older than one ring is gone.
+    if (head - w.tail > kFrameRingSize) {
+        w.dropped += head - kFrameRingSize - w.tail;
+        w.tail = head - kFrameRingSize;
+        w.lastStart = 0;
     }
-    return ok;
-}
 
-static BOOL WINAPI Hook_ClientToScreen(HWND hwnd, LPPOINT pt) {
-    if (!pt) return ClientToScreenRaw(hwnd, pt);
+    for (; w.tail < head; w.tail++) {
+        FrameRecord& r = g_frameRing[w.tail & (kFrameRingSize - 1)];
+        const LONG64 want = w.tail + 1;
+
+        const LONG64 seq = InterlockedCompareExchange64(&r.seq, 0, 0);
+        if (seq != want) {
+            if (seq < want) break;  // claimed but not published yet; retry next drain
+            w.dropped++;            // already overwritten by a later frame
+            w.lastStart = 0;
+            continue;
+        }
+
+        const FrameRecord copy = { 0, r.start, r.end, r.realTicks, r.path };
+        if (InterlockedCompareExchange64(&r.seq, 0, 0) != want) {
+            w.dropped++;
+            w.lastStart = 0;
+            continue;
+        }
 
-    if (ShouldVirtualizeWin32(hwnd)) {
-        LONG vw = 0, vh = 0;
-        GetVirtualSize(vw, vh);
-
-        LONG aw = 0, ah = 0;
-        if (vw > 0 && vh > 0 && GetActualClientSize(hwnd, aw, ah)) {
-            POINT p = *pt;
-            p.x = MulDiv(p.x, aw, vw);
-            p.y = MulDiv(p.y, ah, vh);
-            BOOL ok = ClientToScreenRaw(hwnd, &p);
-            if (ok) *pt = p;
-            return ok;
+        if (w.lastStart && copy.start > w.lastStart) {
+            w.frameMs.push_back(QpcToUs(copy.start - w.lastStart) / 1000.0);
         }
+        w.lastStart = copy.start;
+        w.presentUsSum += QpcToUs(copy.realTicks);
+        w.hookUsSum += QpcToUs(copy.end - copy.start);
+        if (copy.path >= 0 && copy.path < kPathCount) w.paths[copy.path]++;
     }
-    return ClientToScreenRaw(hwnd, pt);
 }
 
-static BOOL WINAPI Hook_ClipCursor(const RECT* r) {
-    if (g_cfg.disableClip && r != nullptr) {
-        if (Real_ClipCursor) Real_ClipCursor(nullptr);
-        return TRUE;
-    }
-    return Real_ClipCursor ? Real_ClipCursor(r) : TRUE;
+static double PercentileMs(std::vector<double>& v, double p) {
+    size_t k = (size_t)(p * (double)(v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
 }
 
-static HWND WINAPI Hook_SetCapture(HWND hwnd) {
-    if (g_cfg.disableClip || (g_hwnd && GetRealForegroundWindow() != g_hwnd)) {
-        ::ReleaseCapture();
-        return nullptr;
+static void ReportFrameWindow(FrameWindow& w) {
+    LONG64 frames = 0;
+    for (LONG64 n : w.paths) frames += n;
+    std::vector<double>& v = w.frameMs;
+
+    if (!v.empty()) {
+        double sum = 0.0;
+        for (double ms : v) sum += ms;
+        const double avg = sum / (double)v.size();
+
+        const double p50 = PercentileMs(v, 0.50);
+        const double p95 = PercentileMs(v, 0.95);
+        const double p99 = PercentileMs(v, 0.99);
+
+        // 1% low: average fps over the slowest 1% of frames (at least one).
+        const size_t worst = (std::max)((size_t)1, v.size() / 100);
+        std::nth_element(v.begin(), v.begin() + (v.size() - worst), v.end());
+        double worstSum = 0.0;
+        for (size_t i = v.size() - worst; i < v.size(); i++) worstSum += v[i];
+        const double low1 = worstSum > 0.0 ? 1000.0 * (double)worst / worstSum : 0.0;
+
+        DebugLog("frames: n=%lld avg=%.2fms (%.1f fps) p50=%.2f p95=%.2f p99=%.2f 1%%low=%.1f fps\n",
+            (long long)v.size(), avg, avg > 0.0 ? 1000.0 / avg : 0.0, p50, p95, p99, low1);
     }
-    return Real_SetCapture ? Real_SetCapture(hwnd) : hwnd;
-}
 
-static BOOL WINAPI Hook_SetCursorPos(int x, int y) {
-    if (g_hwnd && GetRealForegroundWindow() != g_hwnd) {
-        return TRUE;
+    if (frames > 0) {
+        DebugLog("frames: present=%.1fus hook=%.1fus fast=%lld slow=%lld swapchain=%lld scaled=%lld dropped=%lld\n",
+            w.presentUsSum / (double)frames, w.hookUsSum / (double)frames,
+            (long long)w.paths[kPathDeviceFast], (long long)w.paths[kPathDeviceSlow],
+            (long long)w.paths[kPathSwapChain], (long long)w.paths[kPathScaled], (long long)w.dropped);
     }
-    return Real_SetCursorPos ? Real_SetCursorPos(x, y) : TRUE;
-}
 
-static bool LooksLikeModeSwitchA(const DEVMODEA* dm) {
-    if (!dm) return false;
-    DWORD f = dm->dmFields;
-    return (f & (DM_PELSWIDTH | DM_PELSHEIGHT | DM_BITSPERPEL | DM_DISPLAYFREQUENCY)) != 0;
+    v.clear();
+    w.presentUsSum = w.hookUsSum = 0.0;
+    for (LONG64& n : w.paths) n = 0;
+    w.dropped = 0;
 }
 
-static bool LooksLikeModeSwitchW(const DEVMODEW* dm) {
-    if (!dm) return false;
-    DWORD f = dm->dmFields;
-    return (f & (DM_PELSWIDTH | DM_PELSHEIGHT | DM_BITSPERPEL | DM_DISPLAYFREQUENCY)) != 0;
+static DWORD WINAPI FrameStatsThread(void*) {
+    FrameWindow w;
+    w.frameMs.reserve(8192);
+
+    // A restarted aggregator only reports frames from its own run.
+    w.tail = InterlockedCompareExchange64(&g_frameHead, 0, 0);
+
+    ULONGLONG nextReport = GetTickCount64() + kFrameReportMs;
+    while (WaitForSingleObject(g_frameStatsStop, kFrameDrainMs) == WAIT_TIMEOUT) {
+        DrainFrameRing(w);
+
+        if (GetTickCount64() >= nextReport) {
+            ReportFrameWindow(w);
+            nextReport = GetTickCount64() + kFrameReportMs;
+        }
+    }
+
+    // Flush the partial window so the last seconds before the switch-off show up.
+    DrainFrameRing(w);
+    ReportFrameWindow(w);
+    InterlockedExchange(&g_frameStatsThread, 0);
+    return 0;
 }
 
-static LONG WINAPI Hook_ChangeDisplaySettingsExA(LPCSTR dev, DEVMODEA* dm, HWND hwnd, DWORD flags, LPVOID param) {
-    if ((flags & CDS_FULLSCREEN) || LooksLikeModeSwitchA(dm)) {
-        return DISP_CHANGE_SUCCESSFUL;
+// Called by a reload that turns FrameStats off.
+static void StopFrameStats() {
+    if (InterlockedCompareExchange(&g_frameStatsThread, 0, 0) && g_frameStatsStop) {
+        SetEvent(g_frameStatsStop);
+    }
+}
+
+// =============================================================================
+// Call trace
+// =============================================================================
+//
+// Opt-in recorder for what the game asks of the proxy. Each traced detour
+// appends one fixed 64-byte record to a ring in a memory-mapped file, so the
+// writer never blocks on I/O and costs two interlocked operations plus the
+// stores. The memory manager writes the pages back on its own, including when
+// the game crashes, which is when a trace is most useful.
+//
+// d3d9_trace_<pid>.bin: TraceHeader, then `capacity` TraceRecords. `head`
+// counts records ever claimed; record n lives at n & (capacity - 1). Its
+// `seq` is stored last, as n + 1, so a reader takes a slot as record n only
+// if seq says so: a record still being written, or torn by the process
+// dying, keeps the seq of whatever the slot held before. Arguments are
+// 64-bit so handles and pointers from 64-bit games survive.
+
+enum TraceKind : WORD {
+    kTracePresent = 1,      // hOverride, has src/dst/dirty bits, src wh, dst wh
+    kTraceSwapChainPresent, // hOverride, has src/dst/dirty bits, src wh, dst wh
+    kTraceSetViewport,      // X, Y, Width, Height
+    kTraceReset,            // backbuffer wh, Windowed, SwapEffect, flags
+    kTraceCreateDevice,     // adapter | type << 16, behavior, backbuffer wh, Windowed
+    kTraceGetClientRect,    // hwnd
+    kTraceScreenToClient,   // hwnd, x, y
+    kTraceClientToScreen,   // hwnd, x, y
+    kTraceWndProc,          // hwnd, msg, wParam, lParam
+    kTraceGetDeviceState,   // device, cbData
+    kTracePoll,             // device
+};
+
+static const DWORD kTraceMagic = 0x52543944; // 'D9TR'
+static const WORD kTraceVersion = 2;
+
+struct TraceHeader {
+    DWORD magic;
+    WORD version;
+    WORD recordSize;
+    LONG64 qpcFreq;
+    LONG64 capacity;        // records, power of two
+    volatile LONG64 head;
+    DWORD pid;
+    DWORD reserved[7];
+};
+
+struct TraceRecord {
+    volatile LONG64 seq;    // record number + 1 once the rest is written
+    LONG64 qpc;
+    WORD kind;
+    WORD flags;
+    DWORD tid;
+    UINT64 arg[4];
+    UINT64 reserved;        // pads a record to one cache line
+};
+
+static_assert(sizeof(TraceHeader) == 64, "trace header layout");
+static_assert(sizeof(TraceRecord) == 64, "trace record layout");
+
+static TraceHeader* g_trace = nullptr;
+static TraceRecord* g_traceRecords = nullptr;
+
+static inline UINT64 TraceWH(LONG w, LONG h) {
+    return ((DWORD)(WORD)w << 16) | (DWORD)(WORD)h;
+}
+
+static inline UINT64 TracePtr(const void* p) {
+    return (UINT64)(ULONG_PTR)p;
+}
+
+static void Trace(TraceKind kind, UINT64 a0 = 0, UINT64 a1 = 0, UINT64 a2 = 0, UINT64 a3 = 0, WORD flags = 0) {
+    TraceHeader* t = g_trace;
+    if (!t) return;
+
+    const LONG64 n = InterlockedIncrement64(&t->head) - 1;
+    TraceRecord& r = g_traceRecords[n & (t->capacity - 1)];
+    r.qpc = QpcNow();
+    r.kind = kind;
+    r.flags = flags;
+    r.tid = GetCurrentThreadId();
+    r.arg[0] = a0;
+    r.arg[1] = a1;
+    r.arg[2] = a2;
+    r.arg[3] = a3;
+    // Publishes the payload: the exchange orders every store above before it.
+    InterlockedExchange64(&r.seq, n + 1);
+}
+
+static void TracePresent(TraceKind kind, HWND hOverride, const RECT* src, const RECT* dst, const RGNDATA* dirty) {
+    if (!g_trace) return;
+    const DWORD has = (src ? 1u : 0u) | (dst ? 2u : 0u) | (dirty ? 4u : 0u);
+    Trace(kind, TracePtr(hOverride), has,
+        src ? TraceWH(src->right - src->left, src->bottom - src->top) : 0,
+        dst ? TraceWH(dst->right - dst->left, dst->bottom - dst->top) : 0);
+}
+
+// Sized once at startup; turning [Trace] Enabled on by reload takes effect next launch.
+static void StartTrace(const Config& cfg) {
+    if (!cfg.trace) return;
+
+    char path[MAX_PATH];
+    lstrcpynA(path, g_cfgPath, MAX_PATH);
+    char* slash = strrchr(path, '\\');
+    const int dirLen = slash ? (int)(slash + 1 - path) : 0;
+    snprintf(path + dirLen, MAX_PATH - dirLen, "d3d9_trace_%lu.bin", GetCurrentProcessId());
+
+    // Largest power-of-two record count that fits the configured size.
+    LONG64 capacity = 1;
+    const LONG64 room = ((LONG64)cfg.traceSizeMB << 20) - (LONG64)sizeof(TraceHeader);
+    while (capacity * (LONG64)sizeof(TraceRecord) <= room) capacity *= 2;
+    capacity /= 2;
+    const LONG64 bytes = (LONG64)sizeof(TraceHeader) + capacity * (LONG64)sizeof(TraceRecord);
+
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        DebugLog("trace: cannot create %s (%lu)\n", path, GetLastError());
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        (DWORD)(bytes >> 32), (DWORD)bytes, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        DebugLog("trace: cannot map %s (%lu)\n", path, GetLastError());
+        return;
+    }
+
+    // The view keeps the mapping (and the file) alive for the life of the process.
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        DebugLog("trace: cannot map view (%lu)\n", GetLastError());
+        return;
+    }
+
+    TraceHeader* t = static_cast<TraceHeader*>(view);
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    t->magic = kTraceMagic;
+    t->version = kTraceVersion;
+    t->recordSize = (WORD)sizeof(TraceRecord);
+    t->qpcFreq = f.QuadPart;
+    t->capacity = capacity;
+    t->head = 0;
+    t->pid = GetCurrentProcessId();
+
+    g_traceRecords = reinterpret_cast<TraceRecord*>(t + 1);
+    g_trace = t;
+    DebugLog("trace: %s, %lld records\n", path, (long long)capacity);
+}
+
+// =============================================================================
+// Frame pacing
+// =============================================================================
+
+// Time source for FramePacer. Kept behind function pointers so the pacing
+// math can be driven by a fake clock.
+struct PacingClock {
+    LONGLONG freq = 0;                                  // ticks per second
+    LONGLONG (*now)(void* ctx) = nullptr;
+    void (*sleep)(void* ctx, LONGLONG ticks) = nullptr; // coarse, may overshoot
+    void (*spin)(void* ctx) = nullptr;                  // one busy-wait step
+    void* ctx = nullptr;
+};
+
+// Schedules frames on absolute deadlines (last + interval) rather than
+// "sleep for interval", so wake-up error doesn't accumulate across frames.
+struct FramePacer {
+    PacingClock clock;
+    PacingMode mode = kPacingHybrid;
+    LONGLONG interval = 0;   // ticks per frame
+    LONGLONG spinTicks = 0;  // hybrid: wake this far ahead of the deadline, then spin
+    LONGLONG last = 0;       // deadline of the previous frame
+
+    void Configure(const PacingClock& c, int fps, PacingMode m, LONGLONG spinUs) {
+        clock = c;
+        mode = m;
+        interval = fps > 0 ? c.freq / fps : 0;
+        spinTicks = c.freq * spinUs / 1000000;
+        last = 0;
+    }
+
+    LONGLONG NextDeadline(LONGLONG now) {
+        LONGLONG next = last + interval;
+        // First frame, or more than a frame behind: resync instead of bursting to catch up.
+        if (last == 0 || now - next > interval) next = now;
+        last = next;
+        return next;
+    }
+
+    // Blocks until the next deadline. Returns the ticks spent waiting.
+    LONGLONG Wait() {
+        if (interval <= 0) return 0;
+
+        const LONGLONG t0 = clock.now(clock.ctx);
+        const LONGLONG due = NextDeadline(t0);
+        LONGLONG now = t0;
+
+        if (mode != kPacingSpin) {
+            const LONGLONG margin = (mode == kPacingHybrid) ? spinTicks : 0;
+            if (due - now > margin) {
+                clock.sleep(clock.ctx, due - now - margin);
+                now = clock.now(clock.ctx);
+            }
+        }
+        if (mode != kPacingTimer) {
+            while (now < due) {
+                clock.spin(clock.ctx);
+                now = clock.now(clock.ctx);
+            }
+        }
+        return now - t0;
+    }
+};
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static FramePacer g_pacer;
+static HANDLE g_pacerTimer = nullptr;
+static LONGLONG g_pacerFreq = 0;
+static volatile LONG g_pacerBusy = 0;
+static bool g_pacerReady = false;
+static bool g_pacerHires = false;
+static bool g_pacerPeriod = false;      // a timeBeginPeriod(1) is outstanding
+static LONGLONG g_pacerSpinUs = 1000;
+static LONG g_pacerGeneration = -1;
+
+static LONGLONG PacerNow(void*) { return QpcNow(); }
+
+static void PacerSleep(void*, LONGLONG ticks) {
+    // Relative due time in 100ns units.
+    LARGE_INTEGER due;
+    due.QuadPart = -(ticks * 10000000 / g_pacerFreq);
+    if (due.QuadPart >= 0) return;
+
+    if (g_pacerTimer && SetWaitableTimer(g_pacerTimer, &due, 0, nullptr, nullptr, FALSE)) {
+        WaitForSingleObject(g_pacerTimer, INFINITE);
+    }
+    else {
+        Sleep((DWORD)(-due.QuadPart / 10000));
+    }
+}
+
+static void PacerSpin(void*) { YieldProcessor(); }
+
+static void InitPacer() {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    g_pacerFreq = f.QuadPart;
+
+    // High-resolution timers (Win10 1803+) wake within ~0.5ms; older systems
+    // fall back to a plain timer with the system tick raised to 1ms while
+    // pacing sleeps (see SetPacerPeriod).
+    LONGLONG spinUs = 1000;
+    g_pacerTimer = CreateWaitableTimerExW(nullptr, nullptr,
+        CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    const bool hires = g_pacerTimer != nullptr;
+    if (!hires) {
+        g_pacerTimer = CreateWaitableTimerW(nullptr, FALSE, nullptr);
+        spinUs = 2000;
+    }
+
+    g_pacerHires = hires;
+    g_pacerSpinUs = spinUs;
+    g_pacerReady = true;
+    DebugLog("pacing: spin=%lldus, hires timer=%d\n", (long long)spinUs, hires ? 1 : 0);
+}
+
+// The raised system tick costs power machine-wide, so it is only held while a
+// timer-based mode is actually pacing frames.
+static void SetPacerPeriod(bool raise) {
+    if (raise == g_pacerPeriod) return;
+    if (raise) timeBeginPeriod(1);
+    else timeEndPeriod(1);
+    g_pacerPeriod = raise;
+}
+
+// Re-run whenever a reload publishes a new snapshot; the pacer keeps no
+// pointer into the Config it was built from, only its generation.
+static void ConfigurePacer(const Config& cfg) {
+    PacingClock c;
+    c.freq = g_pacerFreq;
+    c.now = &PacerNow;
+    c.sleep = &PacerSleep;
+    c.spin = &PacerSpin;
+    g_pacer.Configure(c, cfg.pacingFps, cfg.pacingMode, g_pacerSpinUs);
+    g_pacerGeneration = cfg.generation;
+    SetPacerPeriod(!g_pacerHires && cfg.pacingFps > 0 && cfg.pacingMode != kPacingSpin);
+
+    DebugLog("pacing: %d fps, mode=%d\n", cfg.pacingFps, (int)cfg.pacingMode);
+}
+
+// Called at the top of the Present hooks. A Present racing in from a second
+// thread skips pacing rather than queueing behind the first.
+static void PaceFrame() {
+    const Config& cfg = Cfg();
+    if (cfg.pacingFps <= 0) {
+        // Pacing was switched off by a reload: drop the raised tick once.
+        if (g_pacerPeriod && InterlockedCompareExchange(&g_pacerBusy, 1, 0) == 0) {
+            ConfigurePacer(cfg);
+            InterlockedExchange(&g_pacerBusy, 0);
+        }
+        return;
+    }
+    if (InterlockedCompareExchange(&g_pacerBusy, 1, 0) != 0) return;
+
+    if (!g_pacerReady) InitPacer();
+    if (g_pacerGeneration != cfg.generation) ConfigurePacer(cfg);
+    g_pacer.Wait();
+
+    InterlockedExchange(&g_pacerBusy, 0);
+}
+
+// =============================================================================
+// High-poll-rate mouse
+// =============================================================================
+
+// A 4-8 kHz mouse hands the game a WM_MOUSEMOVE on nearly every pump iteration.
+// With HighPollMouse=1 only the first move of each frame is delivered; later
+// ones overwrite a pending slot, which is flushed ahead of the next button or
+// wheel message (so clicks land at the right spot) or posted at the next Present.
+
+struct MouseCoalesceStats {
+    volatile LONG64 moves;       // WM_MOUSEMOVE seen
+    volatile LONG64 delivered;   // passed straight through
+    volatile LONG64 merged;      // dropped in favour of a newer position
+    volatile LONG64 flushed;     // pending position delivered later
+    volatile LONG64 rawScaled;   // WM_INPUT mouse packets rescaled
+};
+static MouseCoalesceStats g_coalesceStats{};
+
+// Packed (raw client coords, not yet virtualized): valid bit | keys << 32 | lParam.
+static volatile LONG64 g_pendingMove = 0;
+static LONG64 g_lastMoveFrame = -1;   // window thread only
+static constexpr LONG64 kPendingMoveValid = (LONG64)1 << 62;
+
+static LPARAM MouseLParamToVirtual(const ViewTransform& view, LPARAM lParam) {
+    POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+    p = view.ToVirtual(p);
+    return MAKELPARAM((short)p.x, (short)p.y);
+}
+
+// True if the move was parked in the pending slot instead of delivered.
+static bool CoalesceMouseMove(WPARAM wParam, LPARAM lParam) {
+    InterlockedIncrement64(&g_coalesceStats.moves);
+
+    const LONG64 frame = InterlockedCompareExchange64(&g_presentTotal, 0, 0);
+    if (frame != g_lastMoveFrame) {
+        g_lastMoveFrame = frame;
+        // This move supersedes anything still pending.
+        if (InterlockedExchange64(&g_pendingMove, 0) != 0) InterlockedIncrement64(&g_coalesceStats.merged);
+        InterlockedIncrement64(&g_coalesceStats.delivered);
+        return false;
+    }
+
+    const LONG64 packed = kPendingMoveValid | ((LONG64)(wParam & 0xFFFF) << 32) | (LONG64)(DWORD)lParam;
+    if (InterlockedExchange64(&g_pendingMove, packed) != 0) InterlockedIncrement64(&g_coalesceStats.merged);
+    return true;
+}
+
+// Window thread: deliver the pending move synchronously, ahead of a button/wheel message.
+static void FlushPendingMove(HWND hwnd) {
+    const LONG64 m = InterlockedExchange64(&g_pendingMove, 0);
+    if (!m) return;
+    InterlockedIncrement64(&g_coalesceStats.flushed);
+
+    LPARAM lParam = (LPARAM)(DWORD)m;
+    ViewTransform view;
+    if (ShouldVirtualizeWin32(hwnd, view)) lParam = MouseLParamToVirtual(view, lParam);
+    CallWindowProc(g_origWndProc, hwnd, WM_MOUSEMOVE, (WPARAM)((m >> 32) & 0xFFFF), lParam);
+}
+
+// Present hooks: hand the last position of the frame back to the window. It
+// arrives in the next frame, so Hook_WndProc delivers (and virtualizes) it.
+static void PostPendingMove() {
+    if (!Cfg().highPollMouse || !g_hwnd) return;
+    const LONG64 m = InterlockedExchange64(&g_pendingMove, 0);
+    if (!m) return;
+    InterlockedIncrement64(&g_coalesceStats.flushed);
+    PostMessage(g_hwnd, WM_MOUSEMOVE, (WPARAM)((m >> 32) & 0xFFFF), (LPARAM)(DWORD)m);
+}
+
+using GetRawInputData_t = UINT(WINAPI*)(HRAWINPUT, UINT, LPVOID, PUINT, UINT);
+static GetRawInputData_t Real_GetRawInputData = nullptr;
+
+// Sub-unit remainders so slow movement isn't rounded away (window thread only).
+static LONGLONG g_rawRemX = 0, g_rawRemY = 0;
+
+// The last packet scaled. Games may read one HRAWINPUT more than once; a
+// repeat gets the same deltas instead of adding to the remainders again.
+struct RawScaled {
+    HRAWINPUT h;
+    LONG inX, inY;      // as user32 returned them
+    LONG outX, outY;
+};
+static RawScaled g_rawLast{};
+
+static LONG ScaleRawDelta(LONG d, LONG num, LONG den, LONGLONG& rem) {
+    const LONGLONG scaled = (LONGLONG)d * num + rem;
+    const LONG q = ViewTransform::FloorDiv(scaled, den);
+    rem = scaled - (LONGLONG)q * den;
+    return q;
+}
+
+// Relative raw mouse deltas are scaled by the same factor as WM_MOUSEMOVE, so
+// a cursor the game drives from WM_INPUT moves at the speed of the real one.
+// Absolute packets are normalized to the desktop and left alone.
+static UINT WINAPI Hook_GetRawInputData(HRAWINPUT h, UINT cmd, LPVOID data, PUINT size, UINT headerSize) {
+    UINT n = Real_GetRawInputData(h, cmd, data, size, headerSize);
+    if (cmd != RID_INPUT || !data || n == (UINT)-1 || n < sizeof(RAWINPUTHEADER) + sizeof(RAWMOUSE)) return n;
+
+    RAWINPUT* ri = static_cast<RAWINPUT*>(data);
+    if (ri->header.dwType != RIM_TYPEMOUSE || (ri->data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)) return n;
+
+    ViewTransform view;
+    if (!ShouldVirtualizeWin32(g_hwnd, view)) return n;
+
+    RAWMOUSE& m = ri->data.mouse;
+    if (h == g_rawLast.h && m.lLastX == g_rawLast.inX && m.lLastY == g_rawLast.inY) {
+        m.lLastX = g_rawLast.outX;
+        m.lLastY = g_rawLast.outY;
+        return n;
+    }
+
+    g_rawLast.h = h;
+    g_rawLast.inX = m.lLastX;
+    g_rawLast.inY = m.lLastY;
+    m.lLastX = g_rawLast.outX = ScaleRawDelta(m.lLastX, view.virtW, view.imageW, g_rawRemX);
+    m.lLastY = g_rawLast.outY = ScaleRawDelta(m.lLastY, view.virtH, view.imageH, g_rawRemY);
+    InterlockedIncrement64(&g_coalesceStats.rawScaled);
+    return n;
+}
+
+static void LogMouseCoalesceStats() {
+    if (!Cfg().highPollMouse) return;
+    DebugLog("mouse coalesce: moves=%lld delivered=%lld merged=%lld flushed=%lld raw scaled=%lld\n",
+        (long long)g_coalesceStats.moves, (long long)g_coalesceStats.delivered,
+        (long long)g_coalesceStats.merged, (long long)g_coalesceStats.flushed,
+        (long long)g_coalesceStats.rawScaled);
+}
+
+// =============================================================================
+// Message classification
+// =============================================================================
+
+// What Hook_WndProc has to do for a message, looked up in a table built at
+// compile time. Passthrough messages (timers, paint, IME, hit-testing, and
+// everything >= WM_USER) go straight to the game's WndProc.
+enum MsgClass : BYTE {
+    kMsgPassthrough = 0,
+    kMsgMouseCoord,     // client-coordinate mouse messages: coalescing + virtualization
+    kMsgMouseOther,     // wheel: screen coordinates, only orders against coalesced moves
+    kMsgWindow,         // size/move/activation/focus/cursor/destroy: handled in the switch
+};
+
+struct MsgTable {
+    BYTE cls[WM_USER];
+};
+
+static constexpr MsgTable BuildMsgTable() {
+    MsgTable t{};
+    const UINT mouseCoord[] = {
+        WM_MOUSEMOVE,
+        WM_LBUTTONDOWN, WM_LBUTTONUP, WM_LBUTTONDBLCLK,
+        WM_RBUTTONDOWN, WM_RBUTTONUP, WM_RBUTTONDBLCLK,
+        WM_MBUTTONDOWN, WM_MBUTTONUP, WM_MBUTTONDBLCLK,
+        WM_XBUTTONDOWN, WM_XBUTTONUP, WM_XBUTTONDBLCLK,
+    };
+    const UINT mouseOther[] = { WM_MOUSEWHEEL, WM_MOUSEHWHEEL };
+    const UINT window[] = {
+        WM_SETCURSOR, WM_SIZE, WM_WINDOWPOSCHANGED, WM_MOVE, WM_EXITSIZEMOVE,
+        WM_ACTIVATEAPP, WM_ACTIVATE, WM_SETFOCUS, WM_KILLFOCUS, WM_DESTROY,
+    };
+    for (UINT m : mouseCoord) t.cls[m] = kMsgMouseCoord;
+    for (UINT m : mouseOther) t.cls[m] = kMsgMouseOther;
+    for (UINT m : window) t.cls[m] = kMsgWindow;
+    return t;
+}
+
+static constexpr MsgTable g_msgTable = BuildMsgTable();
+
+static_assert(g_msgTable.cls[WM_TIMER] == kMsgPassthrough, "timers must pass through");
+static_assert(g_msgTable.cls[WM_NCHITTEST] == kMsgPassthrough, "hit-testing must pass through");
+static_assert(g_msgTable.cls[WM_XBUTTONDBLCLK] == kMsgMouseCoord, "mouse table out of sync");
+
+static MsgClass ClassifyMessage(UINT msg) {
+    return msg < WM_USER ? (MsgClass)g_msgTable.cls[msg] : kMsgPassthrough;
+}
+
+// =============================================================================
+// WndProc hook
+// =============================================================================
+
+static LRESULT CALLBACK Hook_WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    Trace(kTraceWndProc, TracePtr(hwnd), msg, (UINT64)wParam, (UINT64)lParam);
+
+    const MsgClass cls = ClassifyMessage(msg);
+    if (cls == kMsgPassthrough) {
+        return CallWindowProc(g_origWndProc, hwnd, msg, wParam, lParam);
+    }
+
+    if (cls != kMsgWindow) {
+        if (Cfg().highPollMouse && hwnd == g_hwnd) {
+            if (msg == WM_MOUSEMOVE) {
+                if (CoalesceMouseMove(wParam, lParam)) return 0;
+            }
+            else {
+                FlushPendingMove(hwnd);
+            }
+        }
+
+        ViewTransform view;
+        if (cls == kMsgMouseCoord && ShouldVirtualizeWin32(hwnd, view)) {
+            lParam = MouseLParamToVirtual(view, lParam);
+        }
+        return CallWindowProc(g_origWndProc, hwnd, msg, wParam, lParam);
+    }
+
+    ViewTransform view;
+    switch (msg) {
+    case WM_SETCURSOR:
+        if (LOWORD(lParam) == HTCLIENT) break;
+        return DefWindowProc(hwnd, msg, wParam, lParam);
+
+    case WM_SIZE:
+        InvalidatePresentState();
+        MousePolicyNotify();
+        if (hwnd == g_hwnd) SetViewClientSize((LONG)LOWORD(lParam), (LONG)HIWORD(lParam));
+        if (ShouldVirtualizeWin32(hwnd, view)) {
+            lParam = MAKELPARAM((WORD)view.virtW, (WORD)view.virtH);
+        }
+        break;
+
+    case WM_WINDOWPOSCHANGED:
+        // Titles that handle this themselves never let DefWindowProc send WM_SIZE.
+        if (hwnd == g_hwnd && lParam && !(((const WINDOWPOS*)lParam)->flags & SWP_NOSIZE)) {
+            RECT rc{};
+            if (GetClientRectRaw(hwnd, &rc)) SetViewClientSize(rc.right - rc.left, rc.bottom - rc.top);
+        }
+        break;
+
+    case WM_MOVE:
+        MousePolicyNotify();
+        break;
+
+    case WM_ACTIVATEAPP:
+        if (wParam == FALSE) {
+            InterlockedExchange(&g_deactivated, 1);
+            MousePolicyOnDeactivate();
+            if (Cfg().ignoreDeactivate) return 0;
+        }
+        else {
+            InterlockedExchange(&g_deactivated, 0);
+            MousePolicyNotify();
+            ApplyMousePolicyNow();
+        }
+        break;
+
+    case WM_ACTIVATE:
+        if (LOWORD(wParam) == WA_INACTIVE) {
+            InterlockedExchange(&g_deactivated, 1);
+            MousePolicyOnDeactivate();
+            if (Cfg().ignoreDeactivate) return 0;
+        }
+        else {
+            InterlockedExchange(&g_deactivated, 0);
+            MousePolicyNotify();
+            ApplyMousePolicyNow();
+        }
+        break;
+
+    case WM_SETFOCUS:
+        InterlockedExchange(&g_deactivated, 0);
+        MousePolicyNotify();
+        ApplyMousePolicyNow();
+        break;
+
+    case WM_KILLFOCUS:
+        InterlockedExchange(&g_deactivated, 1);
+        MousePolicyOnDeactivate();
+        if (Cfg().ignoreDeactivate) return 0;
+        break;
+
+    case WM_DESTROY:
+        InvalidatePresentState();
+        if (hwnd == g_hwnd) ForgetViewClient();
+        LogMousePolicyStats();
+        LogMouseCoalesceStats();
+        break;
+
+    case WM_EXITSIZEMOVE:
+        InvalidatePresentState();
+        MousePolicyNotify();
+        PostMessage(hwnd, WM_ACTIVATE, WA_ACTIVE, 0);
+        PostMessage(hwnd, WM_SETFOCUS, 0, 0);
+        break;
+    }
+
+    return CallWindowProc(g_origWndProc, hwnd, msg, wParam, lParam);
+}
+
+static void InstallWndProc(HWND hwnd) {
+    if (!hwnd) return;
+    if (hwnd == g_wndprocHwnd) return;
+
+    g_origWndProc = reinterpret_cast<WNDPROC>(
+        SetWindowLongPtr(hwnd, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(Hook_WndProc))
+        );
+    g_wndprocHwnd = hwnd;
+}
+
+// =============================================================================
+// Hook sets
+// =============================================================================
+
+// Hooks that only exist to serve one config switch. They are created once and
+// then enabled or disabled as reloads flip the switch, so a feature turned off
+// at runtime stops costing a detour on every call.
+using FeatureFn = bool(*)(const Config&);
+
+struct FeatureHook {
+    void* target;
+    FeatureFn wanted;
+    bool enabled;
+};
+
+static const int kMaxFeatureHooks = 16;
+static FeatureHook g_featureHooks[kMaxFeatureHooks];
+static int g_featureHookCount = 0;
+static SRWLOCK g_featureHookLock = SRWLOCK_INIT;
+
+static void TrackFeatureHook(void* target, FeatureFn wanted, bool enabled) {
+    AcquireSRWLockExclusive(&g_featureHookLock);
+    if (g_featureHookCount < kMaxFeatureHooks) {
+        g_featureHooks[g_featureHookCount] = { target, wanted, enabled };
+        g_featureHookCount++;
+    }
+    ReleaseSRWLockExclusive(&g_featureHookLock);
+}
+
+static bool WantClipHook(const Config& c) { return c.disableClip; }
+static bool WantGfwHook(const Config& c) { return c.ignoreDeactivate; }
+static bool WantRawInputHook(const Config& c) { return c.highPollMouse; }
+
+// Every MH_EnableHook freezes the whole process (thread snapshot + suspend/resume
+// of every thread). A HookSet creates its hooks, queues them, and enables them all
+// with a single MH_ApplyQueued in Commit().
+struct HookSet {
+    const char* name;
+    UINT queued = 0;
+    UINT failed = 0;
+    LONGLONG createTicks = 0;
+
+    explicit HookSet(const char* setName) : name(setName) {}
+
+    // A feature hook is created either way but only enabled when the current
+    // config wants it.
+    bool Add(void* target, void* detour, void** originalOut, FeatureFn feature = nullptr) {
+        if (!target) return false;
+
+        LONGLONG t0 = QpcNow();
+        const bool enable = !feature || feature(Cfg());
+        bool ok = MH_CreateHook(target, detour, originalOut) == MH_OK;
+        if (ok && enable && MH_QueueEnableHook(target) != MH_OK) {
+            // Otherwise it stays created but never enabled, and a retry fails
+            // as already created.
+            MH_RemoveHook(target);
+            if (originalOut) *originalOut = nullptr;
+            ok = false;
+        }
+        createTicks += QpcNow() - t0;
+
+        if (ok && feature) TrackFeatureHook(target, feature, enable);
+
+        if (ok) queued++;
+        else failed++;
+        return ok;
+    }
+
+    MH_STATUS Commit() {
+        if (queued == 0) return MH_OK;
+
+        LONGLONG t0 = QpcNow();
+        MH_STATUS status = MH_ApplyQueued();
+        LONGLONG applyTicks = QpcNow() - t0;
+
+        DebugLog("hooks[%s]: %u queued, %u failed, create %.1f us, apply %.1f us (%s)\n",
+            name, queued, failed, QpcToUs(createTicks), QpcToUs(applyTicks),
+            MH_StatusToString(status));
+        return status;
+    }
+};
+
+// =============================================================================
+// Configuration reload
+// =============================================================================
+
+// Toggles each hook on its own instead of queueing: MH_ApplyQueued applies
+// everyone's queue, and a HookSet on another thread may be half way through
+// queueing its own batch. A hook that is already in the wanted state gets that
+// state re-queued, so such a pending batch cannot flip it back.
+static void ApplyFeatureHooks(const Config& cfg) {
+    UINT changed = 0;
+    MH_STATUS last = MH_OK;
+
+    AcquireSRWLockExclusive(&g_featureHookLock);
+    for (int i = 0; i < g_featureHookCount; i++) {
+        FeatureHook& h = g_featureHooks[i];
+        const bool want = h.wanted(cfg);
+        if (want == h.enabled) continue;
+
+        MH_STATUS st = want ? MH_EnableHook(h.target) : MH_DisableHook(h.target);
+        if (st == (want ? MH_ERROR_ENABLED : MH_ERROR_DISABLED)) {
+            st = want ? MH_QueueEnableHook(h.target) : MH_QueueDisableHook(h.target);
+        }
+        if (st == MH_OK) {
+            h.enabled = want;
+            changed++;
+        }
+        else {
+            last = st;
+        }
+    }
+    ReleaseSRWLockExclusive(&g_featureHookLock);
+
+    if (changed == 0 && last == MH_OK) return;
+    DebugLog("config: %u feature hooks toggled (%s)\n", changed, MH_StatusToString(last));
+}
+
+static void ReloadConfig() {
+    const Config& old = Cfg();
+    Config* cfg = new Config();
+    cfg->Load(g_cfgPath);
+    PublishConfig(cfg);
+
+    DebugLog("config: reloaded %s\n", g_cfgPath);
+
+    ApplyFeatureHooks(*cfg);
+    if (old.frameStats && !cfg->frameStats) StopFrameStats();
+    if (cfg->fit != old.fit || cfg->scaleMode != old.scaleMode) {
+        RebuildView();
+        InvalidatePresentState();
+    }
+}
+
+static FILETIME GetConfigWriteTime() {
+    WIN32_FILE_ATTRIBUTE_DATA fad{};
+    if (!GetFileAttributesExA(g_cfgPath, GetFileExInfoStandard, &fad)) return FILETIME{};
+    return fad.ftLastWriteTime;
+}
+
+// Editors save in several steps (truncate, write, rename); wait for the
+// directory to go quiet before reading the file.
+static const DWORD kConfigSettleMs = 100;
+
+// The watcher thread also does the proxy's other slow file I/O, so that render
+// and input threads only ever queue work and signal this event.
+static HANDLE g_watchWake = nullptr;
+
+static void FlushProfileDecisions();
+
+static DWORD WINAPI ConfigWatchThread(LPVOID) {
+    char dir[MAX_PATH];
+    lstrcpynA(dir, g_cfgPath, MAX_PATH);
+    char* slash = strrchr(dir, '\\');
+    if (slash) *slash = 0;
+
+    HANDLE change = slash ? FindFirstChangeNotificationA(dir, FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME) : INVALID_HANDLE_VALUE;
+    if (change == INVALID_HANDLE_VALUE) {
+        DebugLog("config: cannot watch %s (%lu)\n", dir, GetLastError());
+    }
+
+    // The wake event goes first so queued work is never starved by a busy directory.
+    HANDLE waits[2] = { g_watchWake, change };
+    const DWORD waitCount = change != INVALID_HANDLE_VALUE ? 2 : 1;
+
+    FILETIME last = GetConfigWriteTime();
+    for (;;) {
+        const DWORD w = WaitForMultipleObjects(waitCount, waits, FALSE, INFINITE);
+        if (w == WAIT_OBJECT_0) {
+            FlushProfileDecisions();
+            continue;
+        }
+        if (w != WAIT_OBJECT_0 + 1) break;
+
+        do {
+            if (!FindNextChangeNotification(change)) break;
+        } while (WaitForSingleObject(change, kConfigSettleMs) == WAIT_OBJECT_0);
+
+        // Other files in the game directory change too; only react to ours.
+        FILETIME now = GetConfigWriteTime();
+        if (CompareFileTime(&now, &last) == 0) continue;
+        last = now;
+
+        ReloadConfig();
+    }
+
+    if (change != INVALID_HANDLE_VALUE) FindCloseChangeNotification(change);
+    return 0;
+}
+
+static void StartConfigWatch() {
+    g_watchWake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!g_watchWake) return;
+
+    HANDLE t = CreateThread(nullptr, 0, &ConfigWatchThread, nullptr, 0, nullptr);
+    if (t) CloseHandle(t);
+}
+
+// =============================================================================
+// Title profiles
+// =============================================================================
+//
+// d3d9_profiles.bin (next to preferences.ini) remembers what the runtime
+// heuristics concluded for a given build of a game, so the next launch can
+// install the same hooks in the startup batch instead of during gameplay.
+//
+// Layout: ProfileHeader followed by `count` ProfileRecords sorted by key. The
+// key hashes the lowercase exe name together with the PE timestamp and image
+// size, so a patched executable starts from a clean slate.
+
+enum ProfileFlags : DWORD {
+    kProfileGfwHook    = 0x0001,  // install the GetForegroundWindow spoof at startup
+    kProfileWin32Virt  = 0x0002,  // enable Win32 client virtualization at startup
+};
+
+static const DWORD kProfileMagic = 0x46503944; // 'D9PF'
+static const WORD kProfileVersion = 1;
+static const DWORD kMaxProfiles = 65536;
+
+#pragma pack(push, 1)
+struct ProfileHeader {
+    DWORD magic;
+    WORD version;
+    WORD recordSize;
+    DWORD count;
+    DWORD reserved;
+};
+
+struct ProfileRecord {
+    UINT64 key;
+    DWORD flags;
+    DWORD peStamp;   // informational: TimeDateStamp of the exe
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ProfileHeader) == 16, "profile header layout");
+static_assert(sizeof(ProfileRecord) == 16, "profile record layout");
+
+static char g_profilePath[MAX_PATH] = ".\\d3d9_profiles.bin";
+static UINT64 g_profileKey = 0;
+static DWORD g_profileStamp = 0;
+static volatile LONG g_profileFlags = 0;
+static volatile LONG g_profilePending = 0;
+
+static UINT64 Fnv1a64(UINT64 h, const void* data, size_t n) {
+    const BYTE* p = static_cast<const BYTE*>(data);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool ComputeProfileKey() {
+    char path[MAX_PATH];
+    DWORD len = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    if (len == 0 || len >= MAX_PATH) return false;
+
+    const char* name = strrchr(path, '\\');
+    name = name ? name + 1 : path;
+
+    UINT64 h = 0xcbf29ce484222325ULL;
+    for (const char* c = name; *c; c++) {
+        char lc = (*c >= 'A' && *c <= 'Z') ? (char)(*c - 'A' + 'a') : *c;
+        h = Fnv1a64(h, &lc, 1);
+    }
+
+    const BYTE* base = reinterpret_cast<const BYTE*>(GetModuleHandleA(nullptr));
+    const IMAGE_DOS_HEADER* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    if (!base || dos->e_magic != IMAGE_DOS_SIGNATURE) return false;
+    const IMAGE_NT_HEADERS* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+    if (nt->Signature != IMAGE_NT_SIGNATURE) return false;
+
+    const DWORD stamp = nt->FileHeader.TimeDateStamp;
+    const DWORD size = nt->OptionalHeader.SizeOfImage;
+    h = Fnv1a64(h, &stamp, sizeof(stamp));
+    h = Fnv1a64(h, &size, sizeof(size));
+
+    g_profileKey = h;
+    g_profileStamp = stamp;
+    return true;
+}
+
+// Reads the whole database. A missing or malformed file is an empty database.
+static bool ReadProfiles(std::vector<ProfileRecord>& out) {
+    out.clear();
+
+    HANDLE f = CreateFileA(g_profilePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+
+    ProfileHeader hdr{};
+    DWORD got = 0;
+    bool ok = ReadFile(f, &hdr, sizeof(hdr), &got, nullptr) && got == sizeof(hdr) &&
+        hdr.magic == kProfileMagic && hdr.version == kProfileVersion &&
+        hdr.recordSize == sizeof(ProfileRecord) && hdr.count <= kMaxProfiles;
+
+    if (ok && hdr.count > 0) {
+        out.resize(hdr.count);
+        const DWORD bytes = hdr.count * (DWORD)sizeof(ProfileRecord);
+        ok = ReadFile(f, out.data(), bytes, &got, nullptr) && got == bytes;
+        if (!ok) out.clear();
+    }
+
+    CloseHandle(f);
+    return ok;
+}
+
+static bool WriteProfiles(const std::vector<ProfileRecord>& recs) {
+    char tmp[MAX_PATH + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_profilePath);
+
+    HANDLE f = CreateFileA(tmp, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+
+    ProfileHeader hdr{ kProfileMagic, kProfileVersion, (WORD)sizeof(ProfileRecord), (DWORD)recs.size(), 0 };
+    DWORD put = 0;
+    const DWORD bytes = (DWORD)(recs.size() * sizeof(ProfileRecord));
+    bool ok = WriteFile(f, &hdr, sizeof(hdr), &put, nullptr) && put == sizeof(hdr) &&
+        (bytes == 0 || (WriteFile(f, recs.data(), bytes, &put, nullptr) && put == bytes));
+    CloseHandle(f);
+
+    // Replace in one step so a concurrently starting game never sees a torn file.
+    if (ok) ok = MoveFileExA(tmp, g_profilePath, MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!ok) DeleteFileA(tmp);
+    return ok;
+}
+
+static DWORD LookupProfile() {
+    std::vector<ProfileRecord> recs;
+    if (!ReadProfiles(recs)) return 0;
+
+    auto it = std::lower_bound(recs.begin(), recs.end(), g_profileKey,
+        [](const ProfileRecord& r, UINT64 k) { return r.key < k; });
+    return (it != recs.end() && it->key == g_profileKey) ? it->flags : 0;
+}
+
+static void LoadProfile(const Config& cfg) {
+    // The database lives beside preferences.ini.
+    lstrcpynA(g_profilePath, g_cfgPath, MAX_PATH);
+    char* slash = strrchr(g_profilePath, '\\');
+    if (slash && (size_t)(slash + 1 - g_profilePath) + sizeof("d3d9_profiles.bin") <= MAX_PATH) {
+        lstrcpynA(slash + 1, "d3d9_profiles.bin", MAX_PATH - (int)(slash + 1 - g_profilePath));
+    }
+
+    if (!cfg.profiles && !cfg.profileRecord) return;
+    if (!ComputeProfileKey()) return;
+    if (!cfg.profiles) return;
+
+    const DWORD flags = LookupProfile();
+    InterlockedExchange(&g_profileFlags, (LONG)flags);
+    DebugLog("profile: key %016llx stamp %08lx flags %#lx\n",
+        (unsigned long long)g_profileKey, g_profileStamp, flags);
+}
+
+static bool ProfileHas(DWORD flag) {
+    return (InterlockedCompareExchange(&g_profileFlags, 0, 0) & (LONG)flag) != 0;
+}
+
+// Called when a runtime heuristic settles, typically from Present or the game's
+// window procedure. Only marks the bit; the watcher thread writes it out.
+static void RecordProfileDecision(DWORD flag) {
+    if (!Cfg().profileRecord || g_profileKey == 0) return;
+
+    const LONG before = InterlockedOr(&g_profileFlags, (LONG)flag);
+    if (before & (LONG)flag) return;
+
+    InterlockedOr(&g_profilePending, (LONG)flag);
+    if (g_watchWake) SetEvent(g_watchWake);
+}
+
+// Runs on the watcher thread. Bits recorded while a write is in flight set the
+// event again and go out with the next pass.
+static void FlushProfileDecisions() {
+    const DWORD flags = (DWORD)InterlockedExchange(&g_profilePending, 0);
+    if (flags == 0) return;
+
+    std::vector<ProfileRecord> recs;
+    ReadProfiles(recs);
+
+    auto it = std::lower_bound(recs.begin(), recs.end(), g_profileKey,
+        [](const ProfileRecord& r, UINT64 k) { return r.key < k; });
+    if (it != recs.end() && it->key == g_profileKey) {
+        it->flags |= flags;
+        it->peStamp = g_profileStamp;
+    }
+    else if (recs.size() < kMaxProfiles) {
+        recs.insert(it, ProfileRecord{ g_profileKey, flags, g_profileStamp });
+    }
+
+    const bool ok = WriteProfiles(recs);
+    DebugLog("profile: recorded %#lx (%s)\n", flags, ok ? "ok" : "write failed");
+}
+
+// =============================================================================
+// user32 hooks
+// =============================================================================
+
+using ClipCursor_t = BOOL(WINAPI*)(const RECT*);
+using SetCapture_t = HWND(WINAPI*)(HWND);
+using SetCursorPos_t = BOOL(WINAPI*)(int, int);
+using CDSExA_t = LONG(WINAPI*)(LPCSTR, DEVMODEA*, HWND, DWORD, LPVOID);
+using CDSExW_t = LONG(WINAPI*)(LPCWSTR, DEVMODEW*, HWND, DWORD, LPVOID);
+using GetClientRect_t = BOOL(WINAPI*)(HWND, LPRECT);
+using ScreenToClient_t = BOOL(WINAPI*)(HWND, LPPOINT);
+using ClientToScreen_t = BOOL(WINAPI*)(HWND, LPPOINT);
+
+static ClipCursor_t      Real_ClipCursor = nullptr;
+static SetCapture_t      Real_SetCapture = nullptr;
+static SetCursorPos_t    Real_SetCursorPos = nullptr;
+static CDSExA_t          Real_ChangeDisplaySettingsExA = nullptr;
+static CDSExW_t          Real_ChangeDisplaySettingsExW = nullptr;
+static GetClientRect_t   Real_GetClientRect = nullptr;
+static ScreenToClient_t  Real_ScreenToClient = nullptr;
+static ClientToScreen_t  Real_ClientToScreen = nullptr;
+
+static BOOL GetClientRectRaw(HWND hwnd, RECT* rc) {
+    if (Real_GetClientRect) return Real_GetClientRect(hwnd, rc);
+    return ::GetClientRect(hwnd, rc);
+}
+static BOOL ScreenToClientRaw(HWND hwnd, POINT* pt) {
+    if (Real_ScreenToClient) return Real_ScreenToClient(hwnd, pt);
+    return ::ScreenToClient(hwnd, pt);
+}
+static BOOL ClientToScreenRaw(HWND hwnd, POINT* pt) {
+    if (Real_ClientToScreen) return Real_ClientToScreen(hwnd, pt);
+    return ::ClientToScreen(hwnd, pt);
+}
+
+static bool GetActualClientSize(HWND hwnd, LONG& w, LONG& h) {
+    if (!hwnd || !IsWindow(hwnd)) return false;
+    RECT rc{};
+    if (!GetClientRectRaw(hwnd, &rc)) return false;
+    w = rc.right - rc.left;
+    h = rc.bottom - rc.top;
+    return (w > 0 && h > 0);
+}
+
+static BOOL WINAPI Hook_GetClientRect(HWND hwnd, LPRECT rc) {
+    Trace(kTraceGetClientRect, TracePtr(hwnd));
+    BOOL ok = GetClientRectRaw(hwnd, rc);
+    if (!ok || !rc) return ok;
+
+    ViewTransform view;
+    if (ShouldVirtualizeWin32(hwnd, view)) {
+        rc->left = 0;
+        rc->top = 0;
+        rc->right = view.virtW;
+        rc->bottom = view.virtH;
+    }
+    return ok;
+}
+
+static BOOL WINAPI Hook_ScreenToClient(HWND hwnd, LPPOINT pt) {
+    Trace(kTraceScreenToClient, TracePtr(hwnd), pt ? (UINT64)pt->x : 0, pt ? (UINT64)pt->y : 0);
+    BOOL ok = ScreenToClientRaw(hwnd, pt);
+    if (!ok || !pt) return ok;
+
+    ViewTransform view;
+    if (ShouldVirtualizeWin32(hwnd, view)) *pt = view.ToVirtual(*pt);
+    return ok;
+}
+
+static BOOL WINAPI Hook_ClientToScreen(HWND hwnd, LPPOINT pt) {
+    Trace(kTraceClientToScreen, TracePtr(hwnd), pt ? (UINT64)pt->x : 0, pt ? (UINT64)pt->y : 0);
+    if (!pt) return ClientToScreenRaw(hwnd, pt);
+
+    ViewTransform view;
+    if (ShouldVirtualizeWin32(hwnd, view)) {
+        POINT p = view.ToClient(*pt);
+        BOOL ok = ClientToScreenRaw(hwnd, &p);
+        if (ok) *pt = p;
+        return ok;
+    }
+    return ClientToScreenRaw(hwnd, pt);
+}
+
+static BOOL WINAPI Hook_ClipCursor(const RECT* r) {
+    if (Cfg().disableClip && r != nullptr) {
+        if (Real_ClipCursor) Real_ClipCursor(nullptr);
+        return TRUE;
+    }
+    return Real_ClipCursor ? Real_ClipCursor(r) : TRUE;
+}
+
+static HWND WINAPI Hook_SetCapture(HWND hwnd) {
+    if (Cfg().disableClip || (g_hwnd && GetRealForegroundWindow() != g_hwnd)) {
+        ::ReleaseCapture();
+        return nullptr;
+    }
+    return Real_SetCapture ? Real_SetCapture(hwnd) : hwnd;
+}
+
+static BOOL WINAPI Hook_SetCursorPos(int x, int y) {
+    if (g_hwnd && GetRealForegroundWindow() != g_hwnd) {
+        return TRUE;
+    }
+    return Real_SetCursorPos ? Real_SetCursorPos(x, y) : TRUE;
+}
+
+static bool LooksLikeModeSwitchA(const DEVMODEA* dm) {
+    if (!dm) return false;
+    DWORD f = dm->dmFields;
+    return (f & (DM_PELSWIDTH | DM_PELSHEIGHT | DM_BITSPERPEL | DM_DISPLAYFREQUENCY)) != 0;
+}
+
+static bool LooksLikeModeSwitchW(const DEVMODEW* dm) {
+    if (!dm) return false;
+    DWORD f = dm->dmFields;
+    return (f & (DM_PELSWIDTH | DM_PELSHEIGHT | DM_BITSPERPEL | DM_DISPLAYFREQUENCY)) != 0;
+}
+
+static LONG WINAPI Hook_ChangeDisplaySettingsExA(LPCSTR dev, DEVMODEA* dm, HWND hwnd, DWORD flags, LPVOID param) {
+    if ((flags & CDS_FULLSCREEN) || LooksLikeModeSwitchA(dm)) {
+        return DISP_CHANGE_SUCCESSFUL;
     }
     return Real_ChangeDisplaySettingsExA ? Real_ChangeDisplaySettingsExA(dev, dm, hwnd, flags, param)
         : DISP_CHANGE_SUCCESSFUL;
 }
 
-static LONG WINAPI Hook_ChangeDisplaySettingsExW(LPCWSTR dev, DEVMODEW* dm, HWND hwnd, DWORD flags, LPVOID param) {
-    if ((flags & CDS_FULLSCREEN) || LooksLikeModeSwitchW(dm)) {
-        return DISP_CHANGE_SUCCESSFUL;
-    }
-    return Real_ChangeDisplaySettingsExW ? Real_ChangeDisplaySettingsExW(dev, dm, hwnd, flags, param)
-        : DISP_CHANGE_SUCCESSFUL;
+static LONG WINAPI Hook_ChangeDisplaySettingsExW(LPCWSTR dev, DEVMODEW* dm, HWND hwnd, DWORD flags, LPVOID param) {
+    if ((flags & CDS_FULLSCREEN) || LooksLikeModeSwitchW(dm)) {
+        return DISP_CHANGE_SUCCESSFUL;
+    }
+    return Real_ChangeDisplaySettingsExW ? Real_ChangeDisplaySettingsExW(dev, dm, hwnd, flags, param)
+        : DISP_CHANGE_SUCCESSFUL;
+}
+
+static HWND WINAPI Hook_GetForegroundWindow() {
+    HWND real = Real_GetForegroundWindow ? Real_GetForegroundWindow() : nullptr;
+
+    if (!Cfg().ignoreDeactivate) return real;
+
+    // safety: avoid launchers/config processes that die quickly
+    if (g_processStartMs == 0 || (GetTickCount64() - g_processStartMs) < 5000)
+        return real;
+
+    // don't spoof until we're actually presenting
+    if (InterlockedCompareExchange(&g_seenPresent, 0, 0) == 0)
+        return real;
+
+    // only spoof while deactivated
+    if (InterlockedCompareExchange(&g_deactivated, 0, 0) == 0)
+        return real;
+
+    if (!g_hwnd || !IsWindow(g_hwnd))
+        return real;
+
+    if (real == g_hwnd)
+        return real;
+
+    return g_hwnd;
+}
+
+static bool AddGfwHook(HookSet& hooks) {
+    return hooks.Add(g_pGetForegroundWindow, (void*)&Hook_GetForegroundWindow,
+        (void**)&Real_GetForegroundWindow, &WantGfwHook);
+}
+
+static void MaybeInstallGfwHook() {
+    if (InterlockedCompareExchange(&g_gfwHookInstalled, 0, 0) != 0)
+        return;
+
+    if (!Cfg().ignoreDeactivate)
+        return;
+
+    if (!g_pGetForegroundWindow)
+        return;
+
+    if (g_processStartMs == 0 || (GetTickCount64() - g_processStartMs) < 5000)
+        return;
+
+    if (InterlockedCompareExchange64(&g_presentTotal, 0, 0) < 120)
+        return;
+
+    HookSet hooks("gfw");
+    if (AddGfwHook(hooks)) {
+        if (hooks.Commit() == MH_OK) {
+            InterlockedExchange(&g_gfwHookInstalled, 1);
+            RecordProfileDecision(kProfileGfwHook);
+        }
+    }
+}
+
+static HMODULE g_user32 = nullptr;
+
+static HMODULE GetUser32Module() {
+    if (g_user32) return g_user32;
+    g_user32 = GetModuleHandleA("user32.dll");
+    if (!g_user32) g_user32 = LoadLibraryA("user32.dll");
+    return g_user32;
+}
+
+static void InstallUser32Hooks(HookSet& hooks) {
+    HMODULE user32 = GetUser32Module();
+    if (!user32) return;
+
+    auto hookIfPresent = [&](const char* name, void* detour, void** originalOut, FeatureFn feature = nullptr) {
+        hooks.Add(reinterpret_cast<void*>(GetProcAddress(user32, name)), detour, originalOut, feature);
+        };
+
+    hookIfPresent("ClipCursor", (void*)&Hook_ClipCursor, (void**)&Real_ClipCursor, &WantClipHook);
+    hookIfPresent("SetCapture", (void*)&Hook_SetCapture, (void**)&Real_SetCapture);
+    hookIfPresent("SetCursorPos", (void*)&Hook_SetCursorPos, (void**)&Real_SetCursorPos);
+
+    hookIfPresent("ChangeDisplaySettingsExA", (void*)&Hook_ChangeDisplaySettingsExA, (void**)&Real_ChangeDisplaySettingsExA);
+    hookIfPresent("ChangeDisplaySettingsExW", (void*)&Hook_ChangeDisplaySettingsExW, (void**)&Real_ChangeDisplaySettingsExW);
+
+    g_pGetForegroundWindow = reinterpret_cast<void*>(GetProcAddress(user32, "GetForegroundWindow"));
+}
+
+// These are the "dangerous" hooks that can break some titles. Install only if we detect we need them.
+static void InstallUser32VirtualHooks(HookSet& hooks) {
+    HMODULE user32 = GetUser32Module();
+    if (!user32) return;
+
+    auto hookIfPresent = [&](const char* name, void* detour, void** originalOut, FeatureFn feature = nullptr) {
+        hooks.Add(reinterpret_cast<void*>(GetProcAddress(user32, name)), detour, originalOut, feature);
+        };
+
+    hookIfPresent("GetClientRect", (void*)&Hook_GetClientRect, (void**)&Real_GetClientRect);
+    hookIfPresent("ScreenToClient", (void*)&Hook_ScreenToClient, (void**)&Real_ScreenToClient);
+    hookIfPresent("ClientToScreen", (void*)&Hook_ClientToScreen, (void**)&Real_ClientToScreen);
+    hookIfPresent("GetRawInputData", (void*)&Hook_GetRawInputData, (void**)&Real_GetRawInputData,
+        &WantRawInputHook);
+}
+
+static void MaybeInstallUser32VirtualHooks() {
+    if (InterlockedCompareExchange(&g_win32VirtEnabled, 0, 0) == 0) return;
+
+    // 0 = not installed, 2 = installing, 1 = installed
+    if (InterlockedCompareExchange(&g_win32VirtHooksInstalled, 2, 0) != 0) return;
+
+    HookSet hooks("user32-virtual");
+    InstallUser32VirtualHooks(hooks);
+    hooks.Commit();
+
+    // Even if some hooks fail, we still consider this "installed enough" to avoid thrashing.
+    InterlockedExchange(&g_win32VirtHooksInstalled, 1);
+}
+
+// =============================================================================
+// DirectInput mouse (disable exclusive)
+// =============================================================================
+
+using DirectInput8Create_t = HRESULT(WINAPI*)(HINSTANCE, DWORD, REFIID, LPVOID*, LPUNKNOWN);
+using SetCoopLevel_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self, HWND hwnd, DWORD flags);
+using GetDeviceState_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self, DWORD cbData, LPVOID lpvData);
+using Poll_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self);
+
+static SetCoopLevel_t Real_SetCooperativeLevel = nullptr;
+static HMODULE              g_realDInput8 = nullptr;
+static DirectInput8Create_t Real_DirectInput8Create = nullptr;
+static volatile LONG g_dinputHooksInstalled = 0;
+static GetDeviceState_t Real_GetDeviceState = nullptr;
+static Poll_t           Real_Poll = nullptr;
+
+static bool IsMouseOrKeyboardDevice(IDirectInputDevice8A* self) {
+    if (!self) return false;
+    DIDEVICEINSTANCEA dii{};
+    dii.dwSize = sizeof(dii);
+    if (FAILED(self->GetDeviceInfo(&dii))) return false;
+    const DWORD t = GET_DIDEVICE_TYPE(dii.dwDevType);
+    return t == DI8DEVTYPE_MOUSE || t == DI8DEVTYPE_KEYBOARD;
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_GetDeviceState(IDirectInputDevice8A* self, DWORD cbData, LPVOID lpvData) {
+    Trace(kTraceGetDeviceState, TracePtr(self), cbData);
+    HRESULT hr = Real_GetDeviceState ? Real_GetDeviceState(self, cbData, lpvData) : DIERR_GENERIC;
+
+    if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED) {
+        if (IsMouseOrKeyboardDevice(self)) {
+            self->Acquire();
+            hr = Real_GetDeviceState ? Real_GetDeviceState(self, cbData, lpvData) : hr;
+        }
+    }
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_Poll(IDirectInputDevice8A* self) {
+    Trace(kTracePoll, TracePtr(self));
+    HRESULT hr = Real_Poll ? Real_Poll(self) : DIERR_GENERIC;
+    if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED) {
+        if (IsMouseOrKeyboardDevice(self)) {
+            self->Acquire();
+            hr = Real_Poll ? Real_Poll(self) : hr;
+        }
+    }
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_SetCooperativeLevel(IDirectInputDevice8A* self, HWND hwnd, DWORD flags) {
+    DIDEVICEINSTANCEA dii{};
+    dii.dwSize = sizeof(dii);
+
+    const bool isMouse = (self && SUCCEEDED(self->GetDeviceInfo(&dii)) &&
+        GET_DIDEVICE_TYPE(dii.dwDevType) == DI8DEVTYPE_MOUSE);
+
+    if (isMouse) {
+        flags &= ~DISCL_EXCLUSIVE;
+        flags |= DISCL_NONEXCLUSIVE;
+
+        flags &= ~DISCL_BACKGROUND;
+        flags |= DISCL_FOREGROUND;
+    }
+
+    return Real_SetCooperativeLevel ? Real_SetCooperativeLevel(self, hwnd, flags) : DIERR_GENERIC;
+}
+
+static void EnsureRealDInput8Loaded() {
+    if (g_realDInput8) return;
+
+    char sysdir[MAX_PATH]{};
+    GetSystemDirectoryA(sysdir, MAX_PATH);
+    std::string path = std::string(sysdir) + "\\dinput8.dll";
+
+    g_realDInput8 = LoadLibraryA(path.c_str());
+    if (!g_realDInput8) return;
+
+    Real_DirectInput8Create = reinterpret_cast<DirectInput8Create_t>(
+        GetProcAddress(g_realDInput8, "DirectInput8Create")
+        );
+}
+
+static void InstallDirectInputMouseHook(HookSet& hooks) {
+    EnsureRealDInput8Loaded();
+    if (!Real_DirectInput8Create) return;
+    if (InterlockedCompareExchange(&g_dinputHooksInstalled, 0, 0) != 0) return;
+
+    IDirectInput8A* di = nullptr;
+    HRESULT hr = Real_DirectInput8Create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION,
+        IID_IDirectInput8A, (void**)&di, nullptr);
+    if (FAILED(hr) || !di) return;
+
+    IDirectInputDevice8A* dev = nullptr;
+    hr = di->CreateDevice(GUID_SysMouse, &dev, nullptr);
+    if (FAILED(hr) || !dev) {
+        di->Release();
+        return;
+    }
+
+    void** vtbl = *(void***)dev;
+    void* setCoopPtr = vtbl[13]; // stable for IDirectInputDevice8
+    hooks.Add(setCoopPtr, &Hook_SetCooperativeLevel,
+        reinterpret_cast<void**>(&Real_SetCooperativeLevel));
+
+    void* getStatePtr = vtbl[9]; // GetDeviceState
+    hooks.Add(getStatePtr, &Hook_GetDeviceState,
+        reinterpret_cast<void**>(&Real_GetDeviceState));
+
+    void* pollPtr = vtbl[25];
+    hooks.Add(pollPtr, &Hook_Poll,
+        reinterpret_cast<void**>(&Real_Poll));
+
+    InterlockedExchange(&g_dinputHooksInstalled, 1);
+
+    dev->Release();
+    di->Release();
+}
+
+// =============================================================================
+// D3D9 proxy + hooks
+// =============================================================================
+using PFN_Direct3DCreate9 = IDirect3D9 * (WINAPI*)(UINT);
+using PFN_Direct3DCreate9Ex = HRESULT(WINAPI*)(UINT, IDirect3D9Ex**);
+using Reset_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, D3DPRESENT_PARAMETERS* pPP);
+using Present_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, const RECT*, const RECT*, HWND, const RGNDATA*);
+using SetViewport_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, const D3DVIEWPORT9*);
+using SetRenderTarget_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, DWORD, IDirect3DSurface9*);
+using SwapChainPresent_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DSwapChain9* self,
+    const RECT*, const RECT*, HWND, const RGNDATA*, DWORD);
+using CreateDevice_t = HRESULT(STDMETHODCALLTYPE*)(
+    IDirect3D9* self, UINT Adapter, D3DDEVTYPE DeviceType, HWND hFocusWindow,
+    DWORD BehaviorFlags, D3DPRESENT_PARAMETERS* pPP, IDirect3DDevice9** ppDev);
+using CreateTexture_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self,
+    UINT, UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DTexture9**, HANDLE*);
+using CreateVolumeTexture_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self,
+    UINT, UINT, UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DVolumeTexture9**, HANDLE*);
+using CreateCubeTexture_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self,
+    UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DCubeTexture9**, HANDLE*);
+using CreateVertexBuffer_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self,
+    UINT, DWORD, DWORD, D3DPOOL, IDirect3DVertexBuffer9**, HANDLE*);
+using CreateIndexBuffer_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self,
+    UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DIndexBuffer9**, HANDLE*);
+using ResourceRelease_t = ULONG(STDMETHODCALLTYPE*)(IUnknown* self);
+using TexGetLevelDesc_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DTexture9* self, UINT, D3DSURFACE_DESC*);
+using TexGetSurfaceLevel_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DTexture9* self, UINT, IDirect3DSurface9**);
+using TexLockRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DTexture9* self, UINT, D3DLOCKED_RECT*, const RECT*, DWORD);
+using TexUnlockRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DTexture9* self, UINT);
+using TexAddDirtyRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DTexture9* self, const RECT*);
+using CubeGetLevelDesc_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DCubeTexture9* self, UINT, D3DSURFACE_DESC*);
+using CubeGetSurface_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DCubeTexture9* self,
+    D3DCUBEMAP_FACES, UINT, IDirect3DSurface9**);
+using CubeLockRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DCubeTexture9* self,
+    D3DCUBEMAP_FACES, UINT, D3DLOCKED_RECT*, const RECT*, DWORD);
+using CubeUnlockRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DCubeTexture9* self, D3DCUBEMAP_FACES, UINT);
+using CubeAddDirtyRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DCubeTexture9* self, D3DCUBEMAP_FACES, const RECT*);
+using VolGetLevelDesc_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolumeTexture9* self, UINT, D3DVOLUME_DESC*);
+using VolGetVolumeLevel_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolumeTexture9* self, UINT, IDirect3DVolume9**);
+using VolLockBox_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolumeTexture9* self,
+    UINT, D3DLOCKED_BOX*, const D3DBOX*, DWORD);
+using VolUnlockBox_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolumeTexture9* self, UINT);
+using VolAddDirtyBox_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolumeTexture9* self, const D3DBOX*);
+using SurfUnlockRect_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DSurface9* self);
+using SurfReleaseDC_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DSurface9* self, HDC);
+using VolumeUnlockBox_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVolume9* self);
+using BufLock_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DResource9* self, UINT, UINT, void**, DWORD);
+using BufUnlock_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DResource9* self);
+using VBGetDesc_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DVertexBuffer9* self, D3DVERTEXBUFFER_DESC*);
+using IBGetDesc_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DIndexBuffer9* self, D3DINDEXBUFFER_DESC*);
+
+static HMODULE g_realD3D9 = nullptr;
+static PFN_Direct3DCreate9   Real_Direct3DCreate9 = nullptr;
+static PFN_Direct3DCreate9Ex Real_Direct3DCreate9Ex = nullptr;
+static CreateDevice_t      Real_CreateDevice = nullptr;
+static Reset_t             Real_Reset = nullptr;
+static Present_t           Real_Present = nullptr;
+static SetViewport_t       Real_SetViewport = nullptr;
+static SetRenderTarget_t   Real_SetRenderTarget = nullptr;
+static SwapChainPresent_t  Real_SwapChainPresent = nullptr;
+static CreateTexture_t       Real_CreateTexture = nullptr;
+static CreateVolumeTexture_t Real_CreateVolumeTexture = nullptr;
+static CreateCubeTexture_t   Real_CreateCubeTexture = nullptr;
+static CreateVertexBuffer_t  Real_CreateVertexBuffer = nullptr;
+static CreateIndexBuffer_t   Real_CreateIndexBuffer = nullptr;
+static ResourceRelease_t     Real_DevRelease = nullptr;
+static ResourceRelease_t     Real_TexRelease = nullptr;
+static ResourceRelease_t     Real_CubeRelease = nullptr;
+static ResourceRelease_t     Real_VolRelease = nullptr;
+static TexGetLevelDesc_t     Real_TexGetLevelDesc = nullptr;
+static TexGetSurfaceLevel_t  Real_TexGetSurfaceLevel = nullptr;
+static TexLockRect_t         Real_TexLockRect = nullptr;
+static TexUnlockRect_t       Real_TexUnlockRect = nullptr;
+static TexAddDirtyRect_t     Real_TexAddDirtyRect = nullptr;
+static CubeGetLevelDesc_t    Real_CubeGetLevelDesc = nullptr;
+static CubeGetSurface_t      Real_CubeGetSurface = nullptr;
+static CubeLockRect_t        Real_CubeLockRect = nullptr;
+static CubeUnlockRect_t      Real_CubeUnlockRect = nullptr;
+static CubeAddDirtyRect_t    Real_CubeAddDirtyRect = nullptr;
+static VolGetLevelDesc_t     Real_VolGetLevelDesc = nullptr;
+static VolGetVolumeLevel_t   Real_VolGetVolumeLevel = nullptr;
+static VolLockBox_t          Real_VolLockBox = nullptr;
+static VolUnlockBox_t        Real_VolUnlockBox = nullptr;
+static VolAddDirtyBox_t      Real_VolAddDirtyBox = nullptr;
+static SurfUnlockRect_t      Real_SurfUnlockRect = nullptr;
+static SurfReleaseDC_t       Real_SurfReleaseDC = nullptr;
+static VolumeUnlockBox_t     Real_VolumeUnlockBox = nullptr;
+static ResourceRelease_t     Real_VBRelease = nullptr;
+static BufLock_t             Real_VBLock = nullptr;
+static BufUnlock_t           Real_VBUnlock = nullptr;
+static VBGetDesc_t           Real_VBGetDesc = nullptr;
+static ResourceRelease_t     Real_IBRelease = nullptr;
+static BufLock_t             Real_IBLock = nullptr;
+static BufUnlock_t           Real_IBUnlock = nullptr;
+static IBGetDesc_t           Real_IBGetDesc = nullptr;
+
+static void EnsureRealD3D9Loaded() {
+    if (g_realD3D9) return;
+
+    char sysdir[MAX_PATH]{};
+    GetSystemDirectoryA(sysdir, MAX_PATH);
+    std::string path = std::string(sysdir) + "\\d3d9.dll";
+
+    g_realD3D9 = LoadLibraryA(path.c_str());
+    if (!g_realD3D9) return;
+
+    Real_Direct3DCreate9 = reinterpret_cast<PFN_Direct3DCreate9>(GetProcAddress(g_realD3D9, "Direct3DCreate9"));
+    Real_Direct3DCreate9Ex = reinterpret_cast<PFN_Direct3DCreate9Ex>(GetProcAddress(g_realD3D9, "Direct3DCreate9Ex"));
+}
+
+// Cached backbuffer size for fast viewport clamping.
+static volatile LONG g_bbW = 0;
+static volatile LONG g_bbH = 0;
+static bool UpdateBackbufferSize(IDirect3DDevice9* dev, UINT* outW = nullptr, UINT* outH = nullptr) {
+    if (!dev) return false;
+    bool ok = false;
+    IDirect3DSurface9* bb = nullptr;
+    if (SUCCEEDED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
+        D3DSURFACE_DESC d{};
+        if (SUCCEEDED(bb->GetDesc(&d))) {
+            InterlockedExchange(&g_bbW, (LONG)d.Width);
+            InterlockedExchange(&g_bbH, (LONG)d.Height);
+            // Keep Win32 virtualization in sync with the actual backbuffer.
+            SetViewVirtualSize((LONG)d.Width, (LONG)d.Height);
+            if (outW) *outW = d.Width;
+            if (outH) *outH = d.Height;
+            ok = true;
+        }
+        bb->Release();
+    }
+    return ok;
+}
+
+static void ForceWindowedPP(D3DPRESENT_PARAMETERS& pp, HWND hwnd) {
+    pp.Windowed = TRUE;
+    pp.FullScreen_RefreshRateInHz = 0;
+    if (hwnd) pp.hDeviceWindow = hwnd;
+    if (pp.BackBufferCount == 0) pp.BackBufferCount = 1;
+}
+
+static HWND GetDeviceHwnd(IDirect3DDevice9* dev) {
+    if (!dev) return nullptr;
+
+    D3DDEVICE_CREATION_PARAMETERS cp{};
+    if (SUCCEEDED(dev->GetCreationParameters(&cp)) && cp.hFocusWindow) {
+        return cp.hFocusWindow;
+    }
+
+    IDirect3DSwapChain9* sc = nullptr;
+    if (SUCCEEDED(dev->GetSwapChain(0, &sc)) && sc) {
+        D3DPRESENT_PARAMETERS pp{};
+        if (SUCCEEDED(sc->GetPresentParameters(&pp)) && pp.hDeviceWindow) {
+            sc->Release();
+            return pp.hDeviceWindow;
+        }
+        sc->Release();
+    }
+
+    return nullptr;
+}
+
+static void RefreshHwndFromDevice(IDirect3DDevice9* dev) {
+    HWND hwnd = GetDeviceHwnd(dev);
+    if (hwnd && hwnd != g_hwnd) {
+        g_hwnd = hwnd;
+        InstallWndProc(g_hwnd);
+    }
+}
+
+// =============================================================================
+// Present stretching (shared helper)
+// =============================================================================
+
+static bool BuildClientDstRect(HWND wnd, RECT& outDst) {
+    if (!wnd || !IsWindow(wnd)) return false;
+    RECT cr{};
+    if (!GetClientRectRaw(wnd, &cr)) return false;
+    LONG w = cr.right - cr.left;
+    LONG h = cr.bottom - cr.top;
+    if (w <= 0 || h <= 0) return false;
+    outDst = RECT{ 0,0,w,h };
+    return true;
+}
+
+// True if the caller's dst rect already covers the whole client area.
+static bool DstCoversClient(const RECT* dstIn, const RECT& dstFull) {
+    if (!dstIn) return false;
+    LONG dw = dstIn->right - dstIn->left;
+    LONG dh = dstIn->bottom - dstIn->top;
+    return dstIn->left == 0 && dstIn->top == 0 &&
+        dw == (dstFull.right - dstFull.left) &&
+        dh == (dstFull.bottom - dstFull.top);
+}
+
+// Src rect covering the viewport, clamped to the backbuffer (bbw/bbh may be 0 if unknown).
+// Returns nullptr when D3D should use the entire surface.
+static const RECT* SrcRectFromViewport(const D3DVIEWPORT9& vp, UINT bbw, UINT bbh, RECT& srcOut) {
+    if (vp.Width == 0 || vp.Height == 0) return nullptr;
+
+    // If viewport already covers the whole backbuffer, let D3D treat src as "entire surface".
+    if (bbw && bbh && vp.X == 0 && vp.Y == 0 && vp.Width == bbw && vp.Height == bbh)
+        return nullptr;
+
+    LONG sx = (LONG)vp.X;
+    LONG sy = (LONG)vp.Y;
+    LONG sw = (LONG)vp.Width;
+    LONG sh = (LONG)vp.Height;
+
+    if (bbw && bbh) {
+        if (sx < 0) sx = 0;
+        if (sy < 0) sy = 0;
+        if (sx > (LONG)bbw) sx = (LONG)bbw;
+        if (sy > (LONG)bbh) sy = (LONG)bbh;
+
+        LONG maxW = (LONG)bbw - sx;
+        LONG maxH = (LONG)bbh - sy;
+        if (sw > maxW) sw = maxW;
+        if (sh > maxH) sh = maxH;
+    }
+
+    if (sw <= 0 || sh <= 0) return nullptr;
+
+    srcOut = RECT{ sx, sy, sx + sw, sy + sh };
+    return &srcOut;
+}
+
+static const RECT* ChooseSrcRectFromViewport(IDirect3DDevice9* dev, const RECT* srcIn, RECT& srcOut) {
+    if (srcIn) return srcIn;
+    if (!dev) return nullptr;
+
+    // Backbuffer size (for clamping)
+    UINT bbw = 0, bbh = 0;
+    IDirect3DSurface9* bb = nullptr;
+    if (SUCCEEDED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
+        D3DSURFACE_DESC d{};
+        if (SUCCEEDED(bb->GetDesc(&d))) { bbw = d.Width; bbh = d.Height; }
+        bb->Release();
+    }
+
+    D3DVIEWPORT9 vp{};
+    if (FAILED(dev->GetViewport(&vp))) return nullptr;
+    return SrcRectFromViewport(vp, bbw, bbh, srcOut);
+}
+
+// =============================================================================
+// Per-device Present state
+// =============================================================================
+
+// Everything the device Present path needs, captured once and reused until
+// g_presentEpoch moves (Reset, WM_SIZE/WM_EXITSIZEMOVE, WM_DESTROY). The viewport
+// is a shadow kept up to date by Hook_SetViewport/Hook_SetRenderTarget, so a
+// steady-state Present makes no extra COM or user32 calls.
+struct DeviceState {
+    IDirect3DDevice9* dev = nullptr;
+    LONG epoch = 0;             // == g_presentEpoch while hwnd/bb/dst are valid
+    HWND hwnd = nullptr;
+    UINT bbW = 0, bbH = 0;
+    RECT dst{};                 // full client rect of hwnd
+    RECT image{};               // part of dst the image is presented into (see FitRect)
+
+    bool vpKnown = false;       // false -> re-read with GetViewport on next Present
+    D3DVIEWPORT9 vp{};
+
+    bool srcValid = false;      // src derived from vp + backbuffer size
+    bool hasSrc = false;
+    RECT src{};
+
+    // Shadow of render target 0, maintained by Hook_SetRenderTarget. The backbuffer
+    // pointer is for identity checks only (no reference held; valid until Reset).
+    IDirect3DSurface9* backbuffer = nullptr;
+    UINT backbufferW = 0, backbufferH = 0;
+    bool rt0Known = false;
+    bool rt0IsBackbuffer = false;
+
+    // Frame latency throttling. Ex devices use SetMaximumFrameLatency; plain
+    // devices get a ring of event queries, one issued per Present.
+    int latencyN = 0;                  // MaxFrameLatency last applied, 0 = none
+    bool latencyEx = false;
+    IDirect3DQuery9* frameQueries[kMaxFrameLatency]{};
+    bool frameQueryIssued[kMaxFrameLatency]{};
+    UINT frameQueryNext = 0;
+
+    // Implicit swapchain 0, for identity checks and its present parameters.
+    // No reference held; re-fetched once per epoch.
+    IDirect3DSwapChain9* implicitChain = nullptr;
+    LONG implicitEpoch = 0;
+
+    // GPU scaling target, sized to the client area (see PresentScaled).
+    IDirect3DSwapChain9* scaleChain = nullptr;
+    UINT scaleW = 0, scaleH = 0;
+    UINT scaleFailures = 0;            // failed creates at this size in a row
+    ULONGLONG scaleRetryMs = 0;        // no new attempt before this tick
+};
+
+static void ReleaseLatencyQueries(DeviceState& ds) {
+    for (int i = 0; i < kMaxFrameLatency; i++) {
+        if (ds.frameQueries[i]) ds.frameQueries[i]->Release();
+        ds.frameQueries[i] = nullptr;
+        ds.frameQueryIssued[i] = false;
+    }
+    ds.frameQueryNext = 0;
+}
+
+static void ReleaseScaleChain(DeviceState& ds) {
+    if (ds.scaleChain) ds.scaleChain->Release();
+    ds.scaleChain = nullptr;
+    ds.scaleW = ds.scaleH = 0;
+    ds.scaleFailures = 0;
+    ds.scaleRetryMs = 0;
+}
+
+// Everything we create on a device holds a reference to it and lives in
+// D3DPOOL_DEFAULT, so it must go before Reset, when the game lets go of the
+// device (Hook_DevRelease) and whenever we stop tracking it. All of it is
+// recreated lazily on the next Present.
+static void ReleaseDeviceResources(DeviceState& ds) {
+    ReleaseLatencyQueries(ds);
+    ReleaseScaleChain(ds);
+}
+
+// Device references that ReleaseDeviceResources gives back.
+static ULONG HeldDeviceRefs(const DeviceState& ds) {
+    ULONG n = ds.scaleChain ? 1 : 0;
+    for (IDirect3DQuery9* q : ds.frameQueries) n += q ? 1 : 0;
+    return n;
+}
+
+static DeviceState g_devStates[4];
+static UINT g_devStateNext = 0;
+
+static DeviceState* FindDeviceState(IDirect3DDevice9* dev) {
+    for (auto& ds : g_devStates) {
+        if (ds.dev == dev) return &ds;
+    }
+    return nullptr;
+}
+
+static DeviceState* GetDeviceState(IDirect3DDevice9* dev) {
+    if (DeviceState* ds = FindDeviceState(dev)) return ds;
+
+    DeviceState& ds = g_devStates[g_devStateNext++ % ARRAYSIZE(g_devStates)];
+    ReleaseDeviceResources(ds);
+    ds = DeviceState{};
+    ds.dev = dev;
+    return &ds;
+}
+
+// A new device may reuse the address of a released one.
+static void ForgetDeviceState(IDirect3DDevice9* dev) {
+    if (DeviceState* ds = FindDeviceState(dev)) {
+        ReleaseDeviceResources(*ds);
+        *ds = DeviceState{};
+    }
+}
+
+static void ShadowSetViewport(IDirect3DDevice9* dev, const D3DVIEWPORT9& vp) {
+    DeviceState* ds = FindDeviceState(dev);
+    if (!ds) return;
+    if (ds->vpKnown && memcmp(&ds->vp, &vp, sizeof(vp)) == 0) return;
+    ds->vp = vp;
+    ds->vpKnown = true;
+    ds->srcValid = false;
+}
+
+static void ShadowForgetViewport(IDirect3DDevice9* dev) {
+    DeviceState* ds = FindDeviceState(dev);
+    if (!ds) return;
+    ds->vpKnown = false;
+    ds->srcValid = false;
+}
+
+static void ShadowSetFullViewport(IDirect3DDevice9* dev, UINT w, UINT h) {
+    D3DVIEWPORT9 vp{ 0, 0, w, h, 0.0f, 1.0f };
+    ShadowSetViewport(dev, vp);
+}
+
+// CreateDevice/Reset bind the backbuffer as RT 0 and reset the viewport to cover it.
+static void ShadowResetRenderTarget(IDirect3DDevice9* dev) {
+    DeviceState* ds = GetDeviceState(dev);
+    ds->backbuffer = nullptr;
+    ds->rt0Known = false;
+    ds->vpKnown = false;
+    ds->srcValid = false;
+
+    IDirect3DSurface9* bb = nullptr;
+    if (FAILED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) || !bb) return;
+
+    D3DSURFACE_DESC d{};
+    if (SUCCEEDED(bb->GetDesc(&d)) && d.Width && d.Height) {
+        ds->backbuffer = bb;
+        ds->backbufferW = d.Width;
+        ds->backbufferH = d.Height;
+        ds->rt0Known = true;
+        ds->rt0IsBackbuffer = true;
+        ShadowSetFullViewport(dev, d.Width, d.Height);
+    }
+    bb->Release();
+}
+
+static void ShadowForgetRenderTarget(IDirect3DDevice9* dev) {
+    DeviceState* ds = FindDeviceState(dev);
+    if (!ds) return;
+    ds->backbuffer = nullptr;
+    ds->rt0Known = false;
+    ShadowForgetViewport(dev);
+}
+
+// Fallback for devices whose creation we didn't see (or after a failed Reset):
+// ask D3D once, then let Hook_SetRenderTarget keep the shadow current.
+static bool ProbeRenderTarget(IDirect3DDevice9* dev, DeviceState& ds) {
+    IDirect3DSurface9* bb = nullptr;
+    if (FAILED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) || !bb) return false;
+
+    D3DSURFACE_DESC d{};
+    if (FAILED(bb->GetDesc(&d)) || d.Width == 0 || d.Height == 0) {
+        bb->Release();
+        return false;
+    }
+
+    IDirect3DSurface9* rt = nullptr;
+    if (FAILED(dev->GetRenderTarget(0, &rt)) || !rt) {
+        bb->Release();
+        return false;
+    }
+
+    ds.backbuffer = bb;
+    ds.backbufferW = d.Width;
+    ds.backbufferH = d.Height;
+    ds.rt0IsBackbuffer = (rt == bb);
+    ds.rt0Known = true;
+
+    rt->Release();
+    bb->Release();
+    return true;
+}
+
+static bool IsDeviceStateCurrent(const DeviceState& ds) {
+    return ds.epoch == g_presentEpoch && ds.hwnd == g_hwnd;
+}
+
+static bool RefreshDeviceState(IDirect3DDevice9* dev, DeviceState& ds) {
+    // Sample the epoch first so an invalidation racing with the queries below isn't lost.
+    const LONG epoch = g_presentEpoch;
+    ds.epoch = 0;
+
+    RefreshHwndFromDevice(dev);
+
+    if (!g_hwnd || !IsWindow(g_hwnd)) {
+        g_hwnd = FindMainWindowForThisProcess();
+        if (g_hwnd) InstallWndProc(g_hwnd);
+    }
+
+    HWND target = (g_hwnd && IsWindow(g_hwnd)) ? g_hwnd : GetDeviceHwnd(dev);
+
+    RECT dst{};
+    if (!BuildClientDstRect(target, dst)) return false;
+
+    UINT bbw = 0, bbh = 0;
+    if (!UpdateBackbufferSize(dev, &bbw, &bbh)) return false;
+
+    ds.hwnd = target;
+    ds.dst = dst;
+    ds.image = FitRect(EffectiveFit(), (LONG)bbw, (LONG)bbh, dst.right, dst.bottom);
+    ds.bbW = bbw;
+    ds.bbH = bbh;
+    ds.srcValid = false;
+    ds.epoch = epoch;
+
+    if (target == g_hwnd) SetViewClientSize(dst.right, dst.bottom);
+    PaintBars(target, ds.dst, ds.image);
+    return true;
+}
+
+static const RECT* CachedSrcRect(IDirect3DDevice9* dev, DeviceState& ds) {
+    if (!ds.vpKnown) {
+        if (FAILED(dev->GetViewport(&ds.vp))) return nullptr;
+        ds.vpKnown = true;
+        ds.srcValid = false;
+    }
+
+    if (!ds.srcValid) {
+        ds.hasSrc = SrcRectFromViewport(ds.vp, ds.bbW, ds.bbH, ds.src) != nullptr;
+        ds.srcValid = true;
+    }
+    return ds.hasSrc ? &ds.src : nullptr;
+}
+
+// =============================================================================
+// Flip-model upgrade
+// =============================================================================
+
+// With FlipEx=1 Hook_CreateDevice creates the game's device as FLIPEX through
+// a private IDirect3D9Ex instead of the blit-model one it asked for; the game
+// itself keeps the plain IDirect3D9 it got from Direct3DCreate9. Ex devices
+// reject D3DPOOL_MANAGED, so managed resources are emulated the way the
+// runtime does it: the game gets a DEFAULT resource, every lock goes to a
+// SYSTEMMEM twin, and the twin is uploaded on unlock and after Reset. Textures
+// upload with UpdateTexture. Buffers have no such call; theirs is a DYNAMIC
+// buffer the twin is copied into under D3DLOCK_DISCARD.
+
+// Devices created as FLIPEX. Kept apart from the DeviceState ring, which
+// drops a device's state once four newer ones have come along; an entry goes
+// only when the game releases the device or a new one is created at its
+// address.
+static SRWLOCK g_flipExLock = SRWLOCK_INIT;
+static std::vector<IDirect3DDevice9*> g_flipExDevices;
+static volatile LONG g_flipExCount = 0;
+
+static bool IsFlipExDevice(IDirect3DDevice9* dev) {
+    if (InterlockedCompareExchange(&g_flipExCount, 0, 0) == 0) return false;
+
+    AcquireSRWLockShared(&g_flipExLock);
+    const bool found = std::find(g_flipExDevices.begin(), g_flipExDevices.end(), dev) != g_flipExDevices.end();
+    ReleaseSRWLockShared(&g_flipExLock);
+    return found;
+}
+
+static void SetFlipExDevice(IDirect3DDevice9* dev, bool flip) {
+    if (IsFlipExDevice(dev) == flip) return;
+
+    AcquireSRWLockExclusive(&g_flipExLock);
+    auto it = std::find(g_flipExDevices.begin(), g_flipExDevices.end(), dev);
+    if (flip && it == g_flipExDevices.end()) {
+        g_flipExDevices.push_back(dev);
+        InterlockedIncrement(&g_flipExCount);
+    }
+    else if (!flip && it != g_flipExDevices.end()) {
+        g_flipExDevices.erase(it);
+        InterlockedDecrement(&g_flipExCount);
+    }
+    ReleaseSRWLockExclusive(&g_flipExLock);
+}
+
+static bool CanUseFlipEx(const D3DPRESENT_PARAMETERS& pp) {
+    // Flip model has no multisampled backbuffers.
+    return pp.Windowed && pp.MultiSampleType == D3DMULTISAMPLE_NONE;
+}
+
+static void ApplyFlipExPP(D3DPRESENT_PARAMETERS& pp) {
+    pp.SwapEffect = D3DSWAPEFFECT_FLIPEX;
+    pp.MultiSampleType = D3DMULTISAMPLE_NONE;
+    pp.MultiSampleQuality = 0;
+    if (pp.BackBufferCount < 2) pp.BackBufferCount = 2;
+}
+
+// -----------------------------------------------------------------------------
+// Managed pool emulation
+// -----------------------------------------------------------------------------
+
+enum ShadowKind {
+    kShadowTexture = 0,
+    kShadowCube,
+    kShadowVolume,
+    kShadowVertexBuffer,
+    kShadowIndexBuffer,
+};
+
+struct ShadowEntry {
+    UINT64 id;                          // tells a reused address from the old resource
+    IDirect3DDevice9* dev;              // no reference; the resource keeps it alive
+    IDirect3DResource9* twin;           // SYSTEMMEM copy, one reference
+    ShadowKind kind;
+    UINT bytes;                         // buffers: length of both
+    std::vector<void*> levels;          // twin surfaces/volumes handed to the game
+};
+
+// Keyed by the DEFAULT resource the game holds. g_shadowLevels maps a twin
+// level handed out by GetSurfaceLevel & co. back to that key, so unlocking
+// the level uploads its texture.
+static SRWLOCK g_shadowLock = SRWLOCK_INIT;
+static std::unordered_map<void*, ShadowEntry> g_shadows;
+static std::unordered_map<void*, void*> g_shadowLevels;
+static volatile LONG g_shadowCount = 0;
+static UINT64 g_shadowNextId = 1;
+
+// Not valid on a managed resource; harmless to drop for the twin.
+static const DWORD kManagedIgnoredLockFlags = D3DLOCK_DISCARD | D3DLOCK_NOOVERWRITE;
+
+static bool HaveShadows() {
+    return InterlockedCompareExchange(&g_shadowCount, 0, 0) != 0;
+}
+
+static void RegisterShadow(void* tex, IDirect3DDevice9* dev, IDirect3DResource9* twin, ShadowKind kind,
+    UINT bytes = 0)
+{
+    IDirect3DResource9* stale = nullptr;
+
+    AcquireSRWLockExclusive(&g_shadowLock);
+    auto it = g_shadows.find(tex);
+    if (it != g_shadows.end()) {
+        // The previous texture at this address died without us seeing it.
+        for (void* level : it->second.levels) g_shadowLevels.erase(level);
+        stale = it->second.twin;
+        g_shadows.erase(it);
+        InterlockedDecrement(&g_shadowCount);
+    }
+    g_shadows.emplace(tex, ShadowEntry{ g_shadowNextId++, dev, twin, kind, bytes, {} });
+    InterlockedIncrement(&g_shadowCount);
+    ReleaseSRWLockExclusive(&g_shadowLock);
+
+    if (stale) stale->Release();
+}
+
+static void ForgetShadow(void* tex, UINT64 id) {
+    IDirect3DResource9* twin = nullptr;
+
+    AcquireSRWLockExclusive(&g_shadowLock);
+    auto it = g_shadows.find(tex);
+    if (it != g_shadows.end() && it->second.id == id) {
+        for (void* level : it->second.levels) g_shadowLevels.erase(level);
+        twin = it->second.twin;
+        g_shadows.erase(it);
+        InterlockedDecrement(&g_shadowCount);
+    }
+    ReleaseSRWLockExclusive(&g_shadowLock);
+
+    if (twin) twin->Release();
+}
+
+// Returns the twin with a reference added, or nullptr for resources we don't shadow.
+static IDirect3DResource9* AcquireTwin(void* tex) {
+    if (!HaveShadows()) return nullptr;
+
+    IDirect3DResource9* twin = nullptr;
+    AcquireSRWLockShared(&g_shadowLock);
+    auto it = g_shadows.find(tex);
+    if (it != g_shadows.end()) {
+        twin = it->second.twin;
+        twin->AddRef();
+    }
+    ReleaseSRWLockShared(&g_shadowLock);
+    return twin;
+}
+
+static bool IsShadowed(void* tex) {
+    if (!HaveShadows()) return false;
+
+    AcquireSRWLockShared(&g_shadowLock);
+    const bool found = g_shadows.find(tex) != g_shadows.end();
+    ReleaseSRWLockShared(&g_shadowLock);
+    return found;
+}
+
+static void TrackTwinLevel(void* level, void* tex) {
+    AcquireSRWLockExclusive(&g_shadowLock);
+    auto it = g_shadows.find(tex);
+    if (it != g_shadows.end() && g_shadowLevels.emplace(level, tex).second) {
+        it->second.levels.push_back(level);
+    }
+    ReleaseSRWLockExclusive(&g_shadowLock);
+}
+
+// Straight to the runtime, past the twin redirect in Hook_BufLock.
+static HRESULT RealBufLock(ShadowKind kind, IDirect3DResource9* buf, UINT offset, UINT size, void** data, DWORD flags) {
+    return (kind == kShadowIndexBuffer ? Real_IBLock : Real_VBLock)(buf, offset, size, data, flags);
+}
+
+static HRESULT RealBufUnlock(ShadowKind kind, IDirect3DResource9* buf) {
+    return (kind == kShadowIndexBuffer ? Real_IBUnlock : Real_VBUnlock)(buf);
+}
+
+// Copies the twin into the resource the game renders with. Textures take only
+// the dirty regions, through UpdateTexture. A buffer is copied whole; DISCARD
+// renames its DYNAMIC storage instead of waiting for the GPU to finish with it.
+static void UploadTwin(IDirect3DResource9* res, IDirect3DResource9* twin, ShadowKind kind, UINT bytes,
+    IDirect3DDevice9* dev)
+{
+    if (kind != kShadowVertexBuffer && kind != kShadowIndexBuffer) {
+        dev->UpdateTexture(static_cast<IDirect3DBaseTexture9*>(twin), static_cast<IDirect3DBaseTexture9*>(res));
+        return;
+    }
+
+    void* from = nullptr;
+    void* to = nullptr;
+    if (FAILED(RealBufLock(kind, twin, 0, 0, &from, D3DLOCK_READONLY))) return;
+    if (SUCCEEDED(RealBufLock(kind, res, 0, 0, &to, D3DLOCK_DISCARD))) {
+        memcpy(to, from, bytes);
+        RealBufUnlock(kind, res);
+    }
+    RealBufUnlock(kind, twin);
+}
+
+static void UploadShadow(void* tex) {
+    IDirect3DResource9* twin = nullptr;
+    IDirect3DDevice9* dev = nullptr;
+    ShadowKind kind = kShadowTexture;
+    UINT bytes = 0;
+
+    AcquireSRWLockShared(&g_shadowLock);
+    auto it = g_shadows.find(tex);
+    if (it != g_shadows.end()) {
+        twin = it->second.twin;
+        dev = it->second.dev;
+        kind = it->second.kind;
+        bytes = it->second.bytes;
+        twin->AddRef();
+    }
+    ReleaseSRWLockShared(&g_shadowLock);
+
+    if (!twin) return;
+    UploadTwin(static_cast<IDirect3DResource9*>(tex), twin, kind, bytes, dev);
+    twin->Release();
+}
+
+// Unlock of a twin level the game got from GetSurfaceLevel & co.
+static void UploadShadowOfLevel(void* level) {
+    if (!HaveShadows()) return;
+
+    void* tex = nullptr;
+    AcquireSRWLockShared(&g_shadowLock);
+    auto it = g_shadowLevels.find(level);
+    if (it != g_shadowLevels.end()) tex = it->second;
+    ReleaseSRWLockShared(&g_shadowLock);
+
+    if (tex) UploadShadow(tex);
+}
+
+// After Reset every twin is marked fully dirty and uploaded again, so the
+// resources come back with their contents whatever the runtime did to them.
+static void RestoreShadows(IDirect3DDevice9* dev) {
+    struct Pending {
+        IDirect3DResource9* tex;
+        IDirect3DResource9* twin;
+        ShadowKind kind;
+        UINT bytes;
+    };
+    std::vector<Pending> work;
+
+    AcquireSRWLockShared(&g_shadowLock);
+    for (auto& kv : g_shadows) {
+        if (kv.second.dev != dev) continue;
+        IDirect3DResource9* tex = static_cast<IDirect3DResource9*>(kv.first);
+        tex->AddRef();
+        kv.second.twin->AddRef();
+        work.push_back({ tex, kv.second.twin, kv.second.kind, kv.second.bytes });
+    }
+    ReleaseSRWLockShared(&g_shadowLock);
+
+    for (const Pending& p : work) {
+        switch (p.kind) {
+        case kShadowTexture:
+            static_cast<IDirect3DTexture9*>(p.twin)->AddDirtyRect(nullptr);
+            break;
+        case kShadowCube:
+            for (int f = 0; f < 6; f++) {
+                static_cast<IDirect3DCubeTexture9*>(p.twin)->AddDirtyRect((D3DCUBEMAP_FACES)f, nullptr);
+            }
+            break;
+        case kShadowVolume:
+            static_cast<IDirect3DVolumeTexture9*>(p.twin)->AddDirtyBox(nullptr);
+            break;
+        case kShadowVertexBuffer:
+        case kShadowIndexBuffer:
+            break;
+        }
+        UploadTwin(p.tex, p.twin, p.kind, p.bytes, dev);
+        p.twin->Release();
+        p.tex->Release();
+    }
+
+    if (!work.empty()) DebugLog("flipex: restored %u managed resources after Reset\n", (UINT)work.size());
+}
+
+// A texture with AUTOGENMIPMAP only takes its top level from UpdateTexture and
+// regenerates the rest, so its twin needs just the one level.
+static UINT TwinLevels(IDirect3DBaseTexture9* tex, DWORD usage) {
+    return (usage & D3DUSAGE_AUTOGENMIPMAP) ? 1 : tex->GetLevelCount();
+}
+
+// Every shadowed type shares the same bookkeeping on release. The twin itself
+// and every non-managed resource come through here as well.
+static ULONG ReleaseMaybeShadowed(IUnknown* self, ResourceRelease_t real) {
+    if (!HaveShadows()) return real(self);
+
+    UINT64 id = 0;
+    AcquireSRWLockShared(&g_shadowLock);
+    auto it = g_shadows.find(self);
+    if (it != g_shadows.end()) id = it->second.id;
+    ReleaseSRWLockShared(&g_shadowLock);
+
+    const ULONG refs = real(self);
+    if (id != 0 && refs == 0) ForgetShadow(self, id);
+    return refs;
+}
+
+static ULONG STDMETHODCALLTYPE Hook_TexRelease(IUnknown* self) {
+    return ReleaseMaybeShadowed(self, Real_TexRelease);
+}
+
+static ULONG STDMETHODCALLTYPE Hook_CubeRelease(IUnknown* self) {
+    return ReleaseMaybeShadowed(self, Real_CubeRelease);
+}
+
+static ULONG STDMETHODCALLTYPE Hook_VolRelease(IUnknown* self) {
+    return ReleaseMaybeShadowed(self, Real_VolRelease);
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_TexGetLevelDesc(IDirect3DTexture9* self, UINT level, D3DSURFACE_DESC* desc) {
+    HRESULT hr = Real_TexGetLevelDesc(self, level, desc);
+    if (SUCCEEDED(hr) && desc && IsShadowed(self)) desc->Pool = D3DPOOL_MANAGED;
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_TexGetSurfaceLevel(IDirect3DTexture9* self, UINT level, IDirect3DSurface9** out) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_TexGetSurfaceLevel(self, level, out);
+
+    HRESULT hr = Real_TexGetSurfaceLevel(static_cast<IDirect3DTexture9*>(twin), level, out);
+    if (SUCCEEDED(hr) && out && *out) TrackTwinLevel(*out, self);
+    twin->Release();
+    return hr;
 }
 
-static HWND WINAPI Hook_GetForegroundWindow() {
-    HWND real = Real_GetForegroundWindow ? Real_GetForegroundWindow() : nullptr;
+static HRESULT STDMETHODCALLTYPE Hook_TexLockRect(IDirect3DTexture9* self,
+    UINT level, D3DLOCKED_RECT* locked, const RECT* rect, DWORD flags)
+{
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_TexLockRect(self, level, locked, rect, flags);
 
-    if (!g_cfg.ignoreDeactivate) return real;
+    HRESULT hr = Real_TexLockRect(static_cast<IDirect3DTexture9*>(twin), level, locked, rect,
+        flags & ~kManagedIgnoredLockFlags);
+    twin->Release();
+    return hr;
+}
 
-    // safety: avoid launchers/config processes that die quickly
-    if (g_processStartMs == 0 || (GetTickCount64() - g_processStartMs) < 5000)
-        return real;
+static HRESULT STDMETHODCALLTYPE Hook_TexUnlockRect(IDirect3DTexture9* self, UINT level) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_TexUnlockRect(self, level);
 
-    // don't spoof until we're actually presenting
-    if (InterlockedCompareExchange(&g_seenPresent, 0, 0) == 0)
-        return real;
+    HRESULT hr = Real_TexUnlockRect(static_cast<IDirect3DTexture9*>(twin), level);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
+}
 
-    // only spoof while deactivated
-    if (InterlockedCompareExchange(&g_deactivated, 0, 0) == 0)
-        return real;
+static HRESULT STDMETHODCALLTYPE Hook_TexAddDirtyRect(IDirect3DTexture9* self, const RECT* rect) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_TexAddDirtyRect(self, rect);
 
-    if (!g_hwnd || !IsWindow(g_hwnd))
-        return real;
+    HRESULT hr = Real_TexAddDirtyRect(static_cast<IDirect3DTexture9*>(twin), rect);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
+}
 
-    if (real == g_hwnd)
-        return real;
+static HRESULT STDMETHODCALLTYPE Hook_CubeGetLevelDesc(IDirect3DCubeTexture9* self, UINT level, D3DSURFACE_DESC* desc) {
+    HRESULT hr = Real_CubeGetLevelDesc(self, level, desc);
+    if (SUCCEEDED(hr) && desc && IsShadowed(self)) desc->Pool = D3DPOOL_MANAGED;
+    return hr;
+}
 
-    return g_hwnd;
+static HRESULT STDMETHODCALLTYPE Hook_CubeGetSurface(IDirect3DCubeTexture9* self,
+    D3DCUBEMAP_FACES face, UINT level, IDirect3DSurface9** out)
+{
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_CubeGetSurface(self, face, level, out);
+
+    HRESULT hr = Real_CubeGetSurface(static_cast<IDirect3DCubeTexture9*>(twin), face, level, out);
+    if (SUCCEEDED(hr) && out && *out) TrackTwinLevel(*out, self);
+    twin->Release();
+    return hr;
 }
 
-static void MaybeInstallGfwHook() {
-    if (InterlockedCompareExchange(&g_gfwHookInstalled, 0, 0) != 0)
-        return;
+static HRESULT STDMETHODCALLTYPE Hook_CubeLockRect(IDirect3DCubeTexture9* self,
+    D3DCUBEMAP_FACES face, UINT level, D3DLOCKED_RECT* locked, const RECT* rect, DWORD flags)
+{
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_CubeLockRect(self, face, level, locked, rect, flags);
 
-    if (!g_cfg.ignoreDeactivate)
-        return;
+    HRESULT hr = Real_CubeLockRect(static_cast<IDirect3DCubeTexture9*>(twin), face, level, locked, rect,
+        flags & ~kManagedIgnoredLockFlags);
+    twin->Release();
+    return hr;
+}
 
-    if (!g_pGetForegroundWindow)
-        return;
+static HRESULT STDMETHODCALLTYPE Hook_CubeUnlockRect(IDirect3DCubeTexture9* self, D3DCUBEMAP_FACES face, UINT level) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_CubeUnlockRect(self, face, level);
 
-    if (g_processStartMs == 0 || (GetTickCount64() - g_processStartMs) < 5000)
-        return;
+    HRESULT hr = Real_CubeUnlockRect(static_cast<IDirect3DCubeTexture9*>(twin), face, level);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
+}
 
-    if (g_presentTotal < 120)
-        return;
+static HRESULT STDMETHODCALLTYPE Hook_CubeAddDirtyRect(IDirect3DCubeTexture9* self, D3DCUBEMAP_FACES face, const RECT* rect) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_CubeAddDirtyRect(self, face, rect);
 
-    if (MH_CreateHook(g_pGetForegroundWindow, (void*)&Hook_GetForegroundWindow,
-        (void**)&Real_GetForegroundWindow) == MH_OK) {
-        if (MH_EnableHook(g_pGetForegroundWindow) == MH_OK) {
-            InterlockedExchange(&g_gfwHookInstalled, 1);
-        }
-    }
+    HRESULT hr = Real_CubeAddDirtyRect(static_cast<IDirect3DCubeTexture9*>(twin), face, rect);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
 }
 
-static HMODULE g_user32 = nullptr;
+static HRESULT STDMETHODCALLTYPE Hook_VolGetLevelDesc(IDirect3DVolumeTexture9* self, UINT level, D3DVOLUME_DESC* desc) {
+    HRESULT hr = Real_VolGetLevelDesc(self, level, desc);
+    if (SUCCEEDED(hr) && desc && IsShadowed(self)) desc->Pool = D3DPOOL_MANAGED;
+    return hr;
+}
 
-static HMODULE GetUser32Module() {
-    if (g_user32) return g_user32;
-    g_user32 = GetModuleHandleA("user32.dll");
-    if (!g_user32) g_user32 = LoadLibraryA("user32.dll");
-    return g_user32;
+static HRESULT STDMETHODCALLTYPE Hook_VolGetVolumeLevel(IDirect3DVolumeTexture9* self, UINT level, IDirect3DVolume9** out) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_VolGetVolumeLevel(self, level, out);
+
+    HRESULT hr = Real_VolGetVolumeLevel(static_cast<IDirect3DVolumeTexture9*>(twin), level, out);
+    if (SUCCEEDED(hr) && out && *out) TrackTwinLevel(*out, self);
+    twin->Release();
+    return hr;
 }
 
-static void InstallUser32Hooks() {
-    HMODULE user32 = GetUser32Module();
-    if (!user32) return;
+static HRESULT STDMETHODCALLTYPE Hook_VolLockBox(IDirect3DVolumeTexture9* self,
+    UINT level, D3DLOCKED_BOX* locked, const D3DBOX* box, DWORD flags)
+{
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_VolLockBox(self, level, locked, box, flags);
 
-    auto hookIfPresent = [&](const char* name, void* detour, void** originalOut) {
-        void* p = reinterpret_cast<void*>(GetProcAddress(user32, name));
-        if (!p) return;
-        if (MH_CreateHook(p, detour, originalOut) == MH_OK) {
-            MH_EnableHook(p);
-        }
-        };
+    HRESULT hr = Real_VolLockBox(static_cast<IDirect3DVolumeTexture9*>(twin), level, locked, box,
+        flags & ~kManagedIgnoredLockFlags);
+    twin->Release();
+    return hr;
+}
 
-    hookIfPresent("ClipCursor", (void*)&Hook_ClipCursor, (void**)&Real_ClipCursor);
-    hookIfPresent("SetCapture", (void*)&Hook_SetCapture, (void**)&Real_SetCapture);
-    hookIfPresent("SetCursorPos", (void*)&Hook_SetCursorPos, (void**)&Real_SetCursorPos);
+static HRESULT STDMETHODCALLTYPE Hook_VolUnlockBox(IDirect3DVolumeTexture9* self, UINT level) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_VolUnlockBox(self, level);
 
-    hookIfPresent("ChangeDisplaySettingsExA", (void*)&Hook_ChangeDisplaySettingsExA, (void**)&Real_ChangeDisplaySettingsExA);
-    hookIfPresent("ChangeDisplaySettingsExW", (void*)&Hook_ChangeDisplaySettingsExW, (void**)&Real_ChangeDisplaySettingsExW);
+    HRESULT hr = Real_VolUnlockBox(static_cast<IDirect3DVolumeTexture9*>(twin), level);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
+}
 
-    g_pGetForegroundWindow = reinterpret_cast<void*>(GetProcAddress(user32, "GetForegroundWindow"));
+static HRESULT STDMETHODCALLTYPE Hook_VolAddDirtyBox(IDirect3DVolumeTexture9* self, const D3DBOX* box) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_VolAddDirtyBox(self, box);
+
+    HRESULT hr = Real_VolAddDirtyBox(static_cast<IDirect3DVolumeTexture9*>(twin), box);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
 }
 
-// These are the "dangerous" hooks that can break some titles. Install only if we detect we need them.
-static void InstallUser32VirtualHooks() {
-    HMODULE user32 = GetUser32Module();
-    if (!user32) return;
+// Twin levels handed to the game; every other surface and volume passes straight through.
+static HRESULT STDMETHODCALLTYPE Hook_SurfUnlockRect(IDirect3DSurface9* self) {
+    HRESULT hr = Real_SurfUnlockRect(self);
+    if (SUCCEEDED(hr)) UploadShadowOfLevel(self);
+    return hr;
+}
 
-    auto hookIfPresent = [&](const char* name, void* detour, void** originalOut) {
-        void* p = reinterpret_cast<void*>(GetProcAddress(user32, name));
-        if (!p) return;
-        if (MH_CreateHook(p, detour, originalOut) == MH_OK) {
-            MH_EnableHook(p);
-        }
-        };
+static HRESULT STDMETHODCALLTYPE Hook_SurfReleaseDC(IDirect3DSurface9* self, HDC dc) {
+    HRESULT hr = Real_SurfReleaseDC(self, dc);
+    if (SUCCEEDED(hr)) UploadShadowOfLevel(self);
+    return hr;
+}
 
-    hookIfPresent("GetClientRect", (void*)&Hook_GetClientRect, (void**)&Real_GetClientRect);
-    hookIfPresent("ScreenToClient", (void*)&Hook_ScreenToClient, (void**)&Real_ScreenToClient);
-    hookIfPresent("ClientToScreen", (void*)&Hook_ClientToScreen, (void**)&Real_ClientToScreen);
+static HRESULT STDMETHODCALLTYPE Hook_VolumeUnlockBox(IDirect3DVolume9* self) {
+    HRESULT hr = Real_VolumeUnlockBox(self);
+    if (SUCCEEDED(hr)) UploadShadowOfLevel(self);
+    return hr;
 }
 
-static void MaybeInstallUser32VirtualHooks() {
-    if (InterlockedCompareExchange(&g_win32VirtEnabled, 0, 0) == 0) return;
+// Vertex and index buffers. Where both types share the runtime's code, the
+// vertex buffer detours serve index buffers too.
+static ULONG STDMETHODCALLTYPE Hook_VBRelease(IUnknown* self) {
+    return ReleaseMaybeShadowed(self, Real_VBRelease);
+}
 
-    // 0 = not installed, 2 = installing, 1 = installed
-    if (InterlockedCompareExchange(&g_win32VirtHooksInstalled, 2, 0) != 0) return;
+static ULONG STDMETHODCALLTYPE Hook_IBRelease(IUnknown* self) {
+    return ReleaseMaybeShadowed(self, Real_IBRelease);
+}
 
-    InstallUser32VirtualHooks();
+static HRESULT LockMaybeShadowed(IDirect3DResource9* self, UINT offset, UINT size, void** data, DWORD flags,
+    BufLock_t real)
+{
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return real(self, offset, size, data, flags);
 
-    // Even if some hooks fail, we still consider this "installed enough" to avoid thrashing.
-    InterlockedExchange(&g_win32VirtHooksInstalled, 1);
+    HRESULT hr = real(twin, offset, size, data, flags & ~kManagedIgnoredLockFlags);
+    twin->Release();
+    return hr;
 }
 
-// =============================================================================
-// DirectInput mouse (disable exclusive)
-// =============================================================================
+static HRESULT UnlockMaybeShadowed(IDirect3DResource9* self, BufUnlock_t real) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return real(self);
 
-using DirectInput8Create_t = HRESULT(WINAPI*)(HINSTANCE, DWORD, REFIID, LPVOID*, LPUNKNOWN);
-using SetCoopLevel_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self, HWND hwnd, DWORD flags);
-using GetDeviceState_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self, DWORD cbData, LPVOID lpvData);
-using Poll_t = HRESULT(STDMETHODCALLTYPE*)(IDirectInputDevice8A* self);
+    HRESULT hr = real(twin);
+    if (SUCCEEDED(hr)) UploadShadow(self);
+    twin->Release();
+    return hr;
+}
 
-static SetCoopLevel_t Real_SetCooperativeLevel = nullptr;
-static HMODULE              g_realDInput8 = nullptr;
-static DirectInput8Create_t Real_DirectInput8Create = nullptr;
-static volatile LONG g_dinputHooksInstalled = 0;
-static GetDeviceState_t Real_GetDeviceState = nullptr;
-static Poll_t           Real_Poll = nullptr;
+static HRESULT STDMETHODCALLTYPE Hook_VBLock(IDirect3DResource9* self, UINT offset, UINT size, void** data, DWORD flags) {
+    return LockMaybeShadowed(self, offset, size, data, flags, Real_VBLock);
+}
 
-static bool IsMouseOrKeyboardDevice(IDirectInputDevice8A* self) {
-    if (!self) return false;
-    DIDEVICEINSTANCEA dii{};
-    dii.dwSize = sizeof(dii);
-    if (FAILED(self->GetDeviceInfo(&dii))) return false;
-    const DWORD t = GET_DIDEVICE_TYPE(dii.dwDevType);
-    return t == DI8DEVTYPE_MOUSE || t == DI8DEVTYPE_KEYBOARD;
+static HRESULT STDMETHODCALLTYPE Hook_VBUnlock(IDirect3DResource9* self) {
+    return UnlockMaybeShadowed(self, Real_VBUnlock);
 }
 
-static HRESULT STDMETHODCALLTYPE Hook_GetDeviceState(IDirectInputDevice8A* self, DWORD cbData, LPVOID lpvData) {
-    HRESULT hr = Real_GetDeviceState ? Real_GetDeviceState(self, cbData, lpvData) : DIERR_GENERIC;
+static HRESULT STDMETHODCALLTYPE Hook_IBLock(IDirect3DResource9* self, UINT offset, UINT size, void** data, DWORD flags) {
+    return LockMaybeShadowed(self, offset, size, data, flags, Real_IBLock);
+}
 
-    if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED) {
-        if (IsMouseOrKeyboardDevice(self)) {
-            self->Acquire();
-            hr = Real_GetDeviceState ? Real_GetDeviceState(self, cbData, lpvData) : hr;
-        }
-    }
+static HRESULT STDMETHODCALLTYPE Hook_IBUnlock(IDirect3DResource9* self) {
+    return UnlockMaybeShadowed(self, Real_IBUnlock);
+}
+
+// The twin has the game's usage; only the pool needs putting back.
+static HRESULT STDMETHODCALLTYPE Hook_VBGetDesc(IDirect3DVertexBuffer9* self, D3DVERTEXBUFFER_DESC* desc) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_VBGetDesc(self, desc);
+
+    HRESULT hr = Real_VBGetDesc(static_cast<IDirect3DVertexBuffer9*>(twin), desc);
+    if (SUCCEEDED(hr) && desc) desc->Pool = D3DPOOL_MANAGED;
+    twin->Release();
     return hr;
 }
 
-static HRESULT STDMETHODCALLTYPE Hook_Poll(IDirectInputDevice8A* self) {
-    HRESULT hr = Real_Poll ? Real_Poll(self) : DIERR_GENERIC;
-    if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED) {
-        if (IsMouseOrKeyboardDevice(self)) {
-            self->Acquire();
-            hr = Real_Poll ? Real_Poll(self) : hr;
-        }
+static HRESULT STDMETHODCALLTYPE Hook_IBGetDesc(IDirect3DIndexBuffer9* self, D3DINDEXBUFFER_DESC* desc) {
+    IDirect3DResource9* twin = AcquireTwin(self);
+    if (!twin) return Real_IBGetDesc(self, desc);
+
+    HRESULT hr = Real_IBGetDesc(static_cast<IDirect3DIndexBuffer9*>(twin), desc);
+    if (SUCCEEDED(hr) && desc) desc->Pool = D3DPOOL_MANAGED;
+    twin->Release();
+    return hr;
+}
+
+// Managed textures are only emulated once the lock hooks for that texture
+// type are live; otherwise the request goes to the runtime unchanged.
+static HRESULT STDMETHODCALLTYPE Hook_CreateTexture(IDirect3DDevice9* self,
+    UINT w, UINT h, UINT levels, DWORD usage, D3DFORMAT fmt, D3DPOOL pool,
+    IDirect3DTexture9** out, HANDLE* shared)
+{
+    if (pool != D3DPOOL_MANAGED || !Real_TexLockRect || !out || !IsFlipExDevice(self)) {
+        return Real_CreateTexture(self, w, h, levels, usage, fmt, pool, out, shared);
+    }
+
+    HRESULT hr = Real_CreateTexture(self, w, h, levels, usage, fmt, D3DPOOL_DEFAULT, out, shared);
+    if (FAILED(hr)) return hr;
+
+    IDirect3DTexture9* twin = nullptr;
+    hr = Real_CreateTexture(self, w, h, TwinLevels(*out, usage), 0, fmt, D3DPOOL_SYSTEMMEM, &twin, nullptr);
+    if (FAILED(hr)) {
+        (*out)->Release();
+        *out = nullptr;
+        return hr;
     }
+
+    RegisterShadow(*out, self, twin, kShadowTexture);
     return hr;
 }
 
-static HRESULT STDMETHODCALLTYPE Hook_SetCooperativeLevel(IDirectInputDevice8A* self, HWND hwnd, DWORD flags) {
-    DIDEVICEINSTANCEA dii{};
-    dii.dwSize = sizeof(dii);
+static HRESULT STDMETHODCALLTYPE Hook_CreateVolumeTexture(IDirect3DDevice9* self,
+    UINT w, UINT h, UINT d, UINT levels, DWORD usage, D3DFORMAT fmt, D3DPOOL pool,
+    IDirect3DVolumeTexture9** out, HANDLE* shared)
+{
+    if (pool != D3DPOOL_MANAGED || !Real_VolLockBox || !out || !IsFlipExDevice(self)) {
+        return Real_CreateVolumeTexture(self, w, h, d, levels, usage, fmt, pool, out, shared);
+    }
 
-    const bool isMouse = (self && SUCCEEDED(self->GetDeviceInfo(&dii)) &&
-        GET_DIDEVICE_TYPE(dii.dwDevType) == DI8DEVTYPE_MOUSE);
+    HRESULT hr = Real_CreateVolumeTexture(self, w, h, d, levels, usage, fmt, D3DPOOL_DEFAULT, out, shared);
+    if (FAILED(hr)) return hr;
 
-    if (isMouse) {
-        flags &= ~DISCL_EXCLUSIVE;
-        flags |= DISCL_NONEXCLUSIVE;
+    IDirect3DVolumeTexture9* twin = nullptr;
+    hr = Real_CreateVolumeTexture(self, w, h, d, TwinLevels(*out, usage), 0, fmt, D3DPOOL_SYSTEMMEM, &twin, nullptr);
+    if (FAILED(hr)) {
+        (*out)->Release();
+        *out = nullptr;
+        return hr;
+    }
 
-        flags &= ~DISCL_BACKGROUND;
-        flags |= DISCL_FOREGROUND;
+    RegisterShadow(*out, self, twin, kShadowVolume);
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_CreateCubeTexture(IDirect3DDevice9* self,
+    UINT edge, UINT levels, DWORD usage, D3DFORMAT fmt, D3DPOOL pool,
+    IDirect3DCubeTexture9** out, HANDLE* shared)
+{
+    if (pool != D3DPOOL_MANAGED || !Real_CubeLockRect || !out || !IsFlipExDevice(self)) {
+        return Real_CreateCubeTexture(self, edge, levels, usage, fmt, pool, out, shared);
     }
 
-    return Real_SetCooperativeLevel ? Real_SetCooperativeLevel(self, hwnd, flags) : DIERR_GENERIC;
+    HRESULT hr = Real_CreateCubeTexture(self, edge, levels, usage, fmt, D3DPOOL_DEFAULT, out, shared);
+    if (FAILED(hr)) return hr;
+
+    IDirect3DCubeTexture9* twin = nullptr;
+    hr = Real_CreateCubeTexture(self, edge, TwinLevels(*out, usage), 0, fmt, D3DPOOL_SYSTEMMEM, &twin, nullptr);
+    if (FAILED(hr)) {
+        (*out)->Release();
+        *out = nullptr;
+        return hr;
+    }
+
+    RegisterShadow(*out, self, twin, kShadowCube);
+    return hr;
 }
 
-static void EnsureRealDInput8Loaded() {
-    if (g_realDInput8) return;
+// Buffers the same way, with a twin of the game's usage. The buffer the GPU
+// reads is DYNAMIC so uploads can DISCARD, and WRITEONLY since only uploads
+// touch it; a plain DEFAULT buffer would stall every lock and read back
+// unreliably.
+static const DWORD kShadowBufferUsage = D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY;
 
-    char sysdir[MAX_PATH]{};
-    GetSystemDirectoryA(sysdir, MAX_PATH);
-    std::string path = std::string(sysdir) + "\\dinput8.dll";
+static HRESULT STDMETHODCALLTYPE Hook_CreateVertexBuffer(IDirect3DDevice9* self,
+    UINT len, DWORD usage, DWORD fvf, D3DPOOL pool, IDirect3DVertexBuffer9** out, HANDLE* shared)
+{
+    if (pool != D3DPOOL_MANAGED || !Real_VBLock || !out || !IsFlipExDevice(self)) {
+        return Real_CreateVertexBuffer(self, len, usage, fvf, pool, out, shared);
+    }
 
-    g_realDInput8 = LoadLibraryA(path.c_str());
-    if (!g_realDInput8) return;
+    HRESULT hr = Real_CreateVertexBuffer(self, len, usage | kShadowBufferUsage, fvf, D3DPOOL_DEFAULT, out, shared);
+    if (FAILED(hr)) return hr;
 
-    Real_DirectInput8Create = reinterpret_cast<DirectInput8Create_t>(
-        GetProcAddress(g_realDInput8, "DirectInput8Create")
-        );
+    IDirect3DVertexBuffer9* twin = nullptr;
+    hr = Real_CreateVertexBuffer(self, len, usage, fvf, D3DPOOL_SYSTEMMEM, &twin, nullptr);
+    if (FAILED(hr)) {
+        (*out)->Release();
+        *out = nullptr;
+        return hr;
+    }
+
+    RegisterShadow(*out, self, twin, kShadowVertexBuffer, len);
+    return hr;
 }
 
-static void InstallDirectInputMouseHook() {
-    EnsureRealDInput8Loaded();
-    if (!Real_DirectInput8Create) return;
-    if (InterlockedCompareExchange(&g_dinputHooksInstalled, 0, 0) != 0) return;
+static HRESULT STDMETHODCALLTYPE Hook_CreateIndexBuffer(IDirect3DDevice9* self,
+    UINT len, DWORD usage, D3DFORMAT fmt, D3DPOOL pool, IDirect3DIndexBuffer9** out, HANDLE* shared)
+{
+    if (pool != D3DPOOL_MANAGED || !Real_IBLock || !out || !IsFlipExDevice(self)) {
+        return Real_CreateIndexBuffer(self, len, usage, fmt, pool, out, shared);
+    }
 
-    IDirectInput8A* di = nullptr;
-    HRESULT hr = Real_DirectInput8Create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION,
-        IID_IDirectInput8A, (void**)&di, nullptr);
-    if (FAILED(hr) || !di) return;
+    HRESULT hr = Real_CreateIndexBuffer(self, len, usage | kShadowBufferUsage, fmt, D3DPOOL_DEFAULT, out, shared);
+    if (FAILED(hr)) return hr;
 
-    IDirectInputDevice8A* dev = nullptr;
-    hr = di->CreateDevice(GUID_SysMouse, &dev, nullptr);
-    if (FAILED(hr) || !dev) {
-        di->Release();
-        return;
+    IDirect3DIndexBuffer9* twin = nullptr;
+    hr = Real_CreateIndexBuffer(self, len, usage, fmt, D3DPOOL_SYSTEMMEM, &twin, nullptr);
+    if (FAILED(hr)) {
+        (*out)->Release();
+        *out = nullptr;
+        return hr;
     }
 
-    void** vtbl = *(void***)dev;
-    void* setCoopPtr = vtbl[13]; // stable for IDirectInputDevice8
-    if (setCoopPtr) {
-        if (MH_CreateHook(setCoopPtr, &Hook_SetCooperativeLevel,
-            reinterpret_cast<void**>(&Real_SetCooperativeLevel)) == MH_OK)
-        {
-            MH_EnableHook(setCoopPtr);
+    RegisterShadow(*out, self, twin, kShadowIndexBuffer, len);
+    return hr;
+}
+
+// The texture, surface and volume methods are reached through throwaway
+// SYSTEMMEM objects; every object of a type shares its vtable.
+static void InstallShadowHooks(IDirect3DDevice9* dev, HookSet& hooks) {
+    // IDirect3DTexture9 / IDirect3DCubeTexture9 / IDirect3DVolumeTexture9:
+    //   Release = 2, GetLevelDesc = 17, GetSurfaceLevel / GetCubeMapSurface /
+    //   GetVolumeLevel = 18, LockRect / LockBox = 19, UnlockRect / UnlockBox = 20,
+    //   AddDirtyRect / AddDirtyBox = 21
+    // IDirect3DSurface9: UnlockRect = 14, ReleaseDC = 16
+    // IDirect3DVolume9:  UnlockBox = 10
+    // IDirect3DVertexBuffer9 / IDirect3DIndexBuffer9:
+    //   Release = 2, Lock = 11, Unlock = 12, GetDesc = 13
+    IDirect3DTexture9* tex = nullptr;
+    if (!Real_TexLockRect && SUCCEEDED(dev->CreateTexture(1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM, &tex, nullptr))) {
+        void** vtbl = *(void***)tex;
+        hooks.Add(vtbl[2], &Hook_TexRelease, reinterpret_cast<void**>(&Real_TexRelease));
+        hooks.Add(vtbl[17], &Hook_TexGetLevelDesc, reinterpret_cast<void**>(&Real_TexGetLevelDesc));
+        hooks.Add(vtbl[18], &Hook_TexGetSurfaceLevel, reinterpret_cast<void**>(&Real_TexGetSurfaceLevel));
+        hooks.Add(vtbl[19], &Hook_TexLockRect, reinterpret_cast<void**>(&Real_TexLockRect));
+        hooks.Add(vtbl[20], &Hook_TexUnlockRect, reinterpret_cast<void**>(&Real_TexUnlockRect));
+        hooks.Add(vtbl[21], &Hook_TexAddDirtyRect, reinterpret_cast<void**>(&Real_TexAddDirtyRect));
+
+        IDirect3DSurface9* surf = nullptr;
+        if (!Real_SurfUnlockRect && SUCCEEDED(tex->GetSurfaceLevel(0, &surf)) && surf) {
+            void** svtbl = *(void***)surf;
+            hooks.Add(svtbl[14], &Hook_SurfUnlockRect, reinterpret_cast<void**>(&Real_SurfUnlockRect));
+            hooks.Add(svtbl[16], &Hook_SurfReleaseDC, reinterpret_cast<void**>(&Real_SurfReleaseDC));
+            surf->Release();
         }
+        tex->Release();
     }
 
-    void* getStatePtr = vtbl[9]; // GetDeviceState
-    if (getStatePtr) {
-        if (MH_CreateHook(getStatePtr, &Hook_GetDeviceState,
-            reinterpret_cast<void**>(&Real_GetDeviceState)) == MH_OK)
-        {
-            MH_EnableHook(getStatePtr);
+    // Types that share an implementation with one hooked above (Release, most
+    // likely) fail Add with MH_ERROR_ALREADY_CREATED; the first detour already
+    // looks the object up whatever its type.
+    IDirect3DCubeTexture9* cube = nullptr;
+    if (!Real_CubeLockRect && SUCCEEDED(dev->CreateCubeTexture(1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM, &cube, nullptr))) {
+        void** vtbl = *(void***)cube;
+        hooks.Add(vtbl[2], &Hook_CubeRelease, reinterpret_cast<void**>(&Real_CubeRelease));
+        hooks.Add(vtbl[17], &Hook_CubeGetLevelDesc, reinterpret_cast<void**>(&Real_CubeGetLevelDesc));
+        hooks.Add(vtbl[18], &Hook_CubeGetSurface, reinterpret_cast<void**>(&Real_CubeGetSurface));
+        hooks.Add(vtbl[19], &Hook_CubeLockRect, reinterpret_cast<void**>(&Real_CubeLockRect));
+        hooks.Add(vtbl[20], &Hook_CubeUnlockRect, reinterpret_cast<void**>(&Real_CubeUnlockRect));
+        hooks.Add(vtbl[21], &Hook_CubeAddDirtyRect, reinterpret_cast<void**>(&Real_CubeAddDirtyRect));
+        cube->Release();
+    }
+
+    IDirect3DVolumeTexture9* vol = nullptr;
+    if (!Real_VolLockBox && SUCCEEDED(dev->CreateVolumeTexture(1, 1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM, &vol, nullptr))) {
+        void** vtbl = *(void***)vol;
+        hooks.Add(vtbl[2], &Hook_VolRelease, reinterpret_cast<void**>(&Real_VolRelease));
+        hooks.Add(vtbl[17], &Hook_VolGetLevelDesc, reinterpret_cast<void**>(&Real_VolGetLevelDesc));
+        hooks.Add(vtbl[18], &Hook_VolGetVolumeLevel, reinterpret_cast<void**>(&Real_VolGetVolumeLevel));
+        hooks.Add(vtbl[19], &Hook_VolLockBox, reinterpret_cast<void**>(&Real_VolLockBox));
+        hooks.Add(vtbl[20], &Hook_VolUnlockBox, reinterpret_cast<void**>(&Real_VolUnlockBox));
+        hooks.Add(vtbl[21], &Hook_VolAddDirtyBox, reinterpret_cast<void**>(&Real_VolAddDirtyBox));
+
+        IDirect3DVolume9* level = nullptr;
+        if (!Real_VolumeUnlockBox && SUCCEEDED(vol->GetVolumeLevel(0, &level)) && level) {
+            void** lvtbl = *(void***)level;
+            hooks.Add(lvtbl[10], &Hook_VolumeUnlockBox, reinterpret_cast<void**>(&Real_VolumeUnlockBox));
+            level->Release();
         }
+        vol->Release();
     }
 
-    void* pollPtr = vtbl[25];
-    if (pollPtr) {
-        if (MH_CreateHook(pollPtr, &Hook_Poll,
-            reinterpret_cast<void**>(&Real_Poll)) == MH_OK)
-        {
-            MH_EnableHook(pollPtr);
+    void* vbLock = nullptr;
+    void* vbUnlock = nullptr;
+    IDirect3DVertexBuffer9* vb = nullptr;
+    if (!Real_VBLock && SUCCEEDED(dev->CreateVertexBuffer(16, 0, 0, D3DPOOL_SYSTEMMEM, &vb, nullptr))) {
+        void** vtbl = *(void***)vb;
+        vbLock = vtbl[11];
+        vbUnlock = vtbl[12];
+        hooks.Add(vtbl[2], &Hook_VBRelease, reinterpret_cast<void**>(&Real_VBRelease));
+        hooks.Add(vtbl[11], &Hook_VBLock, reinterpret_cast<void**>(&Real_VBLock));
+        hooks.Add(vtbl[12], &Hook_VBUnlock, reinterpret_cast<void**>(&Real_VBUnlock));
+        hooks.Add(vtbl[13], &Hook_VBGetDesc, reinterpret_cast<void**>(&Real_VBGetDesc));
+        vb->Release();
+    }
+
+    // Index buffers whose Lock and Unlock are the vertex buffer's code go
+    // through the vertex buffer detours, so the originals are the same.
+    IDirect3DIndexBuffer9* ib = nullptr;
+    if (!Real_IBLock && SUCCEEDED(dev->CreateIndexBuffer(16, 0, D3DFMT_INDEX16, D3DPOOL_SYSTEMMEM, &ib, nullptr))) {
+        void** vtbl = *(void***)ib;
+        hooks.Add(vtbl[2], &Hook_IBRelease, reinterpret_cast<void**>(&Real_IBRelease));
+        if (vtbl[11] == vbLock && vtbl[12] == vbUnlock && Real_VBLock && Real_VBUnlock) {
+            Real_IBLock = Real_VBLock;
+            Real_IBUnlock = Real_VBUnlock;
+        }
+        else {
+            hooks.Add(vtbl[11], &Hook_IBLock, reinterpret_cast<void**>(&Real_IBLock));
+            hooks.Add(vtbl[12], &Hook_IBUnlock, reinterpret_cast<void**>(&Real_IBUnlock));
         }
+        hooks.Add(vtbl[13], &Hook_IBGetDesc, reinterpret_cast<void**>(&Real_IBGetDesc));
+        ib->Release();
     }
+}
 
-    InterlockedExchange(&g_dinputHooksInstalled, 1);
+static void InstallFlipExResourceHooks(IDirect3DDevice9* dev, HookSet& hooks) {
+    void** vtbl = *(void***)dev;
 
-    dev->Release();
-    di->Release();
+    // IDirect3DDevice9 vtable:
+    //   CreateTexture       = 23
+    //   CreateVolumeTexture = 24
+    //   CreateCubeTexture   = 25
+    //   CreateVertexBuffer  = 26
+    //   CreateIndexBuffer   = 27
+    if (!Real_CreateTexture) {
+        hooks.Add(vtbl[23], &Hook_CreateTexture, reinterpret_cast<void**>(&Real_CreateTexture));
+    }
+    if (!Real_CreateVolumeTexture) {
+        hooks.Add(vtbl[24], &Hook_CreateVolumeTexture, reinterpret_cast<void**>(&Real_CreateVolumeTexture));
+    }
+    if (!Real_CreateCubeTexture) {
+        hooks.Add(vtbl[25], &Hook_CreateCubeTexture, reinterpret_cast<void**>(&Real_CreateCubeTexture));
+    }
+    if (!Real_CreateVertexBuffer) {
+        hooks.Add(vtbl[26], &Hook_CreateVertexBuffer, reinterpret_cast<void**>(&Real_CreateVertexBuffer));
+    }
+    if (!Real_CreateIndexBuffer) {
+        hooks.Add(vtbl[27], &Hook_CreateIndexBuffer, reinterpret_cast<void**>(&Real_CreateIndexBuffer));
+    }
+
+    InstallShadowHooks(dev, hooks);
 }
 
-// =============================================================================
-// D3D9 proxy + hooks
-// =============================================================================
-using PFN_Direct3DCreate9 = IDirect3D9 * (WINAPI*)(UINT);
-using PFN_Direct3DCreate9Ex = HRESULT(WINAPI*)(UINT, IDirect3D9Ex**);
-using Reset_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, D3DPRESENT_PARAMETERS* pPP);
-using Present_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, const RECT*, const RECT*, HWND, const RGNDATA*);
-using SetViewport_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DDevice9* self, const D3DVIEWPORT9*);
-using SwapChainPresent_t = HRESULT(STDMETHODCALLTYPE*)(IDirect3DSwapChain9* self,
-    const RECT*, const RECT*, HWND, const RGNDATA*, DWORD);
-using CreateDevice_t = HRESULT(STDMETHODCALLTYPE*)(
-    IDirect3D9* self, UINT Adapter, D3DDEVTYPE DeviceType, HWND hFocusWindow,
-    DWORD BehaviorFlags, D3DPRESENT_PARAMETERS* pPP, IDirect3DDevice9** ppDev);
+// CreateDeviceEx may share code with CreateDevice inside d3d9.dll.
+static thread_local bool t_inFlipExCreate = false;
+
+// Our own IDirect3D9Ex, created on first use and kept for the process. The
+// game's IDirect3D9 stays what it asked for, so QueryInterface and vtable
+// checks on it see a plain object; only its devices come from this one.
+static IDirect3D9Ex* g_flipExD3D = nullptr;
+static UINT g_d3dSdkVersion = D3D_SDK_VERSION;
+
+static IDirect3D9Ex* GetFlipExD3D() {
+    if (g_flipExD3D || !Real_Direct3DCreate9Ex) return g_flipExD3D;
+
+    IDirect3D9Ex* ex = nullptr;
+    if (FAILED(Real_Direct3DCreate9Ex(g_d3dSdkVersion, &ex)) || !ex) return nullptr;
+    if (InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&g_flipExD3D), ex, nullptr) != nullptr) {
+        ex->Release();
+    }
+    return g_flipExD3D;
+}
+
+// Creates the game's device as FLIPEX on our IDirect3D9Ex. On failure the
+// caller falls back to the regular CreateDevice. Adapter ordinals are the same
+// on every IDirect3D9 in the process.
+static HRESULT CreateFlipExDevice(
+    UINT Adapter, D3DDEVTYPE DeviceType, HWND hFocusWindow,
+    DWORD BehaviorFlags, D3DPRESENT_PARAMETERS& pp, IDirect3DDevice9** ppDev)
+{
+    IDirect3D9Ex* ex = GetFlipExD3D();
+    if (!ex) return D3DERR_NOTAVAILABLE;
+
+    D3DPRESENT_PARAMETERS flip = pp;
+    ApplyFlipExPP(flip);
+
+    IDirect3DDevice9Ex* dev = nullptr;
+    t_inFlipExCreate = true;
+    HRESULT hr = ex->CreateDeviceEx(Adapter, DeviceType, hFocusWindow, BehaviorFlags, &flip, nullptr, &dev);
+    t_inFlipExCreate = false;
+
+    DebugLog("flipex: CreateDeviceEx hr=0x%08lX (%ux%u, %u buffers)\n",
+        (unsigned long)hr, flip.BackBufferWidth, flip.BackBufferHeight, flip.BackBufferCount);
+    if (FAILED(hr)) return hr;
+
+    // Report back filled-in sizes/formats, but keep the swap effect the game asked for.
+    const D3DSWAPEFFECT requested = pp.SwapEffect;
+    pp = flip;
+    pp.SwapEffect = requested;
 
-static HMODULE g_realD3D9 = nullptr;
-static PFN_Direct3DCreate9   Real_Direct3DCreate9 = nullptr;
-static PFN_Direct3DCreate9Ex Real_Direct3DCreate9Ex = nullptr;
-static CreateDevice_t      Real_CreateDevice = nullptr;
-static Reset_t             Real_Reset = nullptr;
-static Present_t           Real_Present = nullptr;
-static SetViewport_t       Real_SetViewport = nullptr;
-static SwapChainPresent_t  Real_SwapChainPresent = nullptr;
+    *ppDev = dev;
+    return hr;
+}
 
-static void EnsureRealD3D9Loaded() {
-    if (g_realD3D9) return;
+// =============================================================================
+// GPU scaling
+// =============================================================================
 
-    char sysdir[MAX_PATH]{};
-    GetSystemDirectoryA(sysdir, MAX_PATH);
-    std::string path = std::string(sysdir) + "\\d3d9.dll";
+// How the game's backbuffer maps onto the client-sized proxy backbuffer.
+struct ScalePlan {
+    RECT src{};                                 // region of the game's backbuffer
+    RECT dst{};                                 // region of the proxy backbuffer
+    D3DTEXTUREFILTERTYPE filter = D3DTEXF_POINT;
+    bool fillBars = false;                      // dst leaves part of the output uncovered
+};
 
-    g_realD3D9 = LoadLibraryA(path.c_str());
-    if (!g_realD3D9) return;
+// Pure rect/filter planning; no D3D calls. Returns false if there is nothing to scale.
+// Mode=integer implies an integer fit; FitRect falls back to an aspect fit when
+// the output is smaller than the source.
+static bool PlanScale(ScaleMode mode, FitMode fit, const RECT& src, LONG outW, LONG outH, ScalePlan& plan) {
+    const LONG sw = src.right - src.left;
+    const LONG sh = src.bottom - src.top;
+    if (mode == kScaleOff || sw <= 0 || sh <= 0 || outW <= 0 || outH <= 0) return false;
+
+    plan.src = src;
+    plan.dst = FitRect(mode == kScaleInteger ? kFitInteger : fit, sw, sh, outW, outH);
+    plan.filter = (mode == kScaleBilinear) ? D3DTEXF_LINEAR : D3DTEXF_POINT;
+    plan.fillBars = (plan.dst.right - plan.dst.left != outW || plan.dst.bottom - plan.dst.top != outH);
+    return true;
+}
 
-    Real_Direct3DCreate9 = reinterpret_cast<PFN_Direct3DCreate9>(GetProcAddress(g_realD3D9, "Direct3DCreate9"));
-    Real_Direct3DCreate9Ex = reinterpret_cast<PFN_Direct3DCreate9Ex>(GetProcAddress(g_realD3D9, "Direct3DCreate9Ex"));
+static IDirect3DSwapChain9* ImplicitSwapChain(IDirect3DDevice9* dev, DeviceState& ds) {
+    const LONG epoch = g_presentEpoch;
+    if (ds.implicitChain && ds.implicitEpoch == epoch) return ds.implicitChain;
+
+    IDirect3DSwapChain9* sc0 = nullptr;
+    if (FAILED(dev->GetSwapChain(0, &sc0)) || !sc0) return nullptr;
+    sc0->Release();  // the device keeps it alive
+
+    ds.implicitChain = sc0;
+    ds.implicitEpoch = epoch;
+    return sc0;
 }
 
-// Cached backbuffer size for fast viewport clamping.
-static volatile LONG g_bbW = 0;
-static volatile LONG g_bbH = 0;
-static void UpdateBackbufferSize(IDirect3DDevice9* dev) {
-    if (!dev) return;
-    IDirect3DSurface9* bb = nullptr;
-    if (SUCCEEDED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
-        D3DSURFACE_DESC d{};
-        if (SUCCEEDED(bb->GetDesc(&d))) {
-            InterlockedExchange(&g_bbW, (LONG)d.Width);
-            InterlockedExchange(&g_bbH, (LONG)d.Height);
-            // Keep Win32 virtualization in sync with the actual backbuffer.
-            InterlockedExchange(&g_virtualW, (LONG)d.Width);
-            InterlockedExchange(&g_virtualH, (LONG)d.Height);
-        }
-        bb->Release();
+static const DWORD kScaleRetryMinMs = 500;
+static const UINT kScaleRetryMaxShift = 4;  // backoff tops out at 8 s
+
+// Additional swapchain on the game window with a client-sized backbuffer, so
+// the final Present is a 1:1 copy. A failed create is retried with a doubling
+// backoff, at once when the client size changes, and after the next Reset
+// (ReleaseDeviceResources clears the backoff). The chain holds a reference to
+// the device; Hook_DevRelease frees it when the game releases the device.
+static IDirect3DSwapChain9* EnsureScaleChain(IDirect3DDevice9* dev, DeviceState& ds, UINT w, UINT h) {
+    const bool sameSize = ds.scaleW == w && ds.scaleH == h;
+    if (sameSize && ds.scaleChain) return ds.scaleChain;
+    if (sameSize && ds.scaleFailures && GetTickCount64() < ds.scaleRetryMs) return nullptr;
+
+    const UINT failures = sameSize ? ds.scaleFailures : 0;
+    ReleaseScaleChain(ds);
+    ds.scaleW = w;
+    ds.scaleH = h;
+
+    D3DPRESENT_PARAMETERS pp{};
+    IDirect3DSwapChain9* sc0 = ImplicitSwapChain(dev, ds);
+    HRESULT hr = sc0 ? sc0->GetPresentParameters(&pp) : E_FAIL;
+    if (FAILED(hr)) {
+        ds.scaleFailures = failures + 1;
+        ds.scaleRetryMs = GetTickCount64() + (kScaleRetryMinMs << (std::min)(failures, kScaleRetryMaxShift));
+        return nullptr;
     }
-}
 
-static void ForceWindowedPP(D3DPRESENT_PARAMETERS& pp, HWND hwnd) {
+    pp.BackBufferWidth = w;
+    pp.BackBufferHeight = h;
+    pp.BackBufferCount = 1;
+    pp.MultiSampleType = D3DMULTISAMPLE_NONE;
+    pp.MultiSampleQuality = 0;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.hDeviceWindow = ds.hwnd;
     pp.Windowed = TRUE;
+    pp.EnableAutoDepthStencil = FALSE;
+    pp.Flags = 0;
     pp.FullScreen_RefreshRateInHz = 0;
-    if (hwnd) pp.hDeviceWindow = hwnd;
-    if (pp.BackBufferCount == 0) pp.BackBufferCount = 1;
+
+    hr = dev->CreateAdditionalSwapChain(&pp, &ds.scaleChain);
+    if (FAILED(hr)) {
+        ds.scaleChain = nullptr;
+        ds.scaleFailures = failures + 1;
+        ds.scaleRetryMs = GetTickCount64() + (kScaleRetryMinMs << (std::min)(failures, kScaleRetryMaxShift));
+    }
+
+    DebugLog("scaling: proxy swapchain %ux%u hr=0x%08lX (attempt %u)\n", w, h, (unsigned long)hr, failures + 1);
+    return ds.scaleChain;
 }
 
-static HWND GetDeviceHwnd(IDirect3DDevice9* dev) {
-    if (!dev) return nullptr;
+// StretchRects the game's backbuffer into the proxy swapchain and presents
+// that instead. Returns false (nothing presented) when the caller should use
+// the regular rect-based Present.
+static bool PresentScaled(IDirect3DDevice9* dev, DeviceState& ds, const RECT* srcIn, FrameSample& fs, HRESULT& hr) {
+    if (Cfg().scaleMode == kScaleOff || IsFlipExDevice(dev)) return false;
 
-    D3DDEVICE_CREATION_PARAMETERS cp{};
-    if (SUCCEEDED(dev->GetCreationParameters(&cp)) && cp.hFocusWindow) {
-        return cp.hFocusWindow;
-    }
+    const LONG outW = ds.dst.right - ds.dst.left;
+    const LONG outH = ds.dst.bottom - ds.dst.top;
 
-    IDirect3DSwapChain9* sc = nullptr;
-    if (SUCCEEDED(dev->GetSwapChain(0, &sc)) && sc) {
-        D3DPRESENT_PARAMETERS pp{};
-        if (SUCCEEDED(sc->GetPresentParameters(&pp)) && pp.hDeviceWindow) {
-            sc->Release();
-            return pp.hDeviceWindow;
-        }
-        sc->Release();
-    }
+    const RECT* crop = srcIn ? srcIn : CachedSrcRect(dev, ds);
+    const RECT src = crop ? *crop : RECT{ 0, 0, (LONG)ds.bbW, (LONG)ds.bbH };
 
-    return nullptr;
-}
+    // Already 1:1; a plain Present is the cheapest copy.
+    if (src.right - src.left == outW && src.bottom - src.top == outH) return false;
 
-static void RefreshHwndFromDevice(IDirect3DDevice9* dev) {
-    HWND hwnd = GetDeviceHwnd(dev);
-    if (hwnd && hwnd != g_hwnd) {
-        g_hwnd = hwnd;
-        InstallWndProc(g_hwnd);
+    ScalePlan plan;
+    if (!PlanScale(Cfg().scaleMode, EffectiveFit(), src, outW, outH, plan)) return false;
+
+    IDirect3DSwapChain9* chain = EnsureScaleChain(dev, ds, (UINT)outW, (UINT)outH);
+    if (!chain) return false;
+
+    IDirect3DSurface9* bb = nullptr;
+    IDirect3DSurface9* out = nullptr;
+    bool ok = SUCCEEDED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb
+        && SUCCEEDED(chain->GetBackBuffer(0, D3DBACKBUFFER_TYPE_MONO, &out)) && out;
+
+    if (ok) {
+        if (plan.fillBars) dev->ColorFill(out, nullptr, D3DCOLOR_XRGB(0, 0, 0));
+        ok = SUCCEEDED(dev->StretchRect(bb, &plan.src, out, &plan.dst, plan.filter));
     }
+    if (out) out->Release();
+    if (bb) bb->Release();
+    if (!ok) return false;
+
+    // Straight to the real entry point; the proxy chain is ours, not the game's.
+    fs.realStart = QpcNow();
+    hr = Real_SwapChainPresent ? Real_SwapChainPresent(chain, nullptr, nullptr, nullptr, nullptr, 0)
+        : chain->Present(nullptr, nullptr, nullptr, nullptr, 0);
+    fs.realEnd = QpcNow();
+    fs.path = kPathScaled;
+    return true;
 }
 
 // =============================================================================
-// Present stretching (shared helper)
+// Frame latency
 // =============================================================================
 
-static bool BuildClientDstRect(HWND wnd, RECT& outDst) {
-    if (!wnd || !IsWindow(wnd)) return false;
-    RECT cr{};
-    if (!GetClientRectRaw(wnd, &cr)) return false;
-    LONG w = cr.right - cr.left;
-    LONG h = cr.bottom - cr.top;
-    if (w <= 0 || h <= 0) return false;
-    outDst = RECT{ 0,0,w,h };
-    return true;
+static constexpr DWORD kFrameQueryTimeoutMs = 100;
+
+// Spins (yielding) until the GPU has passed the query. Bounded so a lost or
+// hung device can't stall the game forever.
+static void WaitFrameQuery(IDirect3DQuery9* q) {
+    const ULONGLONG giveUp = GetTickCount64() + kFrameQueryTimeoutMs;
+    for (;;) {
+        HRESULT hr = q->GetData(nullptr, 0, D3DGETDATA_FLUSH);
+        if (hr != S_FALSE) return;  // done, or device lost
+        if (GetTickCount64() >= giveUp) return;
+        SwitchToThread();
+    }
 }
 
-static const RECT* ChooseSrcRectFromViewport(IDirect3DDevice9* dev, const RECT* srcIn, RECT& srcOut) {
-    if (srcIn) return srcIn;
-    if (!dev) return nullptr;
+// Called after every real Present. Caps how far the CPU may run ahead of the
+// GPU to MaxFrameLatency frames.
+static void ThrottleFrameLatency(IDirect3DDevice9* dev) {
+    const int n = Cfg().maxFrameLatency;
+    if (!dev) return;
 
-    // Backbuffer size (for clamping)
-    UINT bbw = 0, bbh = 0;
-    IDirect3DSurface9* bb = nullptr;
-    if (SUCCEEDED(dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
-        D3DSURFACE_DESC d{};
-        if (SUCCEEDED(bb->GetDesc(&d))) { bbw = d.Width; bbh = d.Height; }
-        bb->Release();
+    DeviceState* ds = FindDeviceState(dev);
+    if (n <= 0 && (!ds || ds->latencyN == 0)) return;
+    if (!ds) ds = GetDeviceState(dev);
+
+    // First throttled frame, or a config reload changed the limit.
+    if (ds->latencyN != n) {
+        ReleaseLatencyQueries(*ds);
+        ds->latencyN = n;
+        ds->latencyEx = false;
+
+        // 0 hands the limit back to the driver default.
+        IDirect3DDevice9Ex* ex = nullptr;
+        if (SUCCEEDED(dev->QueryInterface(IID_IDirect3DDevice9Ex, (void**)&ex)) && ex) {
+            ds->latencyEx = SUCCEEDED(ex->SetMaximumFrameLatency((UINT)n));
+            ex->Release();
+        }
+        DebugLog("latency: max %d frames via %s\n", n, ds->latencyEx ? "SetMaximumFrameLatency" : "event queries");
     }
+    if (n <= 0 || ds->latencyEx) return;
 
-    D3DVIEWPORT9 vp{};
-    if (FAILED(dev->GetViewport(&vp))) return nullptr;
-    if (vp.Width == 0 || vp.Height == 0) return nullptr;
-
-    // If viewport already covers the whole backbuffer, let D3D treat src as "entire surface".
-    if (bbw && bbh && vp.X == 0 && vp.Y == 0 && vp.Width == bbw && vp.Height == bbh)
-        return nullptr;
-
-    LONG sx = (LONG)vp.X;
-    LONG sy = (LONG)vp.Y;
-    LONG sw = (LONG)vp.Width;
-    LONG sh = (LONG)vp.Height;
-
-    if (bbw && bbh) {
-        if (sx < 0) sx = 0;
-        if (sy < 0) sy = 0;
-        if (sx > (LONG)bbw) sx = (LONG)bbw;
-        if (sy > (LONG)bbh) sy = (LONG)bbh;
+    // Slot i holds the query issued n frames ago; wait for it, then reuse it for this frame.
+    const UINT slot = ds->frameQueryNext;
+    ds->frameQueryNext = (slot + 1) % (UINT)n;
 
-        LONG maxW = (LONG)bbw - sx;
-        LONG maxH = (LONG)bbh - sy;
-        if (sw > maxW) sw = maxW;
-        if (sh > maxH) sh = maxH;
+    IDirect3DQuery9*& q = ds->frameQueries[slot];
+    if (!q && FAILED(dev->CreateQuery(D3DQUERYTYPE_EVENT, &q))) {
+        q = nullptr;
+        return;
     }
 
-    if (sw <= 0 || sh <= 0) return nullptr;
-
-    srcOut = RECT{ sx, sy, sx + sw, sy + sh };
-    return &srcOut;
+    if (ds->frameQueryIssued[slot]) WaitFrameQuery(q);
+    ds->frameQueryIssued[slot] = SUCCEEDED(q->Issue(D3DISSUE_END));
 }
 
+// =============================================================================
+// Device Present hook
+// =============================================================================
+
 static HRESULT PresentStretch_Device(
     IDirect3DDevice9* dev,
+    DeviceState* ds,
     const RECT* srcIn,
     const RECT* dstIn,
     HWND hOverride,
-    const RGNDATA* dirty)
+    const RGNDATA* dirty,
+    FrameSample& fs)
 {
     if (!Real_Present) return D3D_OK;
 
+    auto present = [&](const RECT* s, const RECT* d, HWND h) {
+        fs.realStart = QpcNow();
+        HRESULT hr = Real_Present(dev, s, d, h, dirty);
+        fs.realEnd = QpcNow();
+        return hr;
+    };
+
+    // Flip model takes no rects; DWM scales the backbuffer to the client area.
+    if (IsFlipExDevice(dev)) {
+        fs.path = kPathDeviceFast;
+        return present(nullptr, nullptr, nullptr);
+    }
+
+    // Fast path: cached state is current and the game presents to the window we know.
+    if (ds && (!hOverride || hOverride == ds->hwnd)) {
+        HRESULT hr = D3D_OK;
+        if (PresentScaled(dev, *ds, srcIn, fs, hr)) return hr;
+
+        fs.path = kPathDeviceFast;
+        const RECT* srcUse = srcIn ? srcIn : CachedSrcRect(dev, *ds);
+        const RECT* dstUse = DstCoversClient(dstIn, ds->image) ? dstIn : &ds->image;
+        return present(srcUse, dstUse, ds->hwnd);
+    }
+
     HWND target = (hOverride && IsWindow(hOverride)) ? hOverride
         : (g_hwnd && IsWindow(g_hwnd)) ? g_hwnd
         : GetDeviceHwnd(dev);
 
     RECT dstFull{};
     if (!BuildClientDstRect(target, dstFull)) {
-        return Real_Present(dev, srcIn, dstIn, hOverride, dirty);
-    }
-
-    bool overrideDst = true;
-    if (dstIn) {
-        LONG dw = dstIn->right - dstIn->left;
-        LONG dh = dstIn->bottom - dstIn->top;
-        if (dstIn->left == 0 && dstIn->top == 0 &&
-            dw == (dstFull.right - dstFull.left) &&
-            dh == (dstFull.bottom - dstFull.top))
-        {
-            overrideDst = false;
-        }
+        return present(srcIn, dstIn, hOverride);
     }
 
     RECT srcVP{};
     const RECT* srcUse = ChooseSrcRectFromViewport(dev, srcIn, srcVP);
-    const RECT* dstUse = overrideDst ? &dstFull : dstIn;
+    const RECT dstImage = FitRect(EffectiveFit(), g_bbW, g_bbH, dstFull.right, dstFull.bottom);
+    const RECT* dstUse = DstCoversClient(dstIn, dstImage) ? dstIn : &dstImage;
 
     HWND callOverride = hOverride ? hOverride : target;
-    return Real_Present(dev, srcUse, dstUse, callOverride, dirty);
+    return present(srcUse, dstUse, callOverride);
 }
 
 static HRESULT STDMETHODCALLTYPE Hook_Present(
     IDirect3DDevice9* self,
     const RECT* src, const RECT* dst, HWND hOverride, const RGNDATA* dirty)
 {
+    PaceFrame();
+    TracePresent(kTracePresent, hOverride, src, dst, dirty);
+
+    FrameSample fs{ QpcNow() };
     InterlockedExchange(&g_seenPresent, 1);
-    g_presentTotal++;
+    InterlockedIncrement64(&g_presentTotal);
     MaybeInstallGfwHook();
 
-    RefreshHwndFromDevice(self);
-
-    if (!g_hwnd || !IsWindow(g_hwnd)) {
-        g_hwnd = FindMainWindowForThisProcess();
-        if (g_hwnd) InstallWndProc(g_hwnd);
+    DeviceState* ds = GetDeviceState(self);
+    if (!IsDeviceStateCurrent(*ds) && !RefreshDeviceState(self, *ds)) {
+        ds = nullptr;
     }
 
-    ApplyMousePolicyNow();
+    UpdateMousePolicy();
+    PostPendingMove();
 
-    return PresentStretch_Device(self, src, dst, hOverride, dirty);
+    HRESULT hr = PresentStretch_Device(self, ds, src, dst, hOverride, dirty, fs);
+    ThrottleFrameLatency(self);
+    RecordFrame(fs);
+    return hr;
 }
 
 // =============================================================================
 // Viewport clamping
 // =============================================================================
-static void MaybeEnableWin32VirtualFromViewport(const D3DVIEWPORT9& vp, LONG bbw, LONG bbh) {
+static void MaybeEnableWin32VirtualFromViewport(const D3DVIEWPORT9& vp, LONG bbw, LONG bbh, const DeviceState& ds) {
     if (InterlockedCompareExchange(&g_win32VirtEnabled, 0, 0) != 0) return;
 
     // Don't enable until we've actually presented at least once; avoids launcher/config helpers.
     if (InterlockedCompareExchange(&g_seenPresent, 0, 0) == 0) return;
 
-    if (!g_hwnd || !IsWindow(g_hwnd)) return;
-
+    // Prefer the client size cached by the Present path over asking user32 on every call.
     LONG aw = 0, ah = 0;
-    if (!GetActualClientSize(g_hwnd, aw, ah)) return;
+    if (IsDeviceStateCurrent(ds)) {
+        aw = ds.dst.right - ds.dst.left;
+        ah = ds.dst.bottom - ds.dst.top;
+    }
+    else {
+        if (!g_hwnd || !IsWindow(g_hwnd)) return;
+        if (!GetActualClientSize(g_hwnd, aw, ah)) return;
+    }
 
     auto absL = [](LONG v) -> LONG { return (v < 0) ? -v : v; };
 
@@ -957,40 +3855,34 @@ static void MaybeEnableWin32VirtualFromViewport(const D3DVIEWPORT9& vp, LONG bbw
         if (absL(aw - bbw) > 32 || absL(ah - bbh) > 32) {
             InterlockedExchange(&g_win32VirtEnabled, 1);
             MaybeInstallUser32VirtualHooks();
+            RecordProfileDecision(kProfileWin32Virt);
         }
     }
 }
 
+static HRESULT ForwardSetViewport(IDirect3DDevice9* self, const D3DVIEWPORT9* vp) {
+    HRESULT hr = Real_SetViewport(self, vp);
+    if (SUCCEEDED(hr)) ShadowSetViewport(self, *vp);
+    return hr;
+}
+
 static HRESULT STDMETHODCALLTYPE Hook_SetViewport(IDirect3DDevice9* self, const D3DVIEWPORT9* vpIn) {
+    if (vpIn) Trace(kTraceSetViewport, vpIn->X, vpIn->Y, vpIn->Width, vpIn->Height);
     if (!Real_SetViewport || !vpIn || !self) return D3D_OK;
 
-    IDirect3DSurface9* rt = nullptr;
-    if (FAILED(self->GetRenderTarget(0, &rt)) || !rt) {
-        return Real_SetViewport(self, vpIn);
-    }
-
-    D3DSURFACE_DESC rtDesc{};
-    if (FAILED(rt->GetDesc(&rtDesc)) || rtDesc.Width == 0 || rtDesc.Height == 0) {
-        rt->Release();
-        return Real_SetViewport(self, vpIn);
-    }
-
-    bool isBackbuffer = false;
-    IDirect3DSurface9* bb = nullptr;
-    if (SUCCEEDED(self->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
-        isBackbuffer = (bb == rt);
-        bb->Release();
+    DeviceState* ds = GetDeviceState(self);
+    if (!ds->rt0Known && !ProbeRenderTarget(self, *ds)) {
+        return ForwardSetViewport(self, vpIn);
     }
 
-    if (!isBackbuffer) {
-        rt->Release();
-        return Real_SetViewport(self, vpIn);
+    if (!ds->rt0IsBackbuffer) {
+        return ForwardSetViewport(self, vpIn);
     }
 
-    const LONG bbw = (LONG)rtDesc.Width;
-    const LONG bbh = (LONG)rtDesc.Height;
+    const LONG bbw = (LONG)ds->backbufferW;
+    const LONG bbh = (LONG)ds->backbufferH;
 
-    MaybeEnableWin32VirtualFromViewport(*vpIn, bbw, bbh);
+    MaybeEnableWin32VirtualFromViewport(*vpIn, bbw, bbh, *ds);
 
     D3DVIEWPORT9 vp = *vpIn;
 
@@ -1012,9 +3904,29 @@ static HRESULT STDMETHODCALLTYPE Hook_SetViewport(IDirect3DDevice9* self, const
     vp.Width = newW;
     vp.Height = newH;
 
-    rt->Release();
+    return ForwardSetViewport(self, &vp);
+}
+
+static HRESULT STDMETHODCALLTYPE Hook_SetRenderTarget(IDirect3DDevice9* self, DWORD index, IDirect3DSurface9* rt) {
+    HRESULT hr = Real_SetRenderTarget ? Real_SetRenderTarget(self, index, rt) : D3DERR_INVALIDCALL;
+    if (FAILED(hr) || index != 0) return hr;
 
-    return Real_SetViewport(self, vpIn);
+    // Setting RT 0 implicitly resets the viewport to the full surface.
+    DeviceState* ds = FindDeviceState(self);
+    if (!ds) return hr;
+
+    if (ds->backbuffer) {
+        ds->rt0Known = true;
+        ds->rt0IsBackbuffer = (rt == ds->backbuffer);
+    }
+
+    if (ds->rt0Known && ds->rt0IsBackbuffer) {
+        ShadowSetFullViewport(self, ds->backbufferW, ds->backbufferH);
+    }
+    else {
+        ShadowForgetViewport(self);
+    }
+    return hr;
 }
 
 // =============================================================================
@@ -1035,32 +3947,7 @@ static const RECT* ChooseSrcRectFromSwapChain(IDirect3DSwapChain9* sc, IDirect3D
 
     D3DVIEWPORT9 vp{};
     if (FAILED(dev->GetViewport(&vp))) return nullptr;
-    if (vp.Width == 0 || vp.Height == 0) return nullptr;
-
-    if (bbw && bbh && vp.X == 0 && vp.Y == 0 && vp.Width == bbw && vp.Height == bbh)
-        return nullptr;
-
-    LONG sx = (LONG)vp.X;
-    LONG sy = (LONG)vp.Y;
-    LONG sw = (LONG)vp.Width;
-    LONG sh = (LONG)vp.Height;
-
-    if (bbw && bbh) {
-        if (sx < 0) sx = 0;
-        if (sy < 0) sy = 0;
-        if (sx > (LONG)bbw) sx = (LONG)bbw;
-        if (sy > (LONG)bbh) sy = (LONG)bbh;
-
-        LONG maxW = (LONG)bbw - sx;
-        LONG maxH = (LONG)bbh - sy;
-        if (sw > maxW) sw = maxW;
-        if (sh > maxH) sh = maxH;
-    }
-
-    if (sw <= 0 || sh <= 0) return nullptr;
-
-    srcOut = RECT{ sx, sy, sx + sw, sy + sh };
-    return &srcOut;
+    return SrcRectFromViewport(vp, bbw, bbh, srcOut);
 }
 
 static HRESULT PresentStretch_SwapChain(
@@ -1069,13 +3956,21 @@ static HRESULT PresentStretch_SwapChain(
     const RECT* dstIn,
     HWND hOverride,
     const RGNDATA* dirty,
-    DWORD flags)
+    DWORD flags,
+    FrameSample& fs)
 {
     if (!Real_SwapChainPresent) return D3D_OK;
 
+    auto present = [&](const RECT* s, const RECT* d, HWND h) {
+        fs.realStart = QpcNow();
+        HRESULT hr = Real_SwapChainPresent(sc, s, d, h, dirty, flags);
+        fs.realEnd = QpcNow();
+        return hr;
+    };
+
     IDirect3DDevice9* dev = nullptr;
     if (FAILED(sc->GetDevice(&dev)) || !dev) {
-        return Real_SwapChainPresent(sc, srcIn, dstIn, hOverride, dirty, flags);
+        return present(srcIn, dstIn, hOverride);
     }
 
     // Determine the window the swapchain is meant to present into.
@@ -1095,43 +3990,65 @@ static HRESULT PresentStretch_SwapChain(
         InstallWndProc(g_hwnd);
     }
 
+    if (spp.SwapEffect == D3DSWAPEFFECT_FLIPEX) {
+        dev->Release();
+        return present(nullptr, nullptr, nullptr);
+    }
+
+    // GPU scaling only applies to the implicit swapchain.
+    if (Cfg().scaleMode != kScaleOff && !hOverride) {
+        DeviceState* ds = FindDeviceState(dev);
+        if (ds && IsDeviceStateCurrent(*ds) && ImplicitSwapChain(dev, *ds) == sc) {
+            HRESULT hr = D3D_OK;
+            if (PresentScaled(dev, *ds, srcIn, fs, hr)) {
+                dev->Release();
+                return hr;
+            }
+        }
+    }
+
     RECT dstFull{};
     if (!BuildClientDstRect(target, dstFull)) {
         dev->Release();
-        return Real_SwapChainPresent(sc, srcIn, dstIn, hOverride, dirty, flags);
-    }
-
-    bool overrideDst = true;
-    if (dstIn) {
-        LONG dw = dstIn->right - dstIn->left;
-        LONG dh = dstIn->bottom - dstIn->top;
-        if (dstIn->left == 0 && dstIn->top == 0 &&
-            dw == (dstFull.right - dstFull.left) &&
-            dh == (dstFull.bottom - dstFull.top))
-        {
-            overrideDst = false;
-        }
+        return present(srcIn, dstIn, hOverride);
     }
 
     RECT srcVP{};
     const RECT* srcUse = ChooseSrcRectFromSwapChain(sc, dev, srcIn, srcVP);
-    const RECT* dstUse = overrideDst ? &dstFull : dstIn;
+    const RECT dstImage = FitRect(EffectiveFit(), (LONG)spp.BackBufferWidth, (LONG)spp.BackBufferHeight,
+        dstFull.right, dstFull.bottom);
+    const RECT* dstUse = DstCoversClient(dstIn, dstImage) ? dstIn : &dstImage;
 
     dev->Release();
     HWND callOverride = hOverride ? hOverride : target;
-    return Real_SwapChainPresent(sc, srcUse, dstUse, callOverride, dirty, flags);
+    return present(srcUse, dstUse, callOverride);
 }
 
 static HRESULT STDMETHODCALLTYPE Hook_SwapChainPresent(
     IDirect3DSwapChain9* self,
     const RECT* src, const RECT* dst, HWND hOverride, const RGNDATA* dirty, DWORD flags)
 {
+    PaceFrame();
+    TracePresent(kTraceSwapChainPresent, hOverride, src, dst, dirty);
+
+    FrameSample fs{ QpcNow() };
     InterlockedExchange(&g_seenPresent, 1);
-    g_presentTotal++;
+    InterlockedIncrement64(&g_presentTotal);
     MaybeInstallGfwHook();
 
-    ApplyMousePolicyNow();
-    return PresentStretch_SwapChain(self, src, dst, hOverride, dirty, flags);
+    UpdateMousePolicy();
+    PostPendingMove();
+
+    fs.path = kPathSwapChain;
+    HRESULT hr = PresentStretch_SwapChain(self, src, dst, hOverride, dirty, flags, fs);
+
+    IDirect3DDevice9* dev = nullptr;
+    if (Cfg().maxFrameLatency > 0 && SUCCEEDED(self->GetDevice(&dev)) && dev) {
+        ThrottleFrameLatency(dev);
+        dev->Release();
+    }
+    RecordFrame(fs);
+    return hr;
 }
 
 // =============================================================================
@@ -1140,35 +4057,69 @@ static HRESULT STDMETHODCALLTYPE Hook_SwapChainPresent(
 
 static HRESULT STDMETHODCALLTYPE Hook_Reset(IDirect3DDevice9* self, D3DPRESENT_PARAMETERS* pPP);
 
+// Our queries and scale chain each hold a reference to the device, so the
+// game's last Release would leave it alive, backbuffers and all. Once only
+// those are left they go, and the device with them, FLIPEX entry and all.
+// Objects whose Release shares this code pass straight through the lookup; a
+// shadowed buffer among them still gets its twin freed.
+static ULONG STDMETHODCALLTYPE Hook_DevRelease(IUnknown* self) {
+    IDirect3DDevice9* dev = reinterpret_cast<IDirect3DDevice9*>(self);
+    const ULONG refs = ReleaseMaybeShadowed(self, Real_DevRelease);
+    DeviceState* ds = FindDeviceState(dev);
+    if (!ds || refs != HeldDeviceRefs(*ds)) {
+        if (refs == 0) SetFlipExDevice(dev, false);
+        return refs;
+    }
+
+    // Detached first: releasing our objects drops the device's count again.
+    DeviceState held = *ds;
+    *ds = DeviceState{};
+    ReleaseDeviceResources(held);
+    SetFlipExDevice(dev, false);
+    return 0;
+}
+
 static void InstallDeviceHooks(IDirect3DDevice9* dev) {
     if (!dev) return;
 
     void** vtbl = *(void***)dev;
 
     // IDirect3DDevice9 vtable:
-    //   Reset       = 16
-    //   Present     = 17
-    //   SetViewport = 47
+    //   Release         = 2
+    //   Reset           = 16
+    //   Present         = 17
+    //   SetRenderTarget = 37
+    //   SetViewport     = 47
+    void* releasePtr = vtbl[2];
     void* resetPtr = vtbl[16];
     void* presentPtr = vtbl[17];
+    void* setRenderTargetPtr = vtbl[37];
     void* setViewportPtr = vtbl[47];
 
-    if (resetPtr && !Real_Reset) {
-        if (MH_CreateHook(resetPtr, &Hook_Reset, reinterpret_cast<void**>(&Real_Reset)) == MH_OK) {
-            MH_EnableHook(resetPtr);
-        }
+    HookSet hooks("device");
+
+    if (!Real_DevRelease) {
+        hooks.Add(releasePtr, &Hook_DevRelease, reinterpret_cast<void**>(&Real_DevRelease));
     }
 
-    if (presentPtr && !Real_Present) {
-        if (MH_CreateHook(presentPtr, &Hook_Present, reinterpret_cast<void**>(&Real_Present)) == MH_OK) {
-            MH_EnableHook(presentPtr);
-        }
+    if (!Real_Reset) {
+        hooks.Add(resetPtr, &Hook_Reset, reinterpret_cast<void**>(&Real_Reset));
     }
 
-    if (setViewportPtr && !Real_SetViewport) {
-        if (MH_CreateHook(setViewportPtr, &Hook_SetViewport, reinterpret_cast<void**>(&Real_SetViewport)) == MH_OK) {
-            MH_EnableHook(setViewportPtr);
-        }
+    if (!Real_Present) {
+        hooks.Add(presentPtr, &Hook_Present, reinterpret_cast<void**>(&Real_Present));
+    }
+
+    if (!Real_SetRenderTarget) {
+        hooks.Add(setRenderTargetPtr, &Hook_SetRenderTarget, reinterpret_cast<void**>(&Real_SetRenderTarget));
+    }
+
+    if (!Real_SetViewport) {
+        hooks.Add(setViewportPtr, &Hook_SetViewport, reinterpret_cast<void**>(&Real_SetViewport));
+    }
+
+    if (Cfg().flipEx) {
+        InstallFlipExResourceHooks(dev, hooks);
     }
 
     UpdateBackbufferSize(dev);
@@ -1176,15 +4127,14 @@ static void InstallDeviceHooks(IDirect3DDevice9* dev) {
     if (SUCCEEDED(dev->GetSwapChain(0, &sc)) && sc) {
         void** svtbl = *(void***)sc;
         void* scPresentPtr = svtbl[3];
-        if (scPresentPtr && !Real_SwapChainPresent) {
-            if (MH_CreateHook(scPresentPtr, &Hook_SwapChainPresent,
-                reinterpret_cast<void**>(&Real_SwapChainPresent)) == MH_OK)
-            {
-                MH_EnableHook(scPresentPtr);
-            }
+        if (!Real_SwapChainPresent) {
+            hooks.Add(scPresentPtr, &Hook_SwapChainPresent,
+                reinterpret_cast<void**>(&Real_SwapChainPresent));
         }
         sc->Release();
     }
+
+    hooks.Commit();
 }
 
 // =============================================================================
@@ -1192,6 +4142,10 @@ static void InstallDeviceHooks(IDirect3DDevice9* dev) {
 // =============================================================================
 
 static HRESULT STDMETHODCALLTYPE Hook_Reset(IDirect3DDevice9* self, D3DPRESENT_PARAMETERS* pPP) {
+    if (pPP) {
+        Trace(kTraceReset, TraceWH((LONG)pPP->BackBufferWidth, (LONG)pPP->BackBufferHeight),
+            pPP->Windowed, pPP->SwapEffect, pPP->Flags);
+    }
 
     if (!g_hwnd || !IsWindow(g_hwnd)) {
         g_hwnd = FindMainWindowForThisProcess();
@@ -1201,15 +4155,32 @@ static HRESULT STDMETHODCALLTYPE Hook_Reset(IDirect3DDevice9* self, D3DPRESENT_P
         ForceWindowedPP(*pPP, g_hwnd);
     }
 
+    if (DeviceState* ds = FindDeviceState(self)) ReleaseDeviceResources(*ds);
+
+    // A flip-model device has to stay flip-model across Reset.
+    D3DSWAPEFFECT requested = D3DSWAPEFFECT_DISCARD;
+    const bool flip = pPP && IsFlipExDevice(self);
+    if (flip) {
+        requested = pPP->SwapEffect;
+        ApplyFlipExPP(*pPP);
+    }
+
     HRESULT hr = Real_Reset ? Real_Reset(self, pPP) : D3DERR_INVALIDCALL;
+    if (flip) pPP->SwapEffect = requested;
+
+    // Backbuffer size, viewport and possibly the window changed.
+    InvalidatePresentState();
+    if (SUCCEEDED(hr)) ShadowResetRenderTarget(self);
+    else ShadowForgetRenderTarget(self);
 
     if (SUCCEEDED(hr)) {
         UpdateBackbufferSize(self);
+        if (flip) RestoreShadows(self);
     }
 
     // Re-assert window style after a successful reset.
     if (SUCCEEDED(hr) && g_hwnd && IsWindow(g_hwnd)) {
-        if (!g_cfg.startWindowed) ApplyBorderless(g_hwnd);
+        if (!Cfg().startWindowed) ApplyBorderless(g_hwnd);
         else ApplyWindowed(g_hwnd);
     }
 
@@ -1225,6 +4196,10 @@ static HRESULT STDMETHODCALLTYPE Hook_CreateDevice(
     UINT Adapter, D3DDEVTYPE DeviceType, HWND hFocusWindow,
     DWORD BehaviorFlags, D3DPRESENT_PARAMETERS* pPP, IDirect3DDevice9** ppDev)
 {
+    Trace(kTraceCreateDevice, Adapter | ((DWORD)DeviceType << 16), BehaviorFlags,
+        pPP ? TraceWH((LONG)pPP->BackBufferWidth, (LONG)pPP->BackBufferHeight) : 0,
+        pPP ? (DWORD)pPP->Windowed : 0);
+
     if (hFocusWindow) g_hwnd = hFocusWindow;
     if (!g_hwnd || !IsWindow(g_hwnd)) g_hwnd = FindMainWindowForThisProcess();
 
@@ -1232,7 +4207,7 @@ static HRESULT STDMETHODCALLTYPE Hook_CreateDevice(
         InstallWndProc(g_hwnd);
         GetWindowRect(g_hwnd, &g_windowedRect);
 
-        if (!g_cfg.startWindowed) ApplyBorderless(g_hwnd);
+        if (!Cfg().startWindowed) ApplyBorderless(g_hwnd);
         else ApplyWindowed(g_hwnd);
     }
 
@@ -1240,8 +4215,27 @@ static HRESULT STDMETHODCALLTYPE Hook_CreateDevice(
         ForceWindowedPP(*pPP, g_hwnd);
     }
 
-    HRESULT hr = Real_CreateDevice(self, Adapter, DeviceType, hFocusWindow, BehaviorFlags, pPP, ppDev);
+    HRESULT hr = D3DERR_NOTAVAILABLE;
+    bool flip = false;
+    if (Cfg().flipEx && !t_inFlipExCreate && pPP && ppDev && CanUseFlipEx(*pPP)) {
+        hr = CreateFlipExDevice(Adapter, DeviceType, hFocusWindow, BehaviorFlags, *pPP, ppDev);
+        flip = SUCCEEDED(hr);
+    }
+    if (!flip) {
+        hr = Real_CreateDevice(self, Adapter, DeviceType, hFocusWindow, BehaviorFlags, pPP, ppDev);
+    }
+
+    // The view follows the newest device: a fallback or a game recreating its
+    // device without flip model takes the stretch-only fit back off.
+    const bool flipActive = flip && SUCCEEDED(hr) && ppDev && *ppDev;
+    if (InterlockedExchange(&g_flipExActive, flipActive ? 1 : 0) != (flipActive ? 1 : 0)) RebuildView();
+
     if (SUCCEEDED(hr) && ppDev && *ppDev) {
+        ForgetDeviceState(*ppDev);
+        GetDeviceState(*ppDev);
+        SetFlipExDevice(*ppDev, flip);
+        InvalidatePresentState();
+        ShadowResetRenderTarget(*ppDev);
         InstallDeviceHooks(*ppDev);
     }
 
@@ -1255,30 +4249,98 @@ static void HookCreateDeviceOn(IDirect3D9* d3d) {
     void* createDevicePtr = vtbl[16];
     if (!createDevicePtr) return;
 
-    if (MH_CreateHook(createDevicePtr, &Hook_CreateDevice,
-        reinterpret_cast<void**>(&Real_CreateDevice)) == MH_OK)
-    {
-        MH_EnableHook(createDevicePtr);
-    }
+    HookSet hooks("d3d9");
+    hooks.Add(createDevicePtr, &Hook_CreateDevice, reinterpret_cast<void**>(&Real_CreateDevice));
+    hooks.Commit();
 }
 
 // =============================================================================
 // Initialization
 // =============================================================================
 
-static volatile LONG g_inited = 0;
+void TryChainLoad_Entry(const char* cfgPath);
+
+static INIT_ONCE g_initOnce = INIT_ONCE_STATIC_INIT;
+static volatile LONG g_initThreadId = 0;
+
+// preferences.ini next to this proxy, falling back to the working directory.
+// Resolved once, so a later SetCurrentDirectory in the game does not point
+// reloads or the chain loader at a different file.
+static void ResolveConfigPath() {
+    HMODULE self = nullptr;
+    char path[MAX_PATH];
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+        GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        reinterpret_cast<LPCSTR>(&ResolveConfigPath), &self)) {
+        DWORD len = GetModuleFileNameA(self, path, MAX_PATH);
+        char* slash = (len > 0 && len < MAX_PATH) ? strrchr(path, '\\') : nullptr;
+        if (slash && (slash - path) + sizeof("\\preferences.ini") <= MAX_PATH) {
+            lstrcpynA(slash + 1, "preferences.ini", MAX_PATH - (int)(slash + 1 - path));
+            lstrcpynA(g_cfgPath, path, MAX_PATH);
+            return;
+        }
+    }
+
+    if (!GetFullPathNameA(".\\preferences.ini", MAX_PATH, g_cfgPath, nullptr))
+        lstrcpynA(g_cfgPath, ".\\preferences.ini", MAX_PATH);
+}
+
+static BOOL CALLBACK InitOnceProc(PINIT_ONCE, PVOID, PVOID*);
 
+// Every entry point waits here until init has completed on whichever thread
+// got there first, so no caller sees half-installed hooks or a chain DLL that
+// is still loading. A chain DLL that calls back into our exports from its
+// DllMain runs on the init thread itself and must not wait on its own init.
 static void EnsureInit() {
-    if (InterlockedCompareExchange(&g_inited, 1, 0) != 0) return;
+    if ((DWORD)InterlockedCompareExchange(&g_initThreadId, 0, 0) == GetCurrentThreadId()) return;
+    InitOnceExecuteOnce(&g_initOnce, &InitOnceProc, nullptr, nullptr);
+}
+
+static BOOL CALLBACK InitOnceProc(PINIT_ONCE, PVOID, PVOID*) {
+    InterlockedExchange(&g_initThreadId, (LONG)GetCurrentThreadId());
 
-    g_cfg.Load();
+    LONGLONG t0 = QpcNow();
+    ResolveConfigPath();
+    TryChainLoad_Entry(g_cfgPath);
 
+    Config* cfg = new Config();
+    cfg->Load(g_cfgPath);
+    PublishConfig(cfg);
+
+    LONGLONG t1 = QpcNow();
     if (MH_Initialize() != MH_OK) {
-        return;
+        InterlockedExchange(&g_initThreadId, 0);
+        return TRUE;
+    }
+
+    LoadProfile(*cfg);
+    StartTrace(*cfg);
+
+    LONGLONG t2 = QpcNow();
+    HookSet hooks("startup");
+    InstallUser32Hooks(hooks);
+    InstallDirectInputMouseHook(hooks);
+
+    // A known title gets its late hooks in this batch: one thread freeze
+    // before the first frame instead of one mid-game.
+    const bool eagerGfw = ProfileHas(kProfileGfwHook) && cfg->ignoreDeactivate && AddGfwHook(hooks);
+    if (ProfileHas(kProfileWin32Virt) &&
+        InterlockedCompareExchange(&g_win32VirtHooksInstalled, 2, 0) == 0) {
+        InterlockedExchange(&g_win32VirtEnabled, 1);
+        InstallUser32VirtualHooks(hooks);
+        InterlockedExchange(&g_win32VirtHooksInstalled, 1);
+    }
+
+    if (hooks.Commit() == MH_OK && eagerGfw) {
+        InterlockedExchange(&g_gfwHookInstalled, 1);
     }
+    StartConfigWatch();
 
-    InstallUser32Hooks();
-    InstallDirectInputMouseHook();
+    LONGLONG t3 = QpcNow();
+    DebugLog("init: chain+config %.1f us, minhook %.1f us, hooks %.1f us\n",
+        QpcToUs(t1 - t0), QpcToUs(t2 - t1), QpcToUs(t3 - t2));
+    InterlockedExchange(&g_initThreadId, 0);
+    return TRUE;
 }
 
 // =============================================================================
@@ -1290,6 +4352,9 @@ extern "C" __declspec(dllexport) IDirect3D9* WINAPI Direct3DCreate9(UINT sdk) {
     EnsureRealD3D9Loaded();
     if (!Real_Direct3DCreate9) return nullptr;
 
+    // FlipEx devices come from a private IDirect3D9Ex (see GetFlipExD3D).
+    g_d3dSdkVersion = sdk;
+
     IDirect3D9* d3d = Real_Direct3DCreate9(sdk);
     HookCreateDeviceOn(d3d);
     return d3d;
@@ -1307,10 +4372,19 @@ extern "C" __declspec(dllexport) HRESULT WINAPI Direct3DCreate9Ex(UINT sdk, IDir
     return hr;
 }
 
-static BOOL WINAPI DllMain(HINSTANCE hinst, DWORD reason, LPVOID) {
-    if (reason == DLL_PROCESS_ATTACH) {
-        g_processStartMs = GetTickCount64();
-        DisableThreadLibraryCalls(hinst);
-    }
-    return TRUE;
+// Entry points for dllmain.cpp. NoteProcessAttach runs under the loader lock;
+// StartBorderlessHooks runs on the init thread and races the first export call
+// into the same one-time init.
+void NoteProcessAttach() {
+    g_processStartMs = GetTickCount64();
+}
+
+void StartBorderlessHooks() {
+    EnsureInit();
+}
+
+// Runs under the loader lock on FreeLibrary or process exit. winmm is one of
+// our imports, so it is still attached here.
+void NoteProcessDetach() {
+    SetPacerPeriod(false);
 }
\ No newline at end of file
@@ -1,13 +1,13 @@
 #include <windows.h>
 
+void NoteProcessAttach();
+void NoteProcessDetach();
 void StartBorderlessHooks();
-extern void TryChainLoad_Entry();
 
 static DWORD WINAPI InitThread(LPVOID)
 {
-    // Chain-load optional DLL first (e.g., popww_ap.dll)
-    TryChainLoad_Entry();
-
+    // Chain-loading (see chainload.cpp) runs inside the proxy's init, which
+    // Direct3DCreate9 waits on as well.
     StartBorderlessHooks();
     return 0;
 }
@@ -16,7 +16,11 @@ BOOL WINAPI DllMain(HINSTANCE hinst, DWORD reason, LPVOID)
 {
     if (reason == DLL_PROCESS_ATTACH) {
         DisableThreadLibraryCalls(hinst);
+        NoteProcessAttach();
         CreateThread(nullptr, 0, InitThread, nullptr, 0, nullptr);
     }
+    else if (reason == DLL_PROCESS_DETACH) {
+        NoteProcessDetach();
+    }
     return TRUE;
 }
@@ -0,0 +1,329 @@
+// What each hot detour adds on top of the call it replaces.
+//
+// The proxy runs against the fakes (fake/) with its hooks installed the
+// normal way, and every case times two loops of the same call: through the
+// patched slot or export, which lands in the detour, and straight into the
+// real (fake) function the detour forwards to. The difference is the detour's
+// own cost. Each case also counts the fake calls one detoured call makes
+// (fake_calls.h), which is what the real system would charge for.
+//
+//   detour_bench                          report only
+//   detour_bench --baseline <file>        also exit 1 on any regression
+//   detour_bench --write-baseline <file>  record the current numbers
+//
+// The baseline holds, per detour, the most fake calls of each kind one call
+// may make and a ceiling on the added ns. Call counts are exact, so one extra
+// syscall on a hot path fails the run. Timings are noisy; the written ceiling
+// is a multiple of the measured overhead and only catches gross slowdowns.
+#include "fake_d3d9.h"
+#include "fake_dinput.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+const int kIterations = 20000;
+const int kRounds = 5;
+const double kCallSlack = 0.05;       // per call, for work done every few hundred ms
+const double kWriteNsFactor = 4.0;    // ceiling written = factor x measured overhead
+const double kWriteNsFloor = 500.0;
+
+const LONG kClientW = 1280, kClientH = 720;
+
+HWND g_gameHwnd = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+IDirect3DSwapChain9* g_chain = nullptr;
+IDirectInputDevice8A* g_mouse = nullptr;
+WNDPROC g_hookedProc = nullptr;
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+// --- the calls -----------------------------------------------------------------
+
+const D3DVIEWPORT9 kViewport{ 0, 0, 640, 480, 0.0f, 1.0f };
+const RECT kClip{ 10, 10, 500, 400 };
+const LPARAM kMouseLParam = MAKELPARAM(320, 200);
+
+void HookedPresent() { g_dev->Present(nullptr, nullptr, nullptr, nullptr); }
+void DirectPresent() { Real_Present(g_dev, nullptr, nullptr, nullptr, nullptr); }
+
+void HookedSwapChainPresent() { g_chain->Present(nullptr, nullptr, nullptr, nullptr, 0); }
+void DirectSwapChainPresent() { Real_SwapChainPresent(g_chain, nullptr, nullptr, nullptr, nullptr, 0); }
+
+void HookedSetViewport() { g_dev->SetViewport(&kViewport); }
+void DirectSetViewport() { Real_SetViewport(g_dev, &kViewport); }
+
+void HookedGetClientRect() { RECT rc; GetClientRect(g_gameHwnd, &rc); }
+void DirectGetClientRect() { RECT rc; Real_GetClientRect(g_gameHwnd, &rc); }
+
+void HookedScreenToClient() { POINT pt{ 400, 300 }; ScreenToClient(g_gameHwnd, &pt); }
+void DirectScreenToClient() { POINT pt{ 400, 300 }; Real_ScreenToClient(g_gameHwnd, &pt); }
+
+void HookedClientToScreen() { POINT pt{ 400, 300 }; ClientToScreen(g_gameHwnd, &pt); }
+void DirectClientToScreen() { POINT pt{ 400, 300 }; Real_ClientToScreen(g_gameHwnd, &pt); }
+
+void HookedClipCursor() { ClipCursor(&kClip); }
+void DirectClipCursor() { Real_ClipCursor(&kClip); }
+
+void HookedGetForegroundWindow() { GetForegroundWindow(); }
+void DirectGetForegroundWindow() { Real_GetForegroundWindow(); }
+
+void HookedGetDeviceState() { DIMOUSESTATE2 s; g_mouse->GetDeviceState(sizeof(s), &s); }
+void DirectGetDeviceState() { DIMOUSESTATE2 s; Real_GetDeviceState(g_mouse, sizeof(s), &s); }
+
+void HookedWndProc() { g_hookedProc(g_gameHwnd, WM_MOUSEMOVE, 0, kMouseLParam); }
+void DirectWndProc() { g_origWndProc(g_gameHwnd, WM_MOUSEMOVE, 0, kMouseLParam); }
+
+struct Case {
+    const char* name;
+    void (*hooked)();
+    void (*direct)();
+    void* const* real;  // the Real_* pointer, i.e. the hooked target
+};
+
+const Case kCases[] = {
+    { "Hook_Present", &HookedPresent, &DirectPresent, (void* const*)&Real_Present },
+    { "Hook_SwapChainPresent", &HookedSwapChainPresent, &DirectSwapChainPresent, (void* const*)&Real_SwapChainPresent },
+    { "Hook_SetViewport", &HookedSetViewport, &DirectSetViewport, (void* const*)&Real_SetViewport },
+    { "Hook_GetClientRect", &HookedGetClientRect, &DirectGetClientRect, (void* const*)&Real_GetClientRect },
+    { "Hook_ScreenToClient", &HookedScreenToClient, &DirectScreenToClient, (void* const*)&Real_ScreenToClient },
+    { "Hook_ClientToScreen", &HookedClientToScreen, &DirectClientToScreen, (void* const*)&Real_ClientToScreen },
+    { "Hook_ClipCursor", &HookedClipCursor, &DirectClipCursor, (void* const*)&Real_ClipCursor },
+    { "Hook_GetForegroundWindow", &HookedGetForegroundWindow, &DirectGetForegroundWindow, (void* const*)&Real_GetForegroundWindow },
+    { "Hook_GetDeviceState", &HookedGetDeviceState, &DirectGetDeviceState, (void* const*)&Real_GetDeviceState },
+    { "Hook_WndProc", &HookedWndProc, &DirectWndProc, nullptr },
+};
+
+// --- setup -----------------------------------------------------------------------
+
+// A game in steady state: windowed device with an 800x600 backbuffer shown
+// in a 1280x720 client, so Present stretches and the user32 hooks virtualize.
+bool Setup() {
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, kClientW, kClientH, &GameProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!g_d3d) return false;
+
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    if (FAILED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev))) return false;
+    if (FAILED(g_dev->GetSwapChain(0, &g_chain))) return false;
+
+    // The late hooks: GetForegroundWindow after 5 s and 120 frames; the
+    // user32 virtualization is switched on directly rather than waiting for
+    // the viewport heuristic to decide.
+    FakeAdvanceTicks(6000);
+    for (int i = 0; i < 200; i++) g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    g_dev->SetViewport(&kViewport);
+    InterlockedExchange(&g_win32VirtEnabled, 1);
+    MaybeInstallUser32VirtualHooks();
+    FakeSendMessage(g_gameHwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(kClientW, kClientH));
+
+    HMODULE dinput = LoadLibraryA("dinput8.dll");
+    auto create = reinterpret_cast<DirectInput8Create_t>(GetProcAddress(dinput, "DirectInput8Create"));
+    IDirectInput8A* di = nullptr;
+    if (!create || FAILED(create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION, IID_IDirectInput8A,
+        (void**)&di, nullptr))) return false;
+    if (FAILED(di->CreateDevice(GUID_SysMouse, &g_mouse, nullptr))) return false;
+    g_mouse->SetCooperativeLevel(g_gameHwnd, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
+    g_mouse->Acquire();
+
+    g_hookedProc = FakeWindowProc(g_gameHwnd);
+
+    // Every case must measure a live detour, not the fake on its own.
+    bool ok = g_hookedProc == &Hook_WndProc;
+    for (const Case& c : kCases) {
+        if (c.real && !FakeHookEnabled(*c.real)) {
+            fprintf(stderr, "detour_bench: %s is not installed\n", c.name);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// --- measuring -------------------------------------------------------------------
+
+struct Result {
+    double hookedNs;
+    double directNs;
+    std::map<std::string, double> calls;   // fake calls per detoured call
+    double addedCalls;                      // fake calls per call beyond the direct one
+};
+
+double NsPerCall(void (*fn)()) {
+    double best = 1e30;
+    for (int r = 0; r < kRounds; r++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; i++) fn();
+        const auto t1 = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / kIterations;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+FakeCallSnapshot CallsOf(void (*fn)()) {
+    const FakeCallSnapshot before = FakeCallsNow();
+    for (int i = 0; i < kIterations; i++) fn();
+    return FakeCallsNow() - before;
+}
+
+Result Measure(const Case& c) {
+    for (int i = 0; i < 1000; i++) c.hooked();  // settle caches and lazy state
+
+    Result r;
+    const FakeCallSnapshot hooked = CallsOf(c.hooked);
+    const FakeCallSnapshot direct = CallsOf(c.direct);
+    for (int api = 0; api < kFakeApiCount; api++) {
+        if (hooked.n[api]) r.calls[FakeApiName(api)] = (double)hooked.n[api] / kIterations;
+    }
+    r.addedCalls = (double)(hooked.Total() - direct.Total()) / kIterations;
+
+    r.directNs = NsPerCall(c.direct);
+    r.hookedNs = NsPerCall(c.hooked);
+    return r;
+}
+
+// --- baseline --------------------------------------------------------------------
+
+struct Limit {
+    double maxNs;
+    std::map<std::string, double> calls;
+};
+
+bool ReadBaseline(const char* path, std::map<std::string, Limit>& out) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string name;
+        Limit lim{};
+        if (!(in >> name >> lim.maxNs)) continue;
+        std::string tok;
+        while (in >> tok) {
+            const size_t eq = tok.find('=');
+            if (eq != std::string::npos) lim.calls[tok.substr(0, eq)] = atof(tok.c_str() + eq + 1);
+        }
+        out[name] = lim;
+    }
+    return true;
+}
+
+bool WriteBaseline(const char* path, const std::map<std::string, Result>& results) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# Per-call ceilings for tests/bench/detour_bench.cpp.\n");
+    fprintf(f, "# <detour> <max added ns> <fake api>=<max calls per detoured call>...\n");
+    fprintf(f, "# Fake APIs not listed must not be called. Regenerate with --write-baseline\n");
+    fprintf(f, "# after a deliberate change, and say why in the commit.\n");
+    for (const Case& c : kCases) {
+        const Result& r = results.at(c.name);
+        double ns = (r.hookedNs - r.directNs) * kWriteNsFactor;
+        if (ns < kWriteNsFloor) ns = kWriteNsFloor;
+        fprintf(f, "%-26s %6.0f", c.name, ns);
+        for (const auto& kv : r.calls) fprintf(f, " %s=%.2f", kv.first.c_str(), kv.second);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+int Compare(const std::map<std::string, Limit>& base, const std::map<std::string, Result>& results) {
+    int regressions = 0;
+    for (const Case& c : kCases) {
+        auto it = base.find(c.name);
+        if (it == base.end()) {
+            fprintf(stderr, "REGRESSION %s: not in the baseline\n", c.name);
+            regressions++;
+            continue;
+        }
+        const Limit& lim = it->second;
+        const Result& r = results.at(c.name);
+
+        const double added = r.hookedNs - r.directNs;
+        if (added > lim.maxNs) {
+            fprintf(stderr, "REGRESSION %s: +%.1f ns per call, ceiling %.0f ns\n", c.name, added, lim.maxNs);
+            regressions++;
+        }
+        for (const auto& kv : r.calls) {
+            auto allowed = lim.calls.find(kv.first);
+            const double max = allowed == lim.calls.end() ? 0.0 : allowed->second;
+            if (kv.second > max + kCallSlack) {
+                fprintf(stderr, "REGRESSION %s: %s %.2f per call, baseline %.2f\n",
+                    c.name, kv.first.c_str(), kv.second, max);
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* baseline = nullptr;
+    const char* writeTo = nullptr;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (!strcmp(argv[i], "--baseline")) baseline = argv[++i];
+        else if (!strcmp(argv[i], "--write-baseline")) writeTo = argv[++i];
+    }
+
+    if (!Setup()) {
+        fprintf(stderr, "detour_bench: setup failed\n");
+        FakeExit(2);
+    }
+
+    std::map<std::string, Result> results;
+    printf("%-26s %10s %10s %10s %11s  %s\n", "detour", "direct ns", "hooked ns", "added ns", "added calls",
+        "fake calls per detoured call");
+    for (const Case& c : kCases) {
+        const Result r = Measure(c);
+        printf("%-26s %10.1f %10.1f %+10.1f %+11.2f ", c.name, r.directNs, r.hookedNs, r.hookedNs - r.directNs,
+            r.addedCalls);
+        for (const auto& kv : r.calls) printf(" %s=%.2f", kv.first.c_str(), kv.second);
+        printf("\n");
+        results[c.name] = r;
+    }
+    fflush(stdout);
+
+    if (writeTo) {
+        if (!WriteBaseline(writeTo, results)) {
+            fprintf(stderr, "detour_bench: cannot write %s\n", writeTo);
+            FakeExit(2);
+        }
+        printf("baseline written to %s\n", writeTo);
+    }
+
+    int regressions = 0;
+    if (baseline) {
+        std::map<std::string, Limit> base;
+        if (!ReadBaseline(baseline, base)) {
+            fprintf(stderr, "detour_bench: cannot read %s\n", baseline);
+            FakeExit(2);
+        }
+        regressions = Compare(base, results);
+        printf("%d regression(s) against %s\n", regressions, baseline);
+    }
+    fflush(stdout);
+    FakeExit(regressions ? 1 : 0);
+}
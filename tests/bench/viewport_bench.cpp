@@ -0,0 +1,183 @@
+// Hook_SetViewport against a fake IDirect3DDevice9: what one call costs with
+// the render target 0 shadow, next to what it cost when every call asked the
+// device (GetRenderTarget, GetDesc, GetBackBuffer and two Releases).
+//
+//   viewport_bench
+//
+// Also checks the shadow itself: the clamp reaches the real SetViewport while
+// the backbuffer is bound, an offscreen render target is left alone, and
+// rebinding the backbuffer brings the clamp back, all without a query.
+// Exits 1 if any of that fails or a shadowed call makes any fake call other
+// than the SetViewport it forwards.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include <chrono>
+
+namespace {
+
+const int kIterations = 50000;
+const int kRounds = 5;
+const UINT kBackbufferW = 800, kBackbufferH = 600;
+
+HWND g_gameHwnd = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+IDirect3DSurface9* g_backbuffer = nullptr;
+IDirect3DSurface9* g_offscreen = nullptr;
+
+// Larger than the backbuffer, so the clamp has work to do.
+const D3DVIEWPORT9 kOversize{ 0, 0, 1024, 768, 0.0f, 1.0f };
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+// What Hook_SetViewport did before the shadow: query RT 0 and the backbuffer
+// on every call, then forward.
+HRESULT QueryingSetViewport(IDirect3DDevice9* self, const D3DVIEWPORT9* vpIn) {
+    IDirect3DSurface9* rt = nullptr;
+    if (FAILED(self->GetRenderTarget(0, &rt)) || !rt) return Real_SetViewport(self, vpIn);
+
+    D3DSURFACE_DESC rtDesc{};
+    if (FAILED(rt->GetDesc(&rtDesc)) || rtDesc.Width == 0 || rtDesc.Height == 0) {
+        rt->Release();
+        return Real_SetViewport(self, vpIn);
+    }
+
+    bool isBackbuffer = false;
+    IDirect3DSurface9* bb = nullptr;
+    if (SUCCEEDED(self->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb) {
+        isBackbuffer = (bb == rt);
+        bb->Release();
+    }
+    rt->Release();
+    if (!isBackbuffer) return Real_SetViewport(self, vpIn);
+
+    D3DVIEWPORT9 vp = *vpIn;
+    if (vp.Width > rtDesc.Width - vp.X) vp.Width = rtDesc.Width - vp.X;
+    if (vp.Height > rtDesc.Height - vp.Y) vp.Height = rtDesc.Height - vp.Y;
+    return Real_SetViewport(self, &vp);
+}
+
+void Shadowed() { g_dev->SetViewport(&kOversize); }
+void Querying() { QueryingSetViewport(g_dev, &kOversize); }
+void Direct() { Real_SetViewport(g_dev, &kOversize); }
+
+double NsPerCall(void (*fn)()) {
+    double best = 1e30;
+    for (int r = 0; r < kRounds; r++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; i++) fn();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count()
+            / kIterations;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+FakeCallSnapshot CallsOf(void (*fn)()) {
+    const FakeCallSnapshot before = FakeCallsNow();
+    for (int i = 0; i < kIterations; i++) fn();
+    return FakeCallsNow() - before;
+}
+
+void Setup() {
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, 1280, 720, &GameProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = kBackbufferW;
+    pp.BackBufferHeight = kBackbufferH;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    if (!CHECK(SUCCEEDED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev)))) CheckExit();
+    CHECK(FakeHookEnabled((void*)Real_SetViewport));
+    CHECK(FakeHookEnabled((void*)Real_SetRenderTarget));
+
+    CHECK(SUCCEEDED(g_dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &g_backbuffer)));
+    IDirect3DTexture9* tex = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateTexture(2048, 1024, 1, D3DUSAGE_RENDERTARGET, D3DFMT_X8R8G8B8,
+        D3DPOOL_DEFAULT, &tex, nullptr)));
+    if (tex) CHECK(SUCCEEDED(tex->GetSurfaceLevel(0, &g_offscreen)));
+
+    // Let the config watch thread park in its wait, so its startup calls
+    // don't land in a count below.
+    for (int i = 0; i < 1000 && FakeCallsNow()[kFakeWaitForMultipleObjects] == 0; i++) Sleep(1);
+    CHECK(FakeCallsNow()[kFakeWaitForMultipleObjects] > 0);
+}
+
+// The viewport the real SetViewport got for kOversize, and the calls the
+// detour made for it.
+D3DVIEWPORT9 Forwarded(FakeCallSnapshot& calls) {
+    const FakeCallSnapshot before = FakeCallsNow();
+    g_dev->SetViewport(&kOversize);
+    calls = FakeCallsNow() - before;
+    return FakeDeviceViewport(g_dev);
+}
+
+void Shadow() {
+    FakeCallSnapshot calls;
+    D3DVIEWPORT9 vp = Forwarded(calls);
+    CHECK_EQ(vp.Width, kBackbufferW);
+    CHECK_EQ(vp.Height, kBackbufferH);
+    CHECK_EQ(calls.Total(), 1);
+    CHECK_EQ(calls[kFakeDevSetViewport], 1);
+
+    // An offscreen target (larger than kOversize) gets the viewport as asked.
+    CHECK(SUCCEEDED(g_dev->SetRenderTarget(0, g_offscreen)));
+    vp = Forwarded(calls);
+    CHECK_EQ(vp.Width, kOversize.Width);
+    CHECK_EQ(vp.Height, kOversize.Height);
+    CHECK_EQ(calls.Total(), 1);
+
+    // Back on the backbuffer, clamped again.
+    CHECK(SUCCEEDED(g_dev->SetRenderTarget(0, g_backbuffer)));
+    vp = Forwarded(calls);
+    CHECK_EQ(vp.Width, kBackbufferW);
+    CHECK_EQ(vp.Height, kBackbufferH);
+    CHECK_EQ(calls.Total(), 1);
+    CHECK_EQ(calls[kFakeDevGetRenderTarget] + calls[kFakeDevGetBackBuffer] + calls[kFakeSurfGetDesc], 0);
+}
+
+void Bench() {
+    for (int i = 0; i < 1000; i++) Shadowed();
+
+    const struct { const char* name; void (*fn)(); } kRows[] = {
+        { "shadowed (Hook_SetViewport)", &Shadowed },
+        { "querying (before the shadow)", &Querying },
+        { "direct (Real_SetViewport)", &Direct },
+    };
+    printf("%-30s %9s  %s\n", "SetViewport", "ns/call", "fake calls per call");
+    for (const auto& row : kRows) {
+        const FakeCallSnapshot calls = CallsOf(row.fn);
+        printf("%-30s %9.1f ", row.name, NsPerCall(row.fn));
+        for (int api = 0; api < kFakeApiCount; api++) {
+            if (calls.n[api]) printf(" %s=%.2f", FakeApiName(api), (double)calls.n[api] / kIterations);
+        }
+        printf("\n");
+        if (row.fn == &Shadowed) {
+            CHECK_EQ(calls.Total(), kIterations);
+            CHECK_EQ(calls[kFakeDevSetViewport], kIterations);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Setup);
+    RUN_STEP(Shadow);
+    RUN_STEP(Bench);
+    CheckExit();
+}
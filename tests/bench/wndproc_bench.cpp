@@ -0,0 +1,199 @@
+// Hook_WndProc per message class, against the fake user32: what the game's
+// message pump pays for each kind of message it dispatches to the subclassed
+// window, next to the game's own WndProc called directly.
+//
+//   wndproc_bench
+//
+// "unclassified" is what every message paid before the message table: the
+// HighPollMouse check and a read of the view before anything looked at the
+// message id. Each row also counts the fake calls one message makes. Exits 1
+// if a passthrough message makes any fake call other than the CallWindowProc
+// that delivers it, if one arrives changed, or if a mouse message arrives
+// without being virtualized.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include <chrono>
+
+namespace {
+
+const int kIterations = 50000;
+const int kRounds = 5;
+const LONG kClientW = 1280, kClientH = 720;
+const LPARAM kMouseLParam = MAKELPARAM(640, 360);
+
+HWND g_gameHwnd = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+WNDPROC g_hookedProc = nullptr;
+
+// What the game last received.
+long g_delivered = 0;
+LPARAM g_lastLParam = 0;
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM lParam) {
+    g_delivered++;
+    g_lastLParam = lParam;
+    return 0;
+}
+
+// Hook_WndProc before the message table, for messages the switch ignores.
+LRESULT CALLBACK UnclassifiedWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    Trace(kTraceWndProc, TracePtr(hwnd), msg, (UINT64)wParam, (UINT64)lParam);
+    if (Cfg().highPollMouse && hwnd == g_hwnd) {
+        if (msg == WM_MOUSEMOVE) {
+            if (CoalesceMouseMove(wParam, lParam)) return 0;
+        }
+        else if (msg > WM_MOUSEMOVE && msg <= WM_MOUSELAST) {
+            FlushPendingMove(hwnd);
+        }
+    }
+    ViewTransform view;
+    if (ShouldVirtualizeWin32(hwnd, view) && msg >= WM_MOUSEFIRST && msg <= WM_XBUTTONDBLCLK &&
+        msg != WM_MOUSEWHEEL) {
+        lParam = MouseLParamToVirtual(view, lParam);
+    }
+    return CallWindowProc(g_origWndProc, hwnd, msg, wParam, lParam);
+}
+
+struct Message {
+    const char* name;
+    UINT msg;
+    WPARAM wParam;
+    LPARAM lParam;
+    MsgClass cls;
+};
+
+const Message kMessages[] = {
+    { "WM_TIMER", WM_TIMER, 1, 0, kMsgPassthrough },
+    { "WM_PAINT", WM_PAINT, 0, 0, kMsgPassthrough },
+    { "WM_NCHITTEST", WM_NCHITTEST, 0, MAKELPARAM(740, 460), kMsgPassthrough },
+    { "WM_KEYDOWN", WM_KEYDOWN, 'W', 0x00110001, kMsgPassthrough },
+    { "WM_CHAR", WM_CHAR, 'w', 0x00110001, kMsgPassthrough },
+    { "WM_IME_NOTIFY", WM_IME_NOTIFY, 0, 0, kMsgPassthrough },
+    { "WM_INPUT", WM_INPUT, 0, 0, kMsgPassthrough },
+    { "WM_USER+1", WM_USER + 1, 0, 0, kMsgPassthrough },
+    { "WM_APP+5", WM_APP + 5, 0, 0, kMsgPassthrough },
+    { "WM_MOUSEMOVE", WM_MOUSEMOVE, 0, kMouseLParam, kMsgMouseCoord },
+    { "WM_LBUTTONDOWN", WM_LBUTTONDOWN, MK_LBUTTON, kMouseLParam, kMsgMouseCoord },
+    { "WM_MOUSEWHEEL", WM_MOUSEWHEEL, MAKEWPARAM(0, WHEEL_DELTA), MAKELPARAM(740, 460), kMsgMouseOther },
+    { "WM_SETCURSOR", WM_SETCURSOR, 0, MAKELPARAM(HTCLIENT, WM_MOUSEMOVE), kMsgWindow },
+};
+
+const char* ClassName(MsgClass cls) {
+    switch (cls) {
+    case kMsgPassthrough: return "passthrough";
+    case kMsgMouseCoord: return "mouse";
+    case kMsgMouseOther: return "wheel";
+    case kMsgWindow: return "window";
+    }
+    return "?";
+}
+
+template <typename Fn>
+double NsPerMessage(Fn fn) {
+    double best = 1e30;
+    for (int r = 0; r < kRounds; r++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; i++) fn();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count()
+            / kIterations;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+// A game in steady state, as in detour_bench: an 800x600 backbuffer shown in
+// a 1280x720 client with the user32 virtualization on.
+void Setup() {
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, kClientW, kClientH, &GameProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    if (!CHECK(SUCCEEDED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev)))) CheckExit();
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+
+    InterlockedExchange(&g_win32VirtEnabled, 1);
+    FakeSendMessage(g_gameHwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(kClientW, kClientH));
+
+    g_hookedProc = FakeWindowProc(g_gameHwnd);
+    if (!CHECK(g_hookedProc == &Hook_WndProc)) CheckExit();
+    CHECK(g_origWndProc == &GameProc);
+
+    // Let the config watch thread park in its wait, so its startup calls
+    // don't land in a count below.
+    for (int i = 0; i < 1000 && FakeCallsNow()[kFakeWaitForMultipleObjects] == 0; i++) Sleep(1);
+}
+
+// Each message once through the pump: where it lands and what it costs in
+// fake calls.
+void Classes() {
+    for (const Message& m : kMessages) {
+        CHECK_EQ(ClassifyMessage(m.msg), m.cls);
+
+        const long delivered = g_delivered;
+        const FakeCallSnapshot before = FakeCallsNow();
+        FakeSendMessage(g_gameHwnd, m.msg, m.wParam, m.lParam);
+        const FakeCallSnapshot calls = FakeCallsNow() - before;
+
+        CHECK_EQ(g_delivered - delivered, 1);
+        CHECK_EQ(calls[kFakeCallWindowProc], 1);
+        if (m.cls == kMsgPassthrough) {
+            if (!CHECK_EQ(calls.Total(), 1)) FakePrintCalls(m.name, calls);
+            CHECK_EQ(g_lastLParam, m.lParam);
+        }
+        if (m.cls == kMsgMouseCoord) {
+            // 640,360 in the client is 400,300 in the backbuffer.
+            CHECK_EQ(g_lastLParam, MAKELPARAM(400, 300));
+        }
+    }
+}
+
+void Bench() {
+    printf("%-16s %-12s %9s %13s %9s  %s\n", "message", "class", "hooked ns", "unclassified", "direct",
+        "fake calls per message");
+    for (const Message& m : kMessages) {
+        auto hooked = [&] { g_hookedProc(g_gameHwnd, m.msg, m.wParam, m.lParam); };
+        auto unclassified = [&] { UnclassifiedWndProc(g_gameHwnd, m.msg, m.wParam, m.lParam); };
+        auto direct = [&] { g_origWndProc(g_gameHwnd, m.msg, m.wParam, m.lParam); };
+
+        for (int i = 0; i < 1000; i++) hooked();
+        const FakeCallSnapshot before = FakeCallsNow();
+        for (int i = 0; i < kIterations; i++) hooked();
+        const FakeCallSnapshot calls = FakeCallsNow() - before;
+
+        printf("%-16s %-12s %9.1f %13.1f %9.1f ", m.name, ClassName(m.cls), NsPerMessage(hooked),
+            NsPerMessage(unclassified), NsPerMessage(direct));
+        for (int api = 0; api < kFakeApiCount; api++) {
+            if (calls.n[api]) printf(" %s=%.2f", FakeApiName(api), (double)calls.n[api] / kIterations);
+        }
+        printf("\n");
+        if (m.cls == kMsgPassthrough) {
+            CHECK_EQ(calls.Total(), kIterations);
+            CHECK_EQ(calls[kFakeCallWindowProc], kIterations);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Setup);
+    RUN_STEP(Classes);
+    RUN_STEP(Bench);
+    CheckExit();
+}
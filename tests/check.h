@@ -0,0 +1,44 @@
+#pragma once
+// Minimal assertions for the proxy tests. A failed CHECK prints the location
+// and keeps going so one run reports every broken expectation; CheckExit()
+// ends the process with the verdict (through FakeExit, so the proxy's
+// background threads are not torn down under it).
+#include <cstdio>
+#include "fake_win32.h"
+
+inline int& CheckFailures() {
+    static int n = 0;
+    return n;
+}
+
+inline bool CheckReport(bool ok, const char* expr, const char* file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+        CheckFailures()++;
+    }
+    return ok;
+}
+
+inline bool CheckReportEq(long long a, long long b, const char* ea, const char* eb, const char* file, int line) {
+    if (a != b) {
+        fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", file, line, ea, eb, a, b);
+        CheckFailures()++;
+    }
+    return a == b;
+}
+
+#define CHECK(expr) CheckReport(!!(expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) CheckReportEq((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+
+// Runs one named step of a test and says so, to tell failures apart.
+#define RUN_STEP(fn) do { \
+        const int before_ = CheckFailures(); \
+        fn(); \
+        printf("%-40s %s\n", #fn, CheckFailures() == before_ ? "ok" : "FAILED"); \
+    } while (0)
+
+[[noreturn]] inline void CheckExit() {
+    if (CheckFailures()) fprintf(stderr, "%d check(s) failed\n", CheckFailures());
+    fflush(stdout);
+    FakeExit(CheckFailures() ? 1 : 0);
+}
@@ -0,0 +1,41 @@
+#include "fake_calls.h"
+
+#include <cstdio>
+
+std::atomic<long> g_fakeCalls[kFakeApiCount];
+
+static const char* const kFakeApiNames[kFakeApiCount] = {
+#define FAKE_API_NAME(name) #name,
+    FAKE_API_LIST(FAKE_API_NAME)
+#undef FAKE_API_NAME
+};
+
+const char* FakeApiName(int api) {
+    return (api >= 0 && api < kFakeApiCount) ? kFakeApiNames[api] : "?";
+}
+
+long FakeCallSnapshot::Total() const {
+    long sum = 0;
+    for (long v : n) sum += v;
+    return sum;
+}
+
+FakeCallSnapshot FakeCallsNow() {
+    FakeCallSnapshot s;
+    for (int i = 0; i < kFakeApiCount; i++) s.n[i] = g_fakeCalls[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+FakeCallSnapshot operator-(const FakeCallSnapshot& a, const FakeCallSnapshot& b) {
+    FakeCallSnapshot d;
+    for (int i = 0; i < kFakeApiCount; i++) d.n[i] = a.n[i] - b.n[i];
+    return d;
+}
+
+void FakePrintCalls(const char* label, const FakeCallSnapshot& delta) {
+    printf("%s:", label);
+    for (int i = 0; i < kFakeApiCount; i++) {
+        if (delta.n[i]) printf(" %s=%ld", kFakeApiNames[i], delta.n[i]);
+    }
+    printf("\n");
+}
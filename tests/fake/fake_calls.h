@@ -0,0 +1,69 @@
+#pragma once
+// Call counters for every fake Win32 / D3D9 / DirectInput entry point.
+//
+// Each fake bumps its counter on entry, so a test can state what a detour
+// costs in terms the real system charges for: "one Present and no
+// GetBackBuffer per frame", "no QueryPerformanceCounter in WndProc".
+#include <atomic>
+
+#define FAKE_API_LIST(X) \
+    /* kernel32 */ \
+    X(QueryPerformanceCounter) X(GetTickCount) X(Sleep) X(WaitForSingleObject) \
+    X(WaitForMultipleObjects) X(SetEvent) X(CreateThread) X(GetPrivateProfile) \
+    X(WritePrivateProfile) X(CreateFile) X(ReadFile) X(WriteFile) X(OutputDebugString) \
+    X(GetModuleHandle) X(GetProcAddress) X(LoadLibrary) X(SetWaitableTimer) \
+    X(TimeBeginPeriod) X(TimeEndPeriod) \
+    /* user32 */ \
+    X(GetClientRect) X(GetWindowRect) X(ScreenToClient) X(ClientToScreen) \
+    X(GetForegroundWindow) X(GetFocus) X(ClipCursor) X(GetClipCursor) X(SetCapture) \
+    X(ReleaseCapture) X(GetCapture) X(SetCursorPos) X(GetCursorPos) X(GetRawInputData) \
+    X(CallWindowProc) X(DefWindowProc) X(GetWindowLongPtr) X(SetWindowLongPtr) \
+    X(SetWindowPos) X(IsWindow) X(IsWindowVisible) X(IsIconic) X(EnumWindows) \
+    X(MonitorFromWindow) X(GetMonitorInfo) X(PostMessage) X(PeekMessage) \
+    X(ChangeDisplaySettings) X(GetDC) X(FillRect) \
+    /* IDirect3D9 */ \
+    X(D3DCreateDevice) X(D3DCreateDeviceEx) X(D3DQueryInterface) \
+    /* IDirect3DDevice9 */ \
+    X(DevQueryInterface) X(DevTestCooperativeLevel) X(DevGetCreationParameters) \
+    X(DevCreateAdditionalSwapChain) X(DevGetSwapChain) X(DevReset) X(DevPresent) \
+    X(DevGetBackBuffer) X(DevCreateTexture) X(DevCreateVolumeTexture) X(DevCreateCubeTexture) \
+    X(DevCreateVertexBuffer) X(DevCreateIndexBuffer) X(DevUpdateTexture) X(DevStretchRect) \
+    X(DevColorFill) X(DevSetRenderTarget) X(DevGetRenderTarget) X(DevSetViewport) \
+    X(DevGetViewport) X(DevCreateQuery) X(DevSetMaximumFrameLatency) X(DevResetEx) \
+    X(DevPresentEx) \
+    /* IDirect3DSwapChain9 and friends */ \
+    X(SwapPresent) X(SwapGetBackBuffer) X(SwapGetDevice) X(SwapGetPresentParameters) \
+    X(SurfGetDesc) X(SurfLock) X(SurfUnlock) X(TexLock) X(TexUnlock) X(TexAddDirty) \
+    X(TexGetLevel) X(BufLock) X(BufUnlock) X(QueryIssue) X(QueryGetData) \
+    /* DirectInput */ \
+    X(DInputCreateDevice) X(DiGetDeviceState) X(DiSetCooperativeLevel) X(DiPoll) \
+    X(DiAcquire) X(DiGetDeviceInfo)
+
+enum FakeApi {
+#define FAKE_API_ENUM(name) kFake##name,
+    FAKE_API_LIST(FAKE_API_ENUM)
+#undef FAKE_API_ENUM
+    kFakeApiCount
+};
+
+extern std::atomic<long> g_fakeCalls[kFakeApiCount];
+
+inline void FakeCount(FakeApi api) {
+    g_fakeCalls[api].fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* FakeApiName(int api);
+
+// A copy of every counter; subtracting two gives the calls made in between.
+struct FakeCallSnapshot {
+    long n[kFakeApiCount];
+
+    long operator[](FakeApi api) const { return n[api]; }
+    long Total() const;
+};
+
+FakeCallSnapshot FakeCallsNow();
+FakeCallSnapshot operator-(const FakeCallSnapshot& a, const FakeCallSnapshot& b);
+
+// Prints the nonzero entries of a delta as "name=N ..." on one line.
+void FakePrintCalls(const char* label, const FakeCallSnapshot& delta);
@@ -0,0 +1,1133 @@
+// d3d9.dll for running the proxy on Linux (see fake_d3d9.h).
+//
+// Objects are plain structs whose first member is the vtable pointer, the
+// layout COM gives them; methods are free functions taking the object first,
+// which is how the Itanium ABI passes `this`. A subobject (a texture level, a
+// backbuffer, the implicit swapchain) belongs to its owner: it starts with no
+// references, and while it has any it holds one on the owner.
+#include "fake_d3d9.h"
+#include "fake_calls.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+extern "C" {
+const GUID IID_IDirect3D9 = { 0x81bdcbca, 0x64d4, 0x426d, { 0xae, 0x8d, 0xad, 0x01, 0x47, 0xf4, 0x27, 0x5c } };
+const GUID IID_IDirect3D9Ex = { 0x02177241, 0x69fc, 0x400c, { 0x8f, 0xf1, 0x93, 0xa4, 0x4d, 0xf6, 0x86, 0x1d } };
+const GUID IID_IDirect3DDevice9 = { 0xd0223b96, 0xbf7a, 0x43fd, { 0x92, 0xbd, 0xa4, 0x3b, 0x0d, 0x82, 0xb9, 0xeb } };
+const GUID IID_IDirect3DDevice9Ex = { 0xb18b10ce, 0x2649, 0x405a, { 0x87, 0x0f, 0x95, 0xf7, 0x77, 0xd4, 0x31, 0x3a } };
+const GUID IID_IDirect3DSwapChain9 = { 0x794950f2, 0xadfc, 0x458a, { 0x90, 0x5e, 0x10, 0xa1, 0x0b, 0x0b, 0x50, 0x3b } };
+const GUID IID_IDirect3DTexture9 = { 0x85c31227, 0x3de5, 0x4f00, { 0x9b, 0x3a, 0xf1, 0x1a, 0xc3, 0x8c, 0x18, 0xb5 } };
+}
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// Vtables
+// -----------------------------------------------------------------------------
+
+enum Table {
+    kTableD3D, kTableDevice, kTableSwapChain, kTableSurface, kTableTexture, kTableCube,
+    kTableVolumeTexture, kTableVolume, kTableVertexBuffer, kTableIndexBuffer, kTableQuery,
+};
+
+const char* const kTableNames[] = {
+    "IDirect3D9Ex", "IDirect3DDevice9Ex", "IDirect3DSwapChain9", "IDirect3DSurface9",
+    "IDirect3DTexture9", "IDirect3DCubeTexture9", "IDirect3DVolumeTexture9", "IDirect3DVolume9",
+    "IDirect3DVertexBuffer9", "IDirect3DIndexBuffer9", "IDirect3DQuery9",
+};
+
+[[noreturn]] void Unimplemented(int table, int slot) {
+    fprintf(stderr, "fake d3d9: %s slot %d is not implemented\n", kTableNames[table], slot);
+    FakeExit(70);
+}
+
+template <int T, int Slot>
+HRESULT Unimpl(void*) {
+    Unimplemented(T, Slot);
+}
+
+template <int T, size_t... I>
+void FillUnimpl(void** vt, std::index_sequence<I...>) {
+    ((vt[I] = reinterpret_cast<void*>(&Unimpl<T, (int)I>)), ...);
+}
+
+#define FN(f) reinterpret_cast<void*>(&f)
+
+struct Slot {
+    int index;
+    void* fn;
+};
+
+template <int T, size_t N>
+void BuildTable(void* (&vt)[N], std::initializer_list<Slot> impl) {
+    FillUnimpl<T>(vt, std::make_index_sequence<N>());
+    for (const Slot& s : impl) vt[s.index] = s.fn;
+    FakeRegisterPatchSites(vt, N);
+}
+
+// -----------------------------------------------------------------------------
+// Objects
+// -----------------------------------------------------------------------------
+
+struct Object;
+using DestroyFn = void (*)(Object*);
+
+struct Object {
+    void** vtbl;
+    std::atomic<long> refs;
+    Object* owner;          // set: lifetime belongs to the owner
+    DestroyFn destroy;      // unowned objects only
+};
+
+std::atomic<int> g_live{ 0 };
+
+void AddRefObj(Object* o) {
+    if (o->refs.fetch_add(1) == 0 && o->owner) AddRefObj(o->owner);
+}
+
+ULONG ReleaseObj(Object* o) {
+    const long n = o->refs.fetch_sub(1) - 1;
+    if (n == 0) {
+        if (o->owner) ReleaseObj(o->owner);
+        else o->destroy(o);
+    }
+    return (ULONG)n;
+}
+
+template <typename T>
+T* NewObject(void** vtbl, Object* owner, DestroyFn destroy) {
+    T* o = new T();
+    o->vtbl = vtbl;
+    o->refs = owner ? 0 : 1;
+    o->owner = owner;
+    o->destroy = destroy;
+    g_live++;
+    return o;
+}
+
+template <typename T>
+void DeleteObject(T* o) {
+    if (!o) return;
+    g_live--;
+    delete o;
+}
+
+struct Device;
+
+struct D3D : Object {
+    bool ex;
+};
+
+struct Surface : Object {
+    D3DSURFACE_DESC desc;
+    std::vector<BYTE> bits;
+    bool locked;
+};
+
+struct Volume : Object {
+    D3DVOLUME_DESC desc;
+    std::vector<BYTE> bits;
+    bool locked;
+};
+
+struct SwapChain : Object {
+    Device* dev;            // reference held, unless this is the implicit chain
+    D3DPRESENT_PARAMETERS pp;
+    Surface* bb;            // owned
+};
+
+// Texture, cube texture or volume texture.
+struct Texture : Object {
+    Device* dev;            // reference held
+    D3DRESOURCETYPE type;
+    UINT w, h, d, levels;
+    DWORD usage;
+    D3DFORMAT format;
+    D3DPOOL pool;
+    std::vector<Object*> subs;   // owned; cube textures: face * levels + level
+};
+
+struct Buffer : Object {
+    Device* dev;
+    D3DRESOURCETYPE type;
+    UINT length;
+    DWORD usage;
+    D3DPOOL pool;
+    DWORD lastLockFlags;
+    std::vector<BYTE> data;
+};
+
+struct Query : Object {
+    Device* dev;
+    int pending;
+};
+
+struct Device : Object {
+    D3D* d3d;               // reference held
+    bool ex;
+    D3DDEVICE_CREATION_PARAMETERS cp;
+    SwapChain* chain;       // implicit, owned
+    Surface* rt0;           // no reference held
+    D3DVIEWPORT9 vp;
+    int defaultResources;
+    UINT maxLatency;
+};
+
+void* g_d3dVtbl[22];
+void* g_deviceVtbl[134];
+void* g_swapChainVtbl[10];
+void* g_surfaceVtbl[17];
+void* g_textureVtbl[22];
+void* g_cubeVtbl[22];
+void* g_volumeTextureVtbl[22];
+void* g_volumeVtbl[11];
+void* g_vertexBufferVtbl[14];
+void* g_indexBufferVtbl[14];
+void* g_queryVtbl[8];
+
+FakePresentCall g_lastPresent{};
+std::atomic<int> g_failSwapChains{ 0 };
+std::atomic<int> g_queryLatency{ 0 };
+std::atomic<bool> g_disableEx{ false };
+
+Device* Dev(IDirect3DDevice9* d) { return reinterpret_cast<Device*>(d); }
+
+UINT MipCount(UINT w, UINT h, UINT d) {
+    UINT n = 1;
+    for (UINT m = (std::max)((std::max)(w, h), d); m > 1; m >>= 1) n++;
+    return n;
+}
+
+UINT LevelSize(UINT size, UINT level) {
+    const UINT s = size >> level;
+    return s ? s : 1;
+}
+
+void TrackDefault(Device* dev, D3DPOOL pool, int delta) {
+    if (pool == D3DPOOL_DEFAULT) dev->defaultResources += delta;
+}
+
+// --- IUnknown ----------------------------------------------------------------
+
+HRESULT NoInterface(Object*, REFIID, void** out) {
+    if (out) *out = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG AddRef(Object* self) {
+    AddRefObj(self);
+    return (ULONG)self->refs.load();
+}
+
+ULONG Release(Object* self) {
+    return ReleaseObj(self);
+}
+
+// All three texture types go through this one, as they do in the runtime.
+ULONG TexRelease(Object* self) {
+    Texture* t = static_cast<Texture*>(self);
+    if (t->type != D3DRTYPE_TEXTURE && t->type != D3DRTYPE_CUBETEXTURE && t->type != D3DRTYPE_VOLUMETEXTURE) {
+        Unimplemented(kTableTexture, 2);
+    }
+    return ReleaseObj(self);
+}
+
+// --- IDirect3DSurface9 / IDirect3DVolume9 --------------------------------------
+
+Surface* NewSurface(Object* owner, UINT w, UINT h, D3DFORMAT fmt, DWORD usage, D3DPOOL pool) {
+    Surface* s = NewObject<Surface>(g_surfaceVtbl, owner, nullptr);
+    s->desc = D3DSURFACE_DESC{ fmt, D3DRTYPE_SURFACE, usage, pool, D3DMULTISAMPLE_NONE, 0, w, h };
+    s->locked = false;
+    return s;
+}
+
+HRESULT SurfGetDesc(Surface* self, D3DSURFACE_DESC* desc) {
+    FakeCount(kFakeSurfGetDesc);
+    if (!desc) return D3DERR_INVALIDCALL;
+    *desc = self->desc;
+    return D3D_OK;
+}
+
+HRESULT SurfLockRect(Surface* self, D3DLOCKED_RECT* locked, const RECT*, DWORD) {
+    FakeCount(kFakeSurfLock);
+    if (!locked || self->locked) return D3DERR_INVALIDCALL;
+    const size_t pitch = (size_t)self->desc.Width * 4;
+    if (self->bits.empty()) self->bits.resize(pitch * self->desc.Height);
+    locked->Pitch = (INT)pitch;
+    locked->pBits = self->bits.data();
+    self->locked = true;
+    return D3D_OK;
+}
+
+HRESULT SurfUnlockRect(Surface* self) {
+    FakeCount(kFakeSurfUnlock);
+    if (!self->locked) return D3DERR_INVALIDCALL;
+    self->locked = false;
+    return D3D_OK;
+}
+
+HRESULT SurfGetDC(Surface* self, HDC* dc) {
+    if (!dc || self->locked) return D3DERR_INVALIDCALL;
+    *dc = reinterpret_cast<HDC>(self);
+    self->locked = true;
+    return D3D_OK;
+}
+
+HRESULT SurfReleaseDC(Surface* self, HDC dc) {
+    if (dc != reinterpret_cast<HDC>(self) || !self->locked) return D3DERR_INVALIDCALL;
+    self->locked = false;
+    return D3D_OK;
+}
+
+D3DRESOURCETYPE SurfGetType(Surface*) {
+    return D3DRTYPE_SURFACE;
+}
+
+Volume* NewVolume(Object* owner, UINT w, UINT h, UINT d, D3DFORMAT fmt, D3DPOOL pool) {
+    Volume* v = NewObject<Volume>(g_volumeVtbl, owner, nullptr);
+    v->desc = D3DVOLUME_DESC{ fmt, D3DRTYPE_VOLUME, 0, pool, w, h, d };
+    v->locked = false;
+    return v;
+}
+
+HRESULT VolumeGetDesc(Volume* self, D3DVOLUME_DESC* desc) {
+    if (!desc) return D3DERR_INVALIDCALL;
+    *desc = self->desc;
+    return D3D_OK;
+}
+
+HRESULT VolumeLockBox(Volume* self, D3DLOCKED_BOX* locked, const D3DBOX*, DWORD) {
+    FakeCount(kFakeSurfLock);
+    if (!locked || self->locked) return D3DERR_INVALIDCALL;
+    const size_t row = (size_t)self->desc.Width * 4;
+    const size_t slice = row * self->desc.Height;
+    if (self->bits.empty()) self->bits.resize(slice * self->desc.Depth);
+    locked->RowPitch = (INT)row;
+    locked->SlicePitch = (INT)slice;
+    locked->pBits = self->bits.data();
+    self->locked = true;
+    return D3D_OK;
+}
+
+HRESULT VolumeUnlockBox(Volume* self) {
+    FakeCount(kFakeSurfUnlock);
+    if (!self->locked) return D3DERR_INVALIDCALL;
+    self->locked = false;
+    return D3D_OK;
+}
+
+// --- textures ------------------------------------------------------------------
+
+void DestroyTexture(Object* o) {
+    Texture* t = static_cast<Texture*>(o);
+    for (Object* sub : t->subs) {
+        if (t->type == D3DRTYPE_VOLUMETEXTURE) DeleteObject(static_cast<Volume*>(sub));
+        else DeleteObject(static_cast<Surface*>(sub));
+    }
+    TrackDefault(t->dev, t->pool, -1);
+    Device* dev = t->dev;
+    DeleteObject(t);
+    ReleaseObj(dev);
+}
+
+Texture* NewTexture(Device* dev, D3DRESOURCETYPE type, UINT w, UINT h, UINT d, UINT levels,
+    DWORD usage, D3DFORMAT fmt, D3DPOOL pool)
+{
+    void** vtbl = type == D3DRTYPE_TEXTURE ? g_textureVtbl
+        : type == D3DRTYPE_CUBETEXTURE ? g_cubeVtbl : g_volumeTextureVtbl;
+    Texture* t = NewObject<Texture>(vtbl, nullptr, &DestroyTexture);
+    t->dev = dev;
+    t->type = type;
+    t->w = w;
+    t->h = h;
+    t->d = d;
+    t->levels = (usage & D3DUSAGE_AUTOGENMIPMAP) ? 1 : levels ? levels : MipCount(w, h, d);
+    t->usage = usage;
+    t->format = fmt;
+    t->pool = pool;
+
+    const UINT faces = type == D3DRTYPE_CUBETEXTURE ? 6 : 1;
+    for (UINT f = 0; f < faces; f++) {
+        for (UINT l = 0; l < t->levels; l++) {
+            if (type == D3DRTYPE_VOLUMETEXTURE) {
+                t->subs.push_back(NewVolume(t, LevelSize(w, l), LevelSize(h, l), LevelSize(d, l), fmt, pool));
+            }
+            else {
+                t->subs.push_back(NewSurface(t, LevelSize(w, l), LevelSize(h, l), fmt, usage, pool));
+            }
+        }
+    }
+
+    AddRefObj(dev);
+    TrackDefault(dev, pool, +1);
+    return t;
+}
+
+Object* Sub(Texture* t, UINT face, UINT level) {
+    if (level >= t->levels || face >= (t->type == D3DRTYPE_CUBETEXTURE ? 6u : 1u)) return nullptr;
+    return t->subs[face * t->levels + level];
+}
+
+DWORD TexGetLevelCount(Texture* self) {
+    return self->levels;
+}
+
+HRESULT TexGetLevelDesc(Texture* self, UINT level, D3DSURFACE_DESC* desc) {
+    Object* s = Sub(self, 0, level);
+    if (!s || !desc) return D3DERR_INVALIDCALL;
+    *desc = static_cast<Surface*>(s)->desc;
+    return D3D_OK;
+}
+
+HRESULT TexGetSurfaceLevel(Texture* self, UINT level, IDirect3DSurface9** out) {
+    FakeCount(kFakeTexGetLevel);
+    Object* s = Sub(self, 0, level);
+    if (!s || !out) return D3DERR_INVALIDCALL;
+    AddRefObj(s);
+    *out = reinterpret_cast<IDirect3DSurface9*>(s);
+    return D3D_OK;
+}
+
+HRESULT TexLockRect(Texture* self, UINT level, D3DLOCKED_RECT* locked, const RECT* rect, DWORD flags) {
+    FakeCount(kFakeTexLock);
+    Object* s = Sub(self, 0, level);
+    if (!s) return D3DERR_INVALIDCALL;
+    return SurfLockRect(static_cast<Surface*>(s), locked, rect, flags);
+}
+
+HRESULT TexUnlockRect(Texture* self, UINT level) {
+    FakeCount(kFakeTexUnlock);
+    Object* s = Sub(self, 0, level);
+    if (!s) return D3DERR_INVALIDCALL;
+    return SurfUnlockRect(static_cast<Surface*>(s));
+}
+
+HRESULT TexAddDirtyRect(Texture* self, const RECT*) {
+    FakeCount(kFakeTexAddDirty);
+    return self->pool == D3DPOOL_DEFAULT ? D3DERR_INVALIDCALL : D3D_OK;
+}
+
+HRESULT CubeGetLevelDesc(Texture* self, UINT level, D3DSURFACE_DESC* desc) {
+    Object* s = Sub(self, 0, level);
+    if (!s || !desc) return D3DERR_INVALIDCALL;
+    *desc = static_cast<Surface*>(s)->desc;
+    return D3D_OK;
+}
+
+HRESULT CubeGetSurface(Texture* self, D3DCUBEMAP_FACES face, UINT level, IDirect3DSurface9** out) {
+    FakeCount(kFakeTexGetLevel);
+    Object* s = Sub(self, (UINT)face, level);
+    if (!s || !out) return D3DERR_INVALIDCALL;
+    AddRefObj(s);
+    *out = reinterpret_cast<IDirect3DSurface9*>(s);
+    return D3D_OK;
+}
+
+HRESULT CubeLockRect(Texture* self, D3DCUBEMAP_FACES face, UINT level, D3DLOCKED_RECT* locked,
+    const RECT* rect, DWORD flags)
+{
+    FakeCount(kFakeTexLock);
+    Object* s = Sub(self, (UINT)face, level);
+    if (!s) return D3DERR_INVALIDCALL;
+    return SurfLockRect(static_cast<Surface*>(s), locked, rect, flags);
+}
+
+HRESULT CubeUnlockRect(Texture* self, D3DCUBEMAP_FACES face, UINT level) {
+    FakeCount(kFakeTexUnlock);
+    Object* s = Sub(self, (UINT)face, level);
+    if (!s) return D3DERR_INVALIDCALL;
+    return SurfUnlockRect(static_cast<Surface*>(s));
+}
+
+HRESULT CubeAddDirtyRect(Texture* self, D3DCUBEMAP_FACES face, const RECT*) {
+    FakeCount(kFakeTexAddDirty);
+    if ((UINT)face >= 6 || self->pool == D3DPOOL_DEFAULT) return D3DERR_INVALIDCALL;
+    return D3D_OK;
+}
+
+HRESULT VolGetLevelDesc(Texture* self, UINT level, D3DVOLUME_DESC* desc) {
+    Object* v = Sub(self, 0, level);
+    if (!v || !desc) return D3DERR_INVALIDCALL;
+    *desc = static_cast<Volume*>(v)->desc;
+    return D3D_OK;
+}
+
+HRESULT VolGetVolumeLevel(Texture* self, UINT level, IDirect3DVolume9** out) {
+    FakeCount(kFakeTexGetLevel);
+    Object* v = Sub(self, 0, level);
+    if (!v || !out) return D3DERR_INVALIDCALL;
+    AddRefObj(v);
+    *out = reinterpret_cast<IDirect3DVolume9*>(v);
+    return D3D_OK;
+}
+
+HRESULT VolLockBox(Texture* self, UINT level, D3DLOCKED_BOX* locked, const D3DBOX* box, DWORD flags) {
+    FakeCount(kFakeTexLock);
+    Object* v = Sub(self, 0, level);
+    if (!v) return D3DERR_INVALIDCALL;
+    return VolumeLockBox(static_cast<Volume*>(v), locked, box, flags);
+}
+
+HRESULT VolUnlockBox(Texture* self, UINT level) {
+    FakeCount(kFakeTexUnlock);
+    Object* v = Sub(self, 0, level);
+    if (!v) return D3DERR_INVALIDCALL;
+    return VolumeUnlockBox(static_cast<Volume*>(v));
+}
+
+HRESULT VolAddDirtyBox(Texture* self, const D3DBOX*) {
+    FakeCount(kFakeTexAddDirty);
+    return self->pool == D3DPOOL_DEFAULT ? D3DERR_INVALIDCALL : D3D_OK;
+}
+
+// --- vertex and index buffers --------------------------------------------------
+
+void DestroyBuffer(Object* o) {
+    Buffer* b = static_cast<Buffer*>(o);
+    TrackDefault(b->dev, b->pool, -1);
+    Device* dev = b->dev;
+    DeleteObject(b);
+    ReleaseObj(dev);
+}
+
+Buffer* NewBuffer(Device* dev, D3DRESOURCETYPE type, UINT length, DWORD usage, D3DPOOL pool) {
+    Buffer* b = NewObject<Buffer>(type == D3DRTYPE_VERTEXBUFFER ? g_vertexBufferVtbl : g_indexBufferVtbl,
+        nullptr, &DestroyBuffer);
+    b->dev = dev;
+    b->type = type;
+    b->length = length;
+    b->usage = usage;
+    b->pool = pool;
+    AddRefObj(dev);
+    TrackDefault(dev, pool, +1);
+    return b;
+}
+
+// DISCARD and NOOVERWRITE are only valid on DYNAMIC buffers.
+HRESULT BufLock(Buffer* self, UINT offset, UINT size, void** out, DWORD flags) {
+    FakeCount(kFakeBufLock);
+    if (!out || offset > self->length) return D3DERR_INVALIDCALL;
+    if ((flags & (D3DLOCK_DISCARD | D3DLOCK_NOOVERWRITE)) && !(self->usage & D3DUSAGE_DYNAMIC)) {
+        return D3DERR_INVALIDCALL;
+    }
+    if (self->data.empty()) self->data.resize(self->length);
+    (void)size;
+    self->lastLockFlags = flags;
+    *out = self->data.data() + offset;
+    return D3D_OK;
+}
+
+HRESULT BufUnlock(Buffer*) {
+    FakeCount(kFakeBufUnlock);
+    return D3D_OK;
+}
+
+HRESULT VertexBufGetDesc(Buffer* self, D3DVERTEXBUFFER_DESC* desc) {
+    if (!desc) return D3DERR_INVALIDCALL;
+    *desc = D3DVERTEXBUFFER_DESC{ D3DFMT_UNKNOWN, self->type, self->usage, self->pool, self->length, 0 };
+    return D3D_OK;
+}
+
+HRESULT IndexBufGetDesc(Buffer* self, D3DINDEXBUFFER_DESC* desc) {
+    if (!desc) return D3DERR_INVALIDCALL;
+    *desc = D3DINDEXBUFFER_DESC{ D3DFMT_INDEX16, self->type, self->usage, self->pool, self->length };
+    return D3D_OK;
+}
+
+// --- IDirect3DQuery9 ---------------------------------------------------------
+
+void DestroyQuery(Object* o) {
+    Query* q = static_cast<Query*>(o);
+    Device* dev = q->dev;
+    DeleteObject(q);
+    ReleaseObj(dev);
+}
+
+D3DQUERYTYPE QueryGetType(Query*) {
+    return D3DQUERYTYPE_EVENT;
+}
+
+DWORD QueryGetDataSize(Query*) {
+    return sizeof(BOOL);
+}
+
+HRESULT QueryIssue(Query* self, DWORD flags) {
+    FakeCount(kFakeQueryIssue);
+    if (flags != D3DISSUE_END) return D3DERR_INVALIDCALL;
+    self->pending = g_queryLatency.load();
+    return D3D_OK;
+}
+
+HRESULT QueryGetData(Query* self, void* data, DWORD size, DWORD) {
+    FakeCount(kFakeQueryGetData);
+    if (self->pending > 0) {
+        self->pending--;
+        return S_FALSE;
+    }
+    if (data && size >= sizeof(BOOL)) *static_cast<BOOL*>(data) = TRUE;
+    return S_OK;
+}
+
+// --- IDirect3DSwapChain9 -------------------------------------------------------
+
+void RecordPresent(void* self, bool viaSwapChain, const RECT* src, const RECT* dst, HWND hwnd) {
+    g_lastPresent.count++;
+    g_lastPresent.self = self;
+    g_lastPresent.viaSwapChain = viaSwapChain;
+    g_lastPresent.hasSrc = src != nullptr;
+    g_lastPresent.hasDst = dst != nullptr;
+    g_lastPresent.src = src ? *src : RECT{};
+    g_lastPresent.dst = dst ? *dst : RECT{};
+    g_lastPresent.hwnd = hwnd;
+}
+
+// Flip model presents the whole backbuffer to the whole client area.
+HRESULT CheckPresentRects(const D3DPRESENT_PARAMETERS& pp, const RECT* src, const RECT* dst) {
+    if (pp.SwapEffect == D3DSWAPEFFECT_FLIPEX && (src || dst)) return D3DERR_INVALIDCALL;
+    return D3D_OK;
+}
+
+// Resolves the sizes the runtime fills in: zero width/height take the client
+// size of the device window.
+void FillPresentParameters(D3DPRESENT_PARAMETERS& pp, HWND focus) {
+    const HWND wnd = pp.hDeviceWindow ? pp.hDeviceWindow : focus;
+    if (pp.Windowed && (pp.BackBufferWidth == 0 || pp.BackBufferHeight == 0) && wnd) {
+        const SIZE client = FakeClientSize(wnd);
+        if (pp.BackBufferWidth == 0) pp.BackBufferWidth = (UINT)client.cx;
+        if (pp.BackBufferHeight == 0) pp.BackBufferHeight = (UINT)client.cy;
+    }
+    if (pp.BackBufferWidth == 0) pp.BackBufferWidth = 1;
+    if (pp.BackBufferHeight == 0) pp.BackBufferHeight = 1;
+    if (pp.BackBufferFormat == D3DFMT_UNKNOWN) pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    if (pp.BackBufferCount == 0) pp.BackBufferCount = 1;
+}
+
+SwapChain* NewSwapChain(Device* dev, Object* owner, DestroyFn destroy, const D3DPRESENT_PARAMETERS& pp) {
+    SwapChain* sc = NewObject<SwapChain>(g_swapChainVtbl, owner, destroy);
+    sc->dev = dev;
+    sc->pp = pp;
+    sc->bb = NewSurface(sc, pp.BackBufferWidth, pp.BackBufferHeight, pp.BackBufferFormat,
+        D3DUSAGE_RENDERTARGET, D3DPOOL_DEFAULT);
+    return sc;
+}
+
+void DestroyAdditionalSwapChain(Object* o) {
+    SwapChain* sc = static_cast<SwapChain*>(o);
+    Device* dev = sc->dev;
+    DeleteObject(sc->bb);
+    DeleteObject(sc);
+    dev->defaultResources--;
+    ReleaseObj(dev);
+}
+
+HRESULT SwapPresent(SwapChain* self, const RECT* src, const RECT* dst, HWND hwnd, const RGNDATA*, DWORD) {
+    FakeCount(kFakeSwapPresent);
+    RecordPresent(self, true, src, dst, hwnd);
+    return CheckPresentRects(self->pp, src, dst);
+}
+
+HRESULT SwapGetBackBuffer(SwapChain* self, UINT index, D3DBACKBUFFER_TYPE, IDirect3DSurface9** out) {
+    FakeCount(kFakeSwapGetBackBuffer);
+    if (!out || index >= self->pp.BackBufferCount) return D3DERR_INVALIDCALL;
+    AddRefObj(self->bb);
+    *out = reinterpret_cast<IDirect3DSurface9*>(self->bb);
+    return D3D_OK;
+}
+
+HRESULT SwapGetDevice(SwapChain* self, IDirect3DDevice9** out) {
+    FakeCount(kFakeSwapGetDevice);
+    if (!out) return D3DERR_INVALIDCALL;
+    AddRefObj(self->dev);
+    *out = reinterpret_cast<IDirect3DDevice9*>(self->dev);
+    return D3D_OK;
+}
+
+HRESULT SwapGetPresentParameters(SwapChain* self, D3DPRESENT_PARAMETERS* pp) {
+    FakeCount(kFakeSwapGetPresentParameters);
+    if (!pp) return D3DERR_INVALIDCALL;
+    *pp = self->pp;
+    return D3D_OK;
+}
+
+// --- IDirect3DDevice9Ex ------------------------------------------------------
+
+void SetFullViewport(Device* dev, const Surface* rt) {
+    dev->vp = D3DVIEWPORT9{ 0, 0, rt->desc.Width, rt->desc.Height, 0.0f, 1.0f };
+}
+
+void DestroyDevice(Object* o) {
+    Device* dev = static_cast<Device*>(o);
+    DeleteObject(dev->chain->bb);
+    DeleteObject(dev->chain);
+    D3D* d3d = dev->d3d;
+    DeleteObject(dev);
+    ReleaseObj(d3d);
+}
+
+HRESULT DevQueryInterface(Device* self, REFIID iid, void** out) {
+    FakeCount(kFakeDevQueryInterface);
+    if (!out) return E_POINTER;
+    *out = nullptr;
+    if (iid == IID_IDirect3DDevice9 || (self->ex && iid == IID_IDirect3DDevice9Ex)) {
+        AddRefObj(self);
+        *out = self;
+        return S_OK;
+    }
+    return E_NOINTERFACE;
+}
+
+HRESULT DevTestCooperativeLevel(Device*) {
+    FakeCount(kFakeDevTestCooperativeLevel);
+    return D3D_OK;
+}
+
+HRESULT DevGetDirect3D(Device* self, IDirect3D9** out) {
+    if (!out) return D3DERR_INVALIDCALL;
+    AddRefObj(self->d3d);
+    *out = reinterpret_cast<IDirect3D9*>(self->d3d);
+    return D3D_OK;
+}
+
+HRESULT DevGetCreationParameters(Device* self, D3DDEVICE_CREATION_PARAMETERS* cp) {
+    FakeCount(kFakeDevGetCreationParameters);
+    if (!cp) return D3DERR_INVALIDCALL;
+    *cp = self->cp;
+    return D3D_OK;
+}
+
+HRESULT DevCreateAdditionalSwapChain(Device* self, D3DPRESENT_PARAMETERS* pp, IDirect3DSwapChain9** out) {
+    FakeCount(kFakeDevCreateAdditionalSwapChain);
+    if (!pp || !out || !pp->Windowed) return D3DERR_INVALIDCALL;
+    if (g_failSwapChains.load() > 0) {
+        g_failSwapChains--;
+        return D3DERR_OUTOFVIDEOMEMORY;
+    }
+
+    FillPresentParameters(*pp, self->cp.hFocusWindow);
+    SwapChain* sc = NewSwapChain(self, nullptr, &DestroyAdditionalSwapChain, *pp);
+    AddRefObj(self);
+    self->defaultResources++;
+    *out = reinterpret_cast<IDirect3DSwapChain9*>(sc);
+    return D3D_OK;
+}
+
+HRESULT DevGetSwapChain(Device* self, UINT index, IDirect3DSwapChain9** out) {
+    FakeCount(kFakeDevGetSwapChain);
+    if (!out || index != 0) return D3DERR_INVALIDCALL;
+    AddRefObj(self->chain);
+    *out = reinterpret_cast<IDirect3DSwapChain9*>(self->chain);
+    return D3D_OK;
+}
+
+UINT DevGetNumberOfSwapChains(Device*) {
+    return 1;
+}
+
+HRESULT ResetDevice(Device* self, D3DPRESENT_PARAMETERS* pp) {
+    if (!pp) return D3DERR_INVALIDCALL;
+    if (pp->SwapEffect == D3DSWAPEFFECT_FLIPEX && !self->ex) return D3DERR_INVALIDCALL;
+
+    FillPresentParameters(*pp, self->cp.hFocusWindow);
+    SwapChain* sc = self->chain;
+    sc->pp = *pp;
+    sc->bb->desc.Width = pp->BackBufferWidth;
+    sc->bb->desc.Height = pp->BackBufferHeight;
+    sc->bb->desc.Format = pp->BackBufferFormat;
+    sc->bb->bits.clear();
+    self->rt0 = sc->bb;
+    SetFullViewport(self, sc->bb);
+    return D3D_OK;
+}
+
+HRESULT DevReset(Device* self, D3DPRESENT_PARAMETERS* pp) {
+    FakeCount(kFakeDevReset);
+    if (!self->ex && self->defaultResources > 0) return D3DERR_INVALIDCALL;
+    return ResetDevice(self, pp);
+}
+
+HRESULT DevPresent(Device* self, const RECT* src, const RECT* dst, HWND hwnd, const RGNDATA*) {
+    FakeCount(kFakeDevPresent);
+    RecordPresent(self, false, src, dst, hwnd);
+    return CheckPresentRects(self->chain->pp, src, dst);
+}
+
+HRESULT DevGetBackBuffer(Device* self, UINT swapChain, UINT index, D3DBACKBUFFER_TYPE, IDirect3DSurface9** out) {
+    FakeCount(kFakeDevGetBackBuffer);
+    if (!out || swapChain != 0 || index >= self->chain->pp.BackBufferCount) return D3DERR_INVALIDCALL;
+    AddRefObj(self->chain->bb);
+    *out = reinterpret_cast<IDirect3DSurface9*>(self->chain->bb);
+    return D3D_OK;
+}
+
+HRESULT CheckPool(Device* self, D3DPOOL pool) {
+    return (self->ex && pool == D3DPOOL_MANAGED) ? D3DERR_INVALIDCALL : D3D_OK;
+}
+
+HRESULT DevCreateTexture(Device* self, UINT w, UINT h, UINT levels, DWORD usage, D3DFORMAT fmt, D3DPOOL pool,
+    IDirect3DTexture9** out, HANDLE*)
+{
+    FakeCount(kFakeDevCreateTexture);
+    if (!out || !w || !h || FAILED(CheckPool(self, pool))) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3DTexture9*>(NewTexture(self, D3DRTYPE_TEXTURE, w, h, 1, levels, usage, fmt, pool));
+    return D3D_OK;
+}
+
+HRESULT DevCreateVolumeTexture(Device* self, UINT w, UINT h, UINT d, UINT levels, DWORD usage, D3DFORMAT fmt,
+    D3DPOOL pool, IDirect3DVolumeTexture9** out, HANDLE*)
+{
+    FakeCount(kFakeDevCreateVolumeTexture);
+    if (!out || !w || !h || !d || FAILED(CheckPool(self, pool))) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3DVolumeTexture9*>(
+        NewTexture(self, D3DRTYPE_VOLUMETEXTURE, w, h, d, levels, usage, fmt, pool));
+    return D3D_OK;
+}
+
+HRESULT DevCreateCubeTexture(Device* self, UINT edge, UINT levels, DWORD usage, D3DFORMAT fmt, D3DPOOL pool,
+    IDirect3DCubeTexture9** out, HANDLE*)
+{
+    FakeCount(kFakeDevCreateCubeTexture);
+    if (!out || !edge || FAILED(CheckPool(self, pool))) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3DCubeTexture9*>(
+        NewTexture(self, D3DRTYPE_CUBETEXTURE, edge, edge, 1, levels, usage, fmt, pool));
+    return D3D_OK;
+}
+
+HRESULT DevCreateVertexBuffer(Device* self, UINT length, DWORD usage, DWORD, D3DPOOL pool,
+    IDirect3DVertexBuffer9** out, HANDLE*)
+{
+    FakeCount(kFakeDevCreateVertexBuffer);
+    if (!out || !length || FAILED(CheckPool(self, pool))) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3DVertexBuffer9*>(NewBuffer(self, D3DRTYPE_VERTEXBUFFER, length, usage, pool));
+    return D3D_OK;
+}
+
+HRESULT DevCreateIndexBuffer(Device* self, UINT length, DWORD usage, D3DFORMAT, D3DPOOL pool,
+    IDirect3DIndexBuffer9** out, HANDLE*)
+{
+    FakeCount(kFakeDevCreateIndexBuffer);
+    if (!out || !length || FAILED(CheckPool(self, pool))) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3DIndexBuffer9*>(NewBuffer(self, D3DRTYPE_INDEXBUFFER, length, usage, pool));
+    return D3D_OK;
+}
+
+// The runtime only copies SYSTEMMEM into DEFAULT.
+HRESULT DevUpdateTexture(Device*, Texture* src, Texture* dst) {
+    FakeCount(kFakeDevUpdateTexture);
+    if (!src || !dst || src->type != dst->type) return D3DERR_INVALIDCALL;
+    if (src->pool != D3DPOOL_SYSTEMMEM || dst->pool != D3DPOOL_DEFAULT) return D3DERR_INVALIDCALL;
+    return D3D_OK;
+}
+
+HRESULT DevStretchRect(Device*, Surface* src, const RECT*, Surface* dst, const RECT*, D3DTEXTUREFILTERTYPE) {
+    FakeCount(kFakeDevStretchRect);
+    if (!src || !dst || src == dst) return D3DERR_INVALIDCALL;
+    return D3D_OK;
+}
+
+HRESULT DevColorFill(Device*, Surface* surf, const RECT*, D3DCOLOR) {
+    FakeCount(kFakeDevColorFill);
+    if (!surf || surf->desc.Pool != D3DPOOL_DEFAULT) return D3DERR_INVALIDCALL;
+    return D3D_OK;
+}
+
+// Setting render target 0 resets the viewport to cover it.
+HRESULT DevSetRenderTarget(Device* self, DWORD index, Surface* rt) {
+    FakeCount(kFakeDevSetRenderTarget);
+    if (index != 0) return D3D_OK;  // only render target 0 is tracked
+    if (!rt) return D3DERR_INVALIDCALL;
+    self->rt0 = rt;
+    SetFullViewport(self, rt);
+    return D3D_OK;
+}
+
+HRESULT DevGetRenderTarget(Device* self, DWORD index, IDirect3DSurface9** out) {
+    FakeCount(kFakeDevGetRenderTarget);
+    if (!out || index != 0 || !self->rt0) return D3DERR_INVALIDCALL;
+    AddRefObj(self->rt0);
+    *out = reinterpret_cast<IDirect3DSurface9*>(self->rt0);
+    return D3D_OK;
+}
+
+// Like the runtime, a viewport reaching outside render target 0 is refused.
+HRESULT DevSetViewport(Device* self, const D3DVIEWPORT9* vp) {
+    FakeCount(kFakeDevSetViewport);
+    if (!vp) return D3DERR_INVALIDCALL;
+    if (self->rt0) {
+        const D3DSURFACE_DESC& d = self->rt0->desc;
+        if ((UINT64)vp->X + vp->Width > d.Width || (UINT64)vp->Y + vp->Height > d.Height) return D3DERR_INVALIDCALL;
+    }
+    self->vp = *vp;
+    return D3D_OK;
+}
+
+HRESULT DevGetViewport(Device* self, D3DVIEWPORT9* vp) {
+    FakeCount(kFakeDevGetViewport);
+    if (!vp) return D3DERR_INVALIDCALL;
+    *vp = self->vp;
+    return D3D_OK;
+}
+
+HRESULT DevBeginScene(Device*) {
+    return D3D_OK;
+}
+
+HRESULT DevEndScene(Device*) {
+    return D3D_OK;
+}
+
+HRESULT DevCreateQuery(Device* self, D3DQUERYTYPE type, IDirect3DQuery9** out) {
+    FakeCount(kFakeDevCreateQuery);
+    if (type != D3DQUERYTYPE_EVENT) return D3DERR_NOTAVAILABLE;
+    if (!out) return D3D_OK;  // support check
+
+    Query* q = NewObject<Query>(g_queryVtbl, nullptr, &DestroyQuery);
+    q->dev = self;
+    q->pending = 0;
+    AddRefObj(self);
+    *out = reinterpret_cast<IDirect3DQuery9*>(q);
+    return D3D_OK;
+}
+
+HRESULT DevPresentEx(Device* self, const RECT* src, const RECT* dst, HWND hwnd, const RGNDATA*, DWORD) {
+    FakeCount(kFakeDevPresentEx);
+    RecordPresent(self, false, src, dst, hwnd);
+    return CheckPresentRects(self->chain->pp, src, dst);
+}
+
+HRESULT DevSetMaximumFrameLatency(Device* self, UINT n) {
+    FakeCount(kFakeDevSetMaximumFrameLatency);
+    if (n > 16) return D3DERR_INVALIDCALL;
+    self->maxLatency = n;
+    return D3D_OK;
+}
+
+HRESULT DevGetMaximumFrameLatency(Device* self, UINT* n) {
+    if (!n) return D3DERR_INVALIDCALL;
+    *n = self->maxLatency;
+    return D3D_OK;
+}
+
+HRESULT DevResetEx(Device* self, D3DPRESENT_PARAMETERS* pp, D3DDISPLAYMODEEX*) {
+    FakeCount(kFakeDevResetEx);
+    return ResetDevice(self, pp);
+}
+
+// --- IDirect3D9Ex ------------------------------------------------------------
+
+void DestroyD3D(Object* o) {
+    DeleteObject(static_cast<D3D*>(o));
+}
+
+HRESULT D3DQueryInterface(D3D* self, REFIID iid, void** out) {
+    FakeCount(kFakeD3DQueryInterface);
+    if (!out) return E_POINTER;
+    *out = nullptr;
+    if (iid == IID_IDirect3D9 || (self->ex && iid == IID_IDirect3D9Ex)) {
+        AddRefObj(self);
+        *out = self;
+        return S_OK;
+    }
+    return E_NOINTERFACE;
+}
+
+UINT D3DGetAdapterCount(D3D*) {
+    return 1;
+}
+
+HRESULT CreateDeviceCommon(D3D* self, bool ex, UINT adapter, D3DDEVTYPE type, HWND focus, DWORD flags,
+    D3DPRESENT_PARAMETERS* pp, Device** out)
+{
+    if (!pp || !out || adapter != 0) return D3DERR_INVALIDCALL;
+    *out = nullptr;
+    if (!pp->Windowed) return D3DERR_NOTAVAILABLE;  // the fake desktop has no modes
+    if (pp->SwapEffect == D3DSWAPEFFECT_FLIPEX && !ex) return D3DERR_INVALIDCALL;
+
+    FillPresentParameters(*pp, focus);
+    Device* dev = NewObject<Device>(g_deviceVtbl, nullptr, &DestroyDevice);
+    dev->d3d = self;
+    dev->ex = ex;
+    dev->cp = D3DDEVICE_CREATION_PARAMETERS{ adapter, type, focus, flags };
+    dev->chain = NewSwapChain(dev, dev, nullptr, *pp);
+    dev->rt0 = dev->chain->bb;
+    dev->defaultResources = 0;
+    dev->maxLatency = 3;
+    SetFullViewport(dev, dev->rt0);
+    AddRefObj(self);
+    *out = dev;
+    return D3D_OK;
+}
+
+HRESULT D3DCreateDevice(D3D* self, UINT adapter, D3DDEVTYPE type, HWND focus, DWORD flags,
+    D3DPRESENT_PARAMETERS* pp, IDirect3DDevice9** out)
+{
+    FakeCount(kFakeD3DCreateDevice);
+    return CreateDeviceCommon(self, self->ex, adapter, type, focus, flags, pp, reinterpret_cast<Device**>(out));
+}
+
+HRESULT D3DCreateDeviceEx(D3D* self, UINT adapter, D3DDEVTYPE type, HWND focus, DWORD flags,
+    D3DPRESENT_PARAMETERS* pp, D3DDISPLAYMODEEX*, IDirect3DDevice9Ex** out)
+{
+    FakeCount(kFakeD3DCreateDeviceEx);
+    if (!self->ex) Unimplemented(kTableD3D, 20);
+    return CreateDeviceCommon(self, true, adapter, type, focus, flags, pp, reinterpret_cast<Device**>(out));
+}
+
+// -----------------------------------------------------------------------------
+
+void BuildTables() {
+    BuildTable<kTableD3D>(g_d3dVtbl, {
+        { 0, FN(D3DQueryInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) },
+        { 4, FN(D3DGetAdapterCount) }, { 16, FN(D3DCreateDevice) }, { 20, FN(D3DCreateDeviceEx) },
+    });
+    BuildTable<kTableDevice>(g_deviceVtbl, {
+        { 0, FN(DevQueryInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) },
+        { 3, FN(DevTestCooperativeLevel) }, { 6, FN(DevGetDirect3D) }, { 9, FN(DevGetCreationParameters) },
+        { 13, FN(DevCreateAdditionalSwapChain) }, { 14, FN(DevGetSwapChain) },
+        { 15, FN(DevGetNumberOfSwapChains) }, { 16, FN(DevReset) }, { 17, FN(DevPresent) },
+        { 18, FN(DevGetBackBuffer) }, { 23, FN(DevCreateTexture) }, { 24, FN(DevCreateVolumeTexture) },
+        { 25, FN(DevCreateCubeTexture) }, { 26, FN(DevCreateVertexBuffer) }, { 27, FN(DevCreateIndexBuffer) },
+        { 31, FN(DevUpdateTexture) }, { 34, FN(DevStretchRect) }, { 35, FN(DevColorFill) },
+        { 37, FN(DevSetRenderTarget) }, { 38, FN(DevGetRenderTarget) }, { 41, FN(DevBeginScene) },
+        { 42, FN(DevEndScene) }, { 47, FN(DevSetViewport) }, { 48, FN(DevGetViewport) },
+        { 118, FN(DevCreateQuery) }, { 121, FN(DevPresentEx) }, { 126, FN(DevSetMaximumFrameLatency) },
+        { 127, FN(DevGetMaximumFrameLatency) }, { 132, FN(DevResetEx) },
+    });
+    BuildTable<kTableSwapChain>(g_swapChainVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 3, FN(SwapPresent) },
+        { 5, FN(SwapGetBackBuffer) }, { 8, FN(SwapGetDevice) }, { 9, FN(SwapGetPresentParameters) },
+    });
+    BuildTable<kTableSurface>(g_surfaceVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 10, FN(SurfGetType) },
+        { 12, FN(SurfGetDesc) }, { 13, FN(SurfLockRect) }, { 14, FN(SurfUnlockRect) },
+        { 15, FN(SurfGetDC) }, { 16, FN(SurfReleaseDC) },
+    });
+    BuildTable<kTableTexture>(g_textureVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(TexRelease) }, { 13, FN(TexGetLevelCount) },
+        { 17, FN(TexGetLevelDesc) }, { 18, FN(TexGetSurfaceLevel) }, { 19, FN(TexLockRect) },
+        { 20, FN(TexUnlockRect) }, { 21, FN(TexAddDirtyRect) },
+    });
+    BuildTable<kTableCube>(g_cubeVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(TexRelease) }, { 13, FN(TexGetLevelCount) },
+        { 17, FN(CubeGetLevelDesc) }, { 18, FN(CubeGetSurface) }, { 19, FN(CubeLockRect) },
+        { 20, FN(CubeUnlockRect) }, { 21, FN(CubeAddDirtyRect) },
+    });
+    BuildTable<kTableVolumeTexture>(g_volumeTextureVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(TexRelease) }, { 13, FN(TexGetLevelCount) },
+        { 17, FN(VolGetLevelDesc) }, { 18, FN(VolGetVolumeLevel) }, { 19, FN(VolLockBox) },
+        { 20, FN(VolUnlockBox) }, { 21, FN(VolAddDirtyBox) },
+    });
+    BuildTable<kTableVolume>(g_volumeVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 8, FN(VolumeGetDesc) },
+        { 9, FN(VolumeLockBox) }, { 10, FN(VolumeUnlockBox) },
+    });
+    BuildTable<kTableVertexBuffer>(g_vertexBufferVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 11, FN(BufLock) },
+        { 12, FN(BufUnlock) }, { 13, FN(VertexBufGetDesc) },
+    });
+    BuildTable<kTableIndexBuffer>(g_indexBufferVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 11, FN(BufLock) },
+        { 12, FN(BufUnlock) }, { 13, FN(IndexBufGetDesc) },
+    });
+    BuildTable<kTableQuery>(g_queryVtbl, {
+        { 0, FN(NoInterface) }, { 1, FN(AddRef) }, { 2, FN(Release) }, { 4, FN(QueryGetType) },
+        { 5, FN(QueryGetDataSize) }, { 6, FN(QueryIssue) }, { 7, FN(QueryGetData) },
+    });
+}
+
+void EnsureTables() {
+    static std::once_flag once;
+    std::call_once(once, BuildTables);
+}
+
+D3D* NewD3D(bool ex) {
+    EnsureTables();
+    D3D* d3d = NewObject<D3D>(g_d3dVtbl, nullptr, &DestroyD3D);
+    d3d->ex = ex;
+    return d3d;
+}
+
+IDirect3D9* WINAPI FakeDirect3DCreate9(UINT sdk) {
+    if (sdk != D3D_SDK_VERSION) return nullptr;
+    return reinterpret_cast<IDirect3D9*>(NewD3D(false));
+}
+
+HRESULT WINAPI FakeDirect3DCreate9Ex(UINT sdk, IDirect3D9Ex** out) {
+    if (!out) return D3DERR_INVALIDCALL;
+    *out = nullptr;
+    if (g_disableEx.load()) return D3DERR_NOTAVAILABLE;
+    if (sdk != D3D_SDK_VERSION) return D3DERR_INVALIDCALL;
+    *out = reinterpret_cast<IDirect3D9Ex*>(NewD3D(true));
+    return D3D_OK;
+}
+
+const FakeExport kD3D9Exports[] = {
+    { "Direct3DCreate9", reinterpret_cast<void*>(&FakeDirect3DCreate9) },
+    { "Direct3DCreate9Ex", reinterpret_cast<void*>(&FakeDirect3DCreate9Ex) },
+    { nullptr, nullptr },
+};
+
+[[maybe_unused]] const HMODULE g_d3d9Module = FakeRegisterModule("d3d9.dll", kD3D9Exports);
+
+}  // namespace
+
+// =============================================================================
+// Harness API
+// =============================================================================
+
+FakePresentCall FakeLastPresent() {
+    return g_lastPresent;
+}
+
+D3DPRESENT_PARAMETERS FakeDevicePP(IDirect3DDevice9* dev) {
+    return Dev(dev)->chain->pp;
+}
+
+D3DVIEWPORT9 FakeDeviceViewport(IDirect3DDevice9* dev) {
+    return Dev(dev)->vp;
+}
+
+IDirect3DSurface9* FakeDeviceRenderTarget(IDirect3DDevice9* dev) {
+    return reinterpret_cast<IDirect3DSurface9*>(Dev(dev)->rt0);
+}
+
+UINT FakeDeviceMaxLatency(IDirect3DDevice9* dev) {
+    return Dev(dev)->maxLatency;
+}
+
+bool FakeDeviceIsEx(IDirect3DDevice9* dev) {
+    return Dev(dev)->ex;
+}
+
+int FakeDeviceDefaultResources(IDirect3DDevice9* dev) {
+    return Dev(dev)->defaultResources;
+}
+
+int FakeD3D9LiveObjects() {
+    return g_live.load();
+}
+
+FakeBufferState FakeBuffer(void* buffer) {
+    const Buffer* b = static_cast<const Buffer*>(buffer);
+    return FakeBufferState{ b->usage, b->pool, b->lastLockFlags, b->length, b->data.empty() ? nullptr : b->data.data() };
+}
+
+void FakeD3D9FailSwapChains(int n) {
+    g_failSwapChains = n;
+}
+
+void FakeD3D9SetQueryLatency(int polls) {
+    g_queryLatency = polls;
+}
+
+void FakeD3D9DisableEx(bool disabled) {
+    g_disableEx = disabled;
+}
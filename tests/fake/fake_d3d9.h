@@ -0,0 +1,59 @@
+#pragma once
+// Test-side control of the fake d3d9.dll (fake_d3d9.cpp).
+//
+// Linking fake_d3d9.cpp registers "d3d9.dll" with Direct3DCreate9 and
+// Direct3DCreate9Ex. The objects it hands out have writable vtables that are
+// registered as patch sites, so the proxy's vtable hooks land in them exactly
+// as they would in the runtime. All objects of one type share a vtable, and
+// the three texture types share Release. Every method the proxy or a test
+// calls is implemented and counted (fake_calls.h); any other slot aborts with
+// the interface and slot number.
+//
+// The device behaves like a windowed HAL device as far as the proxy can see:
+// an implicit swapchain with one backbuffer, render target 0 and a viewport
+// that SetRenderTarget(0) and Reset put back to the full surface, and a
+// plain (non-Ex) Reset that fails while D3DPOOL_DEFAULT resources are alive.
+// Ex devices reject D3DPOOL_MANAGED, and buffer locks reject DISCARD and
+// NOOVERWRITE unless the buffer is DYNAMIC.
+#include <d3d9.h>
+
+// The last Present that reached the fake, through the device or a swapchain.
+struct FakePresentCall {
+    long count;                 // Presents so far, all paths
+    void* self;                 // device or swapchain called
+    bool viaSwapChain;
+    bool hasSrc, hasDst;
+    RECT src, dst;
+    HWND hwnd;
+};
+FakePresentCall FakeLastPresent();
+
+// Backbuffer size and present parameters as the fake device holds them
+// after CreateDevice/Reset (so including what the proxy changed).
+D3DPRESENT_PARAMETERS FakeDevicePP(IDirect3DDevice9* dev);
+D3DVIEWPORT9 FakeDeviceViewport(IDirect3DDevice9* dev);
+IDirect3DSurface9* FakeDeviceRenderTarget(IDirect3DDevice9* dev);
+UINT FakeDeviceMaxLatency(IDirect3DDevice9* dev);
+bool FakeDeviceIsEx(IDirect3DDevice9* dev);
+// D3DPOOL_DEFAULT resources and additional swapchains alive on the device.
+int FakeDeviceDefaultResources(IDirect3DDevice9* dev);
+
+// Fake objects not yet destroyed, of every type.
+int FakeD3D9LiveObjects();
+
+// A vertex or index buffer as the runtime holds it, past any hook on Lock.
+struct FakeBufferState {
+    DWORD usage;
+    D3DPOOL pool;
+    DWORD lastLockFlags;
+    UINT length;
+    const BYTE* data;           // nullptr until the first Lock
+};
+FakeBufferState FakeBuffer(void* buffer);
+
+// The next n CreateAdditionalSwapChain calls fail with D3DERR_OUTOFVIDEOMEMORY.
+void FakeD3D9FailSwapChains(int n);
+// After each Issue, GetData reports S_FALSE this many times before S_OK.
+void FakeD3D9SetQueryLatency(int polls);
+// Direct3DCreate9Ex returns D3DERR_NOTAVAILABLE (no Ex runtime).
+void FakeD3D9DisableEx(bool disabled);
@@ -0,0 +1,249 @@
+// dinput8.dll for running the proxy on Linux (see fake_dinput.h). Objects
+// are laid out like the ones in fake_d3d9.cpp: a vtable pointer first, and
+// methods as free functions taking the object first.
+#include "fake_dinput.h"
+#include "fake_calls.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+extern "C" {
+const GUID IID_IDirectInput8A = { 0xbf798030, 0x483a, 0x4da2, { 0xaa, 0x99, 0x5d, 0x64, 0xed, 0x36, 0x97, 0x00 } };
+const GUID GUID_SysMouse = { 0x6f1d2b60, 0xd5a0, 0x11cf, { 0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54, 0x00, 0x00 } };
+const GUID GUID_SysKeyboard = { 0x6f1d2b61, 0xd5a0, 0x11cf, { 0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54, 0x00, 0x00 } };
+}
+
+namespace {
+
+[[noreturn]] void Unimplemented(const char* iface, int slot) {
+    fprintf(stderr, "fake dinput8: %s slot %d is not implemented\n", iface, slot);
+    FakeExit(70);
+}
+
+template <bool Device, int Slot>
+HRESULT Unimpl(void*) {
+    Unimplemented(Device ? "IDirectInputDevice8A" : "IDirectInput8A", Slot);
+}
+
+template <bool Device, size_t... I>
+void FillUnimpl(void** vt, std::index_sequence<I...>) {
+    ((vt[I] = reinterpret_cast<void*>(&Unimpl<Device, (int)I>)), ...);
+}
+
+#define FN(f) reinterpret_cast<void*>(&f)
+
+struct DInput {
+    void** vtbl;
+    std::atomic<long> refs;
+};
+
+struct Device {
+    void** vtbl;
+    std::atomic<long> refs;
+    DWORD devType;
+    bool acquired;
+    bool lost;              // acquisition taken away rather than never granted
+    DWORD coopFlags;
+};
+
+void* g_dinputVtbl[11];
+void* g_deviceVtbl[32];
+
+std::mutex g_mu;
+std::vector<Device*> g_devices;  // kept for FakeDInputLoseDevices; never freed
+DIMOUSESTATE2 g_mouseState{};
+
+// --- IDirectInputDevice8A ----------------------------------------------------
+
+ULONG DevAddRef(Device* self) {
+    return (ULONG)(self->refs.fetch_add(1) + 1);
+}
+
+// Released devices stay allocated so FakeDInputLoseDevices can walk them.
+ULONG DevRelease(Device* self) {
+    return (ULONG)(self->refs.fetch_sub(1) - 1);
+}
+
+HRESULT DevQueryInterface(Device*, REFIID, void** out) {
+    if (out) *out = nullptr;
+    return E_NOINTERFACE;
+}
+
+HRESULT DevAcquire(Device* self) {
+    FakeCount(kFakeDiAcquire);
+    std::lock_guard<std::mutex> lock(g_mu);
+    if (self->acquired) return S_FALSE;
+    self->acquired = true;
+    self->lost = false;
+    return DI_OK;
+}
+
+HRESULT DevUnacquire(Device* self) {
+    std::lock_guard<std::mutex> lock(g_mu);
+    if (!self->acquired) return S_FALSE;
+    self->acquired = false;
+    return DI_OK;
+}
+
+HRESULT NotAcquired(const Device* self) {
+    return self->lost ? DIERR_INPUTLOST : DIERR_NOTACQUIRED;
+}
+
+HRESULT DevGetDeviceState(Device* self, DWORD size, LPVOID data) {
+    FakeCount(kFakeDiGetDeviceState);
+    std::lock_guard<std::mutex> lock(g_mu);
+    if (!self->acquired) return NotAcquired(self);
+    if (!data || size == 0) return E_INVALIDARG;
+    memset(data, 0, size);
+    if (self->devType == DI8DEVTYPE_MOUSE) memcpy(data, &g_mouseState, size < sizeof(g_mouseState) ? size : sizeof(g_mouseState));
+    return DI_OK;
+}
+
+HRESULT DevSetDataFormat(Device*, const DIDATAFORMAT*) {
+    return DI_OK;
+}
+
+HRESULT DevSetCooperativeLevel(Device* self, HWND, DWORD flags) {
+    FakeCount(kFakeDiSetCooperativeLevel);
+    if (!!(flags & DISCL_EXCLUSIVE) == !!(flags & DISCL_NONEXCLUSIVE)) return E_INVALIDARG;
+    if (!!(flags & DISCL_FOREGROUND) == !!(flags & DISCL_BACKGROUND)) return E_INVALIDARG;
+    std::lock_guard<std::mutex> lock(g_mu);
+    self->coopFlags = flags;
+    return DI_OK;
+}
+
+HRESULT DevGetDeviceInfo(Device* self, DIDEVICEINSTANCEA* info) {
+    FakeCount(kFakeDiGetDeviceInfo);
+    if (!info || info->dwSize != sizeof(DIDEVICEINSTANCEA)) return E_INVALIDARG;
+    memset(&info->guidInstance, 0, sizeof(*info) - offsetof(DIDEVICEINSTANCEA, guidInstance));
+    info->guidInstance = self->devType == DI8DEVTYPE_MOUSE ? GUID_SysMouse : GUID_SysKeyboard;
+    info->guidProduct = info->guidInstance;
+    info->dwDevType = self->devType | (self->devType == DI8DEVTYPE_MOUSE ? 0x100u : 0x400u);
+    return DI_OK;
+}
+
+HRESULT DevPoll(Device* self) {
+    FakeCount(kFakeDiPoll);
+    std::lock_guard<std::mutex> lock(g_mu);
+    if (!self->acquired) return NotAcquired(self);
+    return S_FALSE;  // system devices need no polling
+}
+
+// --- IDirectInput8A ----------------------------------------------------------
+
+HRESULT DiQueryInterface(DInput* self, REFIID iid, void** out) {
+    if (!out) return E_POINTER;
+    *out = nullptr;
+    if (iid != IID_IDirectInput8A) return E_NOINTERFACE;
+    self->refs++;
+    *out = self;
+    return S_OK;
+}
+
+ULONG DiAddRef(DInput* self) {
+    return (ULONG)(self->refs.fetch_add(1) + 1);
+}
+
+ULONG DiRelease(DInput* self) {
+    const long n = self->refs.fetch_sub(1) - 1;
+    if (n == 0) delete self;
+    return (ULONG)n;
+}
+
+HRESULT DiCreateDevice(DInput*, REFGUID guid, IDirectInputDevice8A** out, LPUNKNOWN outer) {
+    FakeCount(kFakeDInputCreateDevice);
+    if (!out || outer) return E_INVALIDARG;
+    *out = nullptr;
+
+    DWORD type = 0;
+    if (guid == GUID_SysMouse) type = DI8DEVTYPE_MOUSE;
+    else if (guid == GUID_SysKeyboard) type = DI8DEVTYPE_KEYBOARD;
+    else return DIERR_GENERIC;
+
+    Device* dev = new Device{ g_deviceVtbl, { 1 }, type, false, false, 0 };
+    {
+        std::lock_guard<std::mutex> lock(g_mu);
+        g_devices.push_back(dev);
+    }
+    *out = reinterpret_cast<IDirectInputDevice8A*>(dev);
+    return DI_OK;
+}
+
+void BuildTables() {
+    FillUnimpl<false>(g_dinputVtbl, std::make_index_sequence<11>());
+    g_dinputVtbl[0] = FN(DiQueryInterface);
+    g_dinputVtbl[1] = FN(DiAddRef);
+    g_dinputVtbl[2] = FN(DiRelease);
+    g_dinputVtbl[3] = FN(DiCreateDevice);
+    FakeRegisterPatchSites(g_dinputVtbl, 11);
+
+    FillUnimpl<true>(g_deviceVtbl, std::make_index_sequence<32>());
+    g_deviceVtbl[0] = FN(DevQueryInterface);
+    g_deviceVtbl[1] = FN(DevAddRef);
+    g_deviceVtbl[2] = FN(DevRelease);
+    g_deviceVtbl[7] = FN(DevAcquire);
+    g_deviceVtbl[8] = FN(DevUnacquire);
+    g_deviceVtbl[9] = FN(DevGetDeviceState);
+    g_deviceVtbl[11] = FN(DevSetDataFormat);
+    g_deviceVtbl[13] = FN(DevSetCooperativeLevel);
+    g_deviceVtbl[15] = FN(DevGetDeviceInfo);
+    g_deviceVtbl[25] = FN(DevPoll);
+    FakeRegisterPatchSites(g_deviceVtbl, 32);
+}
+
+HRESULT WINAPI FakeDirectInput8Create(HINSTANCE, DWORD version, REFIID iid, LPVOID* out, LPUNKNOWN outer) {
+    if (!out || outer) return E_INVALIDARG;
+    *out = nullptr;
+    if (version != DIRECTINPUT_VERSION || iid != IID_IDirectInput8A) return E_NOINTERFACE;
+
+    static std::once_flag once;
+    std::call_once(once, BuildTables);
+    *out = new DInput{ g_dinputVtbl, { 1 } };
+    return DI_OK;
+}
+
+const FakeExport kDInput8Exports[] = {
+    { "DirectInput8Create", reinterpret_cast<void*>(&FakeDirectInput8Create) },
+    { nullptr, nullptr },
+};
+
+[[maybe_unused]] const HMODULE g_dinput8Module = FakeRegisterModule("dinput8.dll", kDInput8Exports);
+
+Device* Dev(IDirectInputDevice8A* d) {
+    return reinterpret_cast<Device*>(d);
+}
+
+}  // namespace
+
+// =============================================================================
+// Harness API
+// =============================================================================
+
+void FakeDInputLoseDevices() {
+    std::lock_guard<std::mutex> lock(g_mu);
+    for (Device* d : g_devices) {
+        if (!d->acquired) continue;
+        d->acquired = false;
+        d->lost = true;
+    }
+}
+
+DWORD FakeDInputCoopFlags(IDirectInputDevice8A* dev) {
+    std::lock_guard<std::mutex> lock(g_mu);
+    return Dev(dev)->coopFlags;
+}
+
+bool FakeDInputAcquired(IDirectInputDevice8A* dev) {
+    std::lock_guard<std::mutex> lock(g_mu);
+    return Dev(dev)->acquired;
+}
+
+void FakeDInputSetMouseState(const DIMOUSESTATE2& state) {
+    std::lock_guard<std::mutex> lock(g_mu);
+    g_mouseState = state;
+}
@@ -0,0 +1,20 @@
+#pragma once
+// Test-side control of the fake dinput8.dll (fake_dinput.cpp).
+//
+// Linking fake_dinput.cpp registers "dinput8.dll" with DirectInput8Create.
+// IDirectInput8A::CreateDevice makes a mouse for GUID_SysMouse and a
+// keyboard for GUID_SysKeyboard; all devices share one patchable vtable.
+// A device starts unacquired: GetDeviceState and Poll fail with
+// DIERR_NOTACQUIRED until Acquire, and with DIERR_INPUTLOST after
+// FakeDInputLoseDevices until the next Acquire.
+#include <dinput.h>
+
+// Every device created so far loses acquisition.
+void FakeDInputLoseDevices();
+
+// Flags the last SetCooperativeLevel passed to the fake (after the proxy).
+DWORD FakeDInputCoopFlags(IDirectInputDevice8A* dev);
+bool FakeDInputAcquired(IDirectInputDevice8A* dev);
+
+// What GetDeviceState returns for mice.
+void FakeDInputSetMouseState(const DIMOUSESTATE2& state);
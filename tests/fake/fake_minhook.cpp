@@ -0,0 +1,231 @@
+// MinHook API over the patch sites of the fakes (see fake_minhook.h).
+#include "fake_minhook.h"
+#include "MinHook.h"
+
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct FakeHook {
+    void* target;
+    void* detour;
+    bool enabled;
+    bool queueEnable;
+};
+
+struct HookState {
+    std::mutex mu;
+    bool initialized = false;
+    std::vector<FakeHook> hooks;
+    std::vector<void**> sites;
+    int freezes = 0;
+    const void* failQueueEnable = nullptr;
+};
+
+// Leaked on purpose: the proxy's threads may still call through at exit.
+HookState& State() {
+    static HookState* s = new HookState();
+    return *s;
+}
+
+FakeHook* Find(HookState& s, const void* target) {
+    for (FakeHook& h : s.hooks) {
+        if (h.target == target) return &h;
+    }
+    return nullptr;
+}
+
+void Patch(HookState& s, FakeHook& h, bool enable) {
+    void* from = enable ? h.target : h.detour;
+    void* to = enable ? h.detour : h.target;
+    for (void** site : s.sites) {
+        if (*site == from) *site = to;
+    }
+    // Like EnableHookLL, this also settles the queued state.
+    h.enabled = enable;
+    h.queueEnable = enable;
+}
+
+MH_STATUS SetEnabled(const void* target, bool enable) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+
+    bool changed = false;
+    if (target == MH_ALL_HOOKS) {
+        for (FakeHook& h : s.hooks) {
+            if (h.enabled != enable) {
+                Patch(s, h, enable);
+                changed = true;
+            }
+        }
+    }
+    else {
+        FakeHook* h = Find(s, target);
+        if (!h) return MH_ERROR_NOT_CREATED;
+        if (h->enabled == enable) return enable ? MH_ERROR_ENABLED : MH_ERROR_DISABLED;
+        Patch(s, *h, enable);
+        changed = true;
+    }
+    if (changed) s.freezes++;
+    return MH_OK;
+}
+
+MH_STATUS Queue(const void* target, bool enable) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+
+    if (target == MH_ALL_HOOKS) {
+        for (FakeHook& h : s.hooks) h.queueEnable = enable;
+        return MH_OK;
+    }
+    FakeHook* h = Find(s, target);
+    if (!h) return MH_ERROR_NOT_CREATED;
+    if (enable && target == s.failQueueEnable) return MH_ERROR_MEMORY_PROTECT;
+    h->queueEnable = enable;
+    return MH_OK;
+}
+
+}  // namespace
+
+void FakeRegisterPatchSites(void** sites, size_t count) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    for (size_t i = 0; i < count; i++) {
+        for (const FakeHook& h : s.hooks) {
+            if (h.enabled && sites[i] == h.target) sites[i] = h.detour;
+        }
+        s.sites.push_back(&sites[i]);
+    }
+}
+
+bool FakeHookCreated(const void* target) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    return Find(s, target) != nullptr;
+}
+
+bool FakeHookEnabled(const void* target) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    const FakeHook* h = Find(s, target);
+    return h && h->enabled;
+}
+
+int FakeHookCount() {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    return (int)s.hooks.size();
+}
+
+int FakeHookFreezes() {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    return s.freezes;
+}
+
+void FakeFailQueueEnable(const void* target) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    s.failQueueEnable = target;
+}
+
+extern "C" {
+
+MH_STATUS WINAPI MH_Initialize(VOID) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (s.initialized) return MH_ERROR_ALREADY_INITIALIZED;
+    s.initialized = true;
+    return MH_OK;
+}
+
+MH_STATUS WINAPI MH_Uninitialize(VOID) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+    for (FakeHook& h : s.hooks) {
+        if (h.enabled) Patch(s, h, false);
+    }
+    s.hooks.clear();
+    s.initialized = false;
+    return MH_OK;
+}
+
+MH_STATUS WINAPI MH_CreateHook(LPVOID pTarget, LPVOID pDetour, LPVOID* ppOriginal) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+    if (!pTarget || !pDetour) return MH_ERROR_INVALID_ARGUMENT;
+    if (Find(s, pTarget)) return MH_ERROR_ALREADY_CREATED;
+
+    s.hooks.push_back(FakeHook{ pTarget, pDetour, false, false });
+    if (ppOriginal) *ppOriginal = pTarget;
+    return MH_OK;
+}
+
+MH_STATUS WINAPI MH_RemoveHook(LPVOID pTarget) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+    for (size_t i = 0; i < s.hooks.size(); i++) {
+        if (s.hooks[i].target != pTarget) continue;
+        if (s.hooks[i].enabled) {
+            Patch(s, s.hooks[i], false);
+            s.freezes++;
+        }
+        s.hooks.erase(s.hooks.begin() + (ptrdiff_t)i);
+        return MH_OK;
+    }
+    return MH_ERROR_NOT_CREATED;
+}
+
+MH_STATUS WINAPI MH_EnableHook(LPVOID pTarget) {
+    return SetEnabled(pTarget, true);
+}
+
+MH_STATUS WINAPI MH_DisableHook(LPVOID pTarget) {
+    return SetEnabled(pTarget, false);
+}
+
+MH_STATUS WINAPI MH_QueueEnableHook(LPVOID pTarget) {
+    return Queue(pTarget, true);
+}
+
+MH_STATUS WINAPI MH_QueueDisableHook(LPVOID pTarget) {
+    return Queue(pTarget, false);
+}
+
+MH_STATUS WINAPI MH_ApplyQueued(VOID) {
+    HookState& s = State();
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (!s.initialized) return MH_ERROR_NOT_INITIALIZED;
+
+    bool changed = false;
+    for (FakeHook& h : s.hooks) {
+        if (h.enabled != h.queueEnable) {
+            Patch(s, h, h.queueEnable);
+            changed = true;
+        }
+    }
+    if (changed) s.freezes++;
+    return MH_OK;
+}
+
+const char* WINAPI MH_StatusToString(MH_STATUS status) {
+    switch (status) {
+    case MH_OK: return "MH_OK";
+    case MH_ERROR_ALREADY_INITIALIZED: return "MH_ERROR_ALREADY_INITIALIZED";
+    case MH_ERROR_NOT_INITIALIZED: return "MH_ERROR_NOT_INITIALIZED";
+    case MH_ERROR_ALREADY_CREATED: return "MH_ERROR_ALREADY_CREATED";
+    case MH_ERROR_NOT_CREATED: return "MH_ERROR_NOT_CREATED";
+    case MH_ERROR_ENABLED: return "MH_ERROR_ENABLED";
+    case MH_ERROR_DISABLED: return "MH_ERROR_DISABLED";
+    case MH_ERROR_INVALID_ARGUMENT: return "MH_ERROR_INVALID_ARGUMENT";
+    default: return "(unknown)";
+    }
+}
+
+}  // extern "C"
@@ -0,0 +1,25 @@
+#pragma once
+// Test-side view of the fake MinHook (fake_minhook.cpp).
+//
+// Everything the proxy hooks in the fakes is called through a patchable
+// pointer: a COM vtable slot, or the pointer behind a fake user32 export. Those
+// pointers are the fake's equivalent of a function's first bytes. Enabling a
+// hook rewrites every registered site that holds the target to hold the
+// detour; disabling it writes the target back. The original the proxy calls
+// is the target itself, so Real_* lands in the fake implementation.
+#include <windows.h>
+#include <stddef.h>
+
+// Sites registered after a hook was enabled get that hook applied at once.
+void FakeRegisterPatchSites(void** sites, size_t count);
+
+bool FakeHookCreated(const void* target);
+bool FakeHookEnabled(const void* target);
+int FakeHookCount();
+
+// Every MH_EnableHook/MH_DisableHook/MH_ApplyQueued that changed something;
+// the real MinHook freezes all threads of the process once per such call.
+int FakeHookFreezes();
+
+// MH_QueueEnableHook on target fails from now on (nullptr: none does).
+void FakeFailQueueEnable(const void* target);
@@ -0,0 +1,1676 @@
+// kernel32/user32 for running the proxy on Linux (see fake_win32.h).
+//
+// Kernel objects (events, threads, waitable timers, change notifications)
+// share one mutex and condition variable; QueryPerformanceCounter is
+// CLOCK_MONOTONIC in nanoseconds. Files live under FakeFileRoot(), the ini
+// is an in-memory table, and user32 keeps a single desktop. The user32
+// functions the proxy hooks are called through patch sites (fake_minhook.h).
+#include "fake_win32.h"
+#include "fake_minhook.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ERROR_INVALID_WINDOW_HANDLE 1400
+#define ERROR_TIMEOUT 1460
+#define TIMERR_NOERROR 0
+#define CREATE_WAITABLE_TIMER_MANUAL_RESET 0x1
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define ERROR_INSUFFICIENT_BUFFER 122
+
+namespace {
+
+LONGLONG NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string Lower(const char* s) {
+    std::string r = s ? s : "";
+    for (char& c : r) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return r;
+}
+
+const char* BaseName(const char* path) {
+    const char* a = strrchr(path, '\\');
+    const char* b = strrchr(path, '/');
+    const char* s = a > b ? a : b;
+    return s ? s + 1 : path;
+}
+
+bool EndsWith(const std::string& s, const char* tail) {
+    const size_t n = strlen(tail);
+    return s.size() >= n && s.compare(s.size() - n, n, tail) == 0;
+}
+
+DWORD CopyOut(const std::string& s, LPSTR buf, DWORD size) {
+    if (!buf || size == 0) return 0;
+    const DWORD n = (DWORD)s.size() < size - 1 ? (DWORD)s.size() : size - 1;
+    memcpy(buf, s.data(), n);
+    buf[n] = 0;
+    return n;
+}
+
+thread_local DWORD t_lastError = 0;
+
+// -----------------------------------------------------------------------------
+// Kernel objects
+// -----------------------------------------------------------------------------
+
+enum ObjKind { kObjEvent, kObjThread, kObjTimer, kObjFile, kObjMapping, kObjChange };
+
+struct KObject {
+    ObjKind kind;
+    bool signaled = false;
+    bool manualReset = true;
+    int refs = 1;               // handle + running thread for kObjThread
+    LONGLONG due = 0;           // timer: NowNs() deadline, 0 = not armed
+    DWORD tid = 0;
+    DWORD exitCode = STILL_ACTIVE;
+    int fd = -1;                // file, mapping
+    LONGLONG mapSize = 0;
+    bool mapWrite = false;
+
+    explicit KObject(ObjKind k) : kind(k) {}
+};
+
+struct Kernel {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::vector<KObject*> changeWatchers;
+    std::map<void*, size_t> views;
+};
+
+Kernel& K() {
+    static Kernel* k = new Kernel();
+    return *k;
+}
+
+KObject* Obj(HANDLE h) {
+    if (!h || h == INVALID_HANDLE_VALUE || h == (HANDLE)(LONG_PTR)-2) return nullptr;
+    return static_cast<KObject*>(h);
+}
+
+// Caller holds K().mu.
+void Unref(KObject* o) {
+    if (--o->refs > 0) return;
+    if (o->fd >= 0) close(o->fd);
+    delete o;
+}
+
+std::atomic<DWORD> g_nextTid{ 0x100 };
+thread_local DWORD t_tid = 0;
+
+// Caller holds K().mu. Fires due timers, returns the nearest pending deadline.
+LONGLONG FireTimers(const HANDLE* hs, DWORD n, LONGLONG now) {
+    LONGLONG next = INT64_MAX;
+    for (DWORD i = 0; i < n; i++) {
+        KObject* o = Obj(hs[i]);
+        if (!o || o->kind != kObjTimer || o->due == 0) continue;
+        if (o->due <= now) {
+            o->signaled = true;
+            o->due = 0;
+        }
+        else if (o->due < next) {
+            next = o->due;
+        }
+    }
+    return next;
+}
+
+DWORD WaitObjects(DWORD n, const HANDLE* hs, bool all, DWORD ms) {
+    for (DWORD i = 0; i < n; i++) {
+        if (!Obj(hs[i])) {
+            t_lastError = ERROR_INVALID_HANDLE;
+            return WAIT_FAILED;
+        }
+    }
+
+    const LONGLONG deadline = ms == INFINITE ? INT64_MAX : NowNs() + (LONGLONG)ms * 1000000;
+    Kernel& k = K();
+    std::unique_lock<std::mutex> lock(k.mu);
+    for (;;) {
+        const LONGLONG now = NowNs();
+        const LONGLONG nextTimer = FireTimers(hs, n, now);
+
+        if (all) {
+            bool ready = true;
+            for (DWORD i = 0; i < n; i++) ready = ready && Obj(hs[i])->signaled;
+            if (ready) {
+                for (DWORD i = 0; i < n; i++) {
+                    KObject* o = Obj(hs[i]);
+                    if (!o->manualReset) o->signaled = false;
+                }
+                return WAIT_OBJECT_0;
+            }
+        }
+        else {
+            for (DWORD i = 0; i < n; i++) {
+                KObject* o = Obj(hs[i]);
+                if (!o->signaled) continue;
+                if (!o->manualReset) o->signaled = false;
+                return WAIT_OBJECT_0 + i;
+            }
+        }
+
+        if (now >= deadline) return WAIT_TIMEOUT;
+        const LONGLONG wake = deadline < nextTimer ? deadline : nextTimer;
+        if (wake == INT64_MAX) {
+            k.cv.wait(lock);
+        }
+        else {
+            k.cv.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(wake)));
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Process-wide fake state
+// -----------------------------------------------------------------------------
+
+struct LogState {
+    std::mutex mu;
+    std::deque<std::string> lines;
+    bool echo = getenv("FAKE_WIN32_LOG") != nullptr;
+};
+
+LogState& Log() {
+    static LogState* s = new LogState();
+    return *s;
+}
+
+std::atomic<LONGLONG> g_tickOffsetMs{ 0 };
+
+struct IniState {
+    std::mutex mu;
+    // Lowercase section -> (key, value) in insertion order; keys compare case-insensitively.
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> sections;
+    ULONGLONG stamp = 1;
+};
+
+IniState& Ini() {
+    static IniState* s = new IniState();
+    return *s;
+}
+
+// Bumps the ini write time and wakes every change notification.
+void IniChanged() {
+    {
+        IniState& ini = Ini();
+        ini.stamp++;
+    }
+    Kernel& k = K();
+    std::lock_guard<std::mutex> lock(k.mu);
+    for (KObject* o : k.changeWatchers) o->signaled = true;
+    k.cv.notify_all();
+}
+
+std::string* IniFind(IniState& ini, const char* section, const char* key) {
+    auto it = ini.sections.find(Lower(section));
+    if (it == ini.sections.end()) return nullptr;
+    for (auto& kv : it->second) {
+        if (strcasecmp(kv.first.c_str(), key) == 0) return &kv.second;
+    }
+    return nullptr;
+}
+
+struct FileRoot {
+    std::mutex mu;
+    std::string dir;
+};
+
+FileRoot& Root() {
+    static FileRoot* r = new FileRoot();
+    return *r;
+}
+
+// --- modules -----------------------------------------------------------------
+
+struct FakeModule {
+    std::string name;           // lowercase file name
+    const FakeExport* exports;
+};
+
+std::mutex g_moduleMu;
+
+std::vector<FakeModule*>& Modules() {
+    static std::vector<FakeModule*>* m = new std::vector<FakeModule*>();
+    return *m;
+}
+
+// The game executable as far as ComputeProfileKey can tell.
+struct FakeImage {
+    IMAGE_DOS_HEADER dos;
+    IMAGE_NT_HEADERS nt;
+};
+
+FakeImage* GameImage() {
+    static FakeImage* img = [] {
+        FakeImage* i = new FakeImage();
+        memset(i, 0, sizeof(*i));
+        i->dos.e_magic = IMAGE_DOS_SIGNATURE;
+        i->dos.e_lfanew = (LONG)offsetof(FakeImage, nt);
+        i->nt.Signature = IMAGE_NT_SIGNATURE;
+        i->nt.FileHeader.TimeDateStamp = 0x5F5E1000;
+        i->nt.OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR_MAGIC;
+        i->nt.OptionalHeader.SizeOfImage = 0x00A00000;
+        return i;
+    }();
+    return img;
+}
+
+char g_proxyModule;  // HMODULE of the proxy itself
+
+FakeModule* FindModule(const char* name) {
+    const std::string want = Lower(BaseName(name));
+    std::lock_guard<std::mutex> lock(g_moduleMu);
+    for (FakeModule* m : Modules()) {
+        if (m->name == want || m->name == want + ".dll") return m;
+    }
+    return nullptr;
+}
+
+FakeModule* ModuleFromHandle(HMODULE h) {
+    std::lock_guard<std::mutex> lock(g_moduleMu);
+    for (FakeModule* m : Modules()) {
+        if ((HMODULE)m == h) return m;
+    }
+    return nullptr;
+}
+
+void EnsureUser32();
+
+// -----------------------------------------------------------------------------
+// Desktop
+// -----------------------------------------------------------------------------
+
+struct FakeWindow {
+    LONG_PTR style;
+    RECT rect;
+    WNDPROC proc;
+    HWND owner;
+    DWORD tid;
+    bool alive;
+};
+
+struct Desktop {
+    std::mutex mu;
+    RECT monitor{ 0, 0, 1920, 1080 };
+    std::vector<FakeWindow*> windows;
+    HWND foreground = nullptr;
+    HWND capture = nullptr;
+    bool clipped = false;
+    RECT clip{};
+    POINT cursor{ 960, 540 };
+    std::deque<MSG> queue;
+    std::unordered_map<HRAWINPUT, RAWINPUT> raw;
+    uintptr_t nextRaw = 0x1000;
+};
+
+Desktop& D() {
+    static Desktop* d = new Desktop();
+    return *d;
+}
+
+// Caller holds D().mu.
+FakeWindow* Win(HWND h) {
+    for (FakeWindow* w : D().windows) {
+        if ((HWND)w == h) return w->alive ? w : nullptr;
+    }
+    return nullptr;
+}
+
+// Frame thickness of a captioned, sizable window.
+RECT Frame(LONG_PTR style) {
+    if (style & WS_CAPTION) return RECT{ 8, 31, 8, 8 };
+    return RECT{ 0, 0, 0, 0 };
+}
+
+POINT ClientOrigin(const FakeWindow* w) {
+    const RECT f = Frame(w->style);
+    return POINT{ w->rect.left + f.left, w->rect.top + f.top };
+}
+
+SIZE ClientSize(const FakeWindow* w) {
+    const RECT f = Frame(w->style);
+    LONG cw = w->rect.right - w->rect.left - f.left - f.right;
+    LONG ch = w->rect.bottom - w->rect.top - f.top - f.bottom;
+    return SIZE{ cw > 0 ? cw : 0, ch > 0 ? ch : 0 };
+}
+
+WNDPROC ProcOf(HWND h) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(h);
+    return w ? w->proc : nullptr;
+}
+
+LRESULT Send(HWND h, UINT msg, WPARAM wParam, LPARAM lParam) {
+    WNDPROC proc = ProcOf(h);
+    return proc ? proc(h, msg, wParam, lParam) : 0;
+}
+
+// --- user32 functions the proxy hooks -----------------------------------------
+
+namespace user32 {
+
+BOOL WINAPI ClipCursor(const RECT* r) {
+    FakeCount(kFakeClipCursor);
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    if (!r) {
+        d.clipped = false;
+        return TRUE;
+    }
+    d.clip = RECT{
+        (std::max)(r->left, d.monitor.left), (std::max)(r->top, d.monitor.top),
+        (std::min)(r->right, d.monitor.right), (std::min)(r->bottom, d.monitor.bottom) };
+    d.clipped = true;
+    return TRUE;
+}
+
+HWND WINAPI SetCapture(HWND hwnd) {
+    FakeCount(kFakeSetCapture);
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    HWND prev = d.capture;
+    d.capture = hwnd;
+    return prev;
+}
+
+BOOL WINAPI SetCursorPos(int x, int y) {
+    FakeCount(kFakeSetCursorPos);
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    if (d.clipped) {
+        x = (std::max)((int)d.clip.left, (std::min)(x, (int)d.clip.right - 1));
+        y = (std::max)((int)d.clip.top, (std::min)(y, (int)d.clip.bottom - 1));
+    }
+    d.cursor = POINT{ x, y };
+    return TRUE;
+}
+
+LONG WINAPI ChangeDisplaySettingsExA(LPCSTR, DEVMODEA*, HWND, DWORD, LPVOID) {
+    FakeCount(kFakeChangeDisplaySettings);
+    return DISP_CHANGE_SUCCESSFUL;
+}
+
+LONG WINAPI ChangeDisplaySettingsExW(LPCWSTR, DEVMODEW*, HWND, DWORD, LPVOID) {
+    FakeCount(kFakeChangeDisplaySettings);
+    return DISP_CHANGE_SUCCESSFUL;
+}
+
+HWND WINAPI GetForegroundWindow() {
+    FakeCount(kFakeGetForegroundWindow);
+    std::lock_guard<std::mutex> lock(D().mu);
+    return D().foreground;
+}
+
+BOOL WINAPI GetClientRect(HWND hwnd, LPRECT rc) {
+    FakeCount(kFakeGetClientRect);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w || !rc) {
+        t_lastError = ERROR_INVALID_WINDOW_HANDLE;
+        return FALSE;
+    }
+    const SIZE s = ClientSize(w);
+    *rc = RECT{ 0, 0, s.cx, s.cy };
+    return TRUE;
+}
+
+BOOL WINAPI ScreenToClient(HWND hwnd, LPPOINT pt) {
+    FakeCount(kFakeScreenToClient);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w || !pt) return FALSE;
+    const POINT o = ClientOrigin(w);
+    pt->x -= o.x;
+    pt->y -= o.y;
+    return TRUE;
+}
+
+BOOL WINAPI ClientToScreen(HWND hwnd, LPPOINT pt) {
+    FakeCount(kFakeClientToScreen);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w || !pt) return FALSE;
+    const POINT o = ClientOrigin(w);
+    pt->x += o.x;
+    pt->y += o.y;
+    return TRUE;
+}
+
+UINT WINAPI GetRawInputData(HRAWINPUT h, UINT cmd, LPVOID data, PUINT size, UINT headerSize) {
+    FakeCount(kFakeGetRawInputData);
+    if (!size || headerSize != sizeof(RAWINPUTHEADER)) return (UINT)-1;
+
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    auto it = d.raw.find(h);
+    if (it == d.raw.end()) return (UINT)-1;
+
+    const UINT need = cmd == RID_HEADER ? (UINT)sizeof(RAWINPUTHEADER) : (UINT)sizeof(RAWINPUT);
+    if (!data) {
+        *size = need;
+        return 0;
+    }
+    if (*size < need) {
+        *size = need;
+        t_lastError = ERROR_INSUFFICIENT_BUFFER;
+        return (UINT)-1;
+    }
+    memcpy(data, &it->second, need);
+    return need;
+}
+
+}  // namespace user32
+
+#define FAKE_USER32_HOOKABLE(X) \
+    X(ClipCursor) X(SetCapture) X(SetCursorPos) X(ChangeDisplaySettingsExA) \
+    X(ChangeDisplaySettingsExW) X(GetForegroundWindow) X(GetClientRect) \
+    X(ScreenToClient) X(ClientToScreen) X(GetRawInputData)
+
+enum User32Site {
+#define FAKE_SITE_ENUM(name) kSite##name,
+    FAKE_USER32_HOOKABLE(FAKE_SITE_ENUM)
+#undef FAKE_SITE_ENUM
+    kSiteCount
+};
+
+void* g_user32Sites[kSiteCount] = {
+#define FAKE_SITE_INIT(name) (void*)&user32::name,
+    FAKE_USER32_HOOKABLE(FAKE_SITE_INIT)
+#undef FAKE_SITE_INIT
+};
+
+const FakeExport kUser32Exports[] = {
+#define FAKE_SITE_EXPORT(name) { #name, (void*)&user32::name },
+    FAKE_USER32_HOOKABLE(FAKE_SITE_EXPORT)
+#undef FAKE_SITE_EXPORT
+    { nullptr, nullptr },
+};
+
+void EnsureUser32() {
+    static const bool once = [] {
+        FakeRegisterPatchSites(g_user32Sites, kSiteCount);
+        FakeRegisterModule("user32.dll", kUser32Exports);
+        return true;
+    }();
+    (void)once;
+}
+
+template <typename Fn>
+Fn Site(User32Site s) {
+    EnsureUser32();
+    return reinterpret_cast<Fn>(__atomic_load_n(&g_user32Sites[s], __ATOMIC_ACQUIRE));
+}
+
+}  // namespace
+
+// =============================================================================
+// Harness API
+// =============================================================================
+
+void FakeSetMonitor(const RECT& rc) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    D().monitor = rc;
+}
+
+HWND FakeCreateWindow(int x, int y, int clientW, int clientH, WNDPROC proc, LONG_PTR style) {
+    EnsureUser32();
+    style |= WS_VISIBLE;
+    const RECT f = Frame(style);
+    FakeWindow* w = new FakeWindow{ style,
+        RECT{ x, y, x + f.left + clientW + f.right, y + f.top + clientH + f.bottom },
+        proc, nullptr, GetCurrentThreadId(), true };
+
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    d.windows.push_back(w);
+    if (!d.foreground) d.foreground = (HWND)w;
+    return (HWND)w;
+}
+
+void FakeDestroyWindow(HWND hwnd) {
+    Send(hwnd, WM_DESTROY, 0, 0);
+    Send(hwnd, WM_NCDESTROY, 0, 0);
+
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    if (FakeWindow* w = Win(hwnd)) w->alive = false;
+    if (d.foreground == hwnd) d.foreground = nullptr;
+    if (d.capture == hwnd) d.capture = nullptr;
+}
+
+void FakeSetForeground(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    D().foreground = hwnd;
+}
+
+SIZE FakeClientSize(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    return w ? ClientSize(w) : SIZE{ 0, 0 };
+}
+
+RECT FakeWindowRect(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    return w ? w->rect : RECT{};
+}
+
+LONG_PTR FakeWindowStyle(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    return w ? w->style : 0;
+}
+
+WNDPROC FakeWindowProc(HWND hwnd) {
+    return ProcOf(hwnd);
+}
+
+LRESULT FakeSendMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    return Send(hwnd, msg, wParam, lParam);
+}
+
+int FakePumpMessages() {
+    int n = 0;
+    for (;;) {
+        MSG m;
+        {
+            std::lock_guard<std::mutex> lock(D().mu);
+            if (D().queue.empty()) return n;
+            m = D().queue.front();
+            D().queue.pop_front();
+        }
+        Send(m.hwnd, m.message, m.wParam, m.lParam);
+        n++;
+    }
+}
+
+bool FakeCursorClipped(RECT* clip) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    if (clip && D().clipped) *clip = D().clip;
+    return D().clipped;
+}
+
+POINT FakeCursorPos() {
+    std::lock_guard<std::mutex> lock(D().mu);
+    return D().cursor;
+}
+
+HRAWINPUT FakeQueueRawInput(const RAWINPUT& ri) {
+    Desktop& d = D();
+    std::lock_guard<std::mutex> lock(d.mu);
+    HRAWINPUT h = reinterpret_cast<HRAWINPUT>(d.nextRaw++);
+    RAWINPUT copy = ri;
+    copy.header.dwSize = sizeof(RAWINPUT);
+    d.raw[h] = copy;
+    return h;
+}
+
+void FakeIniSet(const char* section, const char* key, const char* value) {
+    WritePrivateProfileStringA(section, key, value, nullptr);
+}
+
+void FakeIniClear() {
+    {
+        IniState& ini = Ini();
+        std::lock_guard<std::mutex> lock(ini.mu);
+        ini.sections.clear();
+    }
+    IniChanged();
+}
+
+void FakeAdvanceTicks(ULONGLONG ms) {
+    g_tickOffsetMs += (LONGLONG)ms;
+}
+
+void FakeSetFileRoot(const char* dir) {
+    std::lock_guard<std::mutex> lock(Root().mu);
+    Root().dir = dir;
+}
+
+const char* FakeFileRoot() {
+    FileRoot& r = Root();
+    std::lock_guard<std::mutex> lock(r.mu);
+    if (r.dir.empty()) {
+        const char* tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/fake_win32_XXXXXX";
+        std::vector<char> buf(pattern.begin(), pattern.end());
+        buf.push_back(0);
+        r.dir = mkdtemp(buf.data()) ? buf.data() : ".";
+    }
+    return r.dir.c_str();
+}
+
+std::string FakeHostPath(const char* winPath) {
+    return std::string(FakeFileRoot()) + "/" + BaseName(winPath);
+}
+
+HMODULE FakeRegisterModule(const char* name, const FakeExport* exports) {
+    FakeModule* m = new FakeModule{ Lower(BaseName(name)), exports };
+    std::lock_guard<std::mutex> lock(g_moduleMu);
+    Modules().push_back(m);
+    return (HMODULE)m;
+}
+
+bool FakeLogContains(const char* needle) {
+    LogState& log = Log();
+    std::lock_guard<std::mutex> lock(log.mu);
+    for (const std::string& line : log.lines) {
+        if (line.find(needle) != std::string::npos) return true;
+    }
+    return false;
+}
+
+void FakeLogClear() {
+    LogState& log = Log();
+    std::lock_guard<std::mutex> lock(log.mu);
+    log.lines.clear();
+}
+
+void FakeExit(int code) {
+    fflush(stdout);
+    fflush(stderr);
+    _exit(code);
+}
+
+// =============================================================================
+// kernel32
+// =============================================================================
+
+extern "C" {
+
+LONG InterlockedCompareExchange(volatile LONG* p, LONG x, LONG cmp) {
+    __atomic_compare_exchange_n(p, &cmp, x, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return cmp;
+}
+LONG InterlockedExchange(volatile LONG* p, LONG v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+LONG InterlockedExchangeAdd(volatile LONG* p, LONG v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+LONG InterlockedIncrement(volatile LONG* p) { return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST); }
+LONG InterlockedDecrement(volatile LONG* p) { return __atomic_sub_fetch(p, 1, __ATOMIC_SEQ_CST); }
+LONG InterlockedOr(volatile LONG* p, LONG v) { return __atomic_fetch_or(p, v, __ATOMIC_SEQ_CST); }
+LONG InterlockedAnd(volatile LONG* p, LONG v) { return __atomic_fetch_and(p, v, __ATOMIC_SEQ_CST); }
+
+LONG64 InterlockedCompareExchange64(volatile LONG64* p, LONG64 x, LONG64 cmp) {
+    __atomic_compare_exchange_n(p, &cmp, x, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return cmp;
+}
+LONG64 InterlockedExchange64(volatile LONG64* p, LONG64 v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+LONG64 InterlockedExchangeAdd64(volatile LONG64* p, LONG64 v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+LONG64 InterlockedAdd64(volatile LONG64* p, LONG64 v) { return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST); }
+LONG64 InterlockedIncrement64(volatile LONG64* p) { return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST); }
+
+PVOID InterlockedCompareExchangePointer(PVOID volatile* p, PVOID x, PVOID cmp) {
+    __atomic_compare_exchange_n(p, &cmp, x, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return cmp;
+}
+PVOID InterlockedExchangePointer(PVOID volatile* p, PVOID v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+PVOID ReadPointerAcquire(PVOID const volatile* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+void MemoryBarrier(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+void _ReadWriteBarrier(void) { __asm__ __volatile__("" ::: "memory"); }
+
+void YieldProcessor(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+unsigned char BitScanForward(DWORD* index, DWORD mask) {
+    if (!mask) return 0;
+    *index = (DWORD)__builtin_ctz(mask);
+    return 1;
+}
+
+DWORD GetLastError(void) { return t_lastError; }
+void SetLastError(DWORD e) { t_lastError = e; }
+DWORD GetCurrentProcessId(void) { return (DWORD)getpid(); }
+
+DWORD GetCurrentThreadId(void) {
+    if (!t_tid) t_tid = g_nextTid++;
+    return t_tid;
+}
+
+HANDLE GetCurrentProcess(void) { return (HANDLE)(LONG_PTR)-1; }
+HANDLE GetCurrentThread(void) { return (HANDLE)(LONG_PTR)-2; }
+
+DWORD GetThreadId(HANDLE h) {
+    if (h == GetCurrentThread()) return GetCurrentThreadId();
+    KObject* o = Obj(h);
+    return o && o->kind == kObjThread ? o->tid : 0;
+}
+
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES, SIZE_T, LPTHREAD_START_ROUTINE fn, LPVOID arg, DWORD, LPDWORD tidOut) {
+    FakeCount(kFakeCreateThread);
+    KObject* o = new KObject(kObjThread);
+    o->refs = 2;
+    o->tid = g_nextTid++;
+    if (tidOut) *tidOut = o->tid;
+
+    std::thread([o, fn, arg] {
+        t_tid = o->tid;
+        const DWORD code = fn(arg);
+        Kernel& k = K();
+        std::lock_guard<std::mutex> lock(k.mu);
+        o->exitCode = code;
+        o->signaled = true;
+        k.cv.notify_all();
+        Unref(o);
+    }).detach();
+    return o;
+}
+
+BOOL SetThreadPriority(HANDLE, int) { return TRUE; }
+
+BOOL GetExitCodeThread(HANDLE h, LPDWORD code) {
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjThread || !code) return FALSE;
+    std::lock_guard<std::mutex> lock(K().mu);
+    *code = o->exitCode;
+    return TRUE;
+}
+
+BOOL CloseHandle(HANDLE h) {
+    KObject* o = Obj(h);
+    if (!o) {
+        t_lastError = ERROR_INVALID_HANDLE;
+        return FALSE;
+    }
+    Kernel& k = K();
+    std::lock_guard<std::mutex> lock(k.mu);
+    if (o->kind == kObjChange) {
+        auto& w = k.changeWatchers;
+        for (size_t i = 0; i < w.size(); i++) {
+            if (w[i] == o) {
+                w.erase(w.begin() + (ptrdiff_t)i);
+                break;
+            }
+        }
+    }
+    Unref(o);
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE h, DWORD ms) {
+    FakeCount(kFakeWaitForSingleObject);
+    return WaitObjects(1, &h, false, ms);
+}
+
+DWORD WaitForMultipleObjects(DWORD n, const HANDLE* hs, BOOL all, DWORD ms) {
+    FakeCount(kFakeWaitForMultipleObjects);
+    return WaitObjects(n, hs, all != FALSE, ms);
+}
+
+void Sleep(DWORD ms) {
+    FakeCount(kFakeSleep);
+    if (ms == 0) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+BOOL SwitchToThread(void) {
+    std::this_thread::yield();
+    return TRUE;
+}
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL manualReset, BOOL initialState, LPCWSTR) {
+    KObject* o = new KObject(kObjEvent);
+    o->manualReset = manualReset != FALSE;
+    o->signaled = initialState != FALSE;
+    return o;
+}
+
+BOOL SetEvent(HANDLE h) {
+    FakeCount(kFakeSetEvent);
+    KObject* o = Obj(h);
+    if (!o) return FALSE;
+    Kernel& k = K();
+    std::lock_guard<std::mutex> lock(k.mu);
+    o->signaled = true;
+    k.cv.notify_all();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE h) {
+    KObject* o = Obj(h);
+    if (!o) return FALSE;
+    std::lock_guard<std::mutex> lock(K().mu);
+    o->signaled = false;
+    return TRUE;
+}
+
+HANDLE CreateWaitableTimerW(LPSECURITY_ATTRIBUTES, BOOL manualReset, LPCWSTR) {
+    KObject* o = new KObject(kObjTimer);
+    o->manualReset = manualReset != FALSE;
+    return o;
+}
+
+HANDLE CreateWaitableTimerExW(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD flags, DWORD) {
+    KObject* o = new KObject(kObjTimer);
+    o->manualReset = (flags & CREATE_WAITABLE_TIMER_MANUAL_RESET) != 0;
+    return o;
+}
+
+// Relative due times only (negative, 100 ns units), which is all the proxy uses.
+BOOL SetWaitableTimer(HANDLE h, const LARGE_INTEGER* due, LONG, void*, LPVOID, BOOL) {
+    FakeCount(kFakeSetWaitableTimer);
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjTimer || !due || due->QuadPart > 0) {
+        t_lastError = ERROR_INVALID_PARAMETER;
+        return FALSE;
+    }
+    Kernel& k = K();
+    std::lock_guard<std::mutex> lock(k.mu);
+    o->signaled = false;
+    o->due = NowNs() + (-due->QuadPart) * 100;
+    if (o->due == 0) o->due = 1;
+    k.cv.notify_all();
+    return TRUE;
+}
+
+// SRW locks: the pointer-sized word is -1 while held exclusively, else the reader count.
+void InitializeSRWLock(PSRWLOCK l) { l->Ptr = nullptr; }
+
+void AcquireSRWLockExclusive(PSRWLOCK l) {
+    intptr_t* w = reinterpret_cast<intptr_t*>(&l->Ptr);
+    for (;;) {
+        intptr_t expected = 0;
+        if (__atomic_compare_exchange_n(w, &expected, (intptr_t)-1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return;
+        std::this_thread::yield();
+    }
+}
+
+void ReleaseSRWLockExclusive(PSRWLOCK l) {
+    __atomic_store_n(reinterpret_cast<intptr_t*>(&l->Ptr), (intptr_t)0, __ATOMIC_RELEASE);
+}
+
+void AcquireSRWLockShared(PSRWLOCK l) {
+    intptr_t* w = reinterpret_cast<intptr_t*>(&l->Ptr);
+    for (;;) {
+        intptr_t v = __atomic_load_n(w, __ATOMIC_RELAXED);
+        if (v >= 0 && __atomic_compare_exchange_n(w, &v, v + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return;
+        std::this_thread::yield();
+    }
+}
+
+void ReleaseSRWLockShared(PSRWLOCK l) {
+    __atomic_fetch_sub(reinterpret_cast<intptr_t*>(&l->Ptr), (intptr_t)1, __ATOMIC_RELEASE);
+}
+
+// 0 = not run, 1 = running, 2 = done.
+BOOL InitOnceExecuteOnce(PINIT_ONCE once, PINIT_ONCE_FN fn, PVOID param, LPVOID* context) {
+    intptr_t* w = reinterpret_cast<intptr_t*>(&once->Ptr);
+    for (;;) {
+        intptr_t v = __atomic_load_n(w, __ATOMIC_ACQUIRE);
+        if (v == 2) return TRUE;
+        if (v == 0 && __atomic_compare_exchange_n(w, &v, (intptr_t)1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            const BOOL ok = fn(once, param, context);
+            __atomic_store_n(w, ok ? (intptr_t)2 : (intptr_t)0, __ATOMIC_RELEASE);
+            return ok;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* t) {
+    FakeCount(kFakeQueryPerformanceCounter);
+    t->QuadPart = NowNs();
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* f) {
+    f->QuadPart = 1000000000;
+    return TRUE;
+}
+
+ULONGLONG GetTickCount64(void) {
+    FakeCount(kFakeGetTickCount);
+    return (ULONGLONG)(NowNs() / 1000000 + g_tickOffsetMs.load());
+}
+
+DWORD GetTickCount(void) {
+    return (DWORD)GetTickCount64();
+}
+
+void GetSystemTimePreciseAsFileTime(LPFILETIME ft) {
+    const ULONGLONG t = (ULONGLONG)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() / 100 + 116444736000000000ULL;
+    ft->dwLowDateTime = (DWORD)t;
+    ft->dwHighDateTime = (DWORD)(t >> 32);
+}
+
+LONG CompareFileTime(const FILETIME* a, const FILETIME* b) {
+    const ULONGLONG x = ((ULONGLONG)a->dwHighDateTime << 32) | a->dwLowDateTime;
+    const ULONGLONG y = ((ULONGLONG)b->dwHighDateTime << 32) | b->dwLowDateTime;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+UINT timeBeginPeriod(UINT) {
+    FakeCount(kFakeTimeBeginPeriod);
+    return TIMERR_NOERROR;
+}
+
+UINT timeEndPeriod(UINT) {
+    FakeCount(kFakeTimeEndPeriod);
+    return TIMERR_NOERROR;
+}
+
+void OutputDebugStringA(LPCSTR s) {
+    FakeCount(kFakeOutputDebugString);
+    LogState& log = Log();
+    std::lock_guard<std::mutex> lock(log.mu);
+    log.lines.emplace_back(s ? s : "");
+    if (log.lines.size() > 256) log.lines.pop_front();
+    if (log.echo) fputs(log.lines.back().c_str(), stderr);
+}
+
+// Rounds half away from zero, like the real one.
+int MulDiv(int a, int b, int c) {
+    if (c == 0) return -1;
+    const long long n = (long long)a * b;
+    long long q = n / c;
+    const long long r = n % c;
+    if (2 * (r < 0 ? -r : r) >= (c < 0 ? -(long long)c : c)) q += ((n < 0) != (c < 0)) ? -1 : 1;
+    return (int)q;
+}
+
+char* lstrcpynA(LPSTR dst, LPCSTR src, int n) {
+    if (n <= 0) return dst;
+    int i = 0;
+    for (; i < n - 1 && src[i]; i++) dst[i] = src[i];
+    dst[i] = 0;
+    return dst;
+}
+
+int wsprintfA(LPSTR buf, LPCSTR fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf, 1024, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+// --- modules -----------------------------------------------------------------
+
+HMODULE GetModuleHandleA(LPCSTR name) {
+    FakeCount(kFakeGetModuleHandle);
+    EnsureUser32();
+    if (!name) return reinterpret_cast<HMODULE>(GameImage());
+    FakeModule* m = FindModule(name);
+    if (!m) t_lastError = ERROR_MOD_NOT_FOUND;
+    return (HMODULE)m;
+}
+
+BOOL GetModuleHandleExA(DWORD flags, LPCSTR name, HMODULE* out) {
+    if (!out) return FALSE;
+    // Every address asked about belongs to the proxy.
+    *out = (flags & GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS)
+        ? reinterpret_cast<HMODULE>(&g_proxyModule) : GetModuleHandleA(name);
+    return *out != nullptr;
+}
+
+DWORD GetModuleFileNameA(HMODULE h, LPSTR buf, DWORD size) {
+    std::string path;
+    if (!h || h == reinterpret_cast<HMODULE>(GameImage())) path = FAKE_GAME_PATH;
+    else if (h == reinterpret_cast<HMODULE>(&g_proxyModule)) path = FAKE_PROXY_PATH;
+    else if (FakeModule* m = ModuleFromHandle(h)) path = "C:\\Windows\\System32\\" + m->name;
+    else {
+        t_lastError = ERROR_MOD_NOT_FOUND;
+        return 0;
+    }
+
+    if (!buf || size == 0) return 0;
+    if (path.size() >= size) {
+        CopyOut(path, buf, size);
+        t_lastError = ERROR_INSUFFICIENT_BUFFER;
+        return size;
+    }
+    return CopyOut(path, buf, size);
+}
+
+HMODULE LoadLibraryA(LPCSTR name) {
+    FakeCount(kFakeLoadLibrary);
+    EnsureUser32();
+    FakeModule* m = name ? FindModule(name) : nullptr;
+    if (!m) t_lastError = ERROR_MOD_NOT_FOUND;
+    return (HMODULE)m;
+}
+
+// Fake modules have no image to map as a resource.
+HMODULE LoadLibraryExA(LPCSTR name, HANDLE, DWORD flags) {
+    if (flags & (LOAD_LIBRARY_AS_IMAGE_RESOURCE | LOAD_LIBRARY_AS_DATAFILE)) {
+        FakeCount(kFakeLoadLibrary);
+        t_lastError = ERROR_MOD_NOT_FOUND;
+        return nullptr;
+    }
+    return LoadLibraryA(name);
+}
+
+BOOL FreeLibrary(HMODULE) { return TRUE; }
+
+void* GetProcAddress(HMODULE h, LPCSTR name) {
+    FakeCount(kFakeGetProcAddress);
+    EnsureUser32();
+    FakeModule* m = ModuleFromHandle(h);
+    if (m && name) {
+        for (const FakeExport* e = m->exports; e && e->name; e++) {
+            if (strcmp(e->name, name) == 0) return e->fn;
+        }
+    }
+    t_lastError = ERROR_PROC_NOT_FOUND;
+    return nullptr;
+}
+
+BOOL DisableThreadLibraryCalls(HMODULE) { return TRUE; }
+
+UINT GetSystemDirectoryA(LPSTR buf, UINT size) {
+    return CopyOut("C:\\Windows\\System32", buf, size);
+}
+
+// The working directory is the game's folder.
+DWORD GetFullPathNameA(LPCSTR path, DWORD size, LPSTR buf, LPSTR* filePart) {
+    std::string full;
+    if (path[0] == '\\' || (path[0] && path[1] == ':')) full = path;
+    else full = std::string("C:\\Games\\Fake\\") + (strncmp(path, ".\\", 2) == 0 ? path + 2 : path);
+
+    if (full.size() >= size) return (DWORD)full.size() + 1;
+    const DWORD n = CopyOut(full, buf, size);
+    if (filePart) *filePart = buf + (BaseName(buf) - buf);
+    return n;
+}
+
+// Fake modules are never mapped, so there is nothing to report.
+SIZE_T VirtualQuery(LPCVOID, PMEMORY_BASIC_INFORMATION, SIZE_T) {
+    t_lastError = ERROR_INVALID_PARAMETER;
+    return 0;
+}
+
+// --- preferences.ini -----------------------------------------------------------
+
+DWORD GetPrivateProfileStringA(LPCSTR section, LPCSTR key, LPCSTR def, LPSTR buf, DWORD size, LPCSTR) {
+    FakeCount(kFakeGetPrivateProfile);
+    IniState& ini = Ini();
+    std::lock_guard<std::mutex> lock(ini.mu);
+    const std::string* v = (section && key) ? IniFind(ini, section, key) : nullptr;
+    return CopyOut(v ? *v : std::string(def ? def : ""), buf, size);
+}
+
+UINT GetPrivateProfileIntA(LPCSTR section, LPCSTR key, INT def, LPCSTR) {
+    FakeCount(kFakeGetPrivateProfile);
+    IniState& ini = Ini();
+    std::lock_guard<std::mutex> lock(ini.mu);
+    const std::string* v = IniFind(ini, section, key);
+    return v ? (UINT)strtol(v->c_str(), nullptr, 10) : (UINT)def;
+}
+
+BOOL WritePrivateProfileStringA(LPCSTR section, LPCSTR key, LPCSTR value, LPCSTR) {
+    FakeCount(kFakeWritePrivateProfile);
+    {
+        IniState& ini = Ini();
+        std::lock_guard<std::mutex> lock(ini.mu);
+        if (!key) {
+            ini.sections.erase(Lower(section));
+        }
+        else if (std::string* v = IniFind(ini, section, key)) {
+            if (value) {
+                *v = value;
+            }
+            else {
+                auto& keys = ini.sections[Lower(section)];
+                for (size_t i = 0; i < keys.size(); i++) {
+                    if (&keys[i].second == v) {
+                        keys.erase(keys.begin() + (ptrdiff_t)i);
+                        break;
+                    }
+                }
+            }
+        }
+        else if (value) {
+            ini.sections[Lower(section)].emplace_back(key, value);
+        }
+    }
+    IniChanged();
+    return TRUE;
+}
+
+// --- files -----------------------------------------------------------------------
+
+HANDLE CreateFileA(LPCSTR path, DWORD access, DWORD, LPSECURITY_ATTRIBUTES, DWORD disposition, DWORD, HANDLE) {
+    FakeCount(kFakeCreateFile);
+    int flags = (access & GENERIC_WRITE) ? ((access & GENERIC_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    switch (disposition) {
+    case CREATE_NEW: flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS: flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS: flags |= O_CREAT; break;
+    default: break;
+    }
+
+    const int fd = open(FakeHostPath(path).c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        t_lastError = errno == ENOENT ? ERROR_FILE_NOT_FOUND
+            : errno == EEXIST ? ERROR_ALREADY_EXISTS : ERROR_ACCESS_DENIED;
+        return INVALID_HANDLE_VALUE;
+    }
+    KObject* o = new KObject(kObjFile);
+    o->fd = fd;
+    return o;
+}
+
+BOOL ReadFile(HANDLE h, LPVOID buf, DWORD n, LPDWORD got, LPOVERLAPPED) {
+    FakeCount(kFakeReadFile);
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjFile) return FALSE;
+    DWORD total = 0;
+    while (total < n) {
+        const ssize_t r = read(o->fd, static_cast<char*>(buf) + total, n - total);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return FALSE;
+        if (r == 0) break;
+        total += (DWORD)r;
+    }
+    if (got) *got = total;
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE h, LPCVOID buf, DWORD n, LPDWORD put, LPOVERLAPPED) {
+    FakeCount(kFakeWriteFile);
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjFile) return FALSE;
+    DWORD total = 0;
+    while (total < n) {
+        const ssize_t r = write(o->fd, static_cast<const char*>(buf) + total, n - total);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return FALSE;
+        total += (DWORD)r;
+    }
+    if (put) *put = total;
+    return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE h, LARGE_INTEGER dist, PLARGE_INTEGER pos, DWORD method) {
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjFile) return FALSE;
+    const int whence = method == FILE_CURRENT ? SEEK_CUR : method == FILE_END ? SEEK_END : SEEK_SET;
+    const off_t r = lseek(o->fd, (off_t)dist.QuadPart, whence);
+    if (r < 0) return FALSE;
+    if (pos) pos->QuadPart = r;
+    return TRUE;
+}
+
+DWORD SetFilePointer(HANDLE h, LONG low, PLONG high, DWORD method) {
+    LARGE_INTEGER d, pos;
+    d.QuadPart = high ? (((LONGLONG)*high << 32) | (DWORD)low) : (LONGLONG)low;
+    if (!SetFilePointerEx(h, d, &pos, method)) return (DWORD)-1;
+    if (high) *high = (LONG)(pos.QuadPart >> 32);
+    return (DWORD)pos.QuadPart;
+}
+
+BOOL SetEndOfFile(HANDLE h) {
+    KObject* o = Obj(h);
+    if (!o || o->kind != kObjFile) return FALSE;
+    const off_t pos = lseek(o->fd, 0, SEEK_CUR);
+    return pos >= 0 && ftruncate(o->fd, pos) == 0;
+}
+
+BOOL FlushFileBuffers(HANDLE h) {
+    KObject* o = Obj(h);
+    return o && o->kind == kObjFile && fsync(o->fd) == 0;
+}
+
+BOOL GetFileSizeEx(HANDLE h, PLARGE_INTEGER size) {
+    KObject* o = Obj(h);
+    struct stat st;
+    if (!o || o->fd < 0 || fstat(o->fd, &st) != 0) return FALSE;
+    size->QuadPart = st.st_size;
+    return TRUE;
+}
+
+DWORD GetFileAttributesA(LPCSTR path) {
+    struct stat st;
+    if (stat(FakeHostPath(path).c_str(), &st) != 0) {
+        t_lastError = ERROR_FILE_NOT_FOUND;
+        return INVALID_FILE_ATTRIBUTES;
+    }
+    return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+// *.ini files are the in-memory table; their write time moves on every change.
+BOOL GetFileAttributesExA(LPCSTR path, GET_FILEEX_INFO_LEVELS, LPVOID out) {
+    WIN32_FILE_ATTRIBUTE_DATA* fad = static_cast<WIN32_FILE_ATTRIBUTE_DATA*>(out);
+    memset(fad, 0, sizeof(*fad));
+    fad->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+
+    if (EndsWith(Lower(path), ".ini")) {
+        IniState& ini = Ini();
+        std::lock_guard<std::mutex> lock(ini.mu);
+        fad->ftLastWriteTime.dwLowDateTime = (DWORD)ini.stamp;
+        fad->ftLastWriteTime.dwHighDateTime = (DWORD)(ini.stamp >> 32);
+        return TRUE;
+    }
+
+    struct stat st;
+    if (stat(FakeHostPath(path).c_str(), &st) != 0) {
+        t_lastError = ERROR_FILE_NOT_FOUND;
+        return FALSE;
+    }
+    const ULONGLONG t = (ULONGLONG)st.st_mtim.tv_sec * 10000000ULL + (ULONGLONG)st.st_mtim.tv_nsec / 100;
+    fad->ftLastWriteTime.dwLowDateTime = (DWORD)t;
+    fad->ftLastWriteTime.dwHighDateTime = (DWORD)(t >> 32);
+    fad->nFileSizeLow = (DWORD)st.st_size;
+    fad->nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    return TRUE;
+}
+
+BOOL MoveFileExA(LPCSTR from, LPCSTR to, DWORD flags) {
+    const std::string dst = FakeHostPath(to);
+    struct stat st;
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && stat(dst.c_str(), &st) == 0) {
+        t_lastError = ERROR_ALREADY_EXISTS;
+        return FALSE;
+    }
+    return rename(FakeHostPath(from).c_str(), dst.c_str()) == 0;
+}
+
+BOOL DeleteFileA(LPCSTR path) {
+    return unlink(FakeHostPath(path).c_str()) == 0;
+}
+
+// Signaled by any change to the ini table, whatever directory is watched.
+HANDLE FindFirstChangeNotificationA(LPCSTR, BOOL, DWORD) {
+    KObject* o = new KObject(kObjChange);
+    Kernel& k = K();
+    std::lock_guard<std::mutex> lock(k.mu);
+    k.changeWatchers.push_back(o);
+    return o;
+}
+
+BOOL FindNextChangeNotification(HANDLE h) {
+    return ResetEvent(h);
+}
+
+BOOL FindCloseChangeNotification(HANDLE h) {
+    return CloseHandle(h);
+}
+
+HANDLE CreateFileMappingA(HANDLE file, LPSECURITY_ATTRIBUTES, DWORD protect, DWORD high, DWORD low, LPCSTR) {
+    KObject* f = Obj(file);
+    if (!f || f->kind != kObjFile) {
+        t_lastError = ERROR_INVALID_HANDLE;
+        return nullptr;
+    }
+
+    const bool writable = (protect & (PAGE_READWRITE | PAGE_EXECUTE_READWRITE)) != 0;
+    LONGLONG size = ((LONGLONG)high << 32) | low;
+    struct stat st;
+    if (fstat(f->fd, &st) != 0) return nullptr;
+    if (size == 0) size = st.st_size;
+    if (size == 0) {
+        t_lastError = ERROR_INVALID_PARAMETER;
+        return nullptr;
+    }
+    if (size > st.st_size && (!writable || ftruncate(f->fd, (off_t)size) != 0)) {
+        t_lastError = ERROR_ACCESS_DENIED;
+        return nullptr;
+    }
+
+    KObject* m = new KObject(kObjMapping);
+    m->fd = dup(f->fd);
+    m->mapSize = size;
+    m->mapWrite = writable;
+    return m;
+}
+
+LPVOID MapViewOfFile(HANDLE mapping, DWORD access, DWORD high, DWORD low, SIZE_T bytes) {
+    KObject* m = Obj(mapping);
+    if (!m || m->kind != kObjMapping) return nullptr;
+
+    const LONGLONG off = ((LONGLONG)high << 32) | low;
+    const size_t len = bytes ? bytes : (size_t)(m->mapSize - off);
+    const bool write = (access & FILE_MAP_WRITE) != 0;
+    if (write && !m->mapWrite) {
+        t_lastError = ERROR_ACCESS_DENIED;
+        return nullptr;
+    }
+
+    void* p = mmap(nullptr, len, PROT_READ | (write ? PROT_WRITE : 0), MAP_SHARED, m->fd, (off_t)off);
+    if (p == MAP_FAILED) {
+        t_lastError = ERROR_NOT_ENOUGH_MEMORY;
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(K().mu);
+    K().views[p] = len;
+    return p;
+}
+
+BOOL UnmapViewOfFile(LPCVOID p) {
+    size_t len = 0;
+    {
+        std::lock_guard<std::mutex> lock(K().mu);
+        auto it = K().views.find(const_cast<void*>(p));
+        if (it == K().views.end()) return FALSE;
+        len = it->second;
+        K().views.erase(it);
+    }
+    return munmap(const_cast<void*>(p), len) == 0;
+}
+
+BOOL FlushViewOfFile(LPCVOID p, SIZE_T) {
+    std::lock_guard<std::mutex> lock(K().mu);
+    auto it = K().views.upper_bound(const_cast<void*>(p));
+    if (it == K().views.begin()) return FALSE;
+    --it;
+    return msync(it->first, it->second, MS_SYNC) == 0;
+}
+
+// =============================================================================
+// user32 / gdi32
+// =============================================================================
+
+BOOL ClipCursor(const RECT* r) {
+    return Site<decltype(&user32::ClipCursor)>(kSiteClipCursor)(r);
+}
+
+HWND SetCapture(HWND hwnd) {
+    return Site<decltype(&user32::SetCapture)>(kSiteSetCapture)(hwnd);
+}
+
+BOOL SetCursorPos(int x, int y) {
+    return Site<decltype(&user32::SetCursorPos)>(kSiteSetCursorPos)(x, y);
+}
+
+LONG ChangeDisplaySettingsExA(LPCSTR dev, DEVMODEA* dm, HWND hwnd, DWORD flags, LPVOID param) {
+    return Site<decltype(&user32::ChangeDisplaySettingsExA)>(kSiteChangeDisplaySettingsExA)(dev, dm, hwnd, flags, param);
+}
+
+LONG ChangeDisplaySettingsExW(LPCWSTR dev, DEVMODEW* dm, HWND hwnd, DWORD flags, LPVOID param) {
+    return Site<decltype(&user32::ChangeDisplaySettingsExW)>(kSiteChangeDisplaySettingsExW)(dev, dm, hwnd, flags, param);
+}
+
+HWND GetForegroundWindow(void) {
+    return Site<decltype(&user32::GetForegroundWindow)>(kSiteGetForegroundWindow)();
+}
+
+BOOL GetClientRect(HWND hwnd, LPRECT rc) {
+    return Site<decltype(&user32::GetClientRect)>(kSiteGetClientRect)(hwnd, rc);
+}
+
+BOOL ScreenToClient(HWND hwnd, LPPOINT pt) {
+    return Site<decltype(&user32::ScreenToClient)>(kSiteScreenToClient)(hwnd, pt);
+}
+
+BOOL ClientToScreen(HWND hwnd, LPPOINT pt) {
+    return Site<decltype(&user32::ClientToScreen)>(kSiteClientToScreen)(hwnd, pt);
+}
+
+UINT GetRawInputData(HRAWINPUT h, UINT cmd, LPVOID data, PUINT size, UINT headerSize) {
+    return Site<decltype(&user32::GetRawInputData)>(kSiteGetRawInputData)(h, cmd, data, size, headerSize);
+}
+
+HWND GetFocus(void) {
+    FakeCount(kFakeGetFocus);
+    std::lock_guard<std::mutex> lock(D().mu);
+    return D().foreground;
+}
+
+HWND GetCapture(void) {
+    FakeCount(kFakeGetCapture);
+    std::lock_guard<std::mutex> lock(D().mu);
+    return D().capture;
+}
+
+BOOL ReleaseCapture(void) {
+    FakeCount(kFakeReleaseCapture);
+    std::lock_guard<std::mutex> lock(D().mu);
+    D().capture = nullptr;
+    return TRUE;
+}
+
+BOOL GetClipCursor(LPRECT rc) {
+    FakeCount(kFakeGetClipCursor);
+    std::lock_guard<std::mutex> lock(D().mu);
+    *rc = D().clipped ? D().clip : D().monitor;
+    return TRUE;
+}
+
+BOOL GetCursorPos(LPPOINT pt) {
+    FakeCount(kFakeGetCursorPos);
+    std::lock_guard<std::mutex> lock(D().mu);
+    *pt = D().cursor;
+    return TRUE;
+}
+
+BOOL IsWindow(HWND hwnd) {
+    FakeCount(kFakeIsWindow);
+    std::lock_guard<std::mutex> lock(D().mu);
+    return Win(hwnd) != nullptr;
+}
+
+BOOL IsWindowVisible(HWND hwnd) {
+    FakeCount(kFakeIsWindowVisible);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    return w && (w->style & WS_VISIBLE);
+}
+
+BOOL IsIconic(HWND) {
+    FakeCount(kFakeIsIconic);
+    return FALSE;
+}
+
+HWND GetWindow(HWND hwnd, UINT cmd) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    return (w && cmd == GW_OWNER) ? w->owner : nullptr;
+}
+
+DWORD GetWindowThreadProcessId(HWND hwnd, LPDWORD pid) {
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w) return 0;
+    if (pid) *pid = (DWORD)getpid();
+    return w->tid;
+}
+
+BOOL EnumWindows(WNDENUMPROC proc, LPARAM lp) {
+    FakeCount(kFakeEnumWindows);
+    std::vector<HWND> live;
+    {
+        std::lock_guard<std::mutex> lock(D().mu);
+        for (FakeWindow* w : D().windows) {
+            if (w->alive) live.push_back((HWND)w);
+        }
+    }
+    for (HWND h : live) {
+        if (!proc(h, lp)) break;
+    }
+    return TRUE;
+}
+
+BOOL GetWindowRect(HWND hwnd, LPRECT rc) {
+    FakeCount(kFakeGetWindowRect);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w || !rc) return FALSE;
+    *rc = w->rect;
+    return TRUE;
+}
+
+LONG_PTR GetWindowLongPtr(HWND hwnd, int index) {
+    FakeCount(kFakeGetWindowLongPtr);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w) return 0;
+    if (index == GWL_STYLE) return w->style;
+    if (index == GWLP_WNDPROC) return reinterpret_cast<LONG_PTR>(w->proc);
+    return 0;
+}
+
+LONG_PTR SetWindowLongPtr(HWND hwnd, int index, LONG_PTR value) {
+    FakeCount(kFakeSetWindowLongPtr);
+    std::lock_guard<std::mutex> lock(D().mu);
+    FakeWindow* w = Win(hwnd);
+    if (!w) return 0;
+    LONG_PTR prev = 0;
+    if (index == GWL_STYLE) {
+        prev = w->style;
+        w->style = value;
+    }
+    else if (index == GWLP_WNDPROC) {
+        prev = reinterpret_cast<LONG_PTR>(w->proc);
+        w->proc = reinterpret_cast<WNDPROC>(value);
+    }
+    return prev;
+}
+
+// Sends WM_WINDOWPOSCHANGED synchronously; DefWindowProc turns it into WM_MOVE/WM_SIZE.
+BOOL SetWindowPos(HWND hwnd, HWND after, int x, int y, int cx, int cy, UINT flags) {
+    FakeCount(kFakeSetWindowPos);
+    WINDOWPOS wp{ hwnd, after, x, y, cx, cy, flags };
+    {
+        std::lock_guard<std::mutex> lock(D().mu);
+        FakeWindow* w = Win(hwnd);
+        if (!w) return FALSE;
+
+        RECT r = w->rect;
+        if (!(flags & SWP_NOMOVE)) {
+            r.right += x - r.left;
+            r.bottom += y - r.top;
+            r.left = x;
+            r.top = y;
+        }
+        if (!(flags & SWP_NOSIZE)) {
+            r.right = r.left + cx;
+            r.bottom = r.top + cy;
+        }
+        if (r.left == w->rect.left && r.top == w->rect.top) wp.flags |= SWP_NOMOVE;
+        if (r.right - r.left == w->rect.right - w->rect.left &&
+            r.bottom - r.top == w->rect.bottom - w->rect.top) wp.flags |= SWP_NOSIZE;
+        w->rect = r;
+        if (flags & SWP_SHOWWINDOW) w->style |= WS_VISIBLE;
+
+        wp.x = r.left;
+        wp.y = r.top;
+        wp.cx = r.right - r.left;
+        wp.cy = r.bottom - r.top;
+    }
+
+    if ((wp.flags & (SWP_NOMOVE | SWP_NOSIZE)) != (SWP_NOMOVE | SWP_NOSIZE) ||
+        (flags & (SWP_FRAMECHANGED | SWP_SHOWWINDOW))) {
+        Send(hwnd, WM_WINDOWPOSCHANGED, 0, reinterpret_cast<LPARAM>(&wp));
+    }
+    return TRUE;
+}
+
+LRESULT DefWindowProc(HWND hwnd, UINT msg, WPARAM, LPARAM lParam) {
+    FakeCount(kFakeDefWindowProc);
+    if (msg != WM_WINDOWPOSCHANGED) return 0;
+
+    const WINDOWPOS* wp = reinterpret_cast<const WINDOWPOS*>(lParam);
+    POINT origin{};
+    SIZE size{};
+    {
+        std::lock_guard<std::mutex> lock(D().mu);
+        FakeWindow* w = Win(hwnd);
+        if (!w) return 0;
+        origin = ClientOrigin(w);
+        size = ClientSize(w);
+    }
+    const bool frame = (wp->flags & SWP_FRAMECHANGED) != 0;
+    if (frame || !(wp->flags & SWP_NOMOVE)) Send(hwnd, WM_MOVE, 0, MAKELPARAM(origin.x, origin.y));
+    if (frame || !(wp->flags & SWP_NOSIZE)) Send(hwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(size.cx, size.cy));
+    return 0;
+}
+
+LRESULT CallWindowProc(WNDPROC proc, HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    FakeCount(kFakeCallWindowProc);
+    return proc ? proc(hwnd, msg, wParam, lParam) : 0;
+}
+
+BOOL PostMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    FakeCount(kFakePostMessage);
+    std::lock_guard<std::mutex> lock(D().mu);
+    MSG m{};
+    m.hwnd = hwnd;
+    m.message = msg;
+    m.wParam = wParam;
+    m.lParam = lParam;
+    D().queue.push_back(m);
+    return TRUE;
+}
+
+BOOL PeekMessageW(LPMSG msg, HWND hwnd, UINT first, UINT last, UINT remove) {
+    FakeCount(kFakePeekMessage);
+    std::lock_guard<std::mutex> lock(D().mu);
+    auto& q = D().queue;
+    for (auto it = q.begin(); it != q.end(); ++it) {
+        if (hwnd && it->hwnd != hwnd) continue;
+        if ((first || last) && (it->message < first || it->message > last)) continue;
+        *msg = *it;
+        if (remove & PM_REMOVE) q.erase(it);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+HMONITOR MonitorFromWindow(HWND, DWORD) {
+    FakeCount(kFakeMonitorFromWindow);
+    return reinterpret_cast<HMONITOR>(&D());
+}
+
+BOOL GetMonitorInfo(HMONITOR mon, LPMONITORINFO mi) {
+    FakeCount(kFakeGetMonitorInfo);
+    if (mon != reinterpret_cast<HMONITOR>(&D()) || !mi || mi->cbSize < sizeof(MONITORINFO)) return FALSE;
+    std::lock_guard<std::mutex> lock(D().mu);
+    mi->rcMonitor = D().monitor;
+    mi->rcWork = D().monitor;
+    mi->dwFlags = 1;
+    return TRUE;
+}
+
+BOOL GetMonitorInfoA(HMONITOR mon, LPMONITORINFO mi) {
+    return GetMonitorInfo(mon, mi);
+}
+
+BOOL SystemParametersInfoA(UINT, UINT, PVOID, UINT) { return FALSE; }
+
+BOOL EqualRect(const RECT* a, const RECT* b) {
+    return a->left == b->left && a->top == b->top && a->right == b->right && a->bottom == b->bottom;
+}
+
+HDC GetDC(HWND hwnd) {
+    FakeCount(kFakeGetDC);
+    return IsWindow(hwnd) ? reinterpret_cast<HDC>(hwnd) : nullptr;
+}
+
+int ReleaseDC(HWND, HDC) { return 1; }
+
+HGDIOBJ GetStockObject(int i) {
+    return reinterpret_cast<HGDIOBJ>((intptr_t)(0x100 + i));
+}
+
+int FillRect(HDC, const RECT*, HBRUSH) {
+    FakeCount(kFakeFillRect);
+    return 1;
+}
+
+}  // extern "C"
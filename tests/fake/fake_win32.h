@@ -0,0 +1,84 @@
+#pragma once
+// Test-side control of the fake kernel32/user32 layer (fake_win32.cpp).
+//
+// The fake keeps one process-wide "desktop": a monitor, a list of windows
+// with a window proc, style, window rect and client size, a foreground
+// window, a cursor clip and a posted-message queue. A test plays the game:
+// it creates its window, sends messages through whatever window proc is
+// current (the proxy subclasses it), and reads back what the proxy did.
+#include <windows.h>
+#include <string>
+#include "fake_calls.h"
+
+// --- desktop ---------------------------------------------------------------
+
+void FakeSetMonitor(const RECT& rc);
+
+// A visible, unowned top-level window of this process with a caption, so
+// ScreenToClient/ClientToScreen see a nonzero client offset.
+HWND FakeCreateWindow(int x, int y, int clientW, int clientH, WNDPROC proc, LONG_PTR style = WS_OVERLAPPEDWINDOW);
+void FakeDestroyWindow(HWND hwnd);
+void FakeSetForeground(HWND hwnd);
+
+// Client size as the fake computes it from the window rect and style.
+SIZE FakeClientSize(HWND hwnd);
+RECT FakeWindowRect(HWND hwnd);
+LONG_PTR FakeWindowStyle(HWND hwnd);
+WNDPROC FakeWindowProc(HWND hwnd);
+
+// Sends through the window's current proc, as DispatchMessage would.
+LRESULT FakeSendMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+// Dispatches posted messages until the queue is empty; returns how many.
+int FakePumpMessages();
+
+// Cursor state the proxy drives through ClipCursor/SetCapture/SetCursorPos.
+bool FakeCursorClipped(RECT* clip = nullptr);
+POINT FakeCursorPos();
+
+// Makes the next GetRawInputData(h, RID_INPUT, ...) return this packet.
+HRAWINPUT FakeQueueRawInput(const RAWINPUT& ri);
+
+// --- preferences.ini -------------------------------------------------------
+
+// GetPrivateProfile* read from this in-memory table, whatever file they name.
+void FakeIniSet(const char* section, const char* key, const char* value);
+void FakeIniClear();
+
+// --- time ------------------------------------------------------------------
+
+// Moves GetTickCount/GetTickCount64 forward (QueryPerformanceCounter is untouched).
+void FakeAdvanceTicks(ULONGLONG ms);
+
+// --- files and modules -----------------------------------------------------
+
+// Windows paths are mapped onto this directory by file name (default: a
+// fresh directory under $TMPDIR). Used for the profile DB and the trace.
+void FakeSetFileRoot(const char* dir);
+const char* FakeFileRoot();
+// Host path that a Windows path passed to CreateFileA maps to.
+std::string FakeHostPath(const char* winPath);
+
+// The proxy "lives" at C:\Games\Fake\d3d9.dll, the game at C:\Games\Fake\game.exe.
+#define FAKE_PROXY_PATH "C:\\Games\\Fake\\d3d9.dll"
+#define FAKE_GAME_PATH "C:\\Games\\Fake\\game.exe"
+
+struct FakeExport {
+    const char* name;
+    void* fn;
+};
+
+// Registers a system DLL for GetModuleHandle/LoadLibrary/GetProcAddress.
+// The export table must stay valid; a null name ends it.
+HMODULE FakeRegisterModule(const char* name, const FakeExport* exports);
+
+// --- process ---------------------------------------------------------------
+
+// Log lines the proxy writes with OutputDebugStringA are kept (last 256) and
+// echoed to stderr when FAKE_WIN32_LOG is set.
+bool FakeLogContains(const char* needle);
+void FakeLogClear();
+
+// Ends the test without running static destructors under the proxy's
+// background threads.
+[[noreturn]] void FakeExit(int code);
@@ -0,0 +1,4 @@
+// hde32.c only compiles for x86 targets, where MinHook uses it. The decoder
+// itself is plain C and decodes x86 code on any host.
+#define _M_IX86 1
+#include "hde32.c"
@@ -0,0 +1,128 @@
+// Decode throughput of hde32_disasm/hde64_disasm, in instructions per second.
+//
+//   hde64_bench <corpus64.txt>
+//
+// "corpus" decodes the corpus instructions laid end to end, the way
+// CreateTrampolineFunction() walks a prologue, and fails if a decoded length
+// ever disagrees with the corpus, since that would desync every instruction
+// after it. "random" decodes random bytes at every third offset, which takes
+// the error and rare-opcode paths far more often. Each is the best of a few
+// rounds; nothing is compared against a stored number.
+#include "hde_corpus.h"
+
+#include <chrono>
+
+namespace {
+
+const size_t kStreamBytes = 1 << 20;
+const int kRounds = 5;
+const int kCorpusPasses = 20;
+
+struct Stream {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> lengths;   // of each instruction in order, for the corpus stream
+};
+
+// Every corpus instruction the decoder accepts, repeated to kStreamBytes,
+// with int3 padding after so the last decode stays inside the buffer.
+Stream CorpusStream(const Corpus& corpus) {
+    Stream s;
+    std::vector<const CorpusLine*> valid;
+    for (const CorpusLine& line : corpus.lines) {
+        if (line.code.empty()) continue;
+        HDE hs;
+        DecodeIsolated(line.code, hs);
+        if (!(hs.flags & F_ERROR)) valid.push_back(&line);
+    }
+    while (!valid.empty() && s.bytes.size() < kStreamBytes) {
+        for (const CorpusLine* line : valid) {
+            s.bytes.insert(s.bytes.end(), line->code.begin(), line->code.end());
+            s.lengths.push_back((uint8_t)line->code.size());
+        }
+    }
+    s.bytes.resize(s.bytes.size() + 32, 0xCC);
+    return s;
+}
+
+Stream RandomStream() {
+    Stream s;
+    s.bytes.resize(kStreamBytes + 32);
+    uint32_t rng = 54321;
+    for (uint8_t& b : s.bytes) {
+        rng = rng * 1103515245u + 12345u;
+        b = (uint8_t)(rng >> 16);
+    }
+    return s;
+}
+
+double Seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Returns instructions per second, or 0 if the stream lost sync.
+double DecodeCorpus(const Stream& s, unsigned long long& sink) {
+    const auto t0 = std::chrono::steady_clock::now();
+    size_t n = 0;
+    for (int pass = 0; pass < kCorpusPasses; pass++) {
+        const uint8_t* p = s.bytes.data();
+        for (uint8_t expected : s.lengths) {
+            HDE hs;
+            const unsigned int len = HDE_DISASM(p, &hs);
+            if (len != expected) {
+                fprintf(stderr, "corpus stream: %u bytes at offset %zu, expected %u\n", len,
+                    (size_t)(p - s.bytes.data()), expected);
+                return 0;
+            }
+            sink += hs.flags;
+            p += len;
+            n++;
+        }
+    }
+    return n / Seconds(t0);
+}
+
+double DecodeRandom(const Stream& s, unsigned long long& sink) {
+    const auto t0 = std::chrono::steady_clock::now();
+    size_t n = 0;
+    for (size_t i = 0; i < kStreamBytes; i += 3) {
+        HDE hs;
+        sink += HDE_DISASM(&s.bytes[i], &hs) + hs.flags;
+        n++;
+    }
+    return n / Seconds(t0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: hde%d_bench <corpus.txt>\n", HDE_BITS);
+        return 2;
+    }
+    Corpus corpus;
+    std::string error;
+    if (!ReadCorpus(argv[1], corpus, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    const Stream prologues = CorpusStream(corpus);
+    const Stream random = RandomStream();
+    if (prologues.lengths.empty()) {
+        fprintf(stderr, "%s: no instructions\n", argv[1]);
+        return 2;
+    }
+
+    unsigned long long sink = 0;
+    double bestCorpus = 0, bestRandom = 0;
+    for (int round = 0; round < kRounds; round++) {
+        const double c = DecodeCorpus(prologues, sink);
+        if (c == 0) return 1;
+        bestCorpus = c > bestCorpus ? c : bestCorpus;
+        const double r = DecodeRandom(random, sink);
+        bestRandom = r > bestRandom ? r : bestRandom;
+    }
+    printf("hde%d_disasm  corpus %7.1f Minstr/s  random %7.1f Minstr/s  (%llu)\n", HDE_BITS, bestCorpus / 1e6,
+        bestRandom / 1e6, sink & 1);
+    return 0;
+}
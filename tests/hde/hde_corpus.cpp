@@ -0,0 +1,110 @@
+// Checks hde32_disasm/hde64_disasm against a recorded corpus (hde_corpus.h).
+//
+//   hde64_corpus <corpus64.txt>            check
+//   hde64_corpus --write <corpus64.txt>    rewrite the decode column and sweep
+//
+// Every listed instruction must decode to its recorded fields and, unless
+// the decoder flags it as an error, to exactly its own length. The sweep
+// must hash to the recorded digest. The recorded output is that of the
+// decoders before their tables were flattened, so any change in what they
+// produce, on any input the sweep covers, fails here.
+#include "check.h"
+#include "hde_corpus.h"
+
+namespace {
+
+const char* g_path = nullptr;
+Corpus g_corpus;
+
+void Instructions() {
+    int n = 0;
+    for (const CorpusLine& line : g_corpus.lines) {
+        if (line.code.empty()) continue;
+        n++;
+        HDE hs;
+        const unsigned int len = DecodeIsolated(line.code, hs);
+        const std::string decoded = FormatDecoded(hs);
+        if (!CHECK(decoded == line.decoded)) {
+            fprintf(stderr, "  %s\n  decodes as: %s\n", line.text.c_str(), decoded.c_str());
+        }
+        CHECK_EQ(len, hs.len);
+        if (!(hs.flags & F_ERROR) && !CHECK_EQ(len, line.code.size())) {
+            fprintf(stderr, "  %s\n", line.text.c_str());
+        }
+        if (!CHECK(CheckDerivedFields(hs))) fprintf(stderr, "  %s\n", line.text.c_str());
+    }
+    CHECK(n > 0);
+}
+
+void Sweep() {
+    long long decodes = 0, badDerived = 0;
+    const std::string digest = SweepDigest(&decodes, &badDerived);
+    printf("sweep: %lld decodes, digest %s\n", decodes, digest.c_str());
+    CHECK(digest == g_corpus.sweep);
+    CHECK_EQ(badDerived, 0);
+}
+
+bool Write() {
+    std::string out;
+    for (const CorpusLine& line : g_corpus.lines) {
+        if (line.code.empty()) {
+            if (Trim(line.text).compare(0, 6, "sweep ") == 0) continue;  // rewritten below
+            out += line.text + "\n";
+            continue;
+        }
+        HDE hs;
+        const unsigned int len = DecodeIsolated(line.code, hs);
+        if (!(hs.flags & F_ERROR) && len != line.code.size()) {
+            fprintf(stderr, "warning: %s: decodes as %u bytes\n", line.text.c_str(), len);
+        }
+        std::string bytes;
+        char hex[4];
+        for (uint8_t b : line.code) {
+            snprintf(hex, sizeof(hex), "%s%02x", bytes.empty() ? "" : " ", b);
+            bytes += hex;
+        }
+        char padded[64];
+        snprintf(padded, sizeof(padded), "%-30s", bytes.c_str());
+        out += std::string(padded) + " | " + FormatDecoded(hs);
+        if (!line.comment.empty()) out += " | " + line.comment;
+        out += "\n";
+    }
+    out += "sweep " + SweepDigest() + "\n";
+
+    FILE* f = fopen(g_path, "wb");
+    if (!f) return false;
+    fwrite(out.data(), 1, out.size(), f);
+    return fclose(f) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool write = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--write")) write = true;
+        else g_path = argv[i];
+    }
+    if (!g_path) {
+        fprintf(stderr, "usage: hde%d_corpus [--write] <corpus.txt>\n", HDE_BITS);
+        return 2;
+    }
+    std::string error;
+    if (!ReadCorpus(g_path, g_corpus, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    if (write) {
+        if (!Write()) {
+            fprintf(stderr, "cannot write %s\n", g_path);
+            return 2;
+        }
+        return 0;
+    }
+
+    RUN_STEP(Instructions);
+    RUN_STEP(Sweep);
+    if (CheckFailures()) fprintf(stderr, "%d check(s) failed\n", CheckFailures());
+    return CheckFailures() ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+#pragma once
+// The HDE decode corpus, shared by hde_corpus and hde_bench. Both are built
+// once per decoder: HDE_BITS (32 or 64) picks hde32_disasm or hde64_disasm
+// the way trampoline.c does, and the matching corpus file.
+//
+// A corpus file lists one instruction per line:
+//
+//   <bytes in hex> | <what the decoder made of them> | <comment>
+//
+// The middle column prints, in hex, every field of the decoded struct that
+// is not zero, except the ones split out of the ModRM and SIB bytes, which
+// CheckDerivedFields() checks instead. (hde64 never fills in `rex` itself,
+// only the REX bits.) A `sweep` line holds a digest of the raw structs over
+// a fixed set of byte strings far larger than the listed instructions.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if HDE_BITS == 64
+#include "hde64.h"
+typedef hde64s HDE;
+#define HDE_DISASM(code, hs) hde64_disasm(code, hs)
+#elif HDE_BITS == 32
+#include "hde32.h"
+typedef hde32s HDE;
+#define HDE_DISASM(code, hs) hde32_disasm(code, hs)
+#else
+#error HDE_BITS must be 32 or 64
+#endif
+
+// Longest instruction x86 allows; the decoder never reads past it.
+const size_t kMaxInstruction = 15;
+
+struct CorpusLine {
+    std::string text;           // the line as read
+    std::vector<uint8_t> code;  // empty for comments and the sweep line
+    std::string decoded;        // middle column
+    std::string comment;
+};
+
+struct Corpus {
+    std::vector<CorpusLine> lines;
+    std::string sweep;
+};
+
+inline std::string Trim(const std::string& s) {
+    const size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return std::string();
+    const size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+inline bool ReadCorpus(const char* path, Corpus& corpus, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+    std::string text;
+    int lineNo = 0;
+    while (std::getline(in, text)) {
+        lineNo++;
+        CorpusLine line;
+        line.text = text;
+        const std::string t = Trim(text);
+        if (t.empty() || t[0] == '#') {
+            corpus.lines.push_back(line);
+            continue;
+        }
+        if (t.compare(0, 6, "sweep ") == 0) {
+            corpus.sweep = Trim(t.substr(6));
+            corpus.lines.push_back(line);
+            continue;
+        }
+        const size_t bar1 = t.find('|');
+        const size_t bar2 = bar1 == std::string::npos ? bar1 : t.find('|', bar1 + 1);
+        std::istringstream bytes(t.substr(0, bar1));
+        std::string hex;
+        while (bytes >> hex) {
+            char* end = nullptr;
+            const unsigned long b = strtoul(hex.c_str(), &end, 16);
+            if (hex.size() != 2 || *end || b > 0xFF) {
+                error = std::string(path) + ":" + std::to_string(lineNo) + ": bad byte '" + hex + "'";
+                return false;
+            }
+            line.code.push_back((uint8_t)b);
+        }
+        if (line.code.empty() || line.code.size() > kMaxInstruction + 1) {
+            error = std::string(path) + ":" + std::to_string(lineNo) + ": expected 1 to 16 bytes";
+            return false;
+        }
+        if (bar1 != std::string::npos) line.decoded = Trim(t.substr(bar1 + 1, bar2 - bar1 - 1));
+        if (bar2 != std::string::npos) line.comment = Trim(t.substr(bar2 + 1));
+        corpus.lines.push_back(line);
+    }
+    return true;
+}
+
+// Decodes `code` with the bytes after it set to int3, so a length that runs
+// past the instruction shows up as a different decode rather than as
+// whatever followed it in memory.
+inline unsigned int DecodeIsolated(const std::vector<uint8_t>& code, HDE& hs) {
+    uint8_t buf[32];
+    memset(buf, 0xCC, sizeof(buf));
+    memcpy(buf, code.data(), code.size());
+    return HDE_DISASM(buf, &hs);
+}
+
+inline std::string FormatFlags(uint32_t flags) {
+    static const struct { uint32_t bit; const char* name; } kNames[] = {
+        { F_MODRM, "MODRM" }, { F_SIB, "SIB" },
+        { F_IMM8, "IMM8" }, { F_IMM16, "IMM16" }, { F_IMM32, "IMM32" },
+#if HDE_BITS == 64
+        { F_IMM64, "IMM64" },
+#endif
+        { F_DISP8, "DISP8" }, { F_DISP16, "DISP16" }, { F_DISP32, "DISP32" },
+        { F_RELATIVE, "RELATIVE" },
+#if HDE_BITS == 32
+        { F_2IMM16, "2IMM16" },
+#endif
+        { F_ERROR, "ERROR" }, { F_ERROR_OPCODE, "ERROR_OPCODE" }, { F_ERROR_LENGTH, "ERROR_LENGTH" },
+        { F_ERROR_LOCK, "ERROR_LOCK" }, { F_ERROR_OPERAND, "ERROR_OPERAND" },
+        { F_PREFIX_REPNZ, "REPNZ" }, { F_PREFIX_REPX, "REPX" },
+        { F_PREFIX_66, "66" }, { F_PREFIX_67, "67" }, { F_PREFIX_LOCK, "LOCK" }, { F_PREFIX_SEG, "SEG" },
+#if HDE_BITS == 64
+        { F_PREFIX_REX, "REX" },
+#endif
+    };
+    std::string s;
+    for (const auto& n : kNames) {
+        if (!(flags & n.bit)) continue;
+        if (!s.empty()) s += ',';
+        s += n.name;
+        flags &= ~n.bit;
+    }
+    if (flags) {
+        char rest[16];
+        snprintf(rest, sizeof(rest), "%s%x", s.empty() ? "" : ",", flags);
+        s += rest;
+    }
+    return s.empty() ? "0" : s;
+}
+
+inline std::string FormatDecoded(const HDE& hs) {
+    std::string s;
+    char field[40];
+    auto add = [&](const char* name, unsigned long long v) {
+        if (!v) return;
+        snprintf(field, sizeof(field), " %s=%llx", name, v);
+        s += field;
+    };
+    snprintf(field, sizeof(field), "len=%u", hs.len);
+    s = field;
+    add("rep", hs.p_rep);
+    add("lock", hs.p_lock);
+    add("seg", hs.p_seg);
+    add("p66", hs.p_66);
+    add("p67", hs.p_67);
+#if HDE_BITS == 64
+    add("rex", hs.rex);
+    add("rex.w", hs.rex_w);
+    add("rex.r", hs.rex_r);
+    add("rex.x", hs.rex_x);
+    add("rex.b", hs.rex_b);
+    add("imm", hs.imm.imm64);
+#else
+    add("imm", hs.imm.imm32);
+#endif
+    add("op", hs.opcode);
+    add("op2", hs.opcode2);
+    add("modrm", hs.modrm);
+    add("sib", hs.sib);
+    add("disp", hs.disp.disp32);
+    return s + " flags=" + FormatFlags(hs.flags);
+}
+
+// The split-out fields agree with the byte they come from, and are zero
+// when the decoder never got to that byte.
+inline bool CheckDerivedFields(const HDE& hs) {
+    bool ok = true;
+#if HDE_BITS == 64
+    if (!(hs.flags & F_PREFIX_REX)) ok &= !hs.rex_w && !hs.rex_r && !hs.rex_x && !hs.rex_b;
+#endif
+    if (hs.flags & F_MODRM) {
+        ok &= hs.modrm_mod == (hs.modrm >> 6) && hs.modrm_reg == ((hs.modrm >> 3) & 7) &&
+              hs.modrm_rm == (hs.modrm & 7);
+    } else {
+        ok &= !hs.modrm && !hs.modrm_mod && !hs.modrm_reg && !hs.modrm_rm;
+    }
+    if (hs.flags & F_SIB) {
+        ok &= hs.sib_scale == (hs.sib >> 6) && hs.sib_index == ((hs.sib >> 3) & 7) &&
+              hs.sib_base == (hs.sib & 7);
+    } else {
+        ok &= !hs.sib && !hs.sib_scale && !hs.sib_index && !hs.sib_base;
+    }
+    return ok;
+}
+
+// --- the sweep -----------------------------------------------------------------
+
+inline void Fnv1a(uint64_t& h, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * 0x100000001B3ull;
+}
+
+// Prefix runs the sweep puts in front of every opcode/ModRM pair, so each
+// prefix path and both opcode maps are taken. REX is only a prefix in 64-bit
+// code; in 32-bit code 0x48 is dec eax and the sweep just decodes that.
+const char* const kSweepPrefixes[] = {
+    "", "66", "67", "f0", "f2", "f3", "2e", "64", "65", "48", "41", "4c",
+    "0f", "66 0f", "f2 0f", "f3 0f", "f0 0f", "48 0f", "66 48", "f3 48 0f",
+    "66 66 66 66 66 66 66 66 66 66 66 66 66",
+};
+
+// Third bytes for the sweep: SIB and immediate-bearing forms, disp32 ones.
+const uint8_t kSweepThird[] = { 0x00, 0x05, 0x24, 0x25, 0x44, 0x84, 0xC0, 0xE5, 0xFF };
+
+// Calls `fn(const uint8_t* code)` for every byte string the sweep covers:
+// each prefix run, then every opcode/ModRM pair and each third byte, then
+// bytes from a fixed generator; and every offset of 256 KiB of such bytes.
+template <typename Fn>
+void ForEachSweepInput(Fn fn) {
+    uint32_t rng = 12345;
+    auto next = [&]() { rng = rng * 1103515245u + 12345u; return (uint8_t)(rng >> 16); };
+
+    uint8_t buf[32];
+    for (const char* prefixes : kSweepPrefixes) {
+        size_t n = 0;
+        for (const char* p = prefixes; *p; p += p[2] ? 3 : 2) buf[n++] = (uint8_t)strtoul(std::string(p, 2).c_str(), nullptr, 16);
+        for (unsigned pair = 0; pair < 0x10000; pair++) {
+            buf[n] = (uint8_t)(pair >> 8);
+            buf[n + 1] = (uint8_t)pair;
+            for (size_t i = n + 3; i < sizeof(buf); i++) buf[i] = next();
+            for (uint8_t third : kSweepThird) {
+                buf[n + 2] = third;
+                fn(buf);
+            }
+        }
+    }
+
+    std::vector<uint8_t> random((256 << 10) + sizeof(buf));
+    for (uint8_t& b : random) b = next();
+    for (size_t i = 0; i + sizeof(buf) <= random.size(); i++) fn(&random[i]);
+}
+
+// FNV-1a over the length and the raw struct of every sweep decode.
+inline std::string SweepDigest(long long* decodes = nullptr, long long* badDerived = nullptr) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    long long n = 0, bad = 0;
+    ForEachSweepInput([&](const uint8_t* code) {
+        HDE hs;
+        const unsigned int len = HDE_DISASM(code, &hs);
+        Fnv1a(h, &len, sizeof(len));
+        Fnv1a(h, &hs, sizeof(hs));
+        bad += !CheckDerivedFields(hs);
+        n++;
+    });
+    if (decodes) *decodes = n;
+    if (badDerived) *badDerived = bad;
+    char s[24];
+    snprintf(s, sizeof(s), "%016llx", (unsigned long long)h);
+    return s;
+}
@@ -0,0 +1,344 @@
+// The trampoline allocator in buffer.c against a fake BUFFER_BACKEND.
+//
+// The fake reports a 32 GB address space at kSpaceLo and keeps its own map of
+// occupied regions, which the tests lay out to crowd or wall off a hook
+// target. Only the blocks buffer.c allocates are backed by memory (mapped at
+// the address it asked for), since it writes its block header into them.
+#include "check.h"
+#include "host_kernel32.h"
+
+#include <map>
+
+#include <sys/mman.h>
+
+namespace {
+
+const ULONG_PTR kGranularity = 0x10000;
+const ULONG_PTR kBlockSize = 0x1000;                        // MEMORY_BLOCK_SIZE
+const UINT kSlotsPerBlock = kBlockSize / MEMORY_SLOT_SIZE - 1;  // slot 0 is the header
+const ULONG_PTR kMaxRange = 0x40000000;                     // MAX_MEMORY_RANGE
+const LONG_PTR kRel32 = 0x7FFFFFFF;
+
+// Far from where Linux puts the executable, the heap and mmap.
+const ULONG_PTR kSpaceLo = 0x300000000000;
+const ULONG_PTR kSpaceHi = kSpaceLo + 0x800000000 - kGranularity - 1;  // inclusive, like 0x7FFFFFFEFFFF
+
+struct Region {
+    ULONG_PTR size;
+    ULONG_PTR allocationBase;
+    DWORD protect;
+    bool mapped;        // backed by a real mapping (a block)
+};
+
+struct FakeSpace {
+    std::map<ULONG_PTR, Region> regions;
+    int queries;
+    int allocs;
+    int frees;
+    ULONG_PTR lowestQuery;
+    ULONG_PTR highestQuery;
+};
+
+FakeSpace g_space;
+
+// Marks [base, base + size) occupied by one allocation, as a module or some
+// other reservation in the way.
+void Occupy(ULONG_PTR base, ULONG_PTR size, DWORD protect = PAGE_READWRITE) {
+    g_space.regions[base] = Region{ size, base, protect, false };
+}
+
+// Occupies `count` separate granule-sized allocations ending at `top`.
+void Crowd(ULONG_PTR top, int count) {
+    for (int i = 1; i <= count; i++) Occupy(top - (ULONG_PTR)i * kGranularity, kGranularity);
+}
+
+const Region* RegionAt(ULONG_PTR addr, ULONG_PTR* base, ULONG_PTR* nextBase) {
+    auto it = g_space.regions.upper_bound(addr);
+    *nextBase = it == g_space.regions.end() ? kSpaceHi + 1 : it->first;
+    if (it == g_space.regions.begin()) return nullptr;
+    --it;
+    if (addr >= it->first + it->second.size) return nullptr;
+    *base = it->first;
+    return &it->second;
+}
+
+// --- the backend -------------------------------------------------------------
+
+void WINAPI FakeGetSystemInfo(LPSYSTEM_INFO si) {
+    memset(si, 0, sizeof(*si));
+    si->dwPageSize = 0x1000;
+    si->lpMinimumApplicationAddress = (LPVOID)kSpaceLo;
+    si->lpMaximumApplicationAddress = (LPVOID)kSpaceHi;
+    si->dwAllocationGranularity = (DWORD)kGranularity;
+}
+
+SIZE_T WINAPI FakeVirtualQuery(LPCVOID address, PMEMORY_BASIC_INFORMATION mbi, SIZE_T) {
+    const ULONG_PTR addr = (ULONG_PTR)address & ~(ULONG_PTR)0xFFF;
+    g_space.queries++;
+    if (addr < g_space.lowestQuery) g_space.lowestQuery = addr;
+    if (addr > g_space.highestQuery) g_space.highestQuery = addr;
+    if (addr < kSpaceLo || addr > kSpaceHi) return 0;
+
+    ULONG_PTR base = 0, nextBase = 0;
+    const Region* r = RegionAt(addr, &base, &nextBase);
+    memset(mbi, 0, sizeof(*mbi));
+    mbi->BaseAddress = (PVOID)addr;
+    if (r) {
+        mbi->AllocationBase = (PVOID)r->allocationBase;
+        mbi->RegionSize = base + r->size - addr;
+        mbi->State = MEM_COMMIT;
+        mbi->Protect = r->protect;
+    }
+    else {
+        mbi->RegionSize = nextBase - addr;
+        mbi->State = MEM_FREE;
+        mbi->Protect = PAGE_NOACCESS;
+    }
+    return sizeof(*mbi);
+}
+
+LPVOID WINAPI FakeVirtualAlloc(LPVOID address, SIZE_T size, DWORD type, DWORD protect) {
+    const ULONG_PTR addr = (ULONG_PTR)address;
+    CHECK_EQ(size, kBlockSize);
+    CHECK_EQ(type, MEM_COMMIT | MEM_RESERVE);
+    CHECK_EQ(protect, PAGE_EXECUTE_READWRITE);
+    if (!CHECK(addr % kGranularity == 0 && addr >= kSpaceLo && addr + size - 1 <= kSpaceHi)) return NULL;
+
+    ULONG_PTR base = 0, nextBase = 0;
+    if (RegionAt(addr, &base, &nextBase) || nextBase < addr + size) return NULL;
+
+    void* p = mmap(address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != address) {
+        fprintf(stderr, "cannot map %p; the host uses the fake address space\n", address);
+        CheckExit();
+    }
+    g_space.regions[addr] = Region{ size, addr, protect, true };
+    g_space.allocs++;
+    return p;
+}
+
+BOOL WINAPI FakeVirtualFree(LPVOID address, SIZE_T size, DWORD type) {
+    CHECK_EQ(size, 0);
+    CHECK_EQ(type, MEM_RELEASE);
+    auto it = g_space.regions.find((ULONG_PTR)address);
+    if (!CHECK(it != g_space.regions.end() && it->second.mapped)) return FALSE;
+    munmap(address, it->second.size);
+    g_space.regions.erase(it);
+    g_space.frees++;
+    return TRUE;
+}
+
+const BUFFER_BACKEND kFakeBufferBackend = {
+    FakeVirtualAlloc, FakeVirtualFree, FakeVirtualQuery, FakeGetSystemInfo
+};
+
+// --- helpers -----------------------------------------------------------------
+
+// Starts over with an empty space and no blocks.
+void Reset() {
+    UninitializeBuffer();
+    CHECK_EQ(g_space.allocs, g_space.frees);
+    g_space = FakeSpace{};
+    g_space.lowestQuery = (ULONG_PTR)-1;
+    InitializeBuffer();
+}
+
+ULONG_PTR BlockOf(LPVOID slot) {
+    return (ULONG_PTR)slot & ~(kBlockSize - 1);
+}
+
+// Allocates near origin and checks the slot is reachable from it by rel32.
+LPVOID Allocate(ULONG_PTR origin) {
+    LPVOID p = AllocateBuffer((LPVOID)origin);
+    if (p) {
+        const LONG_PTR distance = (LONG_PTR)((ULONG_PTR)p - origin);
+        CHECK(distance >= -kRel32 && distance + MEMORY_SLOT_SIZE <= kRel32);
+        CHECK((ULONG_PTR)p % MEMORY_SLOT_SIZE == 0);
+        CHECK((ULONG_PTR)p != BlockOf(p));
+        memset(p, 0xCC, MEMORY_SLOT_SIZE);
+    }
+    return p;
+}
+
+// --- steps -------------------------------------------------------------------
+
+void Setup() {
+    SetBufferBackend(&kFakeBufferBackend);
+    InitializeBuffer();
+}
+
+// A block serves its slots lowest first; the next allocation after the last
+// free slot takes a new block.
+void SlotExhaustion() {
+    Reset();
+    const ULONG_PTR module = kSpaceLo + 0x100000000;
+    Occupy(module, 0x1000000, PAGE_EXECUTE_READ);
+    const ULONG_PTR origin = module + 0x1234;
+
+    LPVOID slots[kSlotsPerBlock];
+    for (UINT i = 0; i < kSlotsPerBlock; i++) slots[i] = Allocate(origin);
+    CHECK_EQ(g_space.allocs, 1);
+    const ULONG_PTR block = BlockOf(slots[0]);
+    for (UINT i = 0; i < kSlotsPerBlock; i++) {
+        if (!CHECK((ULONG_PTR)slots[i] == block + (i + 1) * MEMORY_SLOT_SIZE)) break;
+    }
+
+    // Freed slots of the full block are handed out again, lowest first,
+    // before a new block is taken.
+    FreeBuffer(slots[17]);
+    CHECK(Allocate(origin) == slots[17]);
+    FreeBuffer(slots[40]);
+    FreeBuffer(slots[3]);
+    CHECK(Allocate(origin) == slots[3]);
+    CHECK(Allocate(origin) == slots[40]);
+    CHECK_EQ(g_space.allocs, 1);
+
+    LPVOID next = Allocate(origin);
+    CHECK(next && BlockOf(next) != block);
+    CHECK_EQ(g_space.allocs, 2);
+}
+
+// A block goes back to the OS when its last slot is freed, and only then.
+void BlockRelease() {
+    Reset();
+    const ULONG_PTR module = kSpaceLo + 0x200000000;
+    Occupy(module, 0x1000000, PAGE_EXECUTE_READ);
+    const ULONG_PTR origin = module + 0x10;
+
+    LPVOID first[kSlotsPerBlock];
+    for (UINT i = 0; i < kSlotsPerBlock; i++) first[i] = Allocate(origin);
+    LPVOID second = Allocate(origin);
+    CHECK_EQ(g_space.allocs, 2);
+
+    for (UINT i = 0; i + 1 < kSlotsPerBlock; i++) FreeBuffer(first[i]);
+    CHECK_EQ(g_space.frees, 0);
+    FreeBuffer(first[kSlotsPerBlock - 1]);
+    CHECK_EQ(g_space.frees, 1);
+    CHECK(g_space.regions.count(BlockOf(first[0])) == 0);
+
+    // The last-used block is released too, and not handed out afterwards.
+    FreeBuffer(second);
+    CHECK_EQ(g_space.frees, 2);
+    LPVOID again = Allocate(origin);
+    CHECK(again != NULL);
+    CHECK_EQ(g_space.allocs, 3);
+    FreeBuffer(again);
+    CHECK_EQ(g_space.frees, 3);
+}
+
+// The search for a new block near a module resumes below its last block
+// instead of walking the module's crowded neighbourhood again.
+void RegionHint() {
+    Reset();
+    const int kCrowd = 200;
+    const ULONG_PTR moduleA = kSpaceLo + 0x300000000;
+    const ULONG_PTR moduleB = kSpaceLo + 0x380000000;
+    Occupy(moduleA, 0x1000000, PAGE_EXECUTE_READ);
+    Occupy(moduleB, 0x1000000, PAGE_EXECUTE_READ);
+    Crowd(moduleA, kCrowd);
+    Crowd(moduleB, kCrowd);
+    // Above both modules is walled off, so blocks can only go below.
+    Occupy(moduleA + 0x1000000, 0x40000000);
+    Occupy(moduleB + 0x1000000, 0x40000000);
+
+    g_space.queries = 0;
+    for (UINT i = 0; i < kSlotsPerBlock; i++) Allocate(moduleA + 0x100);
+    CHECK(g_space.queries > kCrowd);
+    CHECK_EQ(g_space.allocs, 1);
+
+    // Blocks of another module keep A's hint intact.
+    for (UINT i = 0; i < kSlotsPerBlock; i++) Allocate(moduleB + 0x100);
+    CHECK_EQ(g_space.allocs, 2);
+
+    ULONG_PTR lastBlock = 0;
+    for (int round = 0; round < 4; round++) {
+        g_space.queries = 0;
+        LPVOID p = Allocate(moduleA + 0x200);
+        for (UINT i = 1; i < kSlotsPerBlock; i++) Allocate(moduleA + 0x200);
+        CHECK(g_space.queries <= 3);
+        const ULONG_PTR block = BlockOf(p);
+        CHECK(block < moduleA - (ULONG_PTR)kCrowd * kGranularity);
+        if (lastBlock) CHECK_EQ(lastBlock - block, kGranularity);
+        lastBlock = block;
+    }
+
+    // A hint to a block that was released still starts the search there.
+    for (UINT i = 0; i < kSlotsPerBlock; i++) {
+        FreeBuffer((LPVOID)(lastBlock + (i + 1) * MEMORY_SLOT_SIZE));
+    }
+    CHECK(g_space.regions.count(lastBlock) == 0);
+    g_space.queries = 0;
+    CHECK(Allocate(moduleA + 0x300) != NULL);
+    CHECK(g_space.queries <= 3);
+}
+
+// Blocks stay within MAX_MEMORY_RANGE of the target, well inside rel32
+// reach, and the clamping holds at the ends of the address space.
+void RangeLimits() {
+    const ULONG_PTR origin = kSpaceLo + 0x400000000;
+
+    // Walled off in both directions up to the range: no block, and nothing
+    // outside the window is even looked at.
+    Reset();
+    Occupy(origin - kMaxRange - 0x100000, 2 * kMaxRange + 0x200000, PAGE_EXECUTE_READ);
+    CHECK(Allocate(origin) == NULL);
+    CHECK_EQ(g_space.allocs, 0);
+    CHECK(g_space.lowestQuery >= origin - kMaxRange - kGranularity);
+    CHECK(g_space.highestQuery <= origin + kMaxRange);
+
+    // The last granule inside the window below the target is used.
+    Reset();
+    Occupy(origin - kMaxRange - 0x100000, 2 * kMaxRange + 0x100000 - kGranularity, PAGE_EXECUTE_READ);
+    LPVOID p = Allocate(origin);
+    CHECK(p && BlockOf(p) == origin + kMaxRange - kGranularity);
+
+    // One granule further is out of range.
+    Reset();
+    Occupy(origin - kMaxRange - 0x100000, 2 * kMaxRange + 0x100000, PAGE_EXECUTE_READ);
+    CHECK(Allocate(origin) == NULL);
+
+    // Above the target, exactly MAX_MEMORY_RANGE away is still in range...
+    Reset();
+    Occupy(origin - kMaxRange + kGranularity, 2 * kMaxRange, PAGE_EXECUTE_READ);
+    p = Allocate(origin);
+    CHECK(p && BlockOf(p) == origin - kMaxRange);
+
+    // ...and one granule more is not.
+    Reset();
+    Occupy(origin - kMaxRange, 2 * kMaxRange, PAGE_EXECUTE_READ);
+    CHECK(Allocate(origin) == NULL);
+
+    // A block near one target is not reused for a target 3 GB away.
+    Reset();
+    LPVOID nearA = Allocate(origin);
+    LPVOID nearB = Allocate(origin + 0xC0000000);
+    CHECK(nearA && nearB && BlockOf(nearA) != BlockOf(nearB));
+    CHECK_EQ(g_space.allocs, 2);
+
+    // Near the bottom and top of the address space, the window is clamped
+    // instead of wrapping around.
+    Reset();
+    Occupy(kSpaceLo + kGranularity, 0x20000000, PAGE_EXECUTE_READ);
+    p = Allocate(kSpaceLo + 0x100000);
+    CHECK(p && BlockOf(p) == kSpaceLo);
+    CHECK(g_space.lowestQuery >= kSpaceLo);
+
+    Reset();
+    const ULONG_PTR top = kSpaceHi + 1 - kGranularity;
+    Occupy(top - 2 * kMaxRange, 2 * kMaxRange, PAGE_EXECUTE_READ);
+    p = Allocate(top - 0x100000);
+    CHECK(p && BlockOf(p) == top);
+    CHECK(g_space.highestQuery <= kSpaceHi);
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Setup);
+    RUN_STEP(SlotExhaustion);
+    RUN_STEP(BlockRelease);
+    RUN_STEP(RegionHint);
+    RUN_STEP(RangeLimits);
+    Reset();
+    CheckExit();
+}
@@ -0,0 +1,406 @@
+// Freeze()/Unfreeze() in hook.c against a fake thread provider (THREAD_BACKEND).
+//
+// The fake models the threads of the process: an ID, an owner process, an
+// IP, a suspend count, and whether OpenThread or SuspendThread works on it.
+// Hooks are real, on code written into an executable page, so the IP fix-ups
+// move the fake threads between targets and trampolines as on Windows.
+#include "check.h"
+#include "host_kernel32.h"
+
+#include <vector>
+
+namespace {
+
+const LONG kStatusNoMoreEntries = (LONG)0x8000001A;
+const LONG kStatusAccessDenied = (LONG)0xC0000022;
+const ULONG_PTR kHandleBase = 0x70000;
+const DWORD kFakeTidBase = 0x40000000;  // above any real thread ID, so none matches the caller's
+HANDLE const kSnapshot = (HANDLE)(ULONG_PTR)0x6F000;
+
+// push rbp / mov rbp, rsp / sub rsp, 20h / ret: MinHook copies the first
+// three instructions, so the boundaries are at +0, +1 and +4.
+const BYTE kPrologue[] = { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0xC3 };
+const UINT kTargetStride = 64;
+const UINT kTargets = 4;
+
+struct FakeThread {
+    DWORD tid;
+    DWORD pid;
+    DWORD64 ip;
+    bool openable;
+    bool suspendFails;
+    int suspendCount;
+    int opens;          // handles currently open
+    int suspends;       // successful SuspendThread calls
+    int resumes;
+};
+
+struct FakeThreads {
+    std::vector<FakeThread> threads;
+    bool hasNtGetNextThread;
+    size_t ntFailAt;    // walk position at which NtGetNextThread is denied
+
+    int walks;          // NtGetNextThread walks started
+    int snapshots;
+    int openSnapshots;
+    int getContexts;
+    int setContexts;
+    int maxSuspended;
+    int suspendedNow;
+
+    // First byte of `watch` when the first thread was suspended and when the
+    // last one was resumed: the patch must land between the two.
+    const BYTE* watch;
+    int watchAtSuspend;
+    int watchAtResume;
+};
+
+FakeThreads g_fake;
+
+BYTE* g_code = nullptr;
+LPVOID g_trampolines[kTargets];
+size_t g_snapshotPos = 0;
+
+LPVOID Target(UINT i) {
+    return g_code + i * kTargetStride;
+}
+
+LPVOID Detour() {
+    return g_code + 0x800;
+}
+
+DWORD64 Ip(const void* p, UINT offset) {
+    return (DWORD64)(ULONG_PTR)p + offset;
+}
+
+FakeThread* FromHandle(HANDLE h) {
+    const ULONG_PTR i = (ULONG_PTR)h - kHandleBase;
+    return i < g_fake.threads.size() ? &g_fake.threads[i] : nullptr;
+}
+
+HANDLE ToHandle(const FakeThread& t) {
+    return (HANDLE)(kHandleBase + (ULONG_PTR)(&t - g_fake.threads.data()));
+}
+
+FakeThread& AddThread(DWORD64 ip, DWORD pid = 0) {
+    FakeThread t{};
+    t.tid = kFakeTidBase + (DWORD)g_fake.threads.size();
+    t.pid = pid ? pid : GetCurrentProcessId();
+    t.ip = ip;
+    t.openable = true;
+    g_fake.threads.push_back(t);
+    return g_fake.threads.back();
+}
+
+// Resets the model to the calling thread plus `others` idle threads.
+void ResetThreads(int others) {
+    g_fake = FakeThreads{};
+    g_fake.hasNtGetNextThread = true;
+    g_fake.ntFailAt = (size_t)-1;
+    g_fake.watchAtSuspend = g_fake.watchAtResume = -1;
+    g_fake.threads.reserve(512);
+    AddThread(Ip(Detour(), 0)).tid = GetCurrentThreadId();
+    for (int i = 0; i < others; i++) AddThread(Ip(Detour(), 0));
+}
+
+// --- the provider ----------------------------------------------------------
+
+LONG NTAPI FakeNtGetNextThread(HANDLE, HANDLE current, ACCESS_MASK, ULONG, ULONG, PHANDLE next) {
+    size_t i = 0;
+    if (current == NULL) g_fake.walks++;
+    else i = (size_t)(FromHandle(current) - g_fake.threads.data()) + 1;
+
+    // Only this process's threads, as NtGetNextThread(GetCurrentProcess()).
+    while (i < g_fake.threads.size() && g_fake.threads[i].pid != GetCurrentProcessId()) i++;
+    if (i == g_fake.ntFailAt) return kStatusAccessDenied;
+    if (i >= g_fake.threads.size()) return kStatusNoMoreEntries;
+
+    g_fake.threads[i].opens++;
+    *next = ToHandle(g_fake.threads[i]);
+    return 0;
+}
+
+FARPROC WINAPI FakeGetProcAddress(HMODULE, LPCSTR name) {
+    if (g_fake.hasNtGetNextThread && strcmp(name, "NtGetNextThread") == 0)
+        return (FARPROC)&FakeNtGetNextThread;
+    return NULL;
+}
+
+HANDLE WINAPI FakeCreateToolhelp32Snapshot(DWORD flags, DWORD) {
+    CHECK(flags & TH32CS_SNAPTHREAD);
+    g_fake.snapshots++;
+    g_fake.openSnapshots++;
+    return kSnapshot;
+}
+
+BOOL WINAPI FakeThread32Next(HANDLE h, LPTHREADENTRY32 te) {
+    CHECK(h == kSnapshot);
+    if (g_snapshotPos >= g_fake.threads.size()) {
+        SetLastError(ERROR_NO_MORE_FILES);
+        return FALSE;
+    }
+    const FakeThread& t = g_fake.threads[g_snapshotPos++];
+    te->th32ThreadID = t.tid;
+    te->th32OwnerProcessID = t.pid;
+    return TRUE;
+}
+
+BOOL WINAPI FakeThread32First(HANDLE h, LPTHREADENTRY32 te) {
+    g_snapshotPos = 0;
+    return FakeThread32Next(h, te);
+}
+
+HANDLE WINAPI FakeOpenThread(DWORD access, BOOL, DWORD tid) {
+    CHECK((access & (THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_SET_CONTEXT))
+        == (THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_SET_CONTEXT));
+    for (FakeThread& t : g_fake.threads) {
+        if (t.tid != tid) continue;
+        if (!t.openable) {
+            SetLastError(ERROR_ACCESS_DENIED);
+            return NULL;
+        }
+        t.opens++;
+        return ToHandle(t);
+    }
+    SetLastError(ERROR_INVALID_PARAMETER);
+    return NULL;
+}
+
+DWORD WINAPI FakeGetThreadId(HANDLE h) {
+    FakeThread* t = FromHandle(h);
+    return t ? t->tid : 0;
+}
+
+DWORD WINAPI FakeSuspendThread(HANDLE h) {
+    FakeThread* t = FromHandle(h);
+    if (!CHECK(t && t->opens > 0) || t->suspendFails) return (DWORD)-1;
+    if (g_fake.suspendedNow == 0 && g_fake.watch) g_fake.watchAtSuspend = *g_fake.watch;
+    t->suspends++;
+    g_fake.suspendedNow++;
+    if (g_fake.suspendedNow > g_fake.maxSuspended) g_fake.maxSuspended = g_fake.suspendedNow;
+    return (DWORD)t->suspendCount++;
+}
+
+DWORD WINAPI FakeResumeThread(HANDLE h) {
+    FakeThread* t = FromHandle(h);
+    if (!CHECK(t && t->suspendCount > 0)) return (DWORD)-1;
+    t->resumes++;
+    if (--g_fake.suspendedNow == 0 && g_fake.watch) g_fake.watchAtResume = *g_fake.watch;
+    return (DWORD)t->suspendCount--;
+}
+
+BOOL WINAPI FakeGetThreadContext(HANDLE h, LPCONTEXT c) {
+    FakeThread* t = FromHandle(h);
+    if (!CHECK(t && t->suspendCount > 0)) return FALSE;
+    CHECK(c->ContextFlags & CONTEXT_CONTROL);
+    g_fake.getContexts++;
+    c->Rip = t->ip;
+    return TRUE;
+}
+
+BOOL WINAPI FakeSetThreadContext(HANDLE h, const CONTEXT* c) {
+    FakeThread* t = FromHandle(h);
+    if (!CHECK(t && t->suspendCount > 0)) return FALSE;
+    g_fake.setContexts++;
+    t->ip = c->Rip;
+    return TRUE;
+}
+
+BOOL WINAPI FakeCloseHandle(HANDLE h) {
+    if (h == kSnapshot) {
+        g_fake.openSnapshots--;
+        return TRUE;
+    }
+    FakeThread* t = FromHandle(h);
+    if (!CHECK(t && t->opens > 0)) return FALSE;
+    t->opens--;
+    return TRUE;
+}
+
+const THREAD_BACKEND kFakeThreadBackend = {
+    FakeGetProcAddress, FakeCreateToolhelp32Snapshot, FakeThread32First, FakeThread32Next,
+    FakeOpenThread, FakeGetThreadId, FakeSuspendThread, FakeResumeThread,
+    FakeGetThreadContext, FakeSetThreadContext, FakeCloseHandle
+};
+
+// --- checks ----------------------------------------------------------------
+
+// Nothing stays open or suspended between MinHook calls.
+void CheckSettled() {
+    for (const FakeThread& t : g_fake.threads) {
+        CHECK_EQ(t.opens, 0);
+        CHECK_EQ(t.suspendCount, 0);
+    }
+    CHECK_EQ(g_fake.openSnapshots, 0);
+    CHECK_EQ(g_fake.suspendedNow, 0);
+}
+
+void CreateHooks() {
+    for (UINT i = 0; i < kTargets; i++) {
+        memcpy(Target(i), kPrologue, sizeof(kPrologue));
+        CHECK_EQ(MH_CreateHook(Target(i), Detour(), &g_trampolines[i]), MH_OK);
+    }
+}
+
+void Restart(bool hasNtGetNextThread) {
+    CHECK_EQ(MH_Uninitialize(), MH_OK);
+    g_fake.hasNtGetNextThread = hasNtGetNextThread;
+    CHECK_EQ(MH_Initialize(), MH_OK);
+    CreateHooks();
+}
+
+// --- steps -----------------------------------------------------------------
+
+void Setup() {
+    g_code = (BYTE*)VirtualAlloc(NULL, 0x1000, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!CHECK(g_code)) CheckExit();
+    memset(g_code, 0xCC, 0x1000);
+    g_code[0x800] = 0xC3;
+
+    ResetThreads(3);
+    SetThreadBackend(&kFakeThreadBackend);
+    CHECK_EQ(MH_Initialize(), MH_OK);
+    CreateHooks();
+}
+
+// NtGetNextThread walks this process only and opens as it goes; each thread
+// but the caller is suspended once per enable, and the patch is written
+// while they are.
+void NtWalk() {
+    ResetThreads(0);
+    FakeThread& inPrologue = AddThread(Ip(Target(0), 1));
+    FakeThread& later = AddThread(Ip(Target(1), 4));
+    FakeThread& elsewhere = AddThread(Ip(Detour(), 0));
+    FakeThread& foreign = AddThread(Ip(Target(2), 1), GetCurrentProcessId() + 1);
+    g_fake.watch = (const BYTE*)Target(0);
+
+    CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(g_fake.walks, 1);
+    CHECK_EQ(g_fake.snapshots, 0);
+    CHECK_EQ(g_fake.watchAtSuspend, 0x55);
+    CHECK_EQ(g_fake.watchAtResume, 0xE9);
+    CHECK_EQ(g_fake.maxSuspended, 3);
+    CHECK_EQ(g_fake.threads[0].suspends, 0);
+    CHECK_EQ(inPrologue.suspends, 1);
+    CHECK_EQ(later.suspends, 1);
+    CHECK_EQ(elsewhere.suspends, 1);
+    CHECK_EQ(foreign.suspends, 0);
+
+    // Threads at an instruction boundary of a patched prologue continue in
+    // the trampoline; the foreign one is not this process's to move.
+    CHECK(inPrologue.ip == Ip(g_trampolines[0], 1));
+    CHECK(later.ip == Ip(g_trampolines[1], 4));
+    CHECK(elsewhere.ip == Ip(Detour(), 0));
+    CHECK(foreign.ip == Ip(Target(2), 1));
+    CHECK_EQ(g_fake.getContexts, 3);
+    CHECK_EQ(g_fake.setContexts, 2);
+    CheckSettled();
+
+    // Disabling one hook moves only the threads in its trampoline back.
+    CHECK_EQ(MH_DisableHook(Target(1)), MH_OK);
+    CHECK(later.ip == Ip(Target(1), 4));
+    CHECK(inPrologue.ip == Ip(g_trampolines[0], 1));
+    CHECK_EQ(g_fake.walks, 2);
+    CheckSettled();
+
+    CHECK_EQ(MH_DisableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK(inPrologue.ip == Ip(Target(0), 1));
+    CheckSettled();
+}
+
+// A thread the walk may not open makes it start over with a snapshot,
+// without leaking the handles it had opened so far.
+void NtWalkDenied() {
+    ResetThreads(4);
+    g_fake.ntFailAt = 3;
+
+    CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(g_fake.walks, 1);
+    CHECK_EQ(g_fake.snapshots, 1);
+    for (size_t i = 1; i < g_fake.threads.size(); i++) CHECK_EQ(g_fake.threads[i].suspends, 1);
+    CheckSettled();
+    CHECK_EQ(MH_DisableHook(MH_ALL_HOOKS), MH_OK);
+    CheckSettled();
+}
+
+// Without NtGetNextThread: the snapshot lists every process, and threads
+// that cannot be opened or suspended are left alone.
+void Toolhelp() {
+    ResetThreads(0);
+    Restart(false);
+    FakeThread& closed = AddThread(Ip(Target(0), 1));
+    closed.openable = false;
+    FakeThread& stuck = AddThread(Ip(Target(1), 1));
+    stuck.suspendFails = true;
+    FakeThread& normal = AddThread(Ip(Target(2), 1));
+    FakeThread& foreign = AddThread(Ip(Target(3), 1), GetCurrentProcessId() + 1);
+
+    CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(g_fake.walks, 0);
+    CHECK_EQ(g_fake.snapshots, 1);
+    CHECK_EQ(closed.suspends, 0);
+    CHECK_EQ(stuck.suspends, 0);
+    CHECK_EQ(stuck.resumes, 0);
+    CHECK_EQ(normal.suspends, 1);
+    CHECK_EQ(foreign.suspends, 0);
+    CHECK(closed.ip == Ip(Target(0), 1));
+    CHECK(stuck.ip == Ip(Target(1), 1));
+    CHECK(normal.ip == Ip(g_trampolines[2], 1));
+    CHECK(foreign.ip == Ip(Target(3), 1));
+    CheckSettled();
+    CHECK_EQ(MH_DisableHook(MH_ALL_HOOKS), MH_OK);
+    CheckSettled();
+}
+
+// More threads than the initial handle buffer holds, twice, so the second
+// Freeze() reuses the grown buffer.
+void ManyThreads() {
+    for (int round = 0; round < 2; round++) {
+        const bool nt = round == 0;
+        ResetThreads(300);
+        Restart(nt);
+        CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+        CHECK_EQ(MH_DisableHook(MH_ALL_HOOKS), MH_OK);
+        CHECK_EQ(g_fake.maxSuspended, 300);
+        int both = 0;
+        for (size_t i = 1; i < g_fake.threads.size(); i++) both += g_fake.threads[i].suspends == 2;
+        CHECK_EQ(both, 300);
+        CheckSettled();
+    }
+}
+
+// Hook calls that change nothing freeze nothing.
+void NoOpFreezesNothing() {
+    ResetThreads(2);
+    CHECK_EQ(MH_DisableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(MH_QueueDisableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(MH_ApplyQueued(), MH_OK);
+    CHECK_EQ(g_fake.walks + g_fake.snapshots, 0);
+}
+
+// NULL puts the OS functions back: the provider sees no more calls.
+void DefaultBackend() {
+    CHECK_EQ(MH_Uninitialize(), MH_OK);
+    ResetThreads(2);
+    SetThreadBackend(NULL);
+    CHECK_EQ(MH_Initialize(), MH_OK);
+    CreateHooks();
+    CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+    CHECK_EQ(((BYTE*)Target(0))[0], 0xE9);
+    CHECK_EQ(MH_Uninitialize(), MH_OK);
+    CHECK_EQ(((BYTE*)Target(0))[0], 0x55);
+    CHECK_EQ(g_fake.walks + g_fake.snapshots, 0);
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Setup);
+    RUN_STEP(NtWalk);
+    RUN_STEP(NtWalkDenied);
+    RUN_STEP(Toolhelp);
+    RUN_STEP(ManyThreads);
+    RUN_STEP(NoOpFreezesNothing);
+    RUN_STEP(DefaultBackend);
+    CheckExit();
+}
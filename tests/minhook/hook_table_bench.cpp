@@ -0,0 +1,112 @@
+// Cost of the hook table lookups in MH_CreateHook, MH_QueueEnableHook,
+// MH_DisableHook and MH_RemoveHook as the table grows.
+//
+//   hook_table_bench
+//
+// For each table size, creates that many hooks on synthetic targets in one
+// executable region, queues and applies them, then disables and removes them
+// one by one. Reports ns per hook for each phase; "lookup" (queueing a hooked
+// target) and "miss" (queueing one that isn't) do nothing but find the
+// entry, so they should stay flat from the smallest table to the largest.
+// Fails if any call returns an unexpected status or a target is left
+// patched; nothing is compared against a stored number.
+#include "check.h"
+#include "host_kernel32.h"
+
+#include <chrono>
+
+namespace {
+
+// push rbp / mov rbp, rsp / sub rsp, 20h / ret, one per stride.
+const BYTE kPrologue[] = { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0xC3 };
+const UINT kTargetStride = 16;
+const UINT kSizes[] = { 64, 512, 4096 };
+const UINT kMaxTargets = 4096;
+
+BYTE* g_code = nullptr;
+
+LPVOID Target(UINT i) {
+    return g_code + i * kTargetStride;
+}
+
+// Never called; every hook shares it.
+LPVOID Detour() {
+    return g_code + kMaxTargets * kTargetStride;
+}
+
+// An address in the region that is never hooked.
+LPVOID Unhooked(UINT i) {
+    return g_code + i * kTargetStride + 8;
+}
+
+double Seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Runs `fn(i)` for every hook and returns ns per call; counts statuses
+// other than `expected` as failures.
+template <typename Fn>
+double NsPerHook(UINT count, MH_STATUS expected, const char* what, Fn fn) {
+    int bad = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (UINT i = 0; i < count; i++) bad += fn(i) != expected;
+    const double ns = Seconds(t0) * 1e9 / count;
+    if (bad) {
+        fprintf(stderr, "%s: %d of %u calls did not return %s\n", what, bad, count, MH_StatusToString(expected));
+        CheckFailures()++;
+    }
+    return ns;
+}
+
+void Setup() {
+    const SIZE_T size = kMaxTargets * kTargetStride + 0x1000;
+    g_code = (BYTE*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!CHECK(g_code)) CheckExit();
+    memset(g_code, 0xCC, size);
+    for (UINT i = 0; i < kMaxTargets; i++) memcpy(Target(i), kPrologue, sizeof(kPrologue));
+    *(BYTE*)Detour() = 0xC3;
+}
+
+void Table() {
+    printf("%6s %9s %9s %9s %9s %9s %9s\n", "hooks", "create", "lookup", "miss", "apply", "disable", "remove");
+    for (UINT count : kSizes) {
+        if (!CHECK_EQ(MH_Initialize(), MH_OK)) return;
+
+        const double create = NsPerHook(count, MH_OK, "MH_CreateHook",
+            [](UINT i) { return MH_CreateHook(Target(i), Detour(), NULL); });
+        const double lookup = NsPerHook(count, MH_OK, "MH_QueueEnableHook",
+            [](UINT i) { return MH_QueueEnableHook(Target(i)); });
+        const double miss = NsPerHook(count, MH_ERROR_NOT_CREATED, "MH_QueueEnableHook (unhooked)",
+            [](UINT i) { return MH_QueueEnableHook(Unhooked(i)); });
+
+        const auto t0 = std::chrono::steady_clock::now();
+        CHECK_EQ(MH_ApplyQueued(), MH_OK);
+        const double apply = Seconds(t0) * 1e9 / count;
+
+        int patched = 0;
+        for (UINT i = 0; i < count; i++) patched += *(BYTE*)Target(i) == 0xE9;
+        CHECK_EQ(patched, count);
+        CHECK_EQ(MH_CreateHook(Target(count - 1), Detour(), NULL), MH_ERROR_ALREADY_CREATED);
+
+        const double disable = NsPerHook(count, MH_OK, "MH_DisableHook",
+            [](UINT i) { return MH_DisableHook(Target(i)); });
+        const double remove = NsPerHook(count, MH_OK, "MH_RemoveHook",
+            [](UINT i) { return MH_RemoveHook(Target(i)); });
+
+        int restored = 0;
+        for (UINT i = 0; i < count; i++) restored += memcmp(Target(i), kPrologue, sizeof(kPrologue)) == 0;
+        CHECK_EQ(restored, count);
+        CHECK_EQ(MH_EnableHook(Target(0)), MH_ERROR_NOT_CREATED);
+        CHECK_EQ(MH_Uninitialize(), MH_OK);
+
+        printf("%6u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", count, create, lookup, miss, apply, disable, remove);
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Setup);
+    RUN_STEP(Table);
+    CheckExit();
+}
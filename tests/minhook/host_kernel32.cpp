@@ -0,0 +1,353 @@
+// kernel32 for running MinHook's own sources (third_party/minhook/src) on
+// Linux x86-64.
+//
+// Unlike fake_win32.cpp, nothing here is a model: memory is the process's
+// real address space, read from /proc/self/maps and changed with mmap and
+// mprotect, so MinHook allocates trampolines near real code and patches it
+// for real. The thread functions see only the calling thread; tests that
+// need other threads install a THREAD_BACKEND (hook.h) of their own.
+#include "host_kernel32.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ERROR_NOT_SUPPORTED 50
+#define ERROR_INVALID_ADDRESS 487
+#define HOST_GRANULARITY 0x10000
+#define HOST_PAGE 0x1000
+#define HOST_MIN_ADDRESS 0x10000
+#define HOST_MAX_ADDRESS 0x7FFFFFFEFFFFull
+
+namespace {
+
+thread_local DWORD t_lastError = 0;
+
+// VirtualAlloc'ed regions by base, for VirtualFree(MEM_RELEASE).
+std::mutex g_allocMu;
+std::map<ULONG_PTR, SIZE_T> g_allocs;
+
+HANDLE const kHeap = (HANDLE)(ULONG_PTR)0x4EA9;
+HANDLE const kSnapshot = (HANDLE)(ULONG_PTR)0x5A95;
+HMODULE const kKernelBase = (HMODULE)(ULONG_PTR)0x4B42;
+
+bool g_provideWaitOnAddress = false;
+
+// WaitOnAddress/WakeByAddressSingle on a futex; MinHook only waits on LONGs.
+BOOL WINAPI HostWaitOnAddress(volatile VOID* address, PVOID compare, SIZE_T size, DWORD ms) {
+    if (size != sizeof(LONG) || ms != INFINITE) {
+        t_lastError = ERROR_NOT_SUPPORTED;
+        return FALSE;
+    }
+    syscall(SYS_futex, (void*)address, FUTEX_WAIT_PRIVATE, *(const LONG*)compare, nullptr, nullptr, 0);
+    return TRUE;
+}
+
+VOID WINAPI HostWakeByAddressSingle(PVOID address) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+bool IsModule(LPCWSTR name, const char* expected) {
+    if (!name) return false;
+    for (; *expected; name++, expected++) {
+        if (*name != (wchar_t)*expected) return false;
+    }
+    return *name == 0;
+}
+
+struct Mapping {
+    ULONG_PTR lo, hi;
+    DWORD protect;
+    ULONG_PTR allocationBase;
+};
+
+DWORD ProtectFromPerms(const char* perms) {
+    const bool r = perms[0] == 'r', w = perms[1] == 'w', x = perms[2] == 'x';
+    if (x) return w ? PAGE_EXECUTE_READWRITE : r ? PAGE_EXECUTE_READ : PAGE_EXECUTE;
+    if (w) return PAGE_READWRITE;
+    return r ? PAGE_READONLY : PAGE_NOACCESS;
+}
+
+int ProtFromProtect(DWORD protect) {
+    switch (protect & 0xFF) {
+    case PAGE_READONLY: return PROT_READ;
+    case PAGE_READWRITE: return PROT_READ | PROT_WRITE;
+    case PAGE_EXECUTE: return PROT_EXEC;
+    case PAGE_EXECUTE_READ: return PROT_READ | PROT_EXEC;
+    case PAGE_EXECUTE_READWRITE:
+    case PAGE_EXECUTE_WRITECOPY: return PROT_READ | PROT_WRITE | PROT_EXEC;
+    default: return PROT_NONE;
+    }
+}
+
+// Finds the mapping holding addr, or the first one above it. The mappings of
+// one file share an allocation base, as the sections of a module do.
+bool FindMapping(ULONG_PTR addr, Mapping& found, bool& inside) {
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (!f) return false;
+
+    char line[512];
+    unsigned long inode = 0, fileInode = 0;
+    ULONG_PTR fileBase = 0;
+    bool any = false;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lo, hi, offset;
+        char perms[5] = {};
+        unsigned int major, minor;
+        if (sscanf(line, "%lx-%lx %4s %lx %x:%x %lu", &lo, &hi, perms, &offset, &major, &minor, &inode) != 7)
+            continue;
+        if (inode == 0 || inode != fileInode) {
+            fileInode = inode;
+            fileBase = lo;
+        }
+        if (hi <= addr) continue;
+
+        found.lo = lo;
+        found.hi = hi;
+        found.protect = ProtectFromPerms(perms);
+        found.allocationBase = inode != 0 ? fileBase : lo;
+        inside = lo <= addr;
+        any = true;
+        break;
+    }
+    fclose(f);
+    return any;
+}
+
+}  // namespace
+
+// --- test side -------------------------------------------------------------
+
+void FakeExit(int code) {
+    fflush(stdout);
+    fflush(stderr);
+    _exit(code);
+}
+
+void HostProvideWaitOnAddress(bool provide) {
+    g_provideWaitOnAddress = provide;
+}
+
+// --- kernel32 --------------------------------------------------------------
+
+extern "C" {
+
+LONG InterlockedCompareExchange(volatile LONG* p, LONG exchange, LONG comparand) {
+    __atomic_compare_exchange_n(p, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+LONG InterlockedExchange(volatile LONG* p, LONG v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+void YieldProcessor(void) { __builtin_ia32_pause(); }
+BOOL SwitchToThread(void) { return sched_yield() == 0; }
+void Sleep(DWORD ms) { usleep((useconds_t)ms * 1000); }
+
+unsigned char BitScanForward(DWORD* index, DWORD mask) {
+    if (!mask) return 0;
+    *index = (DWORD)__builtin_ctz(mask);
+    return 1;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* out) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    out->QuadPart = (LONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* out) {
+    out->QuadPart = 1000000000;
+    return TRUE;
+}
+
+DWORD GetLastError(void) { return t_lastError; }
+void SetLastError(DWORD e) { t_lastError = e; }
+DWORD GetCurrentProcessId(void) { return (DWORD)getpid(); }
+DWORD GetCurrentThreadId(void) { return (DWORD)syscall(SYS_gettid); }
+HANDLE GetCurrentProcess(void) { return (HANDLE)(LONG_PTR)-1; }
+
+// No modules: NtGetNextThread and WaitOnAddress resolve to NULL, so MinHook
+// takes its Toolhelp and Sleep paths unless a backend says otherwise, or
+// HostProvideWaitOnAddress() added kernelbase.dll with the futex versions.
+HMODULE GetModuleHandleW(LPCWSTR name) {
+    return g_provideWaitOnAddress && IsModule(name, "kernelbase.dll") ? kKernelBase : nullptr;
+}
+
+FARPROC GetProcAddress(HMODULE module, LPCSTR name) {
+    if (module == kKernelBase && strcmp(name, "WaitOnAddress") == 0) return (FARPROC)&HostWaitOnAddress;
+    if (module == kKernelBase && strcmp(name, "WakeByAddressSingle") == 0) return (FARPROC)&HostWakeByAddressSingle;
+    t_lastError = ERROR_PROC_NOT_FOUND;
+    return nullptr;
+}
+
+// --- threads: only the caller exists -----------------------------------------
+
+HANDLE CreateToolhelp32Snapshot(DWORD, DWORD) { return kSnapshot; }
+
+BOOL Thread32First(HANDLE h, LPTHREADENTRY32 te) {
+    if (h != kSnapshot) {
+        t_lastError = ERROR_INVALID_HANDLE;
+        return FALSE;
+    }
+    te->th32ThreadID = GetCurrentThreadId();
+    te->th32OwnerProcessID = GetCurrentProcessId();
+    return TRUE;
+}
+
+BOOL Thread32Next(HANDLE, LPTHREADENTRY32) {
+    t_lastError = ERROR_NO_MORE_FILES;
+    return FALSE;
+}
+
+HANDLE OpenThread(DWORD, BOOL, DWORD) {
+    t_lastError = ERROR_NOT_SUPPORTED;
+    return nullptr;
+}
+
+DWORD GetThreadId(HANDLE) { return 0; }
+
+DWORD SuspendThread(HANDLE) {
+    t_lastError = ERROR_INVALID_HANDLE;
+    return (DWORD)-1;
+}
+
+DWORD ResumeThread(HANDLE) {
+    t_lastError = ERROR_INVALID_HANDLE;
+    return (DWORD)-1;
+}
+
+BOOL GetThreadContext(HANDLE, CONTEXT*) {
+    t_lastError = ERROR_INVALID_HANDLE;
+    return FALSE;
+}
+
+BOOL SetThreadContext(HANDLE, const CONTEXT*) {
+    t_lastError = ERROR_INVALID_HANDLE;
+    return FALSE;
+}
+
+BOOL CloseHandle(HANDLE h) {
+    if (h == kSnapshot) return TRUE;
+    t_lastError = ERROR_INVALID_HANDLE;
+    return FALSE;
+}
+
+// --- heap ----------------------------------------------------------------------
+
+HANDLE HeapCreate(DWORD, SIZE_T, SIZE_T) { return kHeap; }
+BOOL HeapDestroy(HANDLE h) { return h == kHeap; }
+
+LPVOID HeapAlloc(HANDLE, DWORD flags, SIZE_T size) {
+    return (flags & HEAP_ZERO_MEMORY) ? calloc(1, size) : malloc(size);
+}
+
+LPVOID HeapReAlloc(HANDLE, DWORD, LPVOID p, SIZE_T size) { return realloc(p, size); }
+
+BOOL HeapFree(HANDLE, DWORD, LPVOID p) {
+    free(p);
+    return TRUE;
+}
+
+// --- virtual memory --------------------------------------------------------------
+
+void GetSystemInfo(LPSYSTEM_INFO si) {
+    memset(si, 0, sizeof(*si));
+    si->dwPageSize = HOST_PAGE;
+    si->lpMinimumApplicationAddress = (LPVOID)(ULONG_PTR)HOST_MIN_ADDRESS;
+    si->lpMaximumApplicationAddress = (LPVOID)(ULONG_PTR)HOST_MAX_ADDRESS;
+    si->dwAllocationGranularity = HOST_GRANULARITY;
+    si->dwNumberOfProcessors = (DWORD)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+SIZE_T VirtualQuery(LPCVOID address, PMEMORY_BASIC_INFORMATION mbi, SIZE_T size) {
+    const ULONG_PTR addr = (ULONG_PTR)address & ~(ULONG_PTR)(HOST_PAGE - 1);
+    if (size < sizeof(*mbi) || addr > HOST_MAX_ADDRESS) {
+        t_lastError = ERROR_INVALID_PARAMETER;
+        return 0;
+    }
+
+    Mapping m;
+    bool inside = false;
+    if (!FindMapping(addr, m, inside)) {
+        m.lo = m.hi = HOST_MAX_ADDRESS + 1;
+        inside = false;
+    }
+
+    memset(mbi, 0, sizeof(*mbi));
+    mbi->BaseAddress = (PVOID)addr;
+    if (inside) {
+        mbi->AllocationBase = (PVOID)m.allocationBase;
+        mbi->AllocationProtect = m.protect;
+        mbi->RegionSize = m.hi - addr;
+        mbi->State = MEM_COMMIT;
+        mbi->Protect = m.protect;
+    }
+    else {
+        mbi->RegionSize = (m.lo < HOST_MAX_ADDRESS + 1 ? m.lo : HOST_MAX_ADDRESS + 1) - addr;
+        mbi->State = MEM_FREE;
+        mbi->Protect = PAGE_NOACCESS;
+    }
+    return sizeof(*mbi);
+}
+
+LPVOID VirtualAlloc(LPVOID address, SIZE_T size, DWORD, DWORD protect) {
+    size = (size + HOST_PAGE - 1) & ~(SIZE_T)(HOST_PAGE - 1);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (address) flags |= MAP_FIXED_NOREPLACE;
+    void* p = mmap(address, size, ProtFromProtect(protect), flags, -1, 0);
+    if (p == MAP_FAILED || (address && p != address)) {
+        if (p != MAP_FAILED) munmap(p, size);
+        t_lastError = ERROR_INVALID_ADDRESS;
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(g_allocMu);
+    g_allocs[(ULONG_PTR)p] = size;
+    return p;
+}
+
+BOOL VirtualFree(LPVOID address, SIZE_T, DWORD) {
+    std::lock_guard<std::mutex> lock(g_allocMu);
+    auto it = g_allocs.find((ULONG_PTR)address);
+    if (it == g_allocs.end()) {
+        t_lastError = ERROR_INVALID_PARAMETER;
+        return FALSE;
+    }
+    munmap(address, it->second);
+    g_allocs.erase(it);
+    return TRUE;
+}
+
+BOOL VirtualProtect(LPVOID address, SIZE_T size, DWORD protect, PDWORD oldProtect) {
+    MEMORY_BASIC_INFORMATION mbi;
+    if (!VirtualQuery(address, &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT) {
+        t_lastError = ERROR_INVALID_ADDRESS;
+        return FALSE;
+    }
+    const ULONG_PTR lo = (ULONG_PTR)address & ~(ULONG_PTR)(HOST_PAGE - 1);
+    const ULONG_PTR hi = ((ULONG_PTR)address + size + HOST_PAGE - 1) & ~(ULONG_PTR)(HOST_PAGE - 1);
+    if (mprotect((void*)lo, hi - lo, ProtFromProtect(protect)) != 0) {
+        t_lastError = ERROR_ACCESS_DENIED;
+        return FALSE;
+    }
+    *oldProtect = mbi.Protect;
+    return TRUE;
+}
+
+BOOL FlushInstructionCache(HANDLE, LPCVOID address, SIZE_T size) {
+    __builtin___clear_cache((char*)address, (char*)address + size);
+    return TRUE;
+}
+
+}  // extern "C"
@@ -0,0 +1,18 @@
+#pragma once
+// MinHook's own sources as the MinHook tests see them: the public API plus
+// the internal interfaces of buffer.c, hook.c and trampoline.c, running on
+// host_kernel32.cpp.
+#include <windows.h>
+#include <tlhelp32.h>
+#include "MinHook.h"
+
+extern "C" {
+#include "buffer.h"
+#include "hook.h"
+#include "trampoline.h"
+}
+
+// Makes GetModuleHandleW(L"kernelbase.dll") find WaitOnAddress and
+// WakeByAddressSingle, so MinHook's lock waits on a futex instead of taking
+// its SwitchToThread/Sleep path. Call before the first MH_* call.
+void HostProvideWaitOnAddress(bool provide);
@@ -0,0 +1,152 @@
+// MinHook's lock under contention, through the MH_* calls that take it.
+//
+//   lock_stress [--wait-on-address]
+//
+// Each thread owns one hook and, from a common start, queues it enabled and
+// disabled over and over, and now and then removes and recreates it, which
+// holds the lock for the whole trampoline build. Reports calls per second,
+// how many acquisitions found the lock held, how many kernel waits that
+// took and for how long, and the slowest single call, for 1 to kMaxThreads
+// threads. With --wait-on-address the host provides WaitOnAddress, so the
+// lock waits on a futex; without it, the lock falls back to SwitchToThread
+// and Sleep(1).
+//
+// Fails if a call returns anything but MH_OK, or if MH_GetLockStats()
+// counts a different number of acquisitions than calls were made; timings
+// are not checked.
+#include "check.h"
+#include "host_kernel32.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// push rbp / mov rbp, rsp / sub rsp, 20h / ret, one per thread.
+const BYTE kPrologue[] = { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0xC3 };
+const UINT kTargetStride = 16;
+const UINT kMaxThreads = 8;
+const int kIterations = 50000;
+const int kRecreateEvery = 500;
+
+BYTE* g_code = nullptr;
+std::atomic<bool> g_go{ false };
+
+LPVOID Target(UINT i) {
+    return g_code + i * kTargetStride;
+}
+
+LPVOID Detour() {
+    return g_code + kMaxThreads * kTargetStride;
+}
+
+struct ThreadResult {
+    long long calls = 0;
+    int failures = 0;
+    double maxCallUs = 0;
+};
+
+template <typename Fn>
+void Timed(ThreadResult& r, Fn fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const MH_STATUS status = fn();
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    r.calls++;
+    r.failures += status != MH_OK;
+    r.maxCallUs = std::max(r.maxCallUs, us);
+}
+
+void Worker(UINT index, ThreadResult& r) {
+    LPVOID target = Target(index);
+    while (!g_go.load(std::memory_order_acquire)) YieldProcessor();
+
+    for (int i = 1; i <= kIterations; i++) {
+        Timed(r, [&] { return MH_QueueEnableHook(target); });
+        Timed(r, [&] { return MH_QueueDisableHook(target); });
+        if (i % kRecreateEvery == 0) {
+            Timed(r, [&] { return MH_RemoveHook(target); });
+            Timed(r, [&] { return MH_CreateHook(target, Detour(), NULL); });
+        }
+    }
+}
+
+MH_LOCK_STATS Stats() {
+    MH_LOCK_STATS stats{};
+    CHECK_EQ(MH_GetLockStats(&stats), MH_OK);
+    return stats;
+}
+
+void Setup() {
+    g_code = (BYTE*)VirtualAlloc(NULL, 0x1000, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!CHECK(g_code)) CheckExit();
+    memset(g_code, 0xCC, 0x1000);
+    for (UINT i = 0; i < kMaxThreads; i++) memcpy(Target(i), kPrologue, sizeof(kPrologue));
+    *(BYTE*)Detour() = 0xC3;
+}
+
+void Stress() {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    printf("%7s %10s %10s %10s %12s %12s %12s\n", "threads", "Mcalls/s", "calls", "contended", "kernel waits",
+        "mean wait us", "max call us");
+    for (UINT threads = 1; threads <= kMaxThreads; threads *= 2) {
+        if (!CHECK_EQ(MH_Initialize(), MH_OK)) return;
+        for (UINT i = 0; i < threads; i++) CHECK_EQ(MH_CreateHook(Target(i), Detour(), NULL), MH_OK);
+
+        std::vector<ThreadResult> results(threads);
+        std::vector<std::thread> workers;
+        g_go = false;
+        for (UINT i = 0; i < threads; i++) workers.emplace_back(Worker, i, std::ref(results[i]));
+
+        const MH_LOCK_STATS before = Stats();
+        const auto t0 = std::chrono::steady_clock::now();
+        g_go.store(true, std::memory_order_release);
+        for (std::thread& t : workers) t.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        const MH_LOCK_STATS after = Stats();
+
+        ThreadResult total;
+        for (const ThreadResult& r : results) {
+            total.calls += r.calls;
+            total.failures += r.failures;
+            total.maxCallUs = std::max(total.maxCallUs, r.maxCallUs);
+        }
+        CHECK_EQ(total.failures, 0);
+        // The second MH_GetLockStats() counts itself.
+        CHECK_EQ(after.acquisitions - before.acquisitions, total.calls + 1);
+        const ULONGLONG contentions = after.contentions - before.contentions;
+        if (threads == 1) CHECK_EQ(contentions, 0);
+
+        // Every hook still works after the churn.
+        CHECK_EQ(MH_EnableHook(MH_ALL_HOOKS), MH_OK);
+        int patched = 0;
+        for (UINT i = 0; i < threads; i++) patched += *(BYTE*)Target(i) == 0xE9;
+        CHECK_EQ(patched, threads);
+        CHECK_EQ(MH_Uninitialize(), MH_OK);
+
+        const double waitUs = (double)(after.waitTicks - before.waitTicks) * 1e6 / freq.QuadPart;
+        printf("%7u %10.2f %10lld %10llu %12llu %12.2f %12.1f\n", threads, total.calls / seconds / 1e6,
+            total.calls, contentions, after.kernelWaits - before.kernelWaits,
+            contentions ? waitUs / contentions : 0.0, total.maxCallUs);
+    }
+
+    int restored = 0;
+    for (UINT i = 0; i < kMaxThreads; i++) restored += memcmp(Target(i), kPrologue, sizeof(kPrologue)) == 0;
+    CHECK_EQ(restored, kMaxThreads);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const bool waitOnAddress = argc > 1 && strcmp(argv[1], "--wait-on-address") == 0;
+    HostProvideWaitOnAddress(waitOnAddress);
+    printf("lock waits: %s\n", waitOnAddress ? "WaitOnAddress (futex)" : "SwitchToThread / Sleep(1)");
+
+    RUN_STEP(Setup);
+    RUN_STEP(Stress);
+    CheckExit();
+}
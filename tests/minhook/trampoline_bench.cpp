@@ -0,0 +1,101 @@
+// Cost of building one trampoline, per kind of prologue.
+//
+// "build" is BuildTrampolineFunction() from copies of the code, "in place" is
+// CreateTrampolineFunction() on a live target in an executable page, which
+// is what MH_CreateHook() pays per hook. Reports ns per trampoline, the best
+// of a few rounds; fails only if a prologue stops building.
+#include "host_kernel32.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kIterations = 200000;
+const int kRounds = 5;
+
+struct Prologue {
+    const char* name;
+    std::vector<BYTE> code;
+};
+
+const Prologue kPrologues[] = {
+    { "msvc mov [rsp+8], rbx", { 0x48, 0x89, 0x5C, 0x24, 0x08, 0x57, 0x48, 0x83, 0xEC, 0x20 } },
+    { "push rbx / sub rsp", { 0x40, 0x53, 0x48, 0x83, 0xEC, 0x20 } },
+    { "push rbp / mov rbp, rsp", { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20 } },
+    { "mov r11, rsp / mov [r11]", { 0x4C, 0x8B, 0xDC, 0x49, 0x89, 0x5B, 0x08 } },
+    { "RIP-relative load", { 0x48, 0x8B, 0x05, 0xF1, 0x0F, 0x00, 0x00 } },
+    { "call rel32 first", { 0xE8, 0x10, 0x00, 0x00, 0x00, 0x48, 0x83, 0xC4, 0x28 } },
+    { "jcc out, then mov", { 0x74, 0x20, 0x48, 0x8B, 0xC1, 0x90 } },
+    { "jmp [rip] thunk", { 0xFF, 0x25, 0x00, 0x10, 0x00, 0x00 } },
+    { "short, patch above", { 0x33, 0xC0, 0xC3, 0x48, 0x89 } },
+};
+
+template <typename Fn>
+double BestNs(Fn fn) {
+    double best = 0;
+    for (int round = 0; round < kRounds; round++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; i++) fn();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count()
+            / kIterations;
+        best = round == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+}  // namespace
+
+int main() {
+    BYTE* page = (BYTE*)VirtualAlloc(NULL, 0x1000, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    if (!page) {
+        fprintf(stderr, "trampoline_bench: VirtualAlloc failed\n");
+        return 2;
+    }
+    // Target past the first bytes of the page, so in place never asks the OS
+    // about the hot patch area; int3 above and after it.
+    BYTE* target = page + 0x100;
+    BYTE* trampoline = page + 0x800;
+    const LPVOID detour = page + 0xC00;
+
+    int failures = 0;
+    printf("%-28s %10s %10s %6s\n", "prologue", "build ns", "in place", "bytes");
+    for (const Prologue& p : kPrologues) {
+        memset(page, 0xCC, 0x800);
+        memcpy(target, p.code.data(), p.code.size());
+
+        BYTE code[TRAMPOLINE_CODE_SIZE];
+        memcpy(code, target, sizeof(code));
+        BYTE above[sizeof(JMP_REL)];
+        memcpy(above, target - sizeof(above), sizeof(above));
+        BYTE out[MEMORY_SLOT_SIZE];
+
+        TRAMPOLINE ct;
+        BOOL ok = TRUE;
+        const double buildNs = BestNs([&] {
+            memset(&ct, 0, sizeof(ct));
+            ct.pTarget = target;
+            ct.pDetour = detour;
+            ct.pTrampoline = trampoline;
+            ok &= BuildTrampolineFunction(&ct, code, above, out);
+        });
+        const UINT size = (UINT)((LPBYTE)ct.pRelay - (LPBYTE)ct.pTrampoline + sizeof(JMP_ABS));
+        const double inPlaceNs = BestNs([&] {
+            memset(&ct, 0, sizeof(ct));
+            ct.pTarget = target;
+            ct.pDetour = detour;
+            ct.pTrampoline = trampoline;
+            ok &= CreateTrampolineFunction(&ct);
+        });
+
+        if (!ok) {
+            fprintf(stderr, "%s: no trampoline\n", p.name);
+            failures++;
+            continue;
+        }
+        printf("%-28s %10.1f %10.1f %6u\n", p.name, buildNs, inPlaceNs, size);
+    }
+    VirtualFree(page, 0, MEM_RELEASE);
+    return failures ? 1 : 0;
+}
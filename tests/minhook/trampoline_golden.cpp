@@ -0,0 +1,343 @@
+// BuildTrampolineFunction() in trampoline.c against hand-checked trampolines.
+//
+// Each case gives the first bytes of a target and what the builder must make
+// of them: whether it succeeds, whether it needs the hot patch area, the
+// instruction boundaries, and the exact trampoline and relay bytes. The host
+// is x64, so these are the x64 forms: absolute CALL/JMP/Jcc stubs for rel32
+// and rel8 branches, and rewritten disp32 for RIP-relative operands.
+//
+// Expected bytes are hex, plus q(expr) for an 8-byte and d(expr) for a 4-byte
+// little-endian value, where expr adds and subtracts T (the target), N (the
+// trampoline), D (the detour) and hex numbers. Last, random code against the
+// bounds of the builder's buffers.
+#include "check.h"
+#include "host_kernel32.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const ULONG_PTR kTarget = 0x7FF612340100;
+const ULONG_PTR kTrampoline = kTarget + 0x10000;
+const ULONG_PTR kDetour = 0x7FF600001230;
+const BYTE kUntouched = 0xAA;
+
+struct Case {
+    const char* name;
+    const char* code;       // target bytes; the rest of what the builder may read is int3
+    const char* above;      // the 5 bytes above the target, or nullptr if not executable
+    bool ok;
+    bool patchAbove;
+    const char* ips;        // "old:new" boundaries, in hex
+    const char* trampoline; // trampoline then relay
+};
+
+const Case kCases[] = {
+    // Relative CALL/JMP: rebuilt as absolute ones to the same destination.
+    { "call_rel32", "e8 10 00 00 00 48 83 c4 28", "cc cc cc cc cc", true, false, "0:0 5:10",
+      "ff 15 02 00 00 00 eb 08 q(T+15)  ff 25 00 00 00 00 q(T+5)  ff 25 00 00 00 00 q(D)" },
+    { "call_rel32_backward", "e8 f0 ff ff ff 90", "cc cc cc cc cc", true, false, "0:0 5:10",
+      "ff 15 02 00 00 00 eb 08 q(T-b)  ff 25 00 00 00 00 q(T+5)  ff 25 00 00 00 00 q(D)" },
+    { "jmp_rel32", "e9 00 01 00 00", "cc cc cc cc cc", true, false, "0:0",
+      "ff 25 00 00 00 00 q(T+105)  ff 25 00 00 00 00 q(D)" },
+    { "jmp_rel8", "eb 10 cc cc cc", "cc cc cc cc cc", true, false, "0:0",
+      "ff 25 00 00 00 00 q(T+12)  ff 25 00 00 00 00 q(D)" },
+
+    // Jcc out of the copied bytes: inverted short Jcc over an absolute JMP.
+    { "jcc_rel8", "74 20 48 8b c1", "cc cc cc cc cc", true, false, "0:0 2:10 5:13",
+      "75 0e ff 25 00 00 00 00 q(T+22)  48 8b c1  ff 25 00 00 00 00 q(T+5)  ff 25 00 00 00 00 q(D)" },
+    { "jcc_rel32", "0f 8c 00 01 00 00", "cc cc cc cc cc", true, false, "0:0 6:10",
+      "7d 0e ff 25 00 00 00 00 q(T+106)  ff 25 00 00 00 00 q(T+6)  ff 25 00 00 00 00 q(D)" },
+    // A Jcc into the copied bytes is copied as is, and so is what it skips.
+    { "jcc_internal", "74 01 90 31 c0", "cc cc cc cc cc", true, false, "0:0 2:2 3:3 5:5",
+      "74 01 90 31 c0  ff 25 00 00 00 00 q(T+5)  ff 25 00 00 00 00 q(D)" },
+    // ...but nothing in its way may change length.
+    { "call_in_branch", "74 02 e8 00 00 00 00", "cc cc cc cc cc", false, false, "", "" },
+    // LOOP/JRCXZ have no long form.
+    { "loop_out", "e2 10 90 90 90", "cc cc cc cc cc", false, false, "", "" },
+
+    // RIP-relative operands: the disp32 is rebased to the trampoline.
+    { "rip_mov", "48 8b 05 f1 0f 00 00", "cc cc cc cc cc", true, false, "0:0 7:7",
+      "48 8b 05 d(T+ff8-N-7)  ff 25 00 00 00 00 q(T+7)  ff 25 00 00 00 00 q(D)" },
+    { "rip_with_imm", "c7 05 f0 0f 00 00 01 00 00 00", "cc cc cc cc cc", true, false, "0:0 a:a",
+      "c7 05 d(T+ffa-N-a) 01 00 00 00  ff 25 00 00 00 00 q(T+a)  ff 25 00 00 00 00 q(D)" },
+    { "rip_second", "40 53 48 8d 0d f9 ff ff ff", "cc cc cc cc cc", true, false, "0:0 2:2 9:9",
+      "40 53  48 8d 0d d(T-N-7)  ff 25 00 00 00 00 q(T+9)  ff 25 00 00 00 00 q(D)" },
+    // An import thunk ends the function.
+    { "jmp_rip", "ff 25 00 10 00 00", "cc cc cc cc cc", true, false, "0:0",
+      "ff 25 d(T+1006-N-6)  ff 25 00 00 00 00 q(D)" },
+
+    // Plain prologues are copied up to the first boundary at 5 bytes or more.
+    { "prologue_msvc", "48 89 5c 24 08 57", "cc cc cc cc cc", true, false, "0:0 5:5",
+      "48 89 5c 24 08  ff 25 00 00 00 00 q(T+5)  ff 25 00 00 00 00 q(D)" },
+    { "prologue_rex_push", "40 53 48 83 ec 20", "cc cc cc cc cc", true, false, "0:0 2:2 6:6",
+      "40 53 48 83 ec 20  ff 25 00 00 00 00 q(T+6)  ff 25 00 00 00 00 q(D)" },
+
+    // Functions shorter than a JMP rel32: padding after them will do;
+    // otherwise the long jump goes above and a short one at the target.
+    { "short_padded", "33 c0 c3 cc cc", nullptr, true, false, "0:0 2:2",
+      "33 c0 c3  ff 25 00 00 00 00 q(D)" },
+    { "short_patch_above", "33 c0 c3 48 89", "cc cc cc cc cc", true, true, "0:0 2:2",
+      "33 c0 c3  ff 25 00 00 00 00 q(D)" },
+    { "short_above_nops", "33 c0 c3 48 89", "90 90 90 90 90", true, true, "0:0 2:2",
+      "33 c0 c3  ff 25 00 00 00 00 q(D)" },
+    { "short_above_code", "33 c0 c3 48 89", "5d c3 cc cc cc", false, false, "", "" },
+    { "short_above_unmapped", "33 c0 c3 48 89", nullptr, false, false, "", "" },
+    { "one_byte", "c3 48 89 5c 24", "cc cc cc cc cc", false, false, "", "" },
+    { "one_byte_padded", "c3 cc 48 89 5c", "cc cc cc cc cc", true, true, "0:0",
+      "c3  ff 25 00 00 00 00 q(D)" },
+
+    { "invalid", "06", "cc cc cc cc cc", false, false, "", "" },
+
+    // Worst cases for the buffers. The longest copy: four one-byte
+    // instructions, then a 15-byte one.
+    { "longest_copy", "50 51 52 53 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00", "cc cc cc cc cc", true, false,
+      "0:0 1:1 2:2 3:3 4:4 13:13",
+      "50 51 52 53 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00  ff 25 00 00 00 00 q(T+13)"
+      "  ff 25 00 00 00 00 q(D)" },
+    // More prefixes than an instruction may have.
+    { "prefixes_16", "66 66 66 66 66 66 66 66 66 66 66 66 66 66 66 66 90", "cc cc cc cc cc", false, false, "", "" },
+    // Three Jcc stubs and the jump back need more than a slot.
+    { "jcc_overflow", "74 20 75 20 76 20", "cc cc cc cc cc", false, false, "", "" },
+};
+
+std::vector<BYTE> Hex(const char* s) {
+    std::vector<BYTE> out;
+    for (const char* p = s; p && *p;) {
+        if (*p == ' ') { p++; continue; }
+        out.push_back((BYTE)strtoul(std::string(p, 2).c_str(), nullptr, 16));
+        p += 2;
+    }
+    return out;
+}
+
+ULONG_PTR Eval(const std::string& expr) {
+    ULONG_PTR v = 0;
+    size_t i = 0;
+    while (i < expr.size()) {
+        bool negate = false;
+        if (expr[i] == '+' || expr[i] == '-') negate = expr[i++] == '-';
+        ULONG_PTR term;
+        if (expr[i] == 'T') { term = kTarget; i++; }
+        else if (expr[i] == 'N') { term = kTrampoline; i++; }
+        else if (expr[i] == 'D') { term = kDetour; i++; }
+        else {
+            const size_t end = expr.find_first_of("+-", i);
+            term = strtoull(expr.substr(i, end - i).c_str(), nullptr, 16);
+            i = end == std::string::npos ? expr.size() : end;
+        }
+        v = negate ? v - term : v + term;
+    }
+    return v;
+}
+
+std::vector<BYTE> Expected(const char* s) {
+    std::vector<BYTE> out;
+    std::string text(s);
+    size_t i = 0;
+    while (i < text.size()) {
+        if (text[i] == ' ') { i++; continue; }
+        if (text[i] == 'q' || text[i] == 'd') {
+            const size_t close = text.find(')', i);
+            const ULONG_PTR v = Eval(text.substr(i + 2, close - i - 2));
+            const int size = text[i] == 'q' ? 8 : 4;
+            for (int b = 0; b < size; b++) out.push_back((BYTE)(v >> (8 * b)));
+            i = close + 1;
+            continue;
+        }
+        out.push_back((BYTE)strtoul(text.substr(i, 2).c_str(), nullptr, 16));
+        i += 2;
+    }
+    return out;
+}
+
+std::string ToHex(const BYTE* p, size_t n) {
+    std::string s;
+    char b[4];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(b, sizeof(b), "%s%02x", i ? " " : "", p[i]);
+        s += b;
+    }
+    return s;
+}
+
+struct Built {
+    BOOL ok;
+    TRAMPOLINE ct;
+    BYTE out[MEMORY_SLOT_SIZE + 16];
+};
+
+Built Build(const Case& c) {
+    BYTE code[TRAMPOLINE_CODE_SIZE];
+    memset(code, 0xCC, sizeof(code));
+    const std::vector<BYTE> bytes = Hex(c.code);
+    memcpy(code, bytes.data(), bytes.size());
+    const std::vector<BYTE> above = Hex(c.above);
+
+    Built b;
+    memset(&b.ct, 0, sizeof(b.ct));
+    memset(b.out, kUntouched, sizeof(b.out));
+    b.ct.pTarget = (LPVOID)kTarget;
+    b.ct.pDetour = (LPVOID)kDetour;
+    b.ct.pTrampoline = (LPVOID)kTrampoline;
+    b.ok = BuildTrampolineFunction(&b.ct, code, c.above ? above.data() : NULL, b.out);
+    return b;
+}
+
+void Golden() {
+    for (const Case& c : kCases) {
+        const Built b = Build(c);
+        const int before = CheckFailures();
+        CHECK_EQ(b.ok, c.ok);
+        if (b.ok && c.ok) {
+            CHECK_EQ(b.ct.patchAbove, c.patchAbove);
+
+            std::string ips;
+            char ip[16];
+            for (UINT i = 0; i < b.ct.nIP; i++) {
+                snprintf(ip, sizeof(ip), "%s%x:%x", i ? " " : "", b.ct.oldIPs[i], b.ct.newIPs[i]);
+                ips += ip;
+            }
+            CHECK(ips == c.ips);
+
+            // The trampoline and relay, exactly, and nothing written past them.
+            const std::vector<BYTE> expected = Expected(c.trampoline);
+            CHECK(memcmp(b.out, expected.data(), expected.size()) == 0);
+            CHECK(b.out[expected.size()] == kUntouched);
+            CHECK((ULONG_PTR)b.ct.pRelay == kTrampoline + expected.size() - sizeof(JMP_ABS));
+            if (CheckFailures() != before) {
+                fprintf(stderr, "  expected %s\n", ToHex(expected.data(), expected.size()).c_str());
+                fprintf(stderr, "  built    %s\n", ToHex(b.out, expected.size()).c_str());
+                fprintf(stderr, "  ips      %s\n", ips.c_str());
+            }
+        }
+        if (CheckFailures() != before) fprintf(stderr, "  in case %s\n", c.name);
+    }
+}
+
+// CreateTrampolineFunction() builds the same bytes in place, from the live
+// target, and looks at the hot patch area only through the OS.
+void InPlace() {
+    const ULONG_PTR page = 0x1000;
+    BYTE* mem = (BYTE*)VirtualAlloc(NULL, 3 * page, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    if (!CHECK(mem)) return;
+
+    for (const Case& c : kCases) {
+        const std::vector<BYTE> bytes = Hex(c.code);
+        const std::vector<BYTE> above = Hex(c.above);
+
+        // Targets at the start of the middle page, so only the area above
+        // them depends on whether the first page is executable.
+        BYTE* target = mem + page;
+        BYTE* trampoline = mem + 2 * page;
+        memset(mem, 0xCC, 3 * page);
+        memcpy(target, bytes.data(), bytes.size());
+        if (c.above) memcpy(target - above.size(), above.data(), above.size());
+        DWORD old;
+        VirtualProtect(mem, page, c.above ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE, &old);
+        memset(trampoline, kUntouched, MEMORY_SLOT_SIZE);
+
+        TRAMPOLINE live;
+        memset(&live, 0, sizeof(live));
+        live.pTarget = target;
+        live.pDetour = (LPVOID)kDetour;
+        live.pTrampoline = trampoline;
+        const BOOL ok = CreateTrampolineFunction(&live);
+        VirtualProtect(mem, page, PAGE_EXECUTE_READWRITE, &old);
+
+        TRAMPOLINE built;
+        memset(&built, 0, sizeof(built));
+        built.pTarget = live.pTarget;
+        built.pDetour = live.pDetour;
+        built.pTrampoline = trampoline;
+        BYTE out[MEMORY_SLOT_SIZE];
+        memset(out, kUntouched, sizeof(out));
+        BYTE code[TRAMPOLINE_CODE_SIZE];
+        memcpy(code, target, sizeof(code));
+        const BOOL builtOk = BuildTrampolineFunction(&built, code, c.above ? target - sizeof(JMP_REL) : NULL, out);
+
+        const int before = CheckFailures();
+        CHECK_EQ(ok, c.ok);
+        CHECK_EQ(ok, builtOk);
+        if (ok && builtOk) {
+            CHECK_EQ(live.patchAbove, built.patchAbove);
+            CHECK_EQ(live.nIP, built.nIP);
+            CHECK(memcmp(live.oldIPs, built.oldIPs, sizeof(live.oldIPs)) == 0);
+            CHECK(memcmp(live.newIPs, built.newIPs, sizeof(live.newIPs)) == 0);
+            CHECK(live.pRelay == built.pRelay);
+            CHECK(memcmp(trampoline, out, MEMORY_SLOT_SIZE) == 0);
+        }
+        if (CheckFailures() != before) fprintf(stderr, "  in case %s\n", c.name);
+    }
+    VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+// Random targets, biased towards prefixes and the branches the builder
+// rewrites, in a buffer that ends at an inaccessible page: the builder must
+// not read past TRAMPOLINE_CODE_SIZE bytes nor write past its slot, and what
+// it builds has its boundaries in order.
+void Fuzz() {
+    const ULONG_PTR page = 0x1000;
+    const int kRuns = 200000;
+    const BYTE kBiased[] = { 0x66, 0x67, 0xF0, 0xF2, 0xF3, 0x2E, 0x48, 0x4C, 0x0F, 0x05, 0x25, 0x80, 0x74, 0xE2,
+        0xE8, 0xE9, 0xEB, 0xFF, 0xC3, 0xCC, 0x90 };
+
+    BYTE* mem = (BYTE*)VirtualAlloc(NULL, 2 * page, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!CHECK(mem)) return;
+    DWORD old;
+    CHECK(VirtualProtect(mem + page, page, PAGE_NOACCESS, &old));
+    BYTE* code = mem + page - TRAMPOLINE_CODE_SIZE;
+
+    unsigned rng = 1;
+    auto next = [&rng] { rng = rng * 1103515245u + 12345u; return rng >> 16; };
+    int built = 0;
+    for (int run = 0; run < kRuns; run++) {
+        for (UINT i = 0; i < TRAMPOLINE_CODE_SIZE; i++) {
+            const unsigned r = next();
+            code[i] = (r & 1) ? kBiased[(r >> 1) % ARRAYSIZE(kBiased)] : (BYTE)(r >> 8);
+        }
+        BYTE above[sizeof(JMP_REL)];
+        for (BYTE& b : above) b = (next() & 1) ? 0xCC : (BYTE)next();
+
+        TRAMPOLINE ct;
+        memset(&ct, 0, sizeof(ct));
+        ct.pTarget = (LPVOID)kTarget;
+        ct.pDetour = (LPVOID)kDetour;
+        ct.pTrampoline = (LPVOID)kTrampoline;
+        BYTE out[MEMORY_SLOT_SIZE + 16];
+        memset(out, kUntouched, sizeof(out));
+        const BOOL ok = BuildTrampolineFunction(&ct, code, (run & 1) ? above : NULL, out);
+
+        const int before = CheckFailures();
+        for (size_t i = MEMORY_SLOT_SIZE; i < sizeof(out); i++) CHECK(out[i] == kUntouched);
+        if (ok) {
+            built++;
+            CHECK(ct.nIP >= 1 && ct.nIP <= ARRAYSIZE(ct.oldIPs));
+            CHECK_EQ(ct.oldIPs[0], 0);
+            CHECK_EQ(ct.newIPs[0], 0);
+            for (UINT i = 1; i < ct.nIP; i++) {
+                CHECK(ct.oldIPs[i] > ct.oldIPs[i - 1]);
+                CHECK(ct.newIPs[i] > ct.newIPs[i - 1]);
+                // Only the jump back may start past the patched bytes.
+                CHECK(ct.oldIPs[i - 1] < sizeof(JMP_REL));
+            }
+            CHECK((ULONG_PTR)ct.pRelay - kTrampoline + sizeof(JMP_ABS) <= MEMORY_SLOT_SIZE);
+        }
+        if (CheckFailures() != before) {
+            fprintf(stderr, "  run %d: %s\n", run, ToHex(code, TRAMPOLINE_CODE_SIZE).c_str());
+            break;
+        }
+    }
+    printf("%d of %d built\n", built, kRuns);
+    VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Golden);
+    RUN_STEP(InPlace);
+    RUN_STEP(Fuzz);
+    CheckExit();
+}
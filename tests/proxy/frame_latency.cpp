@@ -0,0 +1,165 @@
+// [Latency] MaxFrameLatency against the fake device, which records every
+// call the throttle makes.
+//
+// A plain device gets a ring of D3DQUERYTYPE_EVENT queries: one created per
+// slot, one Issue per Present, and from frame N+1 on a GetData wait on the
+// query of N frames ago, however many polls the fake's query latency asks
+// for. An Ex device gets one SetMaximumFrameLatency instead and no queries.
+// Also checks that a reload changes N (or turns the throttle off) and frees
+// the old queries, that a plain Reset still succeeds with queries in flight,
+// that a query that never signals stalls a frame by the timeout only, and
+// that the game's last Release still destroys the device while the ring holds
+// references to it.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include <chrono>
+
+namespace {
+
+const UINT kQueryPolls = 3;     // S_FALSE answers before the fake's GetData says S_OK
+
+HWND g_gameHwnd = nullptr;
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+D3DPRESENT_PARAMETERS GamePP() {
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    return pp;
+}
+
+void SetLatency(const char* n) {
+    FakeIniSet("Latency", "MaxFrameLatency", n);
+    ReloadConfig();
+}
+
+// Presents once and returns the calls it made.
+FakeCallSnapshot Frame(IDirect3DDevice9* dev) {
+    const FakeCallSnapshot before = FakeCallsNow();
+    CHECK(SUCCEEDED(dev->Present(nullptr, nullptr, nullptr, nullptr)));
+    return FakeCallsNow() - before;
+}
+
+// n frames on a plain device with the ring n deep and empty: the first n
+// create and issue, the rest wait first.
+void CheckQueryRing(IDirect3DDevice9* dev, int n) {
+    for (int frame = 1; frame <= 2 * n + 1; frame++) {
+        const FakeCallSnapshot c = Frame(dev);
+        const bool filling = frame <= n;
+        CHECK_EQ(c[kFakeDevCreateQuery], filling ? 1 : 0);
+        CHECK_EQ(c[kFakeQueryIssue], 1);
+        CHECK_EQ(c[kFakeQueryGetData], filling ? 0 : kQueryPolls + 1);
+        CHECK_EQ(c[kFakeDevSetMaximumFrameLatency], 0);
+    }
+}
+
+void PlainDevice() {
+    IDirect3D9* d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(d3d)) return;
+    D3DPRESENT_PARAMETERS pp = GamePP();
+    IDirect3DDevice9* dev = nullptr;
+    if (!CHECK(SUCCEEDED(d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &dev)))) return;
+    CHECK(!FakeDeviceIsEx(dev));
+    const int baseline = FakeD3D9LiveObjects();
+
+    CheckQueryRing(dev, 2);
+    CHECK_EQ(FakeD3D9LiveObjects(), baseline + 2);
+
+    // A deeper limit starts a new ring; the old queries go.
+    SetLatency("3");
+    CheckQueryRing(dev, 3);
+    CHECK_EQ(FakeD3D9LiveObjects(), baseline + 3);
+
+    // Reset on a plain device fails while D3DPOOL_DEFAULT objects are alive;
+    // the queries are released ahead of it and the ring refills after.
+    pp = GamePP();
+    CHECK(SUCCEEDED(dev->Reset(&pp)));
+    CHECK_EQ(FakeD3D9LiveObjects(), baseline);
+    CheckQueryRing(dev, 3);
+
+    // Off: no more queries, and the ring is freed on the next Present.
+    SetLatency("0");
+    FakeCallSnapshot c = Frame(dev);
+    CHECK_EQ(c[kFakeDevCreateQuery] + c[kFakeQueryIssue] + c[kFakeQueryGetData], 0);
+    CHECK_EQ(FakeD3D9LiveObjects(), baseline);
+    c = Frame(dev);
+    CHECK_EQ(c[kFakeDevCreateQuery] + c[kFakeQueryIssue] + c[kFakeQueryGetData], 0);
+
+    // A query that never signals costs one frame the timeout, then the
+    // frame goes ahead.
+    SetLatency("1");
+    Frame(dev);
+    FakeD3D9SetQueryLatency(1 << 30);
+    Frame(dev);
+    const auto t0 = std::chrono::steady_clock::now();
+    c = Frame(dev);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    CHECK(c[kFakeQueryGetData] > 1);
+    CHECK(ms >= kFrameQueryTimeoutMs - 1 && ms < 10 * kFrameQueryTimeoutMs);
+    FakeD3D9SetQueryLatency(kQueryPolls);
+
+    // The game's last Release takes the ring down with the device, throttle
+    // still on; only the IDirect3D9 is left.
+    CHECK_EQ(dev->Release(), 0);
+    CHECK_EQ(FakeD3D9LiveObjects(), 1);
+    CHECK_EQ(d3d->Release(), 0);
+}
+
+void ExDevice() {
+    SetLatency("2");
+    IDirect3D9Ex* d3d = nullptr;
+    if (!CHECK(SUCCEEDED(Direct3DCreate9Ex(D3D_SDK_VERSION, &d3d)) && d3d)) return;
+    D3DPRESENT_PARAMETERS pp = GamePP();
+    IDirect3DDevice9* dev = nullptr;
+    if (!CHECK(SUCCEEDED(d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &dev)))) return;
+    CHECK(FakeDeviceIsEx(dev));
+
+    // The limit is applied once, not per frame, and no query is made.
+    for (int frame = 1; frame <= 5; frame++) {
+        const FakeCallSnapshot c = Frame(dev);
+        CHECK_EQ(c[kFakeDevSetMaximumFrameLatency], frame == 1 ? 1 : 0);
+        CHECK_EQ(c[kFakeDevCreateQuery] + c[kFakeQueryIssue] + c[kFakeQueryGetData], 0);
+    }
+    CHECK_EQ(FakeDeviceMaxLatency(dev), 2);
+
+    SetLatency("4");
+    CHECK_EQ(Frame(dev)[kFakeDevSetMaximumFrameLatency], 1);
+    CHECK_EQ(FakeDeviceMaxLatency(dev), 4);
+
+    // 0 hands the limit back to the driver, once.
+    SetLatency("0");
+    CHECK_EQ(Frame(dev)[kFakeDevSetMaximumFrameLatency], 1);
+    CHECK_EQ(Frame(dev)[kFakeDevSetMaximumFrameLatency], 0);
+    CHECK_EQ(FakeDeviceMaxLatency(dev), 0);
+
+    CHECK_EQ(dev->Release(), 0);
+    CHECK_EQ(d3d->Release(), 0);
+}
+
+}  // namespace
+
+int main() {
+    FakeIniSet("Latency", "MaxFrameLatency", "2");
+    FakeD3D9SetQueryLatency(kQueryPolls);
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, 1280, 720, &GameProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    RUN_STEP(PlainDevice);
+    RUN_STEP(ExDevice);
+    CheckExit();
+}
@@ -0,0 +1,202 @@
+// FramePacer driven by a fake PacingClock: a microsecond counter that only
+// moves when the pacer sleeps or spins, or when the "game" does its frame's
+// work. Sleeps overshoot by a fixed pseudo-random amount, the way a waitable
+// timer wakes late.
+//
+// Checks that frames land on absolute deadlines in every mode (hybrid and
+// spin exactly, timer within one overshoot, none drifting over many frames),
+// that a stall resyncs instead of bursting, and that fps 0 never touches the
+// clock. Prints the jitter each mode measured.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include <cstdlib>
+
+namespace {
+
+const LONGLONG kFreq = 1000000;         // ticks are microseconds
+const int kFps = 60;
+const LONGLONG kInterval = kFreq / kFps;
+const LONGLONG kSpinUs = 2000;
+const LONGLONG kMaxOvershoot = 1500;    // below kSpinUs, so hybrid always lands in its spin
+const int kFrames = 1000;
+
+struct FakeClock {
+    LONGLONG now = 1;                   // FramePacer takes last == 0 as "no frame yet"
+    unsigned rng = 1;
+    long nows = 0;
+    long sleeps = 0;
+    long spins = 0;
+    LONGLONG slept = 0;
+
+    LONGLONG Overshoot() {
+        rng = rng * 1103515245u + 12345u;
+        return (rng >> 16) % (kMaxOvershoot + 1);
+    }
+};
+
+LONGLONG ClockNow(void* ctx) {
+    FakeClock* c = static_cast<FakeClock*>(ctx);
+    c->nows++;
+    return c->now;
+}
+
+void ClockSleep(void* ctx, LONGLONG ticks) {
+    FakeClock* c = static_cast<FakeClock*>(ctx);
+    c->sleeps++;
+    c->slept += ticks;
+    c->now += ticks + c->Overshoot();
+}
+
+void ClockSpin(void* ctx) {
+    FakeClock* c = static_cast<FakeClock*>(ctx);
+    c->spins++;
+    c->now += 1;
+}
+
+PacingClock Clock(FakeClock& c) {
+    PacingClock pc;
+    pc.freq = kFreq;
+    pc.now = &ClockNow;
+    pc.sleep = &ClockSleep;
+    pc.spin = &ClockSpin;
+    pc.ctx = &c;
+    return pc;
+}
+
+// Frame work that always leaves the pacer something to wait for.
+LONGLONG Work(int frame) {
+    return (frame * 7919) % (kInterval - kSpinUs - kMaxOvershoot);
+}
+
+struct Run {
+    LONGLONG maxJitter = 0;     // largest |spacing - interval| between frames
+    double meanJitter = 0;
+    LONGLONG drift = 0;         // last frame against first + (kFrames - 1) intervals
+};
+
+Run PaceFrames(FramePacer& pacer, FakeClock& clock) {
+    Run r;
+    LONGLONG first = 0, prev = 0, sum = 0;
+    for (int i = 0; i < kFrames; i++) {
+        clock.now += Work(i);
+        pacer.Wait();
+        if (i == 0) {
+            first = clock.now;
+        }
+        else {
+            const LONGLONG jitter = llabs(clock.now - prev - kInterval);
+            r.maxJitter = jitter > r.maxJitter ? jitter : r.maxJitter;
+            sum += jitter;
+        }
+        prev = clock.now;
+    }
+    r.meanJitter = (double)sum / (kFrames - 1);
+    r.drift = prev - first - (LONGLONG)(kFrames - 1) * kInterval;
+    return r;
+}
+
+void Modes() {
+    const struct { const char* name; PacingMode mode; } kModes[] = {
+        { "hybrid", kPacingHybrid },
+        { "timer", kPacingTimer },
+        { "spin", kPacingSpin },
+    };
+    printf("%-8s %12s %12s %10s %12s %12s\n", "mode", "max jitter", "mean jitter", "drift", "sleeps/frame",
+        "spins/frame");
+    for (const auto& m : kModes) {
+        FakeClock clock;
+        FramePacer pacer;
+        pacer.Configure(Clock(clock), kFps, m.mode, kSpinUs);
+        const Run r = PaceFrames(pacer, clock);
+        printf("%-8s %10lldus %10.1fus %8lldus %12.2f %12.1f\n", m.name, r.maxJitter, r.meanJitter, r.drift,
+            (double)clock.sleeps / kFrames, (double)clock.spins / kFrames);
+
+        switch (m.mode) {
+        case kPacingHybrid:
+            // The timer gets it within kSpinUs, the spin the rest of the way.
+            CHECK_EQ(r.maxJitter, 0);
+            CHECK_EQ(clock.sleeps, kFrames - 1);
+            CHECK(clock.spins <= (kFrames - 1) * kSpinUs);
+            break;
+        case kPacingTimer:
+            // Late by at most one overshoot, and never later than that overall.
+            CHECK(r.maxJitter <= kMaxOvershoot);
+            CHECK(r.drift >= 0 && r.drift <= kMaxOvershoot);
+            CHECK_EQ(clock.spins, 0);
+            break;
+        case kPacingSpin:
+            CHECK_EQ(r.maxJitter, 0);
+            CHECK_EQ(clock.sleeps, 0);
+            break;
+        }
+        CHECK(r.drift >= 0 && r.drift <= kMaxOvershoot);
+    }
+}
+
+// Deadlines are last + interval, not now + interval: a frame that wakes late
+// shortens the next wait instead of pushing every later frame back.
+void AbsoluteDeadlines() {
+    FakeClock clock;
+    FramePacer pacer;
+    pacer.Configure(Clock(clock), kFps, kPacingTimer, kSpinUs);
+    pacer.Wait();
+    const LONGLONG start = clock.now;
+
+    clock.now += 1000;
+    pacer.Wait();
+    const LONGLONG late = clock.now - (start + kInterval);
+    CHECK(late >= 0 && late <= kMaxOvershoot);
+
+    clock.now += 1000;
+    const LONGLONG sleptBefore = clock.slept;
+    pacer.Wait();
+    CHECK_EQ(clock.slept - sleptBefore, start + 2 * kInterval - (start + kInterval + late + 1000));
+}
+
+// More than a frame behind: the next frame goes at once and the schedule
+// restarts from it, rather than presenting the missed frames back to back.
+void StallResyncs() {
+    FakeClock clock;
+    FramePacer pacer;
+    pacer.Configure(Clock(clock), kFps, kPacingHybrid, kSpinUs);
+    pacer.Wait();
+
+    clock.now += 5 * kInterval;
+    const LONGLONG resumed = clock.now;
+    CHECK_EQ(pacer.Wait(), 0);
+    CHECK_EQ(clock.now, resumed);
+
+    pacer.Wait();
+    CHECK_EQ(clock.now, resumed + kInterval);
+
+    // Less than a frame behind keeps the grid: no wait now, and the next
+    // deadline is still one interval after the missed one.
+    const LONGLONG missed = clock.now + kInterval;
+    clock.now = missed + kInterval / 2;
+    CHECK_EQ(pacer.Wait(), 0);
+    pacer.Wait();
+    CHECK_EQ(clock.now, missed + kInterval);
+}
+
+void Off() {
+    FakeClock clock;
+    FramePacer pacer;
+    pacer.Configure(Clock(clock), 0, kPacingHybrid, kSpinUs);
+    for (int i = 0; i < 10; i++) CHECK_EQ(pacer.Wait(), 0);
+    CHECK_EQ(clock.nows + clock.sleeps + clock.spins, 0);
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Modes);
+    RUN_STEP(AbsoluteDeadlines);
+    RUN_STEP(StallResyncs);
+    RUN_STEP(Off);
+    CheckExit();
+}
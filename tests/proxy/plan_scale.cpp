@@ -0,0 +1,181 @@
+// PlanScale(): the rects and filter of the GPU scaling stage, for each
+// ScaleMode and FitMode. A table of hand-worked cases, then a sweep over
+// sizes that checks what every plan must satisfy: dst inside the output and
+// centered, the aspect ratio kept by aspect and integer fits, whole-number
+// factors for integer fits whenever the output is big enough, and fillBars
+// set exactly when dst leaves part of the output uncovered. Last, a device
+// that presents through the scale chain still dies on the game's last Release.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+namespace {
+
+struct Case {
+    const char* name;
+    ScaleMode mode;
+    FitMode fit;
+    RECT src;
+    LONG outW, outH;
+    bool planned;
+    RECT dst;
+    D3DTEXTUREFILTERTYPE filter;
+    bool fillBars;
+};
+
+const Case kCases[] = {
+    { "off", kScaleOff, kFitStretch, { 0, 0, 800, 600 }, 1280, 720, false },
+    { "empty source", kScalePoint, kFitStretch, { 0, 0, 0, 600 }, 1280, 720, false },
+    { "inverted source", kScalePoint, kFitStretch, { 800, 0, 0, 600 }, 1280, 720, false },
+    { "minimized output", kScaleBilinear, kFitAspect, { 0, 0, 800, 600 }, 0, 0, false },
+
+    { "point stretch", kScalePoint, kFitStretch, { 0, 0, 800, 600 }, 1280, 720,
+        true, { 0, 0, 1280, 720 }, D3DTEXF_POINT, false },
+    { "bilinear stretch", kScaleBilinear, kFitStretch, { 0, 0, 800, 600 }, 1280, 720,
+        true, { 0, 0, 1280, 720 }, D3DTEXF_LINEAR, false },
+    { "bilinear pillarbox", kScaleBilinear, kFitAspect, { 0, 0, 800, 600 }, 1280, 720,
+        true, { 160, 0, 1120, 720 }, D3DTEXF_LINEAR, true },
+    { "bilinear letterbox", kScaleBilinear, kFitAspect, { 0, 0, 800, 600 }, 1280, 1024,
+        true, { 0, 32, 1280, 992 }, D3DTEXF_LINEAR, true },
+    { "aspect, same ratio", kScalePoint, kFitAspect, { 0, 0, 640, 360 }, 1920, 1080,
+        true, { 0, 0, 1920, 1080 }, D3DTEXF_POINT, false },
+    { "bilinear, integer fit", kScaleBilinear, kFitInteger, { 0, 0, 640, 480 }, 1920, 1080,
+        true, { 320, 60, 1600, 1020 }, D3DTEXF_LINEAR, true },
+
+    // Mode=integer forces the integer fit and nearest filtering.
+    { "integer 2x", kScaleInteger, kFitStretch, { 0, 0, 640, 480 }, 1920, 1080,
+        true, { 320, 60, 1600, 1020 }, D3DTEXF_POINT, true },
+    { "integer, exact fit", kScaleInteger, kFitAspect, { 0, 0, 640, 360 }, 1280, 720,
+        true, { 0, 0, 1280, 720 }, D3DTEXF_POINT, false },
+    { "integer 1x, odd margins", kScaleInteger, kFitStretch, { 0, 0, 800, 600 }, 1281, 721,
+        true, { 240, 60, 1040, 660 }, D3DTEXF_POINT, true },
+    // Smaller than the source: no whole factor, so aspect fit.
+    { "integer, output too small", kScaleInteger, kFitStretch, { 0, 0, 800, 600 }, 640, 400,
+        true, { 53, 0, 586, 400 }, D3DTEXF_POINT, true },
+
+    // Only the size of src matters for dst; src itself is passed through.
+    { "offset source", kScaleBilinear, kFitAspect, { 100, 50, 900, 650 }, 1280, 720,
+        true, { 160, 0, 1120, 720 }, D3DTEXF_LINEAR, true },
+};
+
+bool SameRect(const RECT& a, const RECT& b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+void Table() {
+    for (const Case& c : kCases) {
+        ScalePlan plan;
+        const bool planned = PlanScale(c.mode, c.fit, c.src, c.outW, c.outH, plan);
+        bool ok = planned == c.planned;
+        if (ok && planned) {
+            ok = SameRect(plan.src, c.src) && SameRect(plan.dst, c.dst) && plan.filter == c.filter &&
+                 plan.fillBars == c.fillBars;
+        }
+        if (!CHECK(ok)) {
+            fprintf(stderr, "  %s: planned=%d dst={%ld,%ld,%ld,%ld} filter=%d bars=%d\n", c.name, planned,
+                plan.dst.left, plan.dst.top, plan.dst.right, plan.dst.bottom, (int)plan.filter, plan.fillBars);
+        }
+    }
+}
+
+// One plan against the rules every plan keeps. Returns false if it breaks
+// one, after saying which.
+bool CheckPlan(ScaleMode mode, FitMode fit, LONG sw, LONG sh, LONG outW, LONG outH) {
+    const RECT src{ 0, 0, sw, sh };
+    ScalePlan plan;
+    if (!PlanScale(mode, fit, src, outW, outH, plan)) return CHECK(false);
+
+    const FitMode effective = mode == kScaleInteger ? kFitInteger : fit;
+    const bool wholeFactor = effective == kFitInteger && outW >= sw && outH >= sh;
+    const LONG k = wholeFactor ? (std::min)(outW / sw, outH / sh) : 0;
+    const RECT& d = plan.dst;
+    const LONG w = d.right - d.left, h = d.bottom - d.top;
+    const char* broken = nullptr;
+
+    if (!SameRect(plan.src, src)) broken = "src changed";
+    else if (d.left < 0 || d.top < 0 || d.right > outW || d.bottom > outH || w <= 0 || h <= 0) broken = "dst outside";
+    else if (d.left != (outW - w) / 2 || d.top != (outH - h) / 2) broken = "not centered";
+    else if (plan.fillBars != (w != outW || h != outH)) broken = "fillBars";
+    else if (plan.filter != (mode == kScaleBilinear ? D3DTEXF_LINEAR : D3DTEXF_POINT)) broken = "filter";
+    else if (effective == kFitStretch && (w != outW || h != outH)) broken = "stretch not full";
+    else if (wholeFactor && (w != sw * k || h != sh * k)) broken = "not the largest whole factor";
+    else if (effective != kFitStretch && !wholeFactor && w != outW && h != outH) broken = "touches neither edge";
+    else if (effective != kFitStretch && !wholeFactor &&
+             llabs((LONGLONG)w * sh - (LONGLONG)h * sw) >= (LONGLONG)(std::max)(sw, sh)) {
+        broken = "aspect";
+    }
+
+    if (broken) {
+        fprintf(stderr, "  mode=%d fit=%d %ldx%ld -> %ldx%ld: %s, dst={%ld,%ld,%ld,%ld}\n", (int)mode, (int)fit, sw,
+            sh, outW, outH, broken, d.left, d.top, d.right, d.bottom);
+    }
+    return CHECK(!broken);
+}
+
+void Sweep() {
+    const LONG kSources[][2] = { { 320, 240 }, { 640, 480 }, { 800, 600 }, { 1024, 768 }, { 1280, 720 },
+        { 1366, 768 }, { 1920, 1080 }, { 720, 1280 }, { 513, 257 } };
+    const ScaleMode kModes[] = { kScalePoint, kScaleBilinear, kScaleInteger };
+    const FitMode kFits[] = { kFitStretch, kFitAspect, kFitInteger };
+
+    long plans = 0;
+    for (const auto& s : kSources) {
+        for (LONG outW = 100; outW <= 3840; outW += 97) {
+            for (LONG outH = 100; outH <= 2160; outH += 89) {
+                for (ScaleMode mode : kModes) {
+                    for (FitMode fit : kFits) {
+                        if (!CheckPlan(mode, fit, s[0], s[1], outW, outH)) return;
+                        plans++;
+                    }
+                }
+            }
+        }
+    }
+    printf("%ld plans\n", plans);
+}
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+// An 800x600 backbuffer in a 1280x720 client, so every Present goes through
+// the proxy swapchain, which holds a reference to the device.
+void ReleaseScaledDevice() {
+    FakeIniSet("Scaling", "Mode", "bilinear");
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    HWND hwnd = FakeCreateWindow(100, 100, 1280, 720, &GameProc);
+    FakeSetForeground(hwnd);
+    NoteProcessAttach();
+
+    IDirect3D9* d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(d3d)) return;
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    IDirect3DDevice9* dev = nullptr;
+    if (!CHECK(SUCCEEDED(d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, hwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &dev)))) return;
+
+    for (int i = 0; i < 3; i++) CHECK(SUCCEEDED(dev->Present(nullptr, nullptr, nullptr, nullptr)));
+    CHECK(FakeLastPresent().viaSwapChain);
+    CHECK_EQ(FakeDeviceDefaultResources(dev), 1);
+
+    CHECK_EQ(dev->Release(), 0);
+    CHECK_EQ(FakeD3D9LiveObjects(), 1);
+    CHECK_EQ(d3d->Release(), 0);
+}
+
+}  // namespace
+
+int main() {
+    RUN_STEP(Table);
+    RUN_STEP(Sweep);
+    RUN_STEP(ReleaseScaledDevice);
+    CheckExit();
+}
@@ -0,0 +1,378 @@
+// Runs the proxy's detours unchanged against the fakes, the way a game would
+// reach them: Direct3DCreate9 from our export, CreateDevice and every later
+// call through the vtables the proxy patched. Each step checks that the slot
+// holds the detour, what the fake received, and the fake calls the detour
+// cost (fake_calls.h).
+//
+// IDirect3D9::CreateDevice (16); device Reset (16), Present (17),
+// SetRenderTarget (37), SetViewport (47); swapchain Present (3); the window
+// proc; DirectInput GetDeviceState (9), SetCooperativeLevel (13), Poll (25);
+// and the late GetForegroundWindow hook. Last, a HookSet whose enable cannot
+// be queued.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_dinput.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+namespace {
+
+struct GameWindow {
+    HWND hwnd;
+    UINT lastMsg;
+    WPARAM lastWParam;
+    LPARAM lastLParam;
+    int messages;
+};
+
+GameWindow g_game;
+
+LRESULT CALLBACK GameProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    g_game.lastMsg = msg;
+    g_game.lastWParam = wParam;
+    g_game.lastLParam = lParam;
+    g_game.messages++;
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+void* Slot(void* obj, int slot) {
+    return (*(void***)obj)[slot];
+}
+
+template <typename Fn>
+void* Fp(Fn fn) {
+    return reinterpret_cast<void*>(fn);
+}
+
+bool SameRect(const RECT& a, LONG l, LONG t, LONG r, LONG b) {
+    return a.left == l && a.top == t && a.right == r && a.bottom == b;
+}
+
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+IDirectInputDevice8A* g_mouse = nullptr;
+
+const LONG kClientW = 1280, kClientH = 720;
+const UINT kBackW = 800, kBackH = 600;
+
+void Startup() {
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+
+    CHECK(Slot(g_d3d, 16) == Fp(&Hook_CreateDevice));
+    CHECK(FakeHookEnabled(Fp(Real_CreateDevice)));
+    CHECK(Real_DirectInput8Create != nullptr);
+}
+
+void CreateDevice() {
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = kBackW;
+    pp.BackBufferHeight = kBackH;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = FALSE;  // the fake only creates windowed devices
+    pp.FullScreen_RefreshRateInHz = 60;
+
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_game.hwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    if (!CHECK(SUCCEEDED(hr) && g_dev)) CheckExit();
+
+    CHECK_EQ(d[kFakeD3DCreateDevice], 1);
+    CHECK(pp.Windowed);
+    CHECK_EQ(pp.FullScreen_RefreshRateInHz, 0);
+    CHECK(FakeDevicePP(g_dev).hDeviceWindow == g_game.hwnd);
+    CHECK(!FakeDeviceIsEx(g_dev));
+
+    CHECK(Slot(g_dev, 16) == Fp(&Hook_Reset));
+    CHECK(Slot(g_dev, 17) == Fp(&Hook_Present));
+    CHECK(Slot(g_dev, 37) == Fp(&Hook_SetRenderTarget));
+    CHECK(Slot(g_dev, 47) == Fp(&Hook_SetViewport));
+
+    IDirect3DSwapChain9* sc = nullptr;
+    if (CHECK(SUCCEEDED(g_dev->GetSwapChain(0, &sc)) && sc)) {
+        CHECK(Slot(sc, 3) == Fp(&Hook_SwapChainPresent));
+        sc->Release();
+    }
+
+    CHECK(FakeWindowProc(g_game.hwnd) == &Hook_WndProc);
+    CHECK_EQ(g_bbW, kBackW);
+    CHECK_EQ(g_bbH, kBackH);
+}
+
+void DevicePresent() {
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK(SUCCEEDED(hr));
+
+    // The backbuffer is stretched over the whole client area of the game window.
+    const FakePresentCall p = FakeLastPresent();
+    CHECK(p.self == g_dev);
+    CHECK(!p.viaSwapChain);
+    CHECK(p.hasDst && SameRect(p.dst, 0, 0, kClientW, kClientH));
+    CHECK(p.hwnd == g_game.hwnd);
+    CHECK_EQ(d[kFakeDevPresent], 1);
+
+    // Once the device state is cached, a frame costs the Present and nothing
+    // that walks the device or the window again.
+    const FakeCallSnapshot before2 = FakeCallsNow();
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    const FakeCallSnapshot d2 = FakeCallsNow() - before2;
+    CHECK_EQ(d2[kFakeDevPresent], 1);
+    CHECK_EQ(d2[kFakeDevGetBackBuffer], 0);
+    CHECK_EQ(d2[kFakeDevGetSwapChain], 0);
+    CHECK_EQ(d2[kFakeGetClientRect], 0);
+    CHECK_EQ(d2[kFakeDevGetRenderTarget], 0);
+    if (CheckFailures()) FakePrintCalls("steady Present", d2);
+}
+
+void SwapChainPresent() {
+    IDirect3DSwapChain9* sc = nullptr;
+    if (!CHECK(SUCCEEDED(g_dev->GetSwapChain(0, &sc)) && sc)) return;
+
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = sc->Present(nullptr, nullptr, nullptr, nullptr, 0);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK(SUCCEEDED(hr));
+
+    const FakePresentCall p = FakeLastPresent();
+    CHECK(p.self == sc);
+    CHECK(p.viaSwapChain);
+    CHECK(p.hasDst && SameRect(p.dst, 0, 0, kClientW, kClientH));
+    CHECK(p.hwnd == g_game.hwnd);
+    CHECK_EQ(d[kFakeSwapPresent], 1);
+    CHECK_EQ(d[kFakeDevPresent], 0);
+    sc->Release();
+}
+
+void SetViewport() {
+    // Sized for the desktop rather than the backbuffer: the fake rejects it
+    // as the runtime does, so it only gets through clamped.
+    D3DVIEWPORT9 vp{ 0, 0, 1024, 768, 0.0f, 1.0f };
+    HRESULT hr = g_dev->SetViewport(&vp);
+    CHECK(SUCCEEDED(hr));
+    D3DVIEWPORT9 got = FakeDeviceViewport(g_dev);
+    CHECK_EQ(got.X, 0);
+    CHECK_EQ(got.Width, kBackW);
+    CHECK_EQ(got.Height, kBackH);
+
+    D3DVIEWPORT9 off{ 700, 500, 400, 400, 0.0f, 1.0f };
+    CHECK(SUCCEEDED(g_dev->SetViewport(&off)));
+    got = FakeDeviceViewport(g_dev);
+    CHECK_EQ(got.X, 700);
+    CHECK_EQ(got.Width, kBackW - 700);
+    CHECK_EQ(got.Height, kBackH - 500);
+
+    // The next Present samples the viewport it just shadowed as its source rect.
+    const FakeCallSnapshot before = FakeCallsNow();
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    const FakePresentCall p = FakeLastPresent();
+    CHECK(p.hasSrc && SameRect(p.src, 700, 500, kBackW, kBackH));
+    CHECK_EQ(d[kFakeDevGetViewport], 0);
+
+    // SetRenderTarget(0) puts the full viewport back on the device and in the shadow.
+    IDirect3DSurface9* bb = nullptr;
+    if (CHECK(SUCCEEDED(g_dev->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &bb)) && bb)) {
+        CHECK(SUCCEEDED(g_dev->SetRenderTarget(0, bb)));
+        got = FakeDeviceViewport(g_dev);
+        CHECK_EQ(got.Width, kBackW);
+        g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+        CHECK(!FakeLastPresent().hasSrc || SameRect(FakeLastPresent().src, 0, 0, kBackW, kBackH));
+        bb->Release();
+    }
+}
+
+void Reset() {
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 1024;
+    pp.BackBufferHeight = 768;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = FALSE;
+    pp.FullScreen_RefreshRateInHz = 60;
+
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = g_dev->Reset(&pp);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK(SUCCEEDED(hr));
+    CHECK_EQ(d[kFakeDevReset], 1);
+    CHECK(pp.Windowed);
+    CHECK(FakeDevicePP(g_dev).Windowed);
+    CHECK_EQ(FakeDevicePP(g_dev).BackBufferWidth, 1024);
+    CHECK_EQ(g_bbW, 1024);
+    CHECK_EQ(g_bbH, 768);
+
+    // Nothing the proxy created may survive into the Reset (the fake would fail it).
+    CHECK_EQ(FakeDeviceDefaultResources(g_dev), 0);
+
+    // A viewport that fits the new backbuffer passes untouched.
+    D3DVIEWPORT9 vp{ 0, 0, 1024, 768, 0.0f, 1.0f };
+    CHECK(SUCCEEDED(g_dev->SetViewport(&vp)));
+    CHECK_EQ(FakeDeviceViewport(g_dev).Width, 1024);
+
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    const FakePresentCall p = FakeLastPresent();
+    CHECK(p.hasDst && SameRect(p.dst, 0, 0, kClientW, kClientH));
+}
+
+void WndProc() {
+    // Ordinary traffic reaches the game untouched.
+    int seen = g_game.messages;
+    const FakeCallSnapshot before = FakeCallsNow();
+    FakeSendMessage(g_game.hwnd, WM_USER + 7, 11, 22);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK_EQ(g_game.messages, seen + 1);
+    CHECK_EQ(g_game.lastMsg, WM_USER + 7);
+    CHECK_EQ(g_game.lastWParam, 11);
+    CHECK_EQ(g_game.lastLParam, 22);
+    CHECK_EQ(d[kFakeCallWindowProc], 1);
+    CHECK_EQ(d[kFakeQueryPerformanceCounter], 0);
+
+    // With IgnoreDeactivate the game never hears it lost focus.
+    seen = g_game.messages;
+    CHECK_EQ(FakeSendMessage(g_game.hwnd, WM_ACTIVATEAPP, FALSE, 0), 0);
+    CHECK_EQ(FakeSendMessage(g_game.hwnd, WM_KILLFOCUS, 0, 0), 0);
+    CHECK_EQ(g_game.messages, seen);
+    CHECK_EQ(g_deactivated, 1);
+
+    FakeSendMessage(g_game.hwnd, WM_ACTIVATEAPP, TRUE, 0);
+    CHECK_EQ(g_game.messages, seen + 1);
+    CHECK_EQ(g_deactivated, 0);
+
+    // WM_SIZE reaches the game and updates the view the Present path scales to.
+    FakeSendMessage(g_game.hwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(kClientW, kClientH));
+    CHECK_EQ(g_game.lastMsg, WM_SIZE);
+}
+
+void DirectInput() {
+    HMODULE dinput = LoadLibraryA("dinput8.dll");
+    auto create = reinterpret_cast<DirectInput8Create_t>(GetProcAddress(dinput, "DirectInput8Create"));
+    if (!CHECK(create)) return;
+
+    IDirectInput8A* di = nullptr;
+    if (!CHECK(SUCCEEDED(create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION, IID_IDirectInput8A,
+        (void**)&di, nullptr)) && di)) return;
+    if (!CHECK(SUCCEEDED(di->CreateDevice(GUID_SysMouse, &g_mouse, nullptr)) && g_mouse)) return;
+
+    CHECK(Slot(g_mouse, 9) == Fp(&Hook_GetDeviceState));
+    CHECK(Slot(g_mouse, 13) == Fp(&Hook_SetCooperativeLevel));
+    CHECK(Slot(g_mouse, 25) == Fp(&Hook_Poll));
+
+    // Exclusive background mice lose the exclusive part.
+    CHECK(SUCCEEDED(g_mouse->SetCooperativeLevel(g_game.hwnd, DISCL_EXCLUSIVE | DISCL_BACKGROUND)));
+    CHECK_EQ(FakeDInputCoopFlags(g_mouse), DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
+
+    DIMOUSESTATE2 in{};
+    in.lX = 5;
+    in.lY = -3;
+    FakeDInputSetMouseState(in);
+    CHECK(SUCCEEDED(g_mouse->Acquire()));
+
+    DIMOUSESTATE2 out{};
+    FakeCallSnapshot before = FakeCallsNow();
+    CHECK(SUCCEEDED(g_mouse->GetDeviceState(sizeof(out), &out)));
+    FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK_EQ(out.lX, 5);
+    CHECK_EQ(d[kFakeDiGetDeviceState], 1);
+    CHECK_EQ(d[kFakeDiAcquire], 0);
+
+    // Lost input is re-acquired inside the same call instead of surfacing to the game.
+    FakeDInputLoseDevices();
+    memset(&out, 0, sizeof(out));
+    before = FakeCallsNow();
+    CHECK(SUCCEEDED(g_mouse->GetDeviceState(sizeof(out), &out)));
+    d = FakeCallsNow() - before;
+    CHECK_EQ(out.lY, -3);
+    CHECK_EQ(d[kFakeDiGetDeviceState], 2);
+    CHECK_EQ(d[kFakeDiAcquire], 1);
+    CHECK(FakeDInputAcquired(g_mouse));
+
+    FakeDInputLoseDevices();
+    before = FakeCallsNow();
+    CHECK(SUCCEEDED(g_mouse->Poll()));
+    d = FakeCallsNow() - before;
+    CHECK_EQ(d[kFakeDiPoll], 2);
+    CHECK_EQ(d[kFakeDiAcquire], 1);
+
+    di->Release();
+}
+
+void ForegroundWindow() {
+    HWND other = FakeCreateWindow(40, 40, 320, 240, &DefWindowProc);
+    FakeSetForeground(other);
+
+    // Not before the process has run a while and presented enough frames.
+    CHECK(!FakeHookCreated(g_pGetForegroundWindow));
+    FakeAdvanceTicks(6000);
+    for (int i = 0; i < 120; i++) g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK(FakeHookEnabled(g_pGetForegroundWindow));
+
+    // Deactivated, the game keeps seeing its own window in front.
+    CHECK(GetForegroundWindow() == other);
+    FakeSendMessage(g_game.hwnd, WM_ACTIVATEAPP, FALSE, 0);
+    CHECK(GetForegroundWindow() == g_game.hwnd);
+    FakeSendMessage(g_game.hwnd, WM_ACTIVATEAPP, TRUE, 0);
+    CHECK(GetForegroundWindow() == other);
+
+    FakeSetForeground(g_game.hwnd);
+    FakeDestroyWindow(other);
+}
+
+int StubTarget() { return 1; }
+int StubDetour() { return 2; }
+
+// A hook whose enable cannot be queued is removed again, original and all,
+// instead of staying created but never enabled.
+void QueueFailure() {
+    void* target = reinterpret_cast<void*>(&StubTarget);
+    void* original = nullptr;
+    FakeFailQueueEnable(target);
+
+    HookSet hooks("test");
+    CHECK(!hooks.Add(target, reinterpret_cast<void*>(&StubDetour), &original));
+    CHECK_EQ(hooks.queued, 0u);
+    CHECK_EQ(hooks.failed, 1u);
+    CHECK(!FakeHookCreated(target));
+    CHECK(original == nullptr);
+
+    // Nothing is left behind to make the next attempt fail as already created.
+    FakeFailQueueEnable(nullptr);
+    CHECK(hooks.Add(target, reinterpret_cast<void*>(&StubDetour), &original));
+    CHECK(original == target);
+    CHECK_EQ(hooks.Commit(), MH_OK);
+    CHECK(FakeHookEnabled(target));
+    CHECK_EQ(MH_RemoveHook(target), MH_OK);
+}
+
+void Teardown() {
+    g_mouse->Release();
+    CHECK_EQ(g_dev->Release(), 0);
+    CHECK_EQ(g_d3d->Release(), 0);
+}
+
+}  // namespace
+
+int main() {
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_game.hwnd = FakeCreateWindow(100, 100, kClientW, kClientH, &GameProc);
+    FakeSetForeground(g_game.hwnd);
+    NoteProcessAttach();
+
+    RUN_STEP(Startup);
+    RUN_STEP(CreateDevice);
+    RUN_STEP(DevicePresent);
+    RUN_STEP(SwapChainPresent);
+    RUN_STEP(SetViewport);
+    RUN_STEP(Reset);
+    RUN_STEP(WndProc);
+    RUN_STEP(DirectInput);
+    RUN_STEP(ForegroundWindow);
+    RUN_STEP(QueueFailure);
+    RUN_STEP(Teardown);
+    CheckExit();
+}
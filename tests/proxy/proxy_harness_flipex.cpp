@@ -0,0 +1,253 @@
+// The FlipEx=1 half of proxy_harness.cpp: CreateDevice goes through the
+// proxy's private IDirect3D9Ex, the device's resource creation slots (23-27)
+// are hooked, managed resources are emulated on the Ex device (managed
+// buffers read back what was written and reach the GPU through DISCARD
+// uploads, and the device stays FLIPEX after its DeviceState is evicted), and
+// Present and Reset keep the flip model.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_dinput.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+namespace {
+
+HWND g_gameHwnd = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+
+const LONG kClientW = 1280, kClientH = 720;
+
+void* Slot(void* obj, int slot) {
+    return (*(void***)obj)[slot];
+}
+
+template <typename Fn>
+void* Fp(Fn fn) {
+    return reinterpret_cast<void*>(fn);
+}
+
+D3DPRESENT_PARAMETERS GamePP(UINT w, UINT h) {
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = w;
+    pp.BackBufferHeight = h;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = FALSE;
+    return pp;
+}
+
+void CreateDevice() {
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+    CHECK(Slot(g_d3d, 16) == Fp(&Hook_CreateDevice));
+
+    D3DPRESENT_PARAMETERS pp = GamePP(800, 600);
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    if (!CHECK(SUCCEEDED(hr) && g_dev)) CheckExit();
+
+    CHECK_EQ(d[kFakeD3DCreateDeviceEx], 1);
+    CHECK_EQ(d[kFakeD3DCreateDevice], 0);
+    CHECK(FakeDeviceIsEx(g_dev));
+    CHECK_EQ(FakeDevicePP(g_dev).SwapEffect, D3DSWAPEFFECT_FLIPEX);
+    CHECK_EQ(pp.SwapEffect, D3DSWAPEFFECT_DISCARD);  // the game sees what it asked for
+    CHECK_EQ(g_flipExActive, 1);
+
+    CHECK(Slot(g_dev, 16) == Fp(&Hook_Reset));
+    CHECK(Slot(g_dev, 17) == Fp(&Hook_Present));
+    CHECK(Slot(g_dev, 23) == Fp(&Hook_CreateTexture));
+    CHECK(Slot(g_dev, 24) == Fp(&Hook_CreateVolumeTexture));
+    CHECK(Slot(g_dev, 25) == Fp(&Hook_CreateCubeTexture));
+    CHECK(Slot(g_dev, 26) == Fp(&Hook_CreateVertexBuffer));
+    CHECK(Slot(g_dev, 27) == Fp(&Hook_CreateIndexBuffer));
+    CHECK(Slot(g_dev, 37) == Fp(&Hook_SetRenderTarget));
+    CHECK(Slot(g_dev, 47) == Fp(&Hook_SetViewport));
+
+    IDirect3DSwapChain9* sc = nullptr;
+    if (CHECK(SUCCEEDED(g_dev->GetSwapChain(0, &sc)) && sc)) {
+        CHECK(Slot(sc, 3) == Fp(&Hook_SwapChainPresent));
+        sc->Release();
+    }
+}
+
+void FlipPresent() {
+    // DWM scales flip-model backbuffers; rects would fail the Present.
+    CHECK(SUCCEEDED(g_dev->Present(nullptr, nullptr, nullptr, nullptr)));
+    FakePresentCall p = FakeLastPresent();
+    CHECK(!p.hasSrc && !p.hasDst);
+
+    RECT dst{ 0, 0, kClientW, kClientH };
+    CHECK(SUCCEEDED(g_dev->Present(nullptr, &dst, nullptr, nullptr)));
+    p = FakeLastPresent();
+    CHECK(!p.hasDst);
+
+    IDirect3DSwapChain9* sc = nullptr;
+    if (CHECK(SUCCEEDED(g_dev->GetSwapChain(0, &sc)) && sc)) {
+        CHECK(SUCCEEDED(sc->Present(nullptr, &dst, nullptr, nullptr, 0)));
+        p = FakeLastPresent();
+        CHECK(p.viaSwapChain && !p.hasDst);
+        sc->Release();
+    }
+}
+
+void ManagedResources() {
+    // The Ex device rejects D3DPOOL_MANAGED; through the hooks it works.
+    IDirect3DTexture9* tex = nullptr;
+    const FakeCallSnapshot before = FakeCallsNow();
+    HRESULT hr = g_dev->CreateTexture(64, 64, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &tex, nullptr);
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    if (!CHECK(SUCCEEDED(hr) && tex)) return;
+    CHECK_EQ(d[kFakeDevCreateTexture], 2);  // DEFAULT texture plus its SYSTEMMEM twin
+    CHECK(IsShadowed(tex));
+
+    D3DSURFACE_DESC desc{};
+    CHECK(SUCCEEDED(tex->GetLevelDesc(0, &desc)));
+    CHECK_EQ(desc.Pool, D3DPOOL_MANAGED);
+
+    D3DLOCKED_RECT lr{};
+    CHECK(SUCCEEDED(tex->LockRect(0, &lr, nullptr, 0)));
+    CHECK(SUCCEEDED(tex->UnlockRect(0)));
+
+    IDirect3DCubeTexture9* cube = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateCubeTexture(32, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &cube, nullptr)) && cube);
+    IDirect3DVolumeTexture9* vol = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateVolumeTexture(8, 8, 8, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &vol, nullptr)) && vol);
+    IDirect3DVertexBuffer9* vb = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateVertexBuffer(256, 0, 0, D3DPOOL_MANAGED, &vb, nullptr)) && vb);
+    IDirect3DIndexBuffer9* ib = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateIndexBuffer(256, 0, D3DFMT_INDEX16, D3DPOOL_MANAGED, &ib, nullptr)) && ib);
+
+    // Reset keeps the device flip-model and brings the shadowed contents back.
+    D3DPRESENT_PARAMETERS pp = GamePP(1024, 768);
+    CHECK(SUCCEEDED(g_dev->Reset(&pp)));
+    CHECK_EQ(FakeDevicePP(g_dev).SwapEffect, D3DSWAPEFFECT_FLIPEX);
+    CHECK_EQ(pp.SwapEffect, D3DSWAPEFFECT_DISCARD);
+    CHECK(FakeDevicePP(g_dev).Windowed);
+
+    if (ib) ib->Release();
+    if (vb) vb->Release();
+    if (vol) vol->Release();
+    if (cube) cube->Release();
+    CHECK_EQ(tex->Release(), 0);
+    CHECK_EQ(g_shadowCount, 0);
+}
+
+// A managed buffer reads back what was written, however it is locked, while
+// the DYNAMIC buffer the GPU reads only ever takes whole DISCARD uploads.
+template <typename Buffer, typename Desc>
+void CheckManagedBuffer(Buffer* buf, DWORD usage) {
+    const UINT kBytes = 256;
+    Desc desc{};
+    CHECK(SUCCEEDED(buf->GetDesc(&desc)));
+    CHECK_EQ(desc.Pool, D3DPOOL_MANAGED);
+    CHECK_EQ(desc.Usage, usage);
+    CHECK_EQ(desc.Size, kBytes);
+
+    BYTE* p = nullptr;
+    CHECK(SUCCEEDED(buf->Lock(0, 0, (void**)&p, 0)) && p);
+    for (UINT i = 0; p && i < kBytes; i++) p[i] = (BYTE)i;
+    CHECK(SUCCEEDED(buf->Unlock()));
+
+    // A range lock with NOOVERWRITE, as games stream into managed buffers.
+    p = nullptr;
+    CHECK(SUCCEEDED(buf->Lock(64, 16, (void**)&p, D3DLOCK_NOOVERWRITE)) && p);
+    for (UINT i = 0; p && i < 16; i++) p[i] = 0xEE;
+    const FakeCallSnapshot before = FakeCallsNow();
+    CHECK(SUCCEEDED(buf->Unlock()));
+    const FakeCallSnapshot d = FakeCallsNow() - before;
+    CHECK_EQ(d[kFakeBufLock], 2);       // twin READONLY, buffer DISCARD
+    CHECK_EQ(d[kFakeBufUnlock], 3);
+
+    BYTE expect[kBytes];
+    for (UINT i = 0; i < kBytes; i++) expect[i] = (i >= 64 && i < 80) ? 0xEE : (BYTE)i;
+
+    p = nullptr;
+    CHECK(SUCCEEDED(buf->Lock(0, 0, (void**)&p, D3DLOCK_READONLY)) && p);
+    CHECK(p && memcmp(p, expect, kBytes) == 0);
+    CHECK(SUCCEEDED(buf->Unlock()));
+
+    const FakeBufferState gpu = FakeBuffer(buf);
+    CHECK_EQ(gpu.pool, D3DPOOL_DEFAULT);
+    CHECK_EQ(gpu.usage, usage | D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY);
+    CHECK_EQ(gpu.lastLockFlags, D3DLOCK_DISCARD);
+    CHECK(gpu.data && memcmp(gpu.data, expect, kBytes) == 0);
+}
+
+void ManagedBuffers() {
+    const int live = FakeD3D9LiveObjects();
+
+    IDirect3DVertexBuffer9* vb = nullptr;
+    if (!CHECK(SUCCEEDED(g_dev->CreateVertexBuffer(256, 0, 0, D3DPOOL_MANAGED, &vb, nullptr)) && vb)) return;
+    CHECK(IsShadowed(vb));
+    CheckManagedBuffer<IDirect3DVertexBuffer9, D3DVERTEXBUFFER_DESC>(vb, 0);
+
+    IDirect3DIndexBuffer9* ib = nullptr;
+    if (!CHECK(SUCCEEDED(g_dev->CreateIndexBuffer(256, D3DUSAGE_WRITEONLY, D3DFMT_INDEX16, D3DPOOL_MANAGED, &ib,
+        nullptr)) && ib)) return;
+    CHECK(IsShadowed(ib));
+    CheckManagedBuffer<IDirect3DIndexBuffer9, D3DINDEXBUFFER_DESC>(ib, D3DUSAGE_WRITEONLY);
+
+    // Reset uploads the twins again.
+    D3DPRESENT_PARAMETERS pp = GamePP(800, 600);
+    CHECK(SUCCEEDED(g_dev->Reset(&pp)));
+    CHECK_EQ(FakeBuffer(vb).lastLockFlags, D3DLOCK_DISCARD);
+
+    CHECK_EQ(ib->Release(), 0);
+    CHECK_EQ(vb->Release(), 0);
+    CHECK_EQ(g_shadowCount, 0);
+    CHECK_EQ(FakeD3D9LiveObjects(), live);
+}
+
+// Four newer devices push the game's out of the DeviceState ring; it is still
+// a FLIPEX device, so MANAGED creates still get emulated.
+void EvictedState() {
+    IDirect3DDevice9* others[ARRAYSIZE(g_devStates)]{};
+    for (IDirect3DDevice9*& dev : others) {
+        D3DPRESENT_PARAMETERS pp = GamePP(640, 480);
+        CHECK(SUCCEEDED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+            D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &dev)) && dev);
+    }
+    CHECK(!FindDeviceState(g_dev));
+    CHECK(IsFlipExDevice(g_dev));
+
+    IDirect3DVertexBuffer9* vb = nullptr;
+    CHECK(SUCCEEDED(g_dev->CreateVertexBuffer(256, 0, 0, D3DPOOL_MANAGED, &vb, nullptr)) && vb);
+    CHECK(vb && IsShadowed(vb));
+    if (vb) CHECK_EQ(vb->Release(), 0);
+
+    // Each entry goes with its device.
+    for (IDirect3DDevice9* dev : others) {
+        if (dev) CHECK_EQ(dev->Release(), 0);
+    }
+    CHECK_EQ(g_flipExCount, 1);
+    CHECK(IsFlipExDevice(g_dev));
+}
+
+void Teardown() {
+    CHECK_EQ(g_dev->Release(), 0);
+    CHECK_EQ(g_flipExCount, 0);
+    CHECK_EQ(g_d3d->Release(), 0);
+}
+
+}  // namespace
+
+int main() {
+    FakeIniSet("Preferences", "FlipEx", "1");
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, kClientW, kClientH, &DefWindowProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    RUN_STEP(CreateDevice);
+    RUN_STEP(FlipPresent);
+    RUN_STEP(ManagedResources);
+    RUN_STEP(ManagedBuffers);
+    RUN_STEP(EvictedState);
+    RUN_STEP(Teardown);
+    CheckExit();
+}
@@ -0,0 +1,141 @@
+// [Preferences] HighPollMouse: WM_INPUT mouse deltas read through the
+// GetRawInputData hook are scaled by the factor the view scales WM_MOUSEMOVE
+// by, with the sub-unit remainder carried into the next packet.
+//
+// Checks that a run of one-count packets adds up to the scaled total, that a
+// size query and a second read of the same HRAWINPUT get the deltas of the
+// first read without feeding the remainder again, and that absolute packets
+// are left alone.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+namespace {
+
+const LONG kClientW = 1280, kClientH = 720;
+
+HWND g_gameHwnd = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+ViewTransform g_view;
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+HRAWINPUT QueueMove(LONG dx, LONG dy, USHORT flags = 0) {
+    RAWINPUT ri{};
+    ri.header.dwType = RIM_TYPEMOUSE;
+    ri.data.mouse.usFlags = flags;
+    ri.data.mouse.lLastX = dx;
+    ri.data.mouse.lLastY = dy;
+    return FakeQueueRawInput(ri);
+}
+
+// One RID_INPUT read into a fresh buffer, as the game makes it.
+RAWMOUSE Read(HRAWINPUT h) {
+    RAWINPUT ri{};
+    UINT size = sizeof(ri);
+    CHECK_EQ(GetRawInputData(h, RID_INPUT, &ri, &size, sizeof(RAWINPUTHEADER)), (UINT)sizeof(RAWINPUT));
+    return ri.data.mouse;
+}
+
+// An 800x600 backbuffer in a 1280x720 client with the user32 virtualization
+// on, as in wndproc_bench.
+void Setup() {
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    if (!CHECK(SUCCEEDED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_gameHwnd,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev)))) CheckExit();
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+
+    InterlockedExchange(&g_win32VirtEnabled, 1);
+    MaybeInstallUser32VirtualHooks();
+    FakeSendMessage(g_gameHwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(kClientW, kClientH));
+
+    CHECK(FakeHookEnabled(reinterpret_cast<void*>(Real_GetRawInputData)));
+    if (!CHECK(ShouldVirtualizeWin32(g_gameHwnd, g_view))) CheckExit();
+    CHECK_EQ(g_view.virtW, 800);
+    CHECK_EQ(g_view.imageW, kClientW);
+}
+
+// Slow movement is not rounded away: the remainders carry, so n one-count
+// packets move as far as one n-count packet would.
+void Remainders() {
+    const LONG kPackets = 64;
+    LONG x = 0, y = 0;
+    for (LONG i = 0; i < kPackets; i++) {
+        const RAWMOUSE m = Read(QueueMove(1, 1));
+        x += m.lLastX;
+        y += m.lLastY;
+    }
+    CHECK_EQ(x, kPackets * g_view.virtW / g_view.imageW);
+    CHECK_EQ(y, kPackets * g_view.virtH / g_view.imageH);
+}
+
+// A size query is not a read, and a second read of the same packet is the
+// first one again.
+void RepeatedRead() {
+    const LONGLONG remX = g_rawRemX, remY = g_rawRemY;
+    const LONG64 scaled = g_coalesceStats.rawScaled;
+
+    const HRAWINPUT h = QueueMove(3, 5);
+    UINT size = 0;
+    CHECK_EQ(GetRawInputData(h, RID_INPUT, nullptr, &size, sizeof(RAWINPUTHEADER)), 0u);
+    CHECK_EQ(size, (UINT)sizeof(RAWINPUT));
+    CHECK_EQ(g_rawRemX, remX);
+    CHECK_EQ(g_rawRemY, remY);
+
+    const RAWMOUSE first = Read(h);
+    const LONGLONG afterX = g_rawRemX, afterY = g_rawRemY;
+    const RAWMOUSE second = Read(h);
+    CHECK_EQ(second.lLastX, first.lLastX);
+    CHECK_EQ(second.lLastY, first.lLastY);
+    CHECK_EQ(g_rawRemX, afterX);
+    CHECK_EQ(g_rawRemY, afterY);
+    CHECK_EQ(g_coalesceStats.rawScaled - scaled, 1);
+
+    // The next packet with the same deltas is scaled on its own.
+    const RAWMOUSE next = Read(QueueMove(3, 5));
+    CHECK_EQ(g_coalesceStats.rawScaled - scaled, 2);
+    CHECK_EQ((LONGLONG)(first.lLastX + next.lLastX) * g_view.imageW + g_rawRemX,
+        (LONGLONG)6 * g_view.virtW + remX);
+}
+
+// Absolute packets are in desktop units, which the view does not change.
+void Absolute() {
+    const RAWMOUSE m = Read(QueueMove(30000, 20000, MOUSE_MOVE_ABSOLUTE));
+    CHECK_EQ(m.lLastX, 30000);
+    CHECK_EQ(m.lLastY, 20000);
+}
+
+void Teardown() {
+    CHECK_EQ(g_dev->Release(), 0);
+    CHECK_EQ(g_d3d->Release(), 0);
+}
+
+}  // namespace
+
+int main() {
+    FakeIniSet("Preferences", "HighPollMouse", "1");
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_gameHwnd = FakeCreateWindow(100, 100, kClientW, kClientH, &GameProc);
+    FakeSetForeground(g_gameHwnd);
+    NoteProcessAttach();
+
+    RUN_STEP(Setup);
+    RUN_STEP(Remainders);
+    RUN_STEP(RepeatedRead);
+    RUN_STEP(Absolute);
+    RUN_STEP(Teardown);
+    CheckExit();
+}
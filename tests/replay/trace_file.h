@@ -0,0 +1,72 @@
+#pragma once
+// Reads d3d9_trace_<pid>.bin (see "Call trace" in d3d9_windowed.cpp).
+// Include after d3d9_windowed.cpp, which defines the layout. The format has
+// fixed-size fields only, so a trace from a 32-bit or 64-bit game reads the
+// same here.
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct TraceFile {
+    TraceHeader header;
+    std::vector<TraceRecord> records;  // committed records, oldest first
+    LONG64 first = 0;                  // record number of records[0]
+    LONG64 uncommitted = 0;            // slots in the window whose seq did not match
+};
+
+// Keeps the last `capacity` records that were claimed, in claim order, and
+// drops any slot whose seq does not name it: a write in flight or torn when
+// the process died. False, with a reason, if the file is not a readable trace.
+inline bool ReadTraceFile(const char* path, TraceFile& out, std::string& error) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+
+    TraceFile t;
+    bool ok = fread(&t.header, sizeof(t.header), 1, f) == 1;
+    if (!ok || t.header.magic != kTraceMagic) error = "not a d3d9 trace";
+    else if (t.header.version != kTraceVersion) error = "trace version " + std::to_string(t.header.version);
+    else if (t.header.recordSize != sizeof(TraceRecord)) error = "unexpected record size";
+    else if (t.header.capacity <= 0 || (t.header.capacity & (t.header.capacity - 1)) != 0) error = "bad capacity";
+    ok = ok && error.empty();
+
+    std::vector<TraceRecord> ring;
+    if (ok) {
+        ring.resize((size_t)t.header.capacity);
+        if (fread(ring.data(), sizeof(TraceRecord), ring.size(), f) != ring.size()) {
+            error = "truncated trace";
+            ok = false;
+        }
+    }
+    fclose(f);
+    if (!ok) return false;
+
+    const LONG64 head = t.header.head;
+    t.first = head > t.header.capacity ? head - t.header.capacity : 0;
+    for (LONG64 n = t.first; n < head; n++) {
+        const TraceRecord& r = ring[(size_t)(n & (t.header.capacity - 1))];
+        if (r.seq == n + 1) t.records.push_back(r);
+        else t.uncommitted++;
+    }
+    out = std::move(t);
+    return true;
+}
+
+inline const char* TraceKindName(WORD kind) {
+    switch (kind) {
+    case kTracePresent: return "Present";
+    case kTraceSwapChainPresent: return "SwapChainPresent";
+    case kTraceSetViewport: return "SetViewport";
+    case kTraceReset: return "Reset";
+    case kTraceCreateDevice: return "CreateDevice";
+    case kTraceGetClientRect: return "GetClientRect";
+    case kTraceScreenToClient: return "ScreenToClient";
+    case kTraceClientToScreen: return "ClientToScreen";
+    case kTraceWndProc: return "WndProc";
+    case kTraceGetDeviceState: return "GetDeviceState";
+    case kTracePoll: return "Poll";
+    default: return "(unknown)";
+    }
+}
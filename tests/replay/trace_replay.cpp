@@ -0,0 +1,297 @@
+// Replays a d3d9_trace_<pid>.bin through the proxy's detours on the fakes.
+//
+//   trace_replay <trace.bin> [--realtime] [--client WxH]
+//
+// Every committed record is turned back into the call the game made, through
+// the patched vtable slot, user32 export or window proc, so it runs the same
+// detour code as in the game. The device is created from the CreateDevice
+// record; handles and device pointers in the trace are mapped onto fake
+// objects the first time they appear. By default records are replayed back
+// to back; --realtime waits out the recorded gaps, which is what pacing and
+// latency behavior depend on. The report gives, per record kind, the time
+// the detour took here and the fake calls it made.
+//
+// What the trace does not hold is filled in: the client size comes from the
+// first WM_SIZE (or --client); messages go to a window proc that ignores
+// them, so recorded pointer lParams are never followed, except the WINDOWPOS
+// the proxy itself reads for WM_WINDOWPOSCHANGED, which is rebuilt from the
+// fake window; Present dirty regions are dropped.
+#include "fake_d3d9.h"
+#include "fake_dinput.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include "trace_file.h"
+
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace {
+
+struct KindStats {
+    long count = 0;
+    long failed = 0;
+    double ns = 0;
+    long calls[kFakeApiCount] = {};
+};
+
+struct Replay {
+    const TraceFile* trace = nullptr;
+    LONG clientW = 1280, clientH = 720;
+
+    IDirect3D9* d3d = nullptr;
+    IDirect3DDevice9* dev = nullptr;
+    IDirectInput8A* di = nullptr;
+    std::map<UINT64, HWND> windows;                  // traced hwnd -> fake window
+    std::map<UINT64, IDirectInputDevice8A*> inputs;  // traced device -> fake device
+    HWND game = nullptr;
+
+    std::map<WORD, KindStats> stats;
+    long skipped = 0;
+};
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+D3DPRESENT_PARAMETERS PresentParams(UINT64 wh, BOOL windowed, D3DSWAPEFFECT effect, DWORD flags) {
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = (UINT)(wh >> 16) & 0xFFFF;
+    pp.BackBufferHeight = (UINT)wh & 0xFFFF;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = effect;
+    pp.Windowed = windowed;
+    pp.Flags = flags;
+    return pp;
+}
+
+RECT RectOfWH(UINT64 wh) {
+    return RECT{ 0, 0, (LONG)((wh >> 16) & 0xFFFF), (LONG)(wh & 0xFFFF) };
+}
+
+// The first window the trace names is the game's; any other gets a fake of its own.
+HWND MapWindow(Replay& r, UINT64 traced) {
+    if (!traced) return nullptr;
+    auto it = r.windows.find(traced);
+    if (it != r.windows.end()) return it->second;
+    HWND h = r.windows.empty() ? r.game : FakeCreateWindow(0, 0, 640, 480, &GameProc);
+    r.windows[traced] = h;
+    return h;
+}
+
+IDirectInputDevice8A* MapInput(Replay& r, UINT64 traced, bool keyboard) {
+    auto it = r.inputs.find(traced);
+    if (it != r.inputs.end()) return it->second;
+
+    IDirectInputDevice8A* dev = nullptr;
+    if (!r.di) {
+        HMODULE dinput = LoadLibraryA("dinput8.dll");
+        auto create = reinterpret_cast<DirectInput8Create_t>(GetProcAddress(dinput, "DirectInput8Create"));
+        if (!create || FAILED(create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION, IID_IDirectInput8A,
+            (void**)&r.di, nullptr))) return nullptr;
+    }
+    if (FAILED(r.di->CreateDevice(keyboard ? GUID_SysKeyboard : GUID_SysMouse, &dev, nullptr))) return nullptr;
+    dev->SetCooperativeLevel(r.game, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
+    dev->Acquire();  // the game had its devices acquired before it polled them
+    r.inputs[traced] = dev;
+    return dev;
+}
+
+// Issues the call one record stands for. Returns false if it could not be
+// replayed at all; `hr` is the result of the call otherwise.
+bool Dispatch(Replay& r, const TraceRecord& rec, HRESULT& hr) {
+    hr = S_OK;
+    const UINT64* a = rec.arg;
+    switch (rec.kind) {
+    case kTraceCreateDevice: {
+        if (r.dev) r.dev->Release();
+        r.dev = nullptr;
+        D3DPRESENT_PARAMETERS pp = PresentParams(a[2], (BOOL)a[3], D3DSWAPEFFECT_DISCARD, 0);
+        hr = r.d3d->CreateDevice((UINT)(a[0] & 0xFFFF), (D3DDEVTYPE)(a[0] >> 16), r.game, (DWORD)a[1], &pp, &r.dev);
+        return true;
+    }
+    case kTraceReset: {
+        if (!r.dev) return false;
+        D3DPRESENT_PARAMETERS pp = PresentParams(a[0], (BOOL)a[1], (D3DSWAPEFFECT)a[2], (DWORD)a[3]);
+        hr = r.dev->Reset(&pp);
+        return true;
+    }
+    case kTracePresent:
+    case kTraceSwapChainPresent: {
+        if (!r.dev) return false;
+        const RECT src = RectOfWH(a[2]), dst = RectOfWH(a[3]);
+        const RECT* s = (a[1] & 1) ? &src : nullptr;
+        const RECT* d = (a[1] & 2) ? &dst : nullptr;
+        HWND h = MapWindow(r, a[0]);
+        if (rec.kind == kTracePresent) {
+            hr = r.dev->Present(s, d, h, nullptr);
+            return true;
+        }
+        IDirect3DSwapChain9* sc = nullptr;
+        if (FAILED(r.dev->GetSwapChain(0, &sc)) || !sc) return false;
+        hr = sc->Present(s, d, h, nullptr, 0);
+        sc->Release();
+        return true;
+    }
+    case kTraceSetViewport: {
+        if (!r.dev) return false;
+        const D3DVIEWPORT9 vp{ (DWORD)a[0], (DWORD)a[1], (DWORD)a[2], (DWORD)a[3], 0.0f, 1.0f };
+        hr = r.dev->SetViewport(&vp);
+        return true;
+    }
+    case kTraceGetClientRect: {
+        RECT rc;
+        hr = GetClientRect(MapWindow(r, a[0]), &rc) ? S_OK : E_FAIL;
+        return true;
+    }
+    case kTraceScreenToClient:
+    case kTraceClientToScreen: {
+        POINT pt{ (LONG)a[1], (LONG)a[2] };
+        HWND h = MapWindow(r, a[0]);
+        const BOOL ok = rec.kind == kTraceScreenToClient ? ScreenToClient(h, &pt) : ClientToScreen(h, &pt);
+        hr = ok ? S_OK : E_FAIL;
+        return true;
+    }
+    case kTraceWndProc: {
+        HWND h = MapWindow(r, a[0]);
+        const UINT msg = (UINT)a[1];
+        LPARAM lParam = (LPARAM)a[3];
+        WINDOWPOS wp{};
+        if (msg == WM_WINDOWPOSCHANGED) {
+            const RECT wr = FakeWindowRect(h);
+            wp = WINDOWPOS{ h, nullptr, (int)wr.left, (int)wr.top,
+                (int)(wr.right - wr.left), (int)(wr.bottom - wr.top), 0 };
+            lParam = (LPARAM)&wp;
+        }
+        FakeSendMessage(h, msg, (WPARAM)a[2], lParam);
+        return true;
+    }
+    case kTraceGetDeviceState: {
+        const DWORD size = (DWORD)a[1];
+        IDirectInputDevice8A* dev = MapInput(r, a[0], size == 256);
+        if (!dev || size == 0 || size > 4096) return false;
+        BYTE state[4096];
+        hr = dev->GetDeviceState(size, state);
+        return true;
+    }
+    case kTracePoll: {
+        IDirectInputDevice8A* dev = MapInput(r, a[0], false);
+        if (!dev) return false;
+        hr = dev->Poll();
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool ClientFromTrace(const TraceFile& t, LONG& w, LONG& h) {
+    for (const TraceRecord& rec : t.records) {
+        if (rec.kind == kTraceWndProc && rec.arg[1] == WM_SIZE && rec.arg[2] == SIZE_RESTORED) {
+            w = LOWORD((DWORD)rec.arg[3]);
+            h = HIWORD((DWORD)rec.arg[3]);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Report(const Replay& r, double seconds) {
+    const TraceFile& t = *r.trace;
+    const double freq = (double)t.header.qpcFreq;
+    const double span = t.records.size() > 1
+        ? (double)(t.records.back().qpc - t.records.front().qpc) / freq : 0.0;
+
+    printf("pid %lu: %zu records replayed from #%lld (%lld uncommitted, %ld skipped)\n",
+        (unsigned long)t.header.pid, t.records.size(), (long long)t.first,
+        (long long)t.uncommitted, r.skipped);
+    printf("recorded span %.3f s, replayed in %.3f s\n\n", span, seconds);
+    printf("%-18s %8s %7s %10s  %s\n", "kind", "calls", "failed", "ns/call", "fake calls per call");
+    for (const auto& kv : r.stats) {
+        const KindStats& s = kv.second;
+        printf("%-18s %8ld %7ld %10.1f ", TraceKindName(kv.first), s.count, s.failed, s.ns / s.count);
+        for (int api = 0; api < kFakeApiCount; api++) {
+            if (s.calls[api]) printf(" %s=%.2f", FakeApiName(api), (double)s.calls[api] / s.count);
+        }
+        printf("\n");
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    bool realtime = false;
+    LONG clientW = 0, clientH = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--realtime")) realtime = true;
+        else if (!strcmp(argv[i], "--client") && i + 1 < argc) sscanf(argv[++i], "%ldx%ld", &clientW, &clientH);
+        else path = argv[i];
+    }
+    if (!path) {
+        fprintf(stderr, "usage: trace_replay <trace.bin> [--realtime] [--client WxH]\n");
+        FakeExit(2);
+    }
+
+    TraceFile trace;
+    std::string error;
+    if (!ReadTraceFile(path, trace, error)) {
+        fprintf(stderr, "trace_replay: %s: %s\n", path, error.c_str());
+        FakeExit(2);
+    }
+
+    Replay r;
+    r.trace = &trace;
+    if (clientW > 0 && clientH > 0) {
+        r.clientW = clientW;
+        r.clientH = clientH;
+    }
+    else {
+        ClientFromTrace(trace, r.clientW, r.clientH);
+    }
+
+    FakeSetMonitor(RECT{ 0, 0, 3840, 2160 });
+    r.game = FakeCreateWindow(100, 100, r.clientW, r.clientH, &GameProc);
+    FakeSetForeground(r.game);
+    NoteProcessAttach();
+    r.d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!r.d3d) {
+        fprintf(stderr, "trace_replay: Direct3DCreate9 failed\n");
+        FakeExit(2);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const LONG64 qpc0 = trace.records.empty() ? 0 : trace.records.front().qpc;
+    for (const TraceRecord& rec : trace.records) {
+        if (realtime) {
+            const double offset = (double)(rec.qpc - qpc0) / (double)trace.header.qpcFreq;
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(offset)));
+        }
+
+        const FakeCallSnapshot before = FakeCallsNow();
+        const auto t0 = std::chrono::steady_clock::now();
+        HRESULT hr = S_OK;
+        const bool done = Dispatch(r, rec, hr);
+        const auto t1 = std::chrono::steady_clock::now();
+        const FakeCallSnapshot d = FakeCallsNow() - before;
+        if (!done) {
+            r.skipped++;
+            continue;
+        }
+
+        KindStats& s = r.stats[rec.kind];
+        s.count++;
+        if (FAILED(hr)) s.failed++;
+        s.ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        for (int api = 0; api < kFakeApiCount; api++) s.calls[api] += d.n[api];
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Report(r, seconds);
+    fflush(stdout);
+    FakeExit(trace.records.empty() || r.skipped == (long)trace.records.size() ? 1 : 0);
+}
@@ -0,0 +1,246 @@
+// Records a trace from a scripted session with [Trace] Enabled=1, checks what
+// landed in the file, and leaves a copy for trace_replay.
+//
+//   trace_roundtrip <copy.bin>
+//
+// Covers the ring sizing, full 64-bit handles and pointers, the commit word
+// under concurrent writers, wraparound, and a record torn mid-write.
+#include "check.h"
+#include "fake_d3d9.h"
+#include "fake_dinput.h"
+#include "fake_minhook.h"
+#include "fake_win32.h"
+
+#include "d3d9_windowed.cpp"
+
+#include "trace_file.h"
+
+#include <thread>
+
+namespace {
+
+const LONG kClientW = 1280, kClientH = 720;
+const int kFrames = 300;
+const int kWriters = 4;
+const int kRecordsPerWriter = 1000;
+
+HWND g_game = nullptr;
+IDirect3D9* g_d3d = nullptr;
+IDirect3DDevice9* g_dev = nullptr;
+IDirectInputDevice8A* g_mouse = nullptr;
+std::string g_tracePath;
+
+LRESULT CALLBACK GameProc(HWND, UINT, WPARAM, LPARAM) {
+    return 0;
+}
+
+TraceFile Reread() {
+    TraceFile t;
+    std::string error;
+    if (!CHECK(ReadTraceFile(g_tracePath.c_str(), t, error))) fprintf(stderr, "%s\n", error.c_str());
+    return t;
+}
+
+int CountKind(const TraceFile& t, WORD kind) {
+    int n = 0;
+    for (const TraceRecord& r : t.records) n += r.kind == kind;
+    return n;
+}
+
+const TraceRecord* FindKind(const TraceFile& t, WORD kind) {
+    for (const TraceRecord& r : t.records) {
+        if (r.kind == kind) return &r;
+    }
+    return nullptr;
+}
+
+void Header() {
+    CHECK(g_trace != nullptr);
+    char name[64];
+    snprintf(name, sizeof(name), "d3d9_trace_%lu.bin", GetCurrentProcessId());
+    g_tracePath = FakeHostPath(name);
+
+    // SizeMB=1: the largest power of two that fits 1 MiB less the header.
+    const TraceFile t = Reread();
+    CHECK_EQ(t.header.capacity, 8192);
+    CHECK_EQ(t.header.recordSize, 64);
+    CHECK_EQ(t.header.pid, GetCurrentProcessId());
+}
+
+void Session() {
+    g_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if (!CHECK(g_d3d)) CheckExit();
+
+    D3DPRESENT_PARAMETERS pp{};
+    pp.BackBufferWidth = 800;
+    pp.BackBufferHeight = 600;
+    pp.BackBufferFormat = D3DFMT_X8R8G8B8;
+    pp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    pp.Windowed = TRUE;
+    if (!CHECK(SUCCEEDED(g_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, g_game,
+        D3DCREATE_HARDWARE_VERTEXPROCESSING, &pp, &g_dev)))) CheckExit();
+
+    InterlockedExchange(&g_win32VirtEnabled, 1);
+    MaybeInstallUser32VirtualHooks();
+    FakeSendMessage(g_game, WM_SIZE, SIZE_RESTORED, MAKELPARAM(kClientW, kClientH));
+
+    HMODULE dinput = LoadLibraryA("dinput8.dll");
+    auto create = reinterpret_cast<DirectInput8Create_t>(GetProcAddress(dinput, "DirectInput8Create"));
+    IDirectInput8A* di = nullptr;
+    if (!CHECK(create && SUCCEEDED(create(GetModuleHandleA(nullptr), DIRECTINPUT_VERSION, IID_IDirectInput8A,
+        (void**)&di, nullptr)))) CheckExit();
+    CHECK(SUCCEEDED(di->CreateDevice(GUID_SysMouse, &g_mouse, nullptr)));
+    g_mouse->SetCooperativeLevel(g_game, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
+    g_mouse->Acquire();
+
+    IDirect3DSwapChain9* sc = nullptr;
+    g_dev->GetSwapChain(0, &sc);
+    const D3DVIEWPORT9 vp{ 0, 0, 640, 480, 0.0f, 1.0f };
+    const RECT dst{ 0, 0, 400, 300 };
+    for (int i = 0; i < kFrames; i++) {
+        g_dev->SetViewport(&vp);
+        FakeSendMessage(g_game, WM_MOUSEMOVE, 0, MAKELPARAM(i % kClientW, i % kClientH));
+        DIMOUSESTATE2 s;
+        g_mouse->GetDeviceState(sizeof(s), &s);
+        RECT rc;
+        GetClientRect(g_game, &rc);
+        POINT pt{ -5, -7 };
+        ScreenToClient(g_game, &pt);
+        if (i % 10 == 0) sc->Present(nullptr, &dst, nullptr, nullptr, 0);
+        else g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    }
+    sc->Release();
+
+    pp.BackBufferWidth = 1024;
+    pp.BackBufferHeight = 768;
+    CHECK(SUCCEEDED(g_dev->Reset(&pp)));
+    g_dev->Present(nullptr, nullptr, nullptr, nullptr);
+    di->Release();
+}
+
+void Contents() {
+    const TraceFile t = Reread();
+    CHECK_EQ(t.first, 0);
+    CHECK_EQ(t.uncommitted, 0);
+    CHECK_EQ((LONG64)t.records.size(), t.header.head);
+
+    CHECK_EQ(CountKind(t, kTraceCreateDevice), 1);
+    CHECK_EQ(CountKind(t, kTraceSetViewport), kFrames);
+    CHECK_EQ(CountKind(t, kTracePresent), kFrames - kFrames / 10 + 1);
+    CHECK_EQ(CountKind(t, kTraceSwapChainPresent), kFrames / 10);
+    CHECK_EQ(CountKind(t, kTraceGetDeviceState), kFrames);
+    CHECK_EQ(CountKind(t, kTraceReset), 1);
+
+    // Records come back in the order the detours ran.
+    CHECK(!t.records.empty() && t.records.front().kind == kTraceCreateDevice);
+    for (size_t i = 1; i < t.records.size(); i++) {
+        if (!CHECK(t.records[i].qpc >= t.records[i - 1].qpc)) break;
+    }
+
+    const TraceRecord* create = FindKind(t, kTraceCreateDevice);
+    if (CHECK(create)) {
+        CHECK_EQ(create->arg[2], TraceWH(800, 600));
+        CHECK_EQ(create->arg[3], TRUE);
+    }
+
+    // Handles and pointers are kept whole, not cut to 32 bits.
+    const TraceRecord* state = FindKind(t, kTraceGetDeviceState);
+    if (CHECK(state)) {
+        CHECK(state->arg[0] == (UINT64)(ULONG_PTR)g_mouse);
+        CHECK_EQ(state->arg[1], sizeof(DIMOUSESTATE2));
+    }
+    const TraceRecord* msg = FindKind(t, kTraceWndProc);
+    if (CHECK(msg)) CHECK(msg->arg[0] == (UINT64)(ULONG_PTR)g_game);
+
+    const TraceRecord* s2c = FindKind(t, kTraceScreenToClient);
+    if (CHECK(s2c)) {
+        CHECK_EQ((LONG)s2c->arg[1], -5);
+        CHECK_EQ((LONG)s2c->arg[2], -7);
+    }
+
+    const TraceRecord* swap = FindKind(t, kTraceSwapChainPresent);
+    if (CHECK(swap)) {
+        CHECK_EQ(swap->arg[1], 2u);  // dst only
+        CHECK_EQ(swap->arg[3], TraceWH(400, 300));
+    }
+}
+
+void KeepCopy(const char* out) {
+    FILE* in = fopen(g_tracePath.c_str(), "rb");
+    FILE* dst = fopen(out, "wb");
+    if (!CHECK(in && dst)) CheckExit();
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, dst);
+    fclose(in);
+    CHECK(fclose(dst) == 0);
+}
+
+void ConcurrentWriters() {
+    const LONG64 head0 = g_trace->head;
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; w++) {
+        writers.emplace_back([w] {
+            for (int i = 0; i < kRecordsPerWriter; i++) Trace(kTracePoll, (UINT64)w, (UINT64)i);
+        });
+    }
+    for (std::thread& th : writers) th.join();
+
+    // Every claimed slot was committed, and each writer's records are all
+    // there, complete and in its own order.
+    const TraceFile t = Reread();
+    CHECK_EQ(t.uncommitted, 0);
+    CHECK_EQ(t.header.head, head0 + kWriters * kRecordsPerWriter);
+    int next[kWriters] = {};
+    for (const TraceRecord& r : t.records) {
+        if (r.kind != kTracePoll || r.arg[0] >= (UINT64)kWriters) continue;
+        const int w = (int)r.arg[0];
+        if (!CHECK_EQ(r.arg[1], next[w])) break;
+        next[w]++;
+    }
+    for (int w = 0; w < kWriters; w++) CHECK_EQ(next[w], kRecordsPerWriter);
+}
+
+void Wraparound() {
+    const LONG64 capacity = g_trace->capacity;
+    const D3DVIEWPORT9 vp{ 0, 0, 320, 240, 0.0f, 1.0f };
+    for (LONG64 i = 0; i < capacity + 100; i++) g_dev->SetViewport(&vp);
+
+    TraceFile t = Reread();
+    CHECK_EQ((LONG64)t.records.size(), capacity);
+    CHECK_EQ(t.first, t.header.head - capacity);
+    CHECK_EQ(CountKind(t, kTraceSetViewport), capacity);
+
+    // A writer that died between claiming a slot and committing it leaves the
+    // slot's previous seq behind; the reader drops that slot and only that.
+    const LONG64 victim = t.header.head - 10;
+    g_traceRecords[victim & (capacity - 1)].seq = victim + 1 - capacity;
+    t = Reread();
+    CHECK_EQ(t.uncommitted, 1);
+    CHECK_EQ((LONG64)t.records.size(), capacity - 1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: trace_roundtrip <copy.bin>\n");
+        return 2;
+    }
+
+    FakeIniSet("Trace", "Enabled", "1");
+    FakeIniSet("Trace", "SizeMB", "1");
+    FakeSetMonitor(RECT{ 0, 0, 1920, 1080 });
+    g_game = FakeCreateWindow(100, 100, kClientW, kClientH, &GameProc);
+    FakeSetForeground(g_game);
+    NoteProcessAttach();
+    EnsureInit();
+
+    RUN_STEP(Header);
+    RUN_STEP(Session);
+    RUN_STEP(Contents);
+    KeepCopy(argv[1]);
+    RUN_STEP(ConcurrentWriters);
+    RUN_STEP(Wraparound);
+    CheckExit();
+}
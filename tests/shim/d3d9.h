@@ -0,0 +1,388 @@
+#pragma once
+// Minimal d3d9.h for the Linux test build. Every interface lists all of its
+// methods in SDK order so vtable slot numbers match the real runtime; types
+// the proxy never touches are left opaque.
+#include "unknwn.h"
+
+typedef enum { D3DDEVTYPE_HAL = 1, D3DDEVTYPE_REF = 2, D3DDEVTYPE_SW = 3, D3DDEVTYPE_NULLREF = 4 } D3DDEVTYPE;
+typedef enum {
+    D3DFMT_UNKNOWN = 0, D3DFMT_A8R8G8B8 = 21, D3DFMT_X8R8G8B8 = 22, D3DFMT_R5G6B5 = 23,
+    D3DFMT_D24S8 = 75, D3DFMT_INDEX16 = 101, D3DFMT_INDEX32 = 102,
+} D3DFORMAT;
+typedef enum { D3DPOOL_DEFAULT = 0, D3DPOOL_MANAGED = 1, D3DPOOL_SYSTEMMEM = 2, D3DPOOL_SCRATCH = 3 } D3DPOOL;
+typedef enum { D3DBACKBUFFER_TYPE_MONO = 0 } D3DBACKBUFFER_TYPE;
+typedef enum {
+    D3DSWAPEFFECT_DISCARD = 1, D3DSWAPEFFECT_FLIP = 2, D3DSWAPEFFECT_COPY = 3,
+    D3DSWAPEFFECT_OVERLAY = 4, D3DSWAPEFFECT_FLIPEX = 5,
+} D3DSWAPEFFECT;
+typedef enum { D3DMULTISAMPLE_NONE = 0 } D3DMULTISAMPLE_TYPE;
+typedef enum { D3DTEXF_NONE = 0, D3DTEXF_POINT = 1, D3DTEXF_LINEAR = 2 } D3DTEXTUREFILTERTYPE;
+typedef enum { D3DQUERYTYPE_EVENT = 8 } D3DQUERYTYPE;
+typedef enum {
+    D3DRTYPE_SURFACE = 1, D3DRTYPE_VOLUME = 2, D3DRTYPE_TEXTURE = 3, D3DRTYPE_VOLUMETEXTURE = 4,
+    D3DRTYPE_CUBETEXTURE = 5, D3DRTYPE_VERTEXBUFFER = 6, D3DRTYPE_INDEXBUFFER = 7,
+} D3DRESOURCETYPE;
+typedef enum { D3DSCANLINEORDERING_PROGRESSIVE = 1 } D3DSCANLINEORDERING;
+typedef enum {
+    D3DCUBEMAP_FACE_POSITIVE_X = 0, D3DCUBEMAP_FACE_NEGATIVE_X = 1, D3DCUBEMAP_FACE_POSITIVE_Y = 2,
+    D3DCUBEMAP_FACE_NEGATIVE_Y = 3, D3DCUBEMAP_FACE_POSITIVE_Z = 4, D3DCUBEMAP_FACE_NEGATIVE_Z = 5,
+} D3DCUBEMAP_FACES;
+
+#define D3DISSUE_END (1 << 0)
+#define D3DGETDATA_FLUSH (1 << 0)
+#define D3D_OK S_OK
+#define MAKE_D3DHRESULT(code) ((HRESULT)(0x88760000u | (code)))
+#define D3DERR_DEVICELOST MAKE_D3DHRESULT(2152)
+#define D3DERR_DEVICENOTRESET MAKE_D3DHRESULT(2153)
+#define D3DERR_NOTAVAILABLE MAKE_D3DHRESULT(2154)
+#define D3DERR_INVALIDCALL MAKE_D3DHRESULT(2156)
+#define D3DERR_WASSTILLDRAWING MAKE_D3DHRESULT(540)
+#define D3DERR_OUTOFVIDEOMEMORY MAKE_D3DHRESULT(380)
+#define D3DUSAGE_RENDERTARGET 0x1
+#define D3DUSAGE_DEPTHSTENCIL 0x2
+#define D3DUSAGE_WRITEONLY 0x8
+#define D3DUSAGE_DYNAMIC 0x200
+#define D3DUSAGE_AUTOGENMIPMAP 0x400
+#define D3DLOCK_READONLY 0x10
+#define D3DLOCK_DISCARD 0x2000
+#define D3DLOCK_NOOVERWRITE 0x1000
+#define D3DLOCK_NOSYSLOCK 0x800
+#define D3DPRESENT_INTERVAL_DEFAULT 0
+#define D3DPRESENT_INTERVAL_ONE 1
+#define D3DPRESENT_INTERVAL_IMMEDIATE 0x80000000L
+#define D3DPRESENT_DONOTWAIT 1
+#define D3DPRESENTFLAG_LOCKABLE_BACKBUFFER 1
+#define D3DCREATE_MULTITHREADED 0x4
+#define D3DCREATE_SOFTWARE_VERTEXPROCESSING 0x20
+#define D3DCREATE_HARDWARE_VERTEXPROCESSING 0x40
+#define D3D_SDK_VERSION 32
+#define D3DADAPTER_DEFAULT 0
+
+typedef DWORD D3DCOLOR;
+#define D3DCOLOR_ARGB(a,r,g,b) ((D3DCOLOR)((((a)&0xff)<<24)|(((r)&0xff)<<16)|(((g)&0xff)<<8)|((b)&0xff)))
+#define D3DCOLOR_XRGB(r,g,b) D3DCOLOR_ARGB(0xff,r,g,b)
+
+typedef struct _D3DVIEWPORT9 { DWORD X, Y, Width, Height; float MinZ, MaxZ; } D3DVIEWPORT9;
+typedef struct _D3DSURFACE_DESC {
+    D3DFORMAT Format; D3DRESOURCETYPE Type; DWORD Usage; D3DPOOL Pool;
+    D3DMULTISAMPLE_TYPE MultiSampleType; DWORD MultiSampleQuality; UINT Width, Height;
+} D3DSURFACE_DESC;
+typedef struct _D3DVOLUME_DESC {
+    D3DFORMAT Format; D3DRESOURCETYPE Type; DWORD Usage; D3DPOOL Pool; UINT Width, Height, Depth;
+} D3DVOLUME_DESC;
+typedef struct _D3DPRESENT_PARAMETERS_ {
+    UINT BackBufferWidth, BackBufferHeight; D3DFORMAT BackBufferFormat; UINT BackBufferCount;
+    D3DMULTISAMPLE_TYPE MultiSampleType; DWORD MultiSampleQuality; D3DSWAPEFFECT SwapEffect;
+    HWND hDeviceWindow; BOOL Windowed; BOOL EnableAutoDepthStencil; D3DFORMAT AutoDepthStencilFormat;
+    DWORD Flags; UINT FullScreen_RefreshRateInHz; UINT PresentationInterval;
+} D3DPRESENT_PARAMETERS;
+typedef struct _D3DDEVICE_CREATION_PARAMETERS {
+    UINT AdapterOrdinal; D3DDEVTYPE DeviceType; HWND hFocusWindow; DWORD BehaviorFlags;
+} D3DDEVICE_CREATION_PARAMETERS;
+typedef struct _D3DDISPLAYMODE { UINT Width, Height, RefreshRate; D3DFORMAT Format; } D3DDISPLAYMODE;
+typedef struct _D3DDISPLAYMODEEX {
+    UINT Size, Width, Height, RefreshRate; D3DFORMAT Format; D3DSCANLINEORDERING ScanLineOrdering;
+} D3DDISPLAYMODEEX;
+typedef struct _D3DLOCKED_RECT { INT Pitch; void* pBits; } D3DLOCKED_RECT;
+typedef struct _D3DLOCKED_BOX { INT RowPitch, SlicePitch; void* pBits; } D3DLOCKED_BOX;
+typedef struct _D3DBOX { UINT Left, Top, Right, Bottom, Front, Back; } D3DBOX;
+typedef struct _D3DVERTEXBUFFER_DESC { D3DFORMAT Format; D3DRESOURCETYPE Type; DWORD Usage; D3DPOOL Pool; UINT Size; DWORD FVF; } D3DVERTEXBUFFER_DESC;
+typedef struct _D3DINDEXBUFFER_DESC { D3DFORMAT Format; D3DRESOURCETYPE Type; DWORD Usage; D3DPOOL Pool; UINT Size; } D3DINDEXBUFFER_DESC;
+
+// Opaque to the proxy.
+typedef struct _D3DCAPS9 D3DCAPS9;
+typedef struct _D3DADAPTER_IDENTIFIER9 D3DADAPTER_IDENTIFIER9;
+typedef struct _D3DRASTER_STATUS D3DRASTER_STATUS;
+typedef struct _D3DGAMMARAMP D3DGAMMARAMP;
+typedef struct _D3DMATRIX D3DMATRIX;
+typedef struct _D3DMATERIAL9 D3DMATERIAL9;
+typedef struct _D3DLIGHT9 D3DLIGHT9;
+typedef struct _D3DCLIPSTATUS9 D3DCLIPSTATUS9;
+typedef struct _D3DRECT D3DRECT;
+typedef struct _D3DRECTPATCH_INFO D3DRECTPATCH_INFO;
+typedef struct _D3DTRIPATCH_INFO D3DTRIPATCH_INFO;
+typedef struct _D3DVERTEXELEMENT9 D3DVERTEXELEMENT9;
+typedef struct _D3DPRESENTSTATS D3DPRESENTSTATS;
+typedef struct _D3DDISPLAYMODEFILTER D3DDISPLAYMODEFILTER;
+typedef struct _PALETTEENTRY PALETTEENTRY;
+typedef struct _LUID LUID;
+typedef DWORD D3DTRANSFORMSTATETYPE, D3DRENDERSTATETYPE, D3DSTATEBLOCKTYPE, D3DTEXTURESTAGESTATETYPE,
+    D3DSAMPLERSTATETYPE, D3DPRIMITIVETYPE, D3DCOMPOSERECTSOP, D3DDISPLAYROTATION;
+
+struct IDirect3D9; struct IDirect3DDevice9; struct IDirect3DSwapChain9;
+struct IDirect3DStateBlock9; struct IDirect3DVertexDeclaration9;
+struct IDirect3DVertexShader9; struct IDirect3DPixelShader9;
+
+struct IDirect3DResource9 : IUnknown {
+    STDMETHOD(GetDevice)(IDirect3DDevice9**) PURE;                              // 3
+    STDMETHOD(SetPrivateData)(REFGUID, const void*, DWORD, DWORD) PURE;
+    STDMETHOD(GetPrivateData)(REFGUID, void*, DWORD*) PURE;
+    STDMETHOD(FreePrivateData)(REFGUID) PURE;
+    STDMETHOD_(DWORD, SetPriority)(DWORD) PURE;
+    STDMETHOD_(DWORD, GetPriority)() PURE;
+    STDMETHOD_(void, PreLoad)() PURE;
+    STDMETHOD_(D3DRESOURCETYPE, GetType)() PURE;                                // 10
+};
+
+struct IDirect3DSurface9 : IDirect3DResource9 {
+    STDMETHOD(GetContainer)(REFIID, void**) PURE;                               // 11
+    STDMETHOD(GetDesc)(D3DSURFACE_DESC*) PURE;
+    STDMETHOD(LockRect)(D3DLOCKED_RECT*, const RECT*, DWORD) PURE;
+    STDMETHOD(UnlockRect)() PURE;                                               // 14
+    STDMETHOD(GetDC)(HDC*) PURE;
+    STDMETHOD(ReleaseDC)(HDC) PURE;                                             // 16
+};
+
+struct IDirect3DVolume9 : IUnknown {
+    STDMETHOD(GetDevice)(IDirect3DDevice9**) PURE;                              // 3
+    STDMETHOD(SetPrivateData)(REFGUID, const void*, DWORD, DWORD) PURE;
+    STDMETHOD(GetPrivateData)(REFGUID, void*, DWORD*) PURE;
+    STDMETHOD(FreePrivateData)(REFGUID) PURE;
+    STDMETHOD(GetContainer)(REFIID, void**) PURE;
+    STDMETHOD(GetDesc)(D3DVOLUME_DESC*) PURE;
+    STDMETHOD(LockBox)(D3DLOCKED_BOX*, const D3DBOX*, DWORD) PURE;
+    STDMETHOD(UnlockBox)() PURE;                                                // 10
+};
+
+struct IDirect3DBaseTexture9 : IDirect3DResource9 {
+    STDMETHOD_(DWORD, SetLOD)(DWORD) PURE;                                      // 11
+    STDMETHOD_(DWORD, GetLOD)() PURE;
+    STDMETHOD_(DWORD, GetLevelCount)() PURE;                                    // 13
+    STDMETHOD(SetAutoGenFilterType)(D3DTEXTUREFILTERTYPE) PURE;
+    STDMETHOD_(D3DTEXTUREFILTERTYPE, GetAutoGenFilterType)() PURE;
+    STDMETHOD_(void, GenerateMipSubLevels)() PURE;                              // 16
+};
+
+struct IDirect3DTexture9 : IDirect3DBaseTexture9 {
+    STDMETHOD(GetLevelDesc)(UINT, D3DSURFACE_DESC*) PURE;                       // 17
+    STDMETHOD(GetSurfaceLevel)(UINT, IDirect3DSurface9**) PURE;
+    STDMETHOD(LockRect)(UINT, D3DLOCKED_RECT*, const RECT*, DWORD) PURE;
+    STDMETHOD(UnlockRect)(UINT) PURE;
+    STDMETHOD(AddDirtyRect)(const RECT*) PURE;                                  // 21
+};
+
+struct IDirect3DCubeTexture9 : IDirect3DBaseTexture9 {
+    STDMETHOD(GetLevelDesc)(UINT, D3DSURFACE_DESC*) PURE;                       // 17
+    STDMETHOD(GetCubeMapSurface)(D3DCUBEMAP_FACES, UINT, IDirect3DSurface9**) PURE;
+    STDMETHOD(LockRect)(D3DCUBEMAP_FACES, UINT, D3DLOCKED_RECT*, const RECT*, DWORD) PURE;
+    STDMETHOD(UnlockRect)(D3DCUBEMAP_FACES, UINT) PURE;
+    STDMETHOD(AddDirtyRect)(D3DCUBEMAP_FACES, const RECT*) PURE;                // 21
+};
+
+struct IDirect3DVolumeTexture9 : IDirect3DBaseTexture9 {
+    STDMETHOD(GetLevelDesc)(UINT, D3DVOLUME_DESC*) PURE;                        // 17
+    STDMETHOD(GetVolumeLevel)(UINT, IDirect3DVolume9**) PURE;
+    STDMETHOD(LockBox)(UINT, D3DLOCKED_BOX*, const D3DBOX*, DWORD) PURE;
+    STDMETHOD(UnlockBox)(UINT) PURE;
+    STDMETHOD(AddDirtyBox)(const D3DBOX*) PURE;                                 // 21
+};
+
+struct IDirect3DVertexBuffer9 : IDirect3DResource9 {
+    STDMETHOD(Lock)(UINT, UINT, void**, DWORD) PURE;                            // 11
+    STDMETHOD(Unlock)() PURE;
+    STDMETHOD(GetDesc)(D3DVERTEXBUFFER_DESC*) PURE;
+};
+
+struct IDirect3DIndexBuffer9 : IDirect3DResource9 {
+    STDMETHOD(Lock)(UINT, UINT, void**, DWORD) PURE;                            // 11
+    STDMETHOD(Unlock)() PURE;
+    STDMETHOD(GetDesc)(D3DINDEXBUFFER_DESC*) PURE;
+};
+
+struct IDirect3DQuery9 : IUnknown {
+    STDMETHOD(GetDevice)(IDirect3DDevice9**) PURE;                              // 3
+    STDMETHOD_(D3DQUERYTYPE, GetType)() PURE;
+    STDMETHOD_(DWORD, GetDataSize)() PURE;
+    STDMETHOD(Issue)(DWORD) PURE;                                               // 6
+    STDMETHOD(GetData)(void*, DWORD, DWORD) PURE;                               // 7
+};
+
+struct IDirect3DSwapChain9 : IUnknown {
+    STDMETHOD(Present)(const RECT*, const RECT*, HWND, const RGNDATA*, DWORD) PURE;  // 3
+    STDMETHOD(GetFrontBufferData)(IDirect3DSurface9*) PURE;
+    STDMETHOD(GetBackBuffer)(UINT, D3DBACKBUFFER_TYPE, IDirect3DSurface9**) PURE;
+    STDMETHOD(GetRasterStatus)(D3DRASTER_STATUS*) PURE;
+    STDMETHOD(GetDisplayMode)(D3DDISPLAYMODE*) PURE;
+    STDMETHOD(GetDevice)(IDirect3DDevice9**) PURE;
+    STDMETHOD(GetPresentParameters)(D3DPRESENT_PARAMETERS*) PURE;               // 9
+};
+
+struct IDirect3DDevice9 : IUnknown {
+    STDMETHOD(TestCooperativeLevel)() PURE;                                     // 3
+    STDMETHOD_(UINT, GetAvailableTextureMem)() PURE;
+    STDMETHOD(EvictManagedResources)() PURE;
+    STDMETHOD(GetDirect3D)(IDirect3D9**) PURE;
+    STDMETHOD(GetDeviceCaps)(D3DCAPS9*) PURE;
+    STDMETHOD(GetDisplayMode)(UINT, D3DDISPLAYMODE*) PURE;
+    STDMETHOD(GetCreationParameters)(D3DDEVICE_CREATION_PARAMETERS*) PURE;      // 9
+    STDMETHOD(SetCursorProperties)(UINT, UINT, IDirect3DSurface9*) PURE;
+    STDMETHOD_(void, SetCursorPosition)(int, int, DWORD) PURE;
+    STDMETHOD_(BOOL, ShowCursor)(BOOL) PURE;
+    STDMETHOD(CreateAdditionalSwapChain)(D3DPRESENT_PARAMETERS*, IDirect3DSwapChain9**) PURE;
+    STDMETHOD(GetSwapChain)(UINT, IDirect3DSwapChain9**) PURE;                  // 14
+    STDMETHOD_(UINT, GetNumberOfSwapChains)() PURE;
+    STDMETHOD(Reset)(D3DPRESENT_PARAMETERS*) PURE;                              // 16
+    STDMETHOD(Present)(const RECT*, const RECT*, HWND, const RGNDATA*) PURE;    // 17
+    STDMETHOD(GetBackBuffer)(UINT, UINT, D3DBACKBUFFER_TYPE, IDirect3DSurface9**) PURE;
+    STDMETHOD(GetRasterStatus)(UINT, D3DRASTER_STATUS*) PURE;
+    STDMETHOD(SetDialogBoxMode)(BOOL) PURE;
+    STDMETHOD_(void, SetGammaRamp)(UINT, DWORD, const D3DGAMMARAMP*) PURE;
+    STDMETHOD_(void, GetGammaRamp)(UINT, D3DGAMMARAMP*) PURE;
+    STDMETHOD(CreateTexture)(UINT, UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DTexture9**, HANDLE*) PURE;  // 23
+    STDMETHOD(CreateVolumeTexture)(UINT, UINT, UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DVolumeTexture9**, HANDLE*) PURE;
+    STDMETHOD(CreateCubeTexture)(UINT, UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DCubeTexture9**, HANDLE*) PURE;
+    STDMETHOD(CreateVertexBuffer)(UINT, DWORD, DWORD, D3DPOOL, IDirect3DVertexBuffer9**, HANDLE*) PURE;
+    STDMETHOD(CreateIndexBuffer)(UINT, DWORD, D3DFORMAT, D3DPOOL, IDirect3DIndexBuffer9**, HANDLE*) PURE;    // 27
+    STDMETHOD(CreateRenderTarget)(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*) PURE;
+    STDMETHOD(CreateDepthStencilSurface)(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*) PURE;
+    STDMETHOD(UpdateSurface)(IDirect3DSurface9*, const RECT*, IDirect3DSurface9*, const POINT*) PURE;
+    STDMETHOD(UpdateTexture)(IDirect3DBaseTexture9*, IDirect3DBaseTexture9*) PURE;  // 31
+    STDMETHOD(GetRenderTargetData)(IDirect3DSurface9*, IDirect3DSurface9*) PURE;
+    STDMETHOD(GetFrontBufferData)(UINT, IDirect3DSurface9*) PURE;
+    STDMETHOD(StretchRect)(IDirect3DSurface9*, const RECT*, IDirect3DSurface9*, const RECT*, D3DTEXTUREFILTERTYPE) PURE;  // 34
+    STDMETHOD(ColorFill)(IDirect3DSurface9*, const RECT*, D3DCOLOR) PURE;      // 35
+    STDMETHOD(CreateOffscreenPlainSurface)(UINT, UINT, D3DFORMAT, D3DPOOL, IDirect3DSurface9**, HANDLE*) PURE;
+    STDMETHOD(SetRenderTarget)(DWORD, IDirect3DSurface9*) PURE;                 // 37
+    STDMETHOD(GetRenderTarget)(DWORD, IDirect3DSurface9**) PURE;                // 38
+    STDMETHOD(SetDepthStencilSurface)(IDirect3DSurface9*) PURE;
+    STDMETHOD(GetDepthStencilSurface)(IDirect3DSurface9**) PURE;
+    STDMETHOD(BeginScene)() PURE;
+    STDMETHOD(EndScene)() PURE;
+    STDMETHOD(Clear)(DWORD, const D3DRECT*, DWORD, D3DCOLOR, float, DWORD) PURE;
+    STDMETHOD(SetTransform)(D3DTRANSFORMSTATETYPE, const D3DMATRIX*) PURE;
+    STDMETHOD(GetTransform)(D3DTRANSFORMSTATETYPE, D3DMATRIX*) PURE;
+    STDMETHOD(MultiplyTransform)(D3DTRANSFORMSTATETYPE, const D3DMATRIX*) PURE;
+    STDMETHOD(SetViewport)(const D3DVIEWPORT9*) PURE;                           // 47
+    STDMETHOD(GetViewport)(D3DVIEWPORT9*) PURE;                                 // 48
+    STDMETHOD(SetMaterial)(const D3DMATERIAL9*) PURE;
+    STDMETHOD(GetMaterial)(D3DMATERIAL9*) PURE;
+    STDMETHOD(SetLight)(DWORD, const D3DLIGHT9*) PURE;
+    STDMETHOD(GetLight)(DWORD, D3DLIGHT9*) PURE;
+    STDMETHOD(LightEnable)(DWORD, BOOL) PURE;
+    STDMETHOD(GetLightEnable)(DWORD, BOOL*) PURE;
+    STDMETHOD(SetClipPlane)(DWORD, const float*) PURE;
+    STDMETHOD(GetClipPlane)(DWORD, float*) PURE;
+    STDMETHOD(SetRenderState)(D3DRENDERSTATETYPE, DWORD) PURE;
+    STDMETHOD(GetRenderState)(D3DRENDERSTATETYPE, DWORD*) PURE;
+    STDMETHOD(CreateStateBlock)(D3DSTATEBLOCKTYPE, IDirect3DStateBlock9**) PURE;
+    STDMETHOD(BeginStateBlock)() PURE;
+    STDMETHOD(EndStateBlock)(IDirect3DStateBlock9**) PURE;
+    STDMETHOD(SetClipStatus)(const D3DCLIPSTATUS9*) PURE;
+    STDMETHOD(GetClipStatus)(D3DCLIPSTATUS9*) PURE;
+    STDMETHOD(GetTexture)(DWORD, IDirect3DBaseTexture9**) PURE;
+    STDMETHOD(SetTexture)(DWORD, IDirect3DBaseTexture9*) PURE;                  // 65
+    STDMETHOD(GetTextureStageState)(DWORD, D3DTEXTURESTAGESTATETYPE, DWORD*) PURE;
+    STDMETHOD(SetTextureStageState)(DWORD, D3DTEXTURESTAGESTATETYPE, DWORD) PURE;
+    STDMETHOD(GetSamplerState)(DWORD, D3DSAMPLERSTATETYPE, DWORD*) PURE;
+    STDMETHOD(SetSamplerState)(DWORD, D3DSAMPLERSTATETYPE, DWORD) PURE;
+    STDMETHOD(ValidateDevice)(DWORD*) PURE;
+    STDMETHOD(SetPaletteEntries)(UINT, const PALETTEENTRY*) PURE;
+    STDMETHOD(GetPaletteEntries)(UINT, PALETTEENTRY*) PURE;
+    STDMETHOD(SetCurrentTexturePalette)(UINT) PURE;
+    STDMETHOD(GetCurrentTexturePalette)(UINT*) PURE;
+    STDMETHOD(SetScissorRect)(const RECT*) PURE;
+    STDMETHOD(GetScissorRect)(RECT*) PURE;
+    STDMETHOD(SetSoftwareVertexProcessing)(BOOL) PURE;
+    STDMETHOD_(BOOL, GetSoftwareVertexProcessing)() PURE;
+    STDMETHOD(SetNPatchMode)(float) PURE;
+    STDMETHOD_(float, GetNPatchMode)() PURE;
+    STDMETHOD(DrawPrimitive)(D3DPRIMITIVETYPE, UINT, UINT) PURE;
+    STDMETHOD(DrawIndexedPrimitive)(D3DPRIMITIVETYPE, INT, UINT, UINT, UINT, UINT) PURE;
+    STDMETHOD(DrawPrimitiveUP)(D3DPRIMITIVETYPE, UINT, const void*, UINT) PURE;
+    STDMETHOD(DrawIndexedPrimitiveUP)(D3DPRIMITIVETYPE, UINT, UINT, UINT, const void*, D3DFORMAT, const void*, UINT) PURE;
+    STDMETHOD(ProcessVertices)(UINT, UINT, UINT, IDirect3DVertexBuffer9*, IDirect3DVertexDeclaration9*, DWORD) PURE;
+    STDMETHOD(CreateVertexDeclaration)(const D3DVERTEXELEMENT9*, IDirect3DVertexDeclaration9**) PURE;
+    STDMETHOD(SetVertexDeclaration)(IDirect3DVertexDeclaration9*) PURE;
+    STDMETHOD(GetVertexDeclaration)(IDirect3DVertexDeclaration9**) PURE;
+    STDMETHOD(SetFVF)(DWORD) PURE;
+    STDMETHOD(GetFVF)(DWORD*) PURE;
+    STDMETHOD(CreateVertexShader)(const DWORD*, IDirect3DVertexShader9**) PURE;
+    STDMETHOD(SetVertexShader)(IDirect3DVertexShader9*) PURE;
+    STDMETHOD(GetVertexShader)(IDirect3DVertexShader9**) PURE;
+    STDMETHOD(SetVertexShaderConstantF)(UINT, const float*, UINT) PURE;
+    STDMETHOD(GetVertexShaderConstantF)(UINT, float*, UINT) PURE;
+    STDMETHOD(SetVertexShaderConstantI)(UINT, const int*, UINT) PURE;
+    STDMETHOD(GetVertexShaderConstantI)(UINT, int*, UINT) PURE;
+    STDMETHOD(SetVertexShaderConstantB)(UINT, const BOOL*, UINT) PURE;
+    STDMETHOD(GetVertexShaderConstantB)(UINT, BOOL*, UINT) PURE;
+    STDMETHOD(SetStreamSource)(UINT, IDirect3DVertexBuffer9*, UINT, UINT) PURE;
+    STDMETHOD(GetStreamSource)(UINT, IDirect3DVertexBuffer9**, UINT*, UINT*) PURE;
+    STDMETHOD(SetStreamSourceFreq)(UINT, UINT) PURE;
+    STDMETHOD(GetStreamSourceFreq)(UINT, UINT*) PURE;
+    STDMETHOD(SetIndices)(IDirect3DIndexBuffer9*) PURE;
+    STDMETHOD(GetIndices)(IDirect3DIndexBuffer9**) PURE;
+    STDMETHOD(CreatePixelShader)(const DWORD*, IDirect3DPixelShader9**) PURE;
+    STDMETHOD(SetPixelShader)(IDirect3DPixelShader9*) PURE;
+    STDMETHOD(GetPixelShader)(IDirect3DPixelShader9**) PURE;
+    STDMETHOD(SetPixelShaderConstantF)(UINT, const float*, UINT) PURE;
+    STDMETHOD(GetPixelShaderConstantF)(UINT, float*, UINT) PURE;
+    STDMETHOD(SetPixelShaderConstantI)(UINT, const int*, UINT) PURE;
+    STDMETHOD(GetPixelShaderConstantI)(UINT, int*, UINT) PURE;
+    STDMETHOD(SetPixelShaderConstantB)(UINT, const BOOL*, UINT) PURE;
+    STDMETHOD(GetPixelShaderConstantB)(UINT, BOOL*, UINT) PURE;
+    STDMETHOD(DrawRectPatch)(UINT, const float*, const D3DRECTPATCH_INFO*) PURE;
+    STDMETHOD(DrawTriPatch)(UINT, const float*, const D3DTRIPATCH_INFO*) PURE;
+    STDMETHOD(DeletePatch)(UINT) PURE;
+    STDMETHOD(CreateQuery)(D3DQUERYTYPE, IDirect3DQuery9**) PURE;               // 118
+};
+
+struct IDirect3DDevice9Ex : IDirect3DDevice9 {
+    STDMETHOD(SetConvolutionMonoKernel)(UINT, UINT, float*, float*) PURE;       // 119
+    STDMETHOD(ComposeRects)(IDirect3DSurface9*, IDirect3DSurface9*, IDirect3DVertexBuffer9*, UINT, IDirect3DVertexBuffer9*, D3DCOMPOSERECTSOP, int, int) PURE;
+    STDMETHOD(PresentEx)(const RECT*, const RECT*, HWND, const RGNDATA*, DWORD) PURE;
+    STDMETHOD(GetGPUThreadPriority)(INT*) PURE;
+    STDMETHOD(SetGPUThreadPriority)(INT) PURE;
+    STDMETHOD(WaitForVBlank)(UINT) PURE;
+    STDMETHOD(CheckResourceResidency)(IDirect3DResource9**, UINT32) PURE;
+    STDMETHOD(SetMaximumFrameLatency)(UINT) PURE;                               // 126
+    STDMETHOD(GetMaximumFrameLatency)(UINT*) PURE;
+    STDMETHOD(CheckDeviceState)(HWND) PURE;
+    STDMETHOD(CreateRenderTargetEx)(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*, DWORD) PURE;
+    STDMETHOD(CreateOffscreenPlainSurfaceEx)(UINT, UINT, D3DFORMAT, D3DPOOL, IDirect3DSurface9**, HANDLE*, DWORD) PURE;
+    STDMETHOD(CreateDepthStencilSurfaceEx)(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*, DWORD) PURE;
+    STDMETHOD(ResetEx)(D3DPRESENT_PARAMETERS*, D3DDISPLAYMODEEX*) PURE;         // 132
+    STDMETHOD(GetDisplayModeEx)(UINT, D3DDISPLAYMODEEX*, D3DDISPLAYROTATION*) PURE;
+};
+
+struct IDirect3D9 : IUnknown {
+    STDMETHOD(RegisterSoftwareDevice)(void*) PURE;                              // 3
+    STDMETHOD_(UINT, GetAdapterCount)() PURE;
+    STDMETHOD(GetAdapterIdentifier)(UINT, DWORD, D3DADAPTER_IDENTIFIER9*) PURE;
+    STDMETHOD_(UINT, GetAdapterModeCount)(UINT, D3DFORMAT) PURE;
+    STDMETHOD(EnumAdapterModes)(UINT, D3DFORMAT, UINT, D3DDISPLAYMODE*) PURE;
+    STDMETHOD(GetAdapterDisplayMode)(UINT, D3DDISPLAYMODE*) PURE;
+    STDMETHOD(CheckDeviceType)(UINT, D3DDEVTYPE, D3DFORMAT, D3DFORMAT, BOOL) PURE;
+    STDMETHOD(CheckDeviceFormat)(UINT, D3DDEVTYPE, D3DFORMAT, DWORD, D3DRESOURCETYPE, D3DFORMAT) PURE;
+    STDMETHOD(CheckDeviceMultiSampleType)(UINT, D3DDEVTYPE, D3DFORMAT, BOOL, D3DMULTISAMPLE_TYPE, DWORD*) PURE;
+    STDMETHOD(CheckDepthStencilMatch)(UINT, D3DDEVTYPE, D3DFORMAT, D3DFORMAT, D3DFORMAT) PURE;
+    STDMETHOD(CheckDeviceFormatConversion)(UINT, D3DDEVTYPE, D3DFORMAT, D3DFORMAT) PURE;
+    STDMETHOD(GetDeviceCaps)(UINT, D3DDEVTYPE, D3DCAPS9*) PURE;
+    STDMETHOD_(HMONITOR, GetAdapterMonitor)(UINT) PURE;
+    STDMETHOD(CreateDevice)(UINT, D3DDEVTYPE, HWND, DWORD, D3DPRESENT_PARAMETERS*, IDirect3DDevice9**) PURE;  // 16
+};
+
+struct IDirect3D9Ex : IDirect3D9 {
+    STDMETHOD_(UINT, GetAdapterModeCountEx)(UINT, const D3DDISPLAYMODEFILTER*) PURE;  // 17
+    STDMETHOD(EnumAdapterModesEx)(UINT, const D3DDISPLAYMODEFILTER*, UINT, D3DDISPLAYMODEEX*) PURE;
+    STDMETHOD(GetAdapterDisplayModeEx)(UINT, D3DDISPLAYMODEEX*, D3DDISPLAYROTATION*) PURE;
+    STDMETHOD(CreateDeviceEx)(UINT, D3DDEVTYPE, HWND, DWORD, D3DPRESENT_PARAMETERS*, D3DDISPLAYMODEEX*, IDirect3DDevice9Ex**) PURE;  // 20
+    STDMETHOD(GetAdapterLUID)(UINT, LUID*) PURE;
+};
+
+typedef IDirect3DDevice9* LPDIRECT3DDEVICE9;
+typedef IDirect3D9* LPDIRECT3D9;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern const GUID IID_IDirect3D9;
+extern const GUID IID_IDirect3D9Ex;
+extern const GUID IID_IDirect3DDevice9;
+extern const GUID IID_IDirect3DDevice9Ex;
+extern const GUID IID_IDirect3DSwapChain9;
+extern const GUID IID_IDirect3DTexture9;
+IDirect3D9* WINAPI Direct3DCreate9(UINT SDKVersion);
+HRESULT WINAPI Direct3DCreate9Ex(UINT SDKVersion, IDirect3D9Ex** ppD3D);
+#ifdef __cplusplus
+}
+#endif
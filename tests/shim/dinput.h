@@ -0,0 +1,104 @@
+#pragma once
+// Minimal dinput.h for the Linux test build; methods in SDK order so slot
+// numbers match dinput8.dll.
+#include "unknwn.h"
+
+#ifndef DIRECTINPUT_VERSION
+#define DIRECTINPUT_VERSION 0x0800
+#endif
+
+typedef struct DIDEVICEINSTANCEA {
+    DWORD dwSize; GUID guidInstance; GUID guidProduct; DWORD dwDevType;
+    CHAR tszInstanceName[MAX_PATH]; CHAR tszProductName[MAX_PATH];
+    GUID guidFFDriver; WORD wUsagePage; WORD wUsage;
+} DIDEVICEINSTANCEA;
+typedef struct DIMOUSESTATE2 { LONG lX, lY, lZ; BYTE rgbButtons[8]; } DIMOUSESTATE2;
+typedef struct DIDEVICEOBJECTDATA { DWORD dwOfs; DWORD dwData; DWORD dwTimeStamp; DWORD dwSequence; UINT_PTR uAppData; } DIDEVICEOBJECTDATA;
+
+// Opaque to the proxy.
+typedef struct DIDEVCAPS DIDEVCAPS;
+typedef struct DIPROPHEADER DIPROPHEADER;
+typedef struct DIDATAFORMAT DIDATAFORMAT;
+typedef struct DIDEVICEOBJECTINSTANCEA DIDEVICEOBJECTINSTANCEA;
+typedef struct DIEFFECT DIEFFECT;
+typedef struct DIEFFECTINFOA DIEFFECTINFOA;
+typedef struct DIEFFESCAPE DIEFFESCAPE;
+typedef struct DIACTIONFORMATA DIACTIONFORMATA;
+typedef struct DIDEVICEIMAGEINFOHEADERA DIDEVICEIMAGEINFOHEADERA;
+typedef struct DICONFIGUREDEVICESPARAMSA DICONFIGUREDEVICESPARAMSA;
+typedef struct IDirectInputEffect IDirectInputEffect;
+typedef void* LPDIENUMDEVICEOBJECTSCALLBACKA;
+typedef void* LPDIENUMEFFECTSCALLBACKA;
+typedef void* LPDIENUMCREATEDEFFECTOBJECTSCALLBACK;
+typedef void* LPDIENUMEFFECTSINFILECALLBACK;
+typedef void* LPDIENUMDEVICESCALLBACKA;
+typedef void* LPDIENUMDEVICESBYSEMANTICSCBA;
+typedef void* LPDICONFIGUREDEVICESCALLBACK;
+typedef void* DIFILEEFFECT;
+
+#define LOBYTE(w) ((BYTE)(((DWORD_PTR)(w)) & 0xff))
+#define GET_DIDEVICE_TYPE(dwDevType) LOBYTE(dwDevType)
+#define DI8DEVTYPE_MOUSE 0x12
+#define DI8DEVTYPE_KEYBOARD 0x13
+#define DISCL_EXCLUSIVE 0x1
+#define DISCL_NONEXCLUSIVE 0x2
+#define DISCL_FOREGROUND 0x4
+#define DISCL_BACKGROUND 0x8
+#define DI_OK S_OK
+#define DIERR_GENERIC E_FAIL
+#define DIERR_INPUTLOST ((HRESULT)0x8007001EL)
+#define DIERR_NOTACQUIRED ((HRESULT)0x8007000CL)
+
+struct IDirectInputDevice8A : IUnknown {
+    STDMETHOD(GetCapabilities)(DIDEVCAPS*) PURE;                                // 3
+    STDMETHOD(EnumObjects)(LPDIENUMDEVICEOBJECTSCALLBACKA, LPVOID, DWORD) PURE;
+    STDMETHOD(GetProperty)(REFGUID, DIPROPHEADER*) PURE;
+    STDMETHOD(SetProperty)(REFGUID, const DIPROPHEADER*) PURE;
+    STDMETHOD(Acquire)() PURE;                                                  // 7
+    STDMETHOD(Unacquire)() PURE;
+    STDMETHOD(GetDeviceState)(DWORD, LPVOID) PURE;                              // 9
+    STDMETHOD(GetDeviceData)(DWORD, DIDEVICEOBJECTDATA*, LPDWORD, DWORD) PURE;
+    STDMETHOD(SetDataFormat)(const DIDATAFORMAT*) PURE;
+    STDMETHOD(SetEventNotification)(HANDLE) PURE;
+    STDMETHOD(SetCooperativeLevel)(HWND, DWORD) PURE;                           // 13
+    STDMETHOD(GetObjectInfo)(DIDEVICEOBJECTINSTANCEA*, DWORD, DWORD) PURE;
+    STDMETHOD(GetDeviceInfo)(DIDEVICEINSTANCEA*) PURE;                          // 15
+    STDMETHOD(RunControlPanel)(HWND, DWORD) PURE;
+    STDMETHOD(Initialize)(HINSTANCE, DWORD, REFGUID) PURE;
+    STDMETHOD(CreateEffect)(REFGUID, const DIEFFECT*, IDirectInputEffect**, LPUNKNOWN) PURE;
+    STDMETHOD(EnumEffects)(LPDIENUMEFFECTSCALLBACKA, LPVOID, DWORD) PURE;
+    STDMETHOD(GetEffectInfo)(DIEFFECTINFOA*, REFGUID) PURE;
+    STDMETHOD(GetForceFeedbackState)(LPDWORD) PURE;
+    STDMETHOD(SendForceFeedbackCommand)(DWORD) PURE;
+    STDMETHOD(EnumCreatedEffectObjects)(LPDIENUMCREATEDEFFECTOBJECTSCALLBACK, LPVOID, DWORD) PURE;
+    STDMETHOD(Escape)(DIEFFESCAPE*) PURE;
+    STDMETHOD(Poll)() PURE;                                                     // 25
+    STDMETHOD(SendDeviceData)(DWORD, const DIDEVICEOBJECTDATA*, LPDWORD, DWORD) PURE;
+    STDMETHOD(EnumEffectsInFile)(LPCSTR, LPDIENUMEFFECTSINFILECALLBACK, LPVOID, DWORD) PURE;
+    STDMETHOD(WriteEffectToFile)(LPCSTR, DWORD, DIFILEEFFECT*, DWORD) PURE;
+    STDMETHOD(BuildActionMap)(DIACTIONFORMATA*, LPCSTR, DWORD) PURE;
+    STDMETHOD(SetActionMap)(DIACTIONFORMATA*, LPCSTR, DWORD) PURE;
+    STDMETHOD(GetImageInfo)(DIDEVICEIMAGEINFOHEADERA*) PURE;                    // 31
+};
+typedef IDirectInputDevice8A IDirectInputDevice8;
+
+struct IDirectInput8A : IUnknown {
+    STDMETHOD(CreateDevice)(REFGUID, IDirectInputDevice8A**, LPUNKNOWN) PURE;   // 3
+    STDMETHOD(EnumDevices)(DWORD, LPDIENUMDEVICESCALLBACKA, LPVOID, DWORD) PURE;
+    STDMETHOD(GetDeviceStatus)(REFGUID) PURE;
+    STDMETHOD(RunControlPanel)(HWND, DWORD) PURE;
+    STDMETHOD(Initialize)(HINSTANCE, DWORD) PURE;
+    STDMETHOD(FindDevice)(REFGUID, LPCSTR, GUID*) PURE;
+    STDMETHOD(EnumDevicesBySemantics)(LPCSTR, DIACTIONFORMATA*, LPDIENUMDEVICESBYSEMANTICSCBA, LPVOID, DWORD) PURE;
+    STDMETHOD(ConfigureDevices)(LPDICONFIGUREDEVICESCALLBACK, DICONFIGUREDEVICESPARAMSA*, DWORD, LPVOID) PURE;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern const GUID IID_IDirectInput8A;
+extern const GUID GUID_SysMouse;
+extern const GUID GUID_SysKeyboard;
+#ifdef __cplusplus
+}
+#endif
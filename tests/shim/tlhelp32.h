@@ -0,0 +1,19 @@
+#pragma once
+#include "windows.h"
+
+typedef struct tagTHREADENTRY32 {
+    DWORD dwSize, cntUsage, th32ThreadID, th32OwnerProcessID;
+    LONG tpBasePri, tpDeltaPri;
+    DWORD dwFlags;
+} THREADENTRY32, *LPTHREADENTRY32;
+#define TH32CS_SNAPTHREAD 0x4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+HANDLE CreateToolhelp32Snapshot(DWORD, DWORD);
+BOOL Thread32First(HANDLE, LPTHREADENTRY32);
+BOOL Thread32Next(HANDLE, LPTHREADENTRY32);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#include "windows.h"
+
+// COM interfaces are declared with plain virtuals and no virtual destructor,
+// so the Itanium vtable has exactly one slot per method, in declaration
+// order, and a vtable pointer at offset 0 - the same layout MSVC gives COM.
+// Hook code that indexes vtables by slot number sees the real numbering.
+#define STDMETHODCALLTYPE
+#define STDMETHOD(name) virtual HRESULT STDMETHODCALLTYPE name
+#define STDMETHOD_(type, name) virtual type STDMETHODCALLTYPE name
+#define PURE = 0
+
+struct IUnknown {
+    STDMETHOD(QueryInterface)(REFIID, void**) PURE;
+    STDMETHOD_(ULONG, AddRef)() PURE;
+    STDMETHOD_(ULONG, Release)() PURE;
+};
+typedef IUnknown* LPUNKNOWN;
+
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define S_FALSE 1
+
+#ifdef __cplusplus
+static inline bool IsEqualGUID(const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+static inline bool operator==(const GUID& a, const GUID& b) { return IsEqualGUID(a, b); }
+static inline bool operator!=(const GUID& a, const GUID& b) { return !IsEqualGUID(a, b); }
+#endif
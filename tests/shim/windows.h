@@ -0,0 +1,531 @@
+#pragma once
+// Minimal windows.h for building the proxy on Linux against the fakes in
+// tests/fake. Only what d3d9_windowed.cpp, chainload.cpp and MinHook use is
+// declared; every function here is implemented by fake_win32.cpp (or by the
+// MinHook tests themselves). Types keep their Windows sizes: DWORD/LONG are
+// 32-bit, pointers and *_PTR types follow the target.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+#define NTAPI
+#define STDMETHODCALLTYPE
+#define __declspec(x)
+#ifndef __stdcall
+#define __stdcall
+#endif
+#ifndef __cdecl
+#define __cdecl
+#endif
+#ifndef __forceinline
+#define __forceinline inline __attribute__((always_inline))
+#endif
+#define VOID void
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+
+// -----------------------------------------------------------------------------
+// Base types
+// -----------------------------------------------------------------------------
+
+typedef int BOOL, INT;
+typedef unsigned char BYTE, UINT8, UCHAR, *LPBYTE, *PBYTE;
+typedef signed char INT8;
+typedef unsigned short WORD, USHORT, UINT16;
+typedef short SHORT, INT16;
+typedef unsigned int UINT, UINT32, DWORD, ULONG, *PUINT, *PUINT32, *LPDWORD, *PDWORD, *PULONG;
+typedef int LONG, INT32, HRESULT, NTSTATUS, *PLONG;
+typedef uint64_t ULONGLONG, UINT64, DWORD64;
+typedef int64_t LONGLONG, LONG64, INT64;
+typedef uintptr_t ULONG_PTR, DWORD_PTR, SIZE_T, UINT_PTR, WPARAM, *PULONG_PTR;
+typedef intptr_t LONG_PTR, INT_PTR, SSIZE_T, LPARAM, LRESULT;
+typedef void *LPVOID, *PVOID, *HANDLE, **PHANDLE, **LPHANDLE;
+typedef const void* LPCVOID;
+typedef void* FARPROC;
+typedef char CHAR;
+typedef wchar_t WCHAR;
+typedef const char *LPCSTR, *PCSTR;
+typedef char *LPSTR, *PSTR;
+typedef const wchar_t *LPCWSTR, *PCWSTR;
+typedef wchar_t *LPWSTR, *PWSTR;
+typedef DWORD ACCESS_MASK;
+typedef WORD ATOM;
+
+typedef struct HWND__* HWND;
+typedef struct HINSTANCE__* HINSTANCE;
+typedef HINSTANCE HMODULE;
+typedef struct HMONITOR__* HMONITOR;
+typedef struct HDC__* HDC;
+typedef struct HRAWINPUT__* HRAWINPUT;
+typedef void *HCURSOR, *HBRUSH, *HGDIOBJ;
+
+typedef struct _RECT { LONG left, top, right, bottom; } RECT, *LPRECT, *PRECT;
+typedef const RECT* LPCRECT;
+typedef struct _POINT { LONG x, y; } POINT, *LPPOINT, *PPOINT;
+typedef struct _SIZE { LONG cx, cy; } SIZE;
+
+typedef struct _GUID { DWORD Data1; WORD Data2, Data3; BYTE Data4[8]; } GUID, IID, CLSID;
+#ifdef __cplusplus
+typedef const GUID& REFIID;
+typedef const GUID& REFGUID;
+#else
+typedef const GUID* REFIID;
+typedef const GUID* REFGUID;
+#endif
+
+typedef union _LARGE_INTEGER {
+    struct { DWORD LowPart; LONG HighPart; } u;
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+typedef struct _FILETIME { DWORD dwLowDateTime, dwHighDateTime; } FILETIME, *LPFILETIME;
+
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define S_OK ((HRESULT)0)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define LOWORD(l) ((WORD)(((DWORD_PTR)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xffff))
+#define MAKEWORD(a, b) ((WORD)(((BYTE)(a)) | ((WORD)((BYTE)(b))) << 8))
+#define MAKELONG(a, b) ((LONG)(((WORD)(a)) | ((DWORD)((WORD)(b))) << 16))
+#define MAKELPARAM(l, h) ((LPARAM)(DWORD)MAKELONG(l, h))
+#define MAKEWPARAM(l, h) ((WPARAM)(DWORD)MAKELONG(l, h))
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define FIELD_OFFSET(t, f) ((LONG)offsetof(t, f))
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+#define FillMemory(p, n, v) memset((p), (v), (n))
+
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#define strtok_s strtok_r
+
+// -----------------------------------------------------------------------------
+// kernel32
+// -----------------------------------------------------------------------------
+
+typedef DWORD (WINAPI* LPTHREAD_START_ROUTINE)(LPVOID);
+typedef struct _SECURITY_ATTRIBUTES { DWORD nLength; LPVOID lpSecurityDescriptor; BOOL bInheritHandle; } SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+typedef struct _OVERLAPPED { ULONG_PTR Internal, InternalHigh; DWORD Offset, OffsetHigh; HANDLE hEvent; } OVERLAPPED, *LPOVERLAPPED;
+typedef struct _SRWLOCK { PVOID Ptr; } SRWLOCK, *PSRWLOCK;
+#define SRWLOCK_INIT {0}
+typedef struct _INIT_ONCE { PVOID Ptr; } INIT_ONCE, *PINIT_ONCE;
+#define INIT_ONCE_STATIC_INIT {0}
+typedef BOOL (CALLBACK* PINIT_ONCE_FN)(PINIT_ONCE, PVOID, PVOID*);
+typedef struct _CRITICAL_SECTION { PVOID Impl[5]; } CRITICAL_SECTION, *LPCRITICAL_SECTION;
+
+typedef struct _SYSTEM_INFO {
+    WORD wProcessorArchitecture, wReserved;
+    DWORD dwPageSize;
+    LPVOID lpMinimumApplicationAddress, lpMaximumApplicationAddress;
+    DWORD_PTR dwActiveProcessorMask;
+    DWORD dwNumberOfProcessors, dwProcessorType, dwAllocationGranularity;
+    WORD wProcessorLevel, wProcessorRevision;
+} SYSTEM_INFO, *LPSYSTEM_INFO;
+
+typedef struct _MEMORY_BASIC_INFORMATION {
+    PVOID BaseAddress, AllocationBase;
+    DWORD AllocationProtect;
+    SIZE_T RegionSize;
+    DWORD State, Protect, Type;
+} MEMORY_BASIC_INFORMATION, *PMEMORY_BASIC_INFORMATION;
+
+typedef struct _WIN32_FILE_ATTRIBUTE_DATA {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime, ftLastAccessTime, ftLastWriteTime;
+    DWORD nFileSizeHigh, nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+typedef enum _GET_FILEEX_INFO_LEVELS { GetFileExInfoStandard } GET_FILEEX_INFO_LEVELS;
+
+#define CONTEXT_CONTROL 0x1
+#define CONTEXT_FULL 0x7
+typedef struct _CONTEXT { DWORD ContextFlags; DWORD Eip; DWORD64 Rip; } CONTEXT, *PCONTEXT, *LPCONTEXT;
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED ((DWORD)0xFFFFFFFF)
+#define STILL_ACTIVE 259
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x2
+#define TIMER_ALL_ACCESS 0x1F0003
+#define THREAD_PRIORITY_LOWEST (-2)
+#define THREAD_PRIORITY_BELOW_NORMAL (-1)
+#define THREAD_PRIORITY_NORMAL 0
+#define THREAD_SUSPEND_RESUME 0x2
+#define THREAD_GET_CONTEXT 0x8
+#define THREAD_SET_CONTEXT 0x10
+#define THREAD_QUERY_INFORMATION 0x40
+
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_INVALID_HANDLE 6
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_NO_MORE_FILES 18
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_MOD_NOT_FOUND 126
+#define ERROR_PROC_NOT_FOUND 127
+#define ERROR_ALREADY_EXISTS 183
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define FILE_NOTIFY_CHANGE_FILE_NAME 0x1
+#define FILE_NOTIFY_CHANGE_LAST_WRITE 0x10
+
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define PAGE_EXECUTE 0x10
+#define PAGE_EXECUTE_READ 0x20
+#define PAGE_EXECUTE_READWRITE 0x40
+#define PAGE_EXECUTE_WRITECOPY 0x80
+#define PAGE_GUARD 0x100
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define MEM_FREE 0x10000
+#define FILE_MAP_WRITE 0x2
+#define FILE_MAP_READ 0x4
+#define HEAP_ZERO_MEMORY 0x8
+
+#define DONT_RESOLVE_DLL_REFERENCES 0x1
+#define LOAD_LIBRARY_AS_DATAFILE 0x2
+#define LOAD_LIBRARY_AS_IMAGE_RESOURCE 0x20
+#define GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT 0x2
+#define GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS 0x4
+
+#define IMAGE_DOS_SIGNATURE 0x5A4D
+#define IMAGE_NT_SIGNATURE 0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC 0x10b
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC 0x20b
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define IMAGE_NT_OPTIONAL_HDR_MAGIC IMAGE_NT_OPTIONAL_HDR64_MAGIC
+#else
+#define IMAGE_NT_OPTIONAL_HDR_MAGIC IMAGE_NT_OPTIONAL_HDR32_MAGIC
+#endif
+#define IMAGE_DIRECTORY_ENTRY_IMPORT 1
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES 16
+// Header layouts are shortened to the fields the proxy reads.
+typedef struct _IMAGE_DOS_HEADER { WORD e_magic; WORD e_unused[29]; LONG e_lfanew; } IMAGE_DOS_HEADER, *PIMAGE_DOS_HEADER;
+typedef struct _IMAGE_FILE_HEADER {
+    WORD Machine, NumberOfSections; DWORD TimeDateStamp, PointerToSymbolTable, NumberOfSymbols;
+    WORD SizeOfOptionalHeader, Characteristics;
+} IMAGE_FILE_HEADER;
+typedef struct _IMAGE_DATA_DIRECTORY { DWORD VirtualAddress, Size; } IMAGE_DATA_DIRECTORY;
+typedef struct _IMAGE_OPTIONAL_HEADER {
+    WORD Magic; DWORD SizeOfImage; DWORD CheckSum;
+    IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER;
+typedef struct _IMAGE_NT_HEADERS { DWORD Signature; IMAGE_FILE_HEADER FileHeader; IMAGE_OPTIONAL_HEADER OptionalHeader; } IMAGE_NT_HEADERS, *PIMAGE_NT_HEADERS;
+typedef struct _IMAGE_IMPORT_DESCRIPTOR { DWORD OriginalFirstThunk, TimeDateStamp, ForwarderChain, Name, FirstThunk; } IMAGE_IMPORT_DESCRIPTOR;
+
+// -----------------------------------------------------------------------------
+// user32 / gdi32
+// -----------------------------------------------------------------------------
+
+typedef LRESULT (CALLBACK* WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef BOOL (CALLBACK* WNDENUMPROC)(HWND, LPARAM);
+typedef struct _RGNDATA { DWORD dwSize, iType, nCount, nRgnSize; RECT rcBound; char Buffer[1]; } RGNDATA;
+typedef struct _MSG { HWND hwnd; UINT message; WPARAM wParam; LPARAM lParam; DWORD time; POINT pt; } MSG, *LPMSG;
+typedef struct _MONITORINFO { DWORD cbSize; RECT rcMonitor; RECT rcWork; DWORD dwFlags; } MONITORINFO, *LPMONITORINFO;
+typedef struct _WINDOWPOS { HWND hwnd, hwndInsertAfter; int x, y, cx, cy; UINT flags; } WINDOWPOS;
+typedef struct _DEVMODEA { CHAR dmDeviceName[32]; DWORD dmFields; DWORD dmBitsPerPel, dmPelsWidth, dmPelsHeight, dmDisplayFrequency; } DEVMODEA;
+typedef struct _DEVMODEW { WCHAR dmDeviceName[32]; DWORD dmFields; DWORD dmBitsPerPel, dmPelsWidth, dmPelsHeight, dmDisplayFrequency; } DEVMODEW;
+
+typedef struct tagRAWINPUTHEADER { DWORD dwType, dwSize; HANDLE hDevice; WPARAM wParam; } RAWINPUTHEADER;
+typedef struct tagRAWMOUSE {
+    USHORT usFlags;
+    union { ULONG ulButtons; struct { USHORT usButtonFlags, usButtonData; }; };
+    ULONG ulRawButtons; LONG lLastX, lLastY; ULONG ulExtraInformation;
+} RAWMOUSE;
+typedef struct tagRAWINPUT { RAWINPUTHEADER header; union { RAWMOUSE mouse; } data; } RAWINPUT;
+#define RID_INPUT 0x10000003
+#define RID_HEADER 0x10000005
+#define RIM_TYPEMOUSE 0
+#define RIM_TYPEKEYBOARD 1
+#define MOUSE_MOVE_RELATIVE 0
+#define MOUSE_MOVE_ABSOLUTE 1
+
+#define WM_NULL 0x0000
+#define WM_DESTROY 0x0002
+#define WM_MOVE 0x0003
+#define WM_SIZE 0x0005
+#define WM_ACTIVATE 0x0006
+#define WM_SETFOCUS 0x0007
+#define WM_KILLFOCUS 0x0008
+#define WM_PAINT 0x000F
+#define WM_ACTIVATEAPP 0x001C
+#define WM_SETCURSOR 0x0020
+#define WM_WINDOWPOSCHANGED 0x0047
+#define WM_DISPLAYCHANGE 0x007E
+#define WM_NCDESTROY 0x0082
+#define WM_NCHITTEST 0x0084
+#define WM_INPUT 0x00FF
+#define WM_KEYDOWN 0x0100
+#define WM_KEYUP 0x0101
+#define WM_CHAR 0x0102
+#define WM_TIMER 0x0113
+#define WM_MOUSEFIRST 0x0200
+#define WM_MOUSEMOVE 0x0200
+#define WM_LBUTTONDOWN 0x0201
+#define WM_LBUTTONUP 0x0202
+#define WM_LBUTTONDBLCLK 0x0203
+#define WM_RBUTTONDOWN 0x0204
+#define WM_RBUTTONUP 0x0205
+#define WM_RBUTTONDBLCLK 0x0206
+#define WM_MBUTTONDOWN 0x0207
+#define WM_MBUTTONUP 0x0208
+#define WM_MBUTTONDBLCLK 0x0209
+#define WM_MOUSEWHEEL 0x020A
+#define WM_XBUTTONDOWN 0x020B
+#define WM_XBUTTONUP 0x020C
+#define WM_XBUTTONDBLCLK 0x020D
+#define WM_MOUSEHWHEEL 0x020E
+#define WM_MOUSELAST 0x020E
+#define WM_ENTERSIZEMOVE 0x0231
+#define WM_EXITSIZEMOVE 0x0232
+#define WM_IME_NOTIFY 0x0282
+#define WM_USER 0x0400
+#define WM_APP 0x8000
+
+#define HTCLIENT 1
+#define MK_LBUTTON 0x0001
+#define WHEEL_DELTA 120
+#define WA_INACTIVE 0
+#define WA_ACTIVE 1
+#define WA_CLICKACTIVE 2
+#define SIZE_RESTORED 0
+#define SIZE_MINIMIZED 1
+#define GWL_STYLE (-16)
+#define GWL_EXSTYLE (-20)
+#define GWLP_WNDPROC (-4)
+#define GW_OWNER 4
+#define WS_POPUP 0x80000000L
+#define WS_VISIBLE 0x10000000L
+#define WS_CAPTION 0x00C00000L
+#define WS_SYSMENU 0x00080000L
+#define WS_THICKFRAME 0x00040000L
+#define WS_MINIMIZEBOX 0x00020000L
+#define WS_MAXIMIZEBOX 0x00010000L
+#define WS_OVERLAPPEDWINDOW 0x00CF0000L
+#define HWND_TOP ((HWND)0)
+#define HWND_NOTOPMOST ((HWND)-2)
+#define SWP_NOSIZE 0x0001
+#define SWP_NOMOVE 0x0002
+#define SWP_NOZORDER 0x0004
+#define SWP_FRAMECHANGED 0x0020
+#define SWP_SHOWWINDOW 0x0040
+#define SWP_NOOWNERZORDER 0x0200
+#define MONITOR_DEFAULTTONEAREST 0x2
+#define DM_BITSPERPEL 0x00040000
+#define DM_PELSWIDTH 0x00080000
+#define DM_PELSHEIGHT 0x00100000
+#define DM_DISPLAYFREQUENCY 0x00400000
+#define CDS_FULLSCREEN 0x4
+#define DISP_CHANGE_SUCCESSFUL 0
+#define PM_NOREMOVE 0x0
+#define PM_REMOVE 0x1
+#define PM_NOYIELD 0x2
+#define BLACK_BRUSH 4
+
+// -----------------------------------------------------------------------------
+// Functions (implemented by tests/fake/fake_win32.cpp)
+// -----------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LONG InterlockedCompareExchange(volatile LONG*, LONG, LONG);
+LONG InterlockedExchange(volatile LONG*, LONG);
+LONG InterlockedExchangeAdd(volatile LONG*, LONG);
+LONG InterlockedIncrement(volatile LONG*);
+LONG InterlockedDecrement(volatile LONG*);
+LONG InterlockedOr(volatile LONG*, LONG);
+LONG InterlockedAnd(volatile LONG*, LONG);
+LONG64 InterlockedCompareExchange64(volatile LONG64*, LONG64, LONG64);
+LONG64 InterlockedExchange64(volatile LONG64*, LONG64);
+LONG64 InterlockedExchangeAdd64(volatile LONG64*, LONG64);
+LONG64 InterlockedAdd64(volatile LONG64*, LONG64);
+LONG64 InterlockedIncrement64(volatile LONG64*);
+PVOID InterlockedCompareExchangePointer(PVOID volatile*, PVOID, PVOID);
+PVOID InterlockedExchangePointer(PVOID volatile*, PVOID);
+PVOID ReadPointerAcquire(PVOID const volatile*);
+void MemoryBarrier(void);
+void YieldProcessor(void);
+void _ReadWriteBarrier(void);
+unsigned char BitScanForward(DWORD*, DWORD);
+
+DWORD GetLastError(void);
+void SetLastError(DWORD);
+DWORD GetCurrentProcessId(void);
+DWORD GetCurrentThreadId(void);
+HANDLE GetCurrentProcess(void);
+HANDLE GetCurrentThread(void);
+DWORD GetThreadId(HANDLE);
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES, SIZE_T, LPTHREAD_START_ROUTINE, LPVOID, DWORD, LPDWORD);
+BOOL SetThreadPriority(HANDLE, int);
+BOOL GetExitCodeThread(HANDLE, LPDWORD);
+HANDLE OpenThread(DWORD, BOOL, DWORD);
+DWORD SuspendThread(HANDLE);
+DWORD ResumeThread(HANDLE);
+BOOL GetThreadContext(HANDLE, CONTEXT*);
+BOOL SetThreadContext(HANDLE, const CONTEXT*);
+BOOL CloseHandle(HANDLE);
+DWORD WaitForSingleObject(HANDLE, DWORD);
+DWORD WaitForMultipleObjects(DWORD, const HANDLE*, BOOL, DWORD);
+void Sleep(DWORD);
+BOOL SwitchToThread(void);
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL, BOOL, LPCWSTR);
+BOOL SetEvent(HANDLE);
+BOOL ResetEvent(HANDLE);
+HANDLE CreateWaitableTimerW(LPSECURITY_ATTRIBUTES, BOOL, LPCWSTR);
+HANDLE CreateWaitableTimerExW(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD, DWORD);
+BOOL SetWaitableTimer(HANDLE, const LARGE_INTEGER*, LONG, void*, LPVOID, BOOL);
+void InitializeSRWLock(PSRWLOCK);
+void AcquireSRWLockExclusive(PSRWLOCK);
+void ReleaseSRWLockExclusive(PSRWLOCK);
+void AcquireSRWLockShared(PSRWLOCK);
+void ReleaseSRWLockShared(PSRWLOCK);
+void InitializeCriticalSection(LPCRITICAL_SECTION);
+void DeleteCriticalSection(LPCRITICAL_SECTION);
+void EnterCriticalSection(LPCRITICAL_SECTION);
+void LeaveCriticalSection(LPCRITICAL_SECTION);
+BOOL InitOnceExecuteOnce(PINIT_ONCE, PINIT_ONCE_FN, PVOID, LPVOID*);
+BOOL WaitOnAddress(volatile void*, PVOID, SIZE_T, DWORD);
+void WakeByAddressSingle(PVOID);
+void WakeByAddressAll(PVOID);
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER*);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER*);
+DWORD GetTickCount(void);
+ULONGLONG GetTickCount64(void);
+void GetSystemTimePreciseAsFileTime(LPFILETIME);
+LONG CompareFileTime(const FILETIME*, const FILETIME*);
+UINT timeBeginPeriod(UINT);
+UINT timeEndPeriod(UINT);
+
+void OutputDebugStringA(LPCSTR);
+int MulDiv(int, int, int);
+char* lstrcpynA(LPSTR, LPCSTR, int);
+int wsprintfA(LPSTR, LPCSTR, ...);
+
+HMODULE GetModuleHandleA(LPCSTR);
+HMODULE GetModuleHandleW(LPCWSTR);
+BOOL GetModuleHandleExA(DWORD, LPCSTR, HMODULE*);
+DWORD GetModuleFileNameA(HMODULE, LPSTR, DWORD);
+DWORD GetModuleFileNameW(HMODULE, LPWSTR, DWORD);
+HMODULE LoadLibraryA(LPCSTR);
+HMODULE LoadLibraryW(LPCWSTR);
+HMODULE LoadLibraryExA(LPCSTR, HANDLE, DWORD);
+BOOL FreeLibrary(HMODULE);
+FARPROC GetProcAddress(HMODULE, LPCSTR);
+BOOL DisableThreadLibraryCalls(HMODULE);
+UINT GetSystemDirectoryA(LPSTR, UINT);
+DWORD GetFullPathNameA(LPCSTR, DWORD, LPSTR, LPSTR*);
+
+DWORD GetPrivateProfileStringA(LPCSTR, LPCSTR, LPCSTR, LPSTR, DWORD, LPCSTR);
+UINT GetPrivateProfileIntA(LPCSTR, LPCSTR, INT, LPCSTR);
+DWORD GetPrivateProfileSectionA(LPCSTR, LPSTR, DWORD, LPCSTR);
+BOOL WritePrivateProfileStringA(LPCSTR, LPCSTR, LPCSTR, LPCSTR);
+
+HANDLE CreateFileA(LPCSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+BOOL ReadFile(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED);
+BOOL WriteFile(HANDLE, LPCVOID, DWORD, LPDWORD, LPOVERLAPPED);
+DWORD SetFilePointer(HANDLE, LONG, PLONG, DWORD);
+BOOL SetFilePointerEx(HANDLE, LARGE_INTEGER, PLARGE_INTEGER, DWORD);
+BOOL SetEndOfFile(HANDLE);
+BOOL FlushFileBuffers(HANDLE);
+BOOL GetFileSizeEx(HANDLE, PLARGE_INTEGER);
+DWORD GetFileAttributesA(LPCSTR);
+BOOL GetFileAttributesExA(LPCSTR, GET_FILEEX_INFO_LEVELS, LPVOID);
+BOOL MoveFileExA(LPCSTR, LPCSTR, DWORD);
+BOOL DeleteFileA(LPCSTR);
+HANDLE FindFirstChangeNotificationA(LPCSTR, BOOL, DWORD);
+BOOL FindNextChangeNotification(HANDLE);
+BOOL FindCloseChangeNotification(HANDLE);
+HANDLE CreateFileMappingA(HANDLE, LPSECURITY_ATTRIBUTES, DWORD, DWORD, DWORD, LPCSTR);
+LPVOID MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, SIZE_T);
+BOOL UnmapViewOfFile(LPCVOID);
+BOOL FlushViewOfFile(LPCVOID, SIZE_T);
+
+LPVOID VirtualAlloc(LPVOID, SIZE_T, DWORD, DWORD);
+BOOL VirtualFree(LPVOID, SIZE_T, DWORD);
+BOOL VirtualProtect(LPVOID, SIZE_T, DWORD, PDWORD);
+SIZE_T VirtualQuery(LPCVOID, PMEMORY_BASIC_INFORMATION, SIZE_T);
+void GetSystemInfo(LPSYSTEM_INFO);
+BOOL FlushInstructionCache(HANDLE, LPCVOID, SIZE_T);
+HANDLE HeapCreate(DWORD, SIZE_T, SIZE_T);
+BOOL HeapDestroy(HANDLE);
+LPVOID HeapAlloc(HANDLE, DWORD, SIZE_T);
+LPVOID HeapReAlloc(HANDLE, DWORD, LPVOID, SIZE_T);
+BOOL HeapFree(HANDLE, DWORD, LPVOID);
+
+HWND GetForegroundWindow(void);
+HWND GetFocus(void);
+HWND GetCapture(void);
+HWND SetCapture(HWND);
+BOOL ReleaseCapture(void);
+BOOL IsWindow(HWND);
+BOOL IsWindowVisible(HWND);
+BOOL IsIconic(HWND);
+HWND GetWindow(HWND, UINT);
+DWORD GetWindowThreadProcessId(HWND, LPDWORD);
+BOOL EnumWindows(WNDENUMPROC, LPARAM);
+BOOL GetClientRect(HWND, LPRECT);
+BOOL GetWindowRect(HWND, LPRECT);
+BOOL ScreenToClient(HWND, LPPOINT);
+BOOL ClientToScreen(HWND, LPPOINT);
+LONG_PTR GetWindowLongPtr(HWND, int);
+LONG_PTR SetWindowLongPtr(HWND, int, LONG_PTR);
+BOOL SetWindowPos(HWND, HWND, int, int, int, int, UINT);
+LRESULT DefWindowProc(HWND, UINT, WPARAM, LPARAM);
+LRESULT CallWindowProc(WNDPROC, HWND, UINT, WPARAM, LPARAM);
+BOOL PostMessage(HWND, UINT, WPARAM, LPARAM);
+BOOL PeekMessageW(LPMSG, HWND, UINT, UINT, UINT);
+HMONITOR MonitorFromWindow(HWND, DWORD);
+BOOL GetMonitorInfo(HMONITOR, LPMONITORINFO);
+BOOL GetMonitorInfoA(HMONITOR, LPMONITORINFO);
+BOOL ClipCursor(const RECT*);
+BOOL GetClipCursor(LPRECT);
+BOOL GetCursorPos(LPPOINT);
+BOOL SetCursorPos(int, int);
+LONG ChangeDisplaySettingsExA(LPCSTR, DEVMODEA*, HWND, DWORD, LPVOID);
+LONG ChangeDisplaySettingsExW(LPCWSTR, DEVMODEW*, HWND, DWORD, LPVOID);
+UINT GetRawInputData(HRAWINPUT, UINT, LPVOID, PUINT, UINT);
+BOOL SystemParametersInfoA(UINT, UINT, PVOID, UINT);
+BOOL EqualRect(const RECT*, const RECT*);
+HDC GetDC(HWND);
+int ReleaseDC(HWND, HDC);
+HGDIOBJ GetStockObject(int);
+int FillRect(HDC, const RECT*, HBRUSH);
+
+#ifdef __cplusplus
+}
+#endif
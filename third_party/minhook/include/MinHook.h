@@ -79,7 +79,10 @@ typedef enum MH_STATUS
     MH_ERROR_MODULE_NOT_FOUND,
 
     // The specified function is not found.
-    MH_ERROR_FUNCTION_NOT_FOUND
+    MH_ERROR_FUNCTION_NOT_FOUND,
+
+    // A required pointer argument is NULL.
+    MH_ERROR_INVALID_ARGUMENT
 }
 MH_STATUS;
 
@@ -87,6 +90,19 @@ MH_STATUS;
 // MH_QueueEnableHook or MH_QueueDisableHook.
 #define MH_ALL_HOOKS NULL
 
+#ifdef MH_ENABLE_LOCK_STATS
+// Counters of the internal lock. Collected only if MinHook is built with
+// MH_ENABLE_LOCK_STATS defined.
+typedef struct MH_LOCK_STATS
+{
+    ULONGLONG acquisitions; // Number of times the lock was taken.
+    ULONGLONG contentions;  // Number of times the lock was found already held.
+    ULONGLONG kernelWaits;  // Number of waits after spinning didn't help.
+    ULONGLONG waitTicks;    // Time spent waiting, in QueryPerformanceCounter ticks.
+}
+MH_LOCK_STATS;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -180,6 +196,13 @@ extern "C" {
     // Translates the MH_STATUS to its name as a string.
     const char * WINAPI MH_StatusToString(MH_STATUS status);
 
+#ifdef MH_ENABLE_LOCK_STATS
+    // Retrieves the counters of the internal lock.
+    // Parameters:
+    //   pStats [out] A pointer to the structure to receive the counters.
+    MH_STATUS WINAPI MH_GetLockStats(MH_LOCK_STATS *pStats);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,12 +29,22 @@
 #include <windows.h>
 #include "buffer.h"
 
+#ifndef ARRAYSIZE
+    #define ARRAYSIZE(A) (sizeof(A)/sizeof((A)[0]))
+#endif
+
 // Size of each memory block. (= page size of VirtualAlloc)
 #define MEMORY_BLOCK_SIZE 0x1000
 
+// Number of slots in each memory block. Slot 0 holds the MEMORY_BLOCK itself.
+#define MEMORY_SLOTS_PER_BLOCK (MEMORY_BLOCK_SIZE / MEMORY_SLOT_SIZE)
+
 // Max range for seeking a memory block. (= 1024MB)
 #define MAX_MEMORY_RANGE 0x40000000
 
+// Number of modules to remember the last allocated block for.
+#define REGION_HINT_COUNT 8
+
 // Memory protection flags to check the executable address.
 #define PAGE_EXECUTE_FLAGS \
     (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
@@ -42,48 +52,127 @@
 // Memory slot.
 typedef struct _MEMORY_SLOT
 {
-    union
-    {
-        struct _MEMORY_SLOT *pNext;
-        UINT8 buffer[MEMORY_SLOT_SIZE];
-    };
+    UINT8 buffer[MEMORY_SLOT_SIZE];
 } MEMORY_SLOT, *PMEMORY_SLOT;
 
 // Memory block info. Placed at the head of each block.
 typedef struct _MEMORY_BLOCK
 {
+    struct _MEMORY_BLOCK *pPrev;
     struct _MEMORY_BLOCK *pNext;
-    PMEMORY_SLOT pFree;         // First element of the free slot list.
+    UINT32 freeMap[MEMORY_SLOTS_PER_BLOCK / 32];    // Set bits are unused slots.
     UINT usedCount;
 } MEMORY_BLOCK, *PMEMORY_BLOCK;
 
+// The block info must fit in its slot.
+typedef char MEMORY_BLOCK_FITS_IN_SLOT[(sizeof(MEMORY_BLOCK) <= MEMORY_SLOT_SIZE) ? 1 : -1];
+
+// Last block allocated near a module.
+typedef struct _REGION_HINT
+{
+    ULONG_PTR moduleBase;       // Allocation base of the module, 0 if unused.
+    ULONG_PTR lastBlock;
+} REGION_HINT;
+
 //-------------------------------------------------------------------------
 // Global Variables:
 //-------------------------------------------------------------------------
 
-// First element of the memory block list.
+// OS functions used to manage the memory blocks.
+const BUFFER_BACKEND g_defaultBufferBackend =
+{
+    VirtualAlloc, VirtualFree, VirtualQuery, GetSystemInfo
+};
+const BUFFER_BACKEND *g_pBackend = &g_defaultBufferBackend;
+
+// Usable address space, from GetSystemInfo().
+struct
+{
+    ULONG_PTR minAddr;
+    ULONG_PTR maxAddr;
+    DWORD     granularity;
+} g_addressSpace;
+
+// Blocks with at least one unused slot.
 PMEMORY_BLOCK g_pMemoryBlocks;
 
+// Blocks with no unused slot.
+PMEMORY_BLOCK g_pFullBlocks;
+
+// Block of the last allocation. Hooks tend to come in groups per module,
+// so this is usually the one to allocate from next.
+PMEMORY_BLOCK g_pLastBlock;
+
+// Where the last block near each module went, so that searching for the
+// next one doesn't walk the same occupied regions again.
+REGION_HINT g_regionHints[REGION_HINT_COUNT];
+UINT        g_nextRegionHint;
+
 //-------------------------------------------------------------------------
-VOID InitializeBuffer(VOID)
+VOID SetBufferBackend(const BUFFER_BACKEND *pBackend)
 {
-    // Nothing to do for now.
+    g_pBackend = (pBackend != NULL) ? pBackend : &g_defaultBufferBackend;
 }
 
 //-------------------------------------------------------------------------
-VOID UninitializeBuffer(VOID)
+VOID InitializeBuffer(VOID)
 {
-    PMEMORY_BLOCK pBlock = g_pMemoryBlocks;
-    g_pMemoryBlocks = NULL;
+    SYSTEM_INFO si;
+    g_pBackend->pGetSystemInfo(&si);
+
+    g_addressSpace.minAddr     = (ULONG_PTR)si.lpMinimumApplicationAddress;
+    g_addressSpace.maxAddr     = (ULONG_PTR)si.lpMaximumApplicationAddress;
+    g_addressSpace.granularity = si.dwAllocationGranularity;
+}
 
+//-------------------------------------------------------------------------
+static VOID ReleaseBlockList(PMEMORY_BLOCK pBlock)
+{
     while (pBlock)
     {
         PMEMORY_BLOCK pNext = pBlock->pNext;
-        VirtualFree(pBlock, 0, MEM_RELEASE);
+        g_pBackend->pVirtualFree(pBlock, 0, MEM_RELEASE);
         pBlock = pNext;
     }
 }
 
+//-------------------------------------------------------------------------
+VOID UninitializeBuffer(VOID)
+{
+    ReleaseBlockList(g_pMemoryBlocks);
+    ReleaseBlockList(g_pFullBlocks);
+
+    g_pMemoryBlocks = NULL;
+    g_pFullBlocks   = NULL;
+    g_pLastBlock    = NULL;
+
+    memset(g_regionHints, 0, sizeof(g_regionHints));
+    g_nextRegionHint = 0;
+}
+
+//-------------------------------------------------------------------------
+static VOID LinkBlock(PMEMORY_BLOCK *ppHead, PMEMORY_BLOCK pBlock)
+{
+    pBlock->pPrev = NULL;
+    pBlock->pNext = *ppHead;
+    if (*ppHead != NULL)
+        (*ppHead)->pPrev = pBlock;
+
+    *ppHead = pBlock;
+}
+
+//-------------------------------------------------------------------------
+static VOID UnlinkBlock(PMEMORY_BLOCK *ppHead, PMEMORY_BLOCK pBlock)
+{
+    if (pBlock->pPrev != NULL)
+        pBlock->pPrev->pNext = pBlock->pNext;
+    else
+        *ppHead = pBlock->pNext;
+
+    if (pBlock->pNext != NULL)
+        pBlock->pNext->pPrev = pBlock->pPrev;
+}
+
 //-------------------------------------------------------------------------
 #if defined(_M_X64) || defined(__x86_64__)
 static LPVOID FindPrevFreeRegion(LPVOID pAddress, LPVOID pMinAddr, DWORD dwAllocationGranularity)
@@ -99,7 +188,7 @@ static LPVOID FindPrevFreeRegion(LPVOID pAddress, LPVOID pMinAddr, DWORD dwAlloc
     while (tryAddr >= (ULONG_PTR)pMinAddr)
     {
         MEMORY_BASIC_INFORMATION mbi;
-        if (VirtualQuery((LPVOID)tryAddr, &mbi, sizeof(mbi)) == 0)
+        if (g_pBackend->pVirtualQuery((LPVOID)tryAddr, &mbi, sizeof(mbi)) == 0)
             break;
 
         if (mbi.State == MEM_FREE)
@@ -130,7 +219,7 @@ static LPVOID FindNextFreeRegion(LPVOID pAddress, LPVOID pMaxAddr, DWORD dwAlloc
     while (tryAddr <= (ULONG_PTR)pMaxAddr)
     {
         MEMORY_BASIC_INFORMATION mbi;
-        if (VirtualQuery((LPVOID)tryAddr, &mbi, sizeof(mbi)) == 0)
+        if (g_pBackend->pVirtualQuery((LPVOID)tryAddr, &mbi, sizeof(mbi)) == 0)
             break;
 
         if (mbi.State == MEM_FREE)
@@ -148,96 +237,166 @@ static LPVOID FindNextFreeRegion(LPVOID pAddress, LPVOID pMaxAddr, DWORD dwAlloc
 #endif
 
 //-------------------------------------------------------------------------
-static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
-{
-    PMEMORY_BLOCK pBlock;
 #if defined(_M_X64) || defined(__x86_64__)
-    ULONG_PTR minAddr;
-    ULONG_PTR maxAddr;
-
-    SYSTEM_INFO si;
-    GetSystemInfo(&si);
-    minAddr = (ULONG_PTR)si.lpMinimumApplicationAddress;
-    maxAddr = (ULONG_PTR)si.lpMaximumApplicationAddress;
+static PMEMORY_BLOCK AllocateBlockAbove(LPVOID pFrom, ULONG_PTR minAddr)
+{
+    LPVOID pAlloc = pFrom;
+    while ((ULONG_PTR)pAlloc >= minAddr)
+    {
+        PMEMORY_BLOCK pBlock;
 
-    // pOrigin ± 512MB
-    if ((ULONG_PTR)pOrigin > MAX_MEMORY_RANGE && minAddr < (ULONG_PTR)pOrigin - MAX_MEMORY_RANGE)
-        minAddr = (ULONG_PTR)pOrigin - MAX_MEMORY_RANGE;
+        pAlloc = FindPrevFreeRegion(pAlloc, (LPVOID)minAddr, g_addressSpace.granularity);
+        if (pAlloc == NULL)
+            break;
 
-    if (maxAddr > (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE)
-        maxAddr = (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE;
+        pBlock = (PMEMORY_BLOCK)g_pBackend->pVirtualAlloc(
+            pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+        if (pBlock != NULL)
+            return pBlock;
+    }
 
-    // Make room for MEMORY_BLOCK_SIZE bytes.
-    maxAddr -= MEMORY_BLOCK_SIZE - 1;
+    return NULL;
+}
 #endif
 
-    // Look the registered blocks for a reachable one.
-    for (pBlock = g_pMemoryBlocks; pBlock != NULL; pBlock = pBlock->pNext)
-    {
+//-------------------------------------------------------------------------
 #if defined(_M_X64) || defined(__x86_64__)
-        // Ignore the blocks too far.
-        if ((ULONG_PTR)pBlock < minAddr || (ULONG_PTR)pBlock >= maxAddr)
-            continue;
-#endif
-        // The block has at least one unused slot.
-        if (pBlock->pFree != NULL)
+static PMEMORY_BLOCK AllocateBlockBelow(LPVOID pFrom, ULONG_PTR maxAddr)
+{
+    LPVOID pAlloc = pFrom;
+    while ((ULONG_PTR)pAlloc <= maxAddr)
+    {
+        PMEMORY_BLOCK pBlock;
+
+        pAlloc = FindNextFreeRegion(pAlloc, (LPVOID)maxAddr, g_addressSpace.granularity);
+        if (pAlloc == NULL)
+            break;
+
+        pBlock = (PMEMORY_BLOCK)g_pBackend->pVirtualAlloc(
+            pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+        if (pBlock != NULL)
             return pBlock;
     }
 
+    return NULL;
+}
+#endif
+
+//-------------------------------------------------------------------------
 #if defined(_M_X64) || defined(__x86_64__)
-    // Alloc a new block above if not found.
+static REGION_HINT *FindRegionHint(ULONG_PTR moduleBase)
+{
+    UINT i;
+    for (i = 0; i < REGION_HINT_COUNT; ++i)
     {
-        LPVOID pAlloc = pOrigin;
-        while ((ULONG_PTR)pAlloc >= minAddr)
-        {
-            pAlloc = FindPrevFreeRegion(pAlloc, (LPVOID)minAddr, si.dwAllocationGranularity);
-            if (pAlloc == NULL)
-                break;
-
-            pBlock = (PMEMORY_BLOCK)VirtualAlloc(
-                pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-            if (pBlock != NULL)
-                break;
-        }
+        if (g_regionHints[i].moduleBase == moduleBase)
+            return &g_regionHints[i];
     }
 
+    return NULL;
+}
+#endif
+
+//-------------------------------------------------------------------------
+#if defined(_M_X64) || defined(__x86_64__)
+static PMEMORY_BLOCK AllocateNearBlock(LPVOID pOrigin, ULONG_PTR minAddr, ULONG_PTR maxAddr)
+{
+    PMEMORY_BLOCK pBlock = NULL;
+    ULONG_PTR     moduleBase = 0;
+    ULONG_PTR     hint = 0;
+    REGION_HINT  *pHint = NULL;
+
+    MEMORY_BASIC_INFORMATION mbi;
+    if (g_pBackend->pVirtualQuery(pOrigin, &mbi, sizeof(mbi)) != 0)
+    {
+        moduleBase = (ULONG_PTR)mbi.AllocationBase;
+        pHint = FindRegionHint(moduleBase);
+        if (pHint != NULL)
+            hint = pHint->lastBlock;
+    }
+
+    // Resume where the last block of this module went. Everything between
+    // there and pOrigin was occupied back then. If that fails, search from
+    // pOrigin again in case something in between was freed.
+
+    // Alloc a new block above if not found.
+    if (hint != 0 && hint >= minAddr && hint < (ULONG_PTR)pOrigin)
+        pBlock = AllocateBlockAbove((LPVOID)hint, minAddr);
+    if (pBlock == NULL)
+        pBlock = AllocateBlockAbove(pOrigin, minAddr);
+
     // Alloc a new block below if not found.
+    if (pBlock == NULL && hint > (ULONG_PTR)pOrigin && hint <= maxAddr)
+        pBlock = AllocateBlockBelow((LPVOID)hint, maxAddr);
     if (pBlock == NULL)
+        pBlock = AllocateBlockBelow(pOrigin, maxAddr);
+
+    if (pBlock != NULL && moduleBase != 0)
     {
-        LPVOID pAlloc = pOrigin;
-        while ((ULONG_PTR)pAlloc <= maxAddr)
+        if (pHint == NULL)
         {
-            pAlloc = FindNextFreeRegion(pAlloc, (LPVOID)maxAddr, si.dwAllocationGranularity);
-            if (pAlloc == NULL)
-                break;
-
-            pBlock = (PMEMORY_BLOCK)VirtualAlloc(
-                pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-            if (pBlock != NULL)
-                break;
+            pHint = &g_regionHints[g_nextRegionHint];
+            g_nextRegionHint = (g_nextRegionHint + 1) % REGION_HINT_COUNT;
+            pHint->moduleBase = moduleBase;
         }
+
+        pHint->lastBlock = (ULONG_PTR)pBlock;
+    }
+
+    return pBlock;
+}
+#endif
+
+//-------------------------------------------------------------------------
+static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
+{
+    PMEMORY_BLOCK pBlock;
+#if defined(_M_X64) || defined(__x86_64__)
+    ULONG_PTR minAddr = g_addressSpace.minAddr;
+    ULONG_PTR maxAddr = g_addressSpace.maxAddr;
+
+    // pOrigin ± 512MB
+    if ((ULONG_PTR)pOrigin > MAX_MEMORY_RANGE && minAddr < (ULONG_PTR)pOrigin - MAX_MEMORY_RANGE)
+        minAddr = (ULONG_PTR)pOrigin - MAX_MEMORY_RANGE;
+
+    if (maxAddr > (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE)
+        maxAddr = (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE;
+
+    // Make room for MEMORY_BLOCK_SIZE bytes.
+    maxAddr -= MEMORY_BLOCK_SIZE - 1;
+
+    // Try the block of the last allocation first.
+    pBlock = g_pLastBlock;
+    if (pBlock != NULL && pBlock->usedCount < MEMORY_SLOTS_PER_BLOCK - 1
+        && (ULONG_PTR)pBlock >= minAddr && (ULONG_PTR)pBlock < maxAddr)
+        return pBlock;
+
+    // Look the registered blocks for a reachable one. Only blocks with an
+    // unused slot are on this list.
+    for (pBlock = g_pMemoryBlocks; pBlock != NULL; pBlock = pBlock->pNext)
+    {
+        if ((ULONG_PTR)pBlock >= minAddr && (ULONG_PTR)pBlock < maxAddr)
+            return pBlock;
     }
+
+    pBlock = AllocateNearBlock(pOrigin, minAddr, maxAddr);
 #else
     // In x86 mode, a memory block can be placed anywhere.
-    pBlock = (PMEMORY_BLOCK)VirtualAlloc(
+    if (g_pMemoryBlocks != NULL)
+        return g_pMemoryBlocks;
+
+    pBlock = (PMEMORY_BLOCK)g_pBackend->pVirtualAlloc(
         NULL, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
 #endif
 
     if (pBlock != NULL)
     {
-        // Build a linked list of all the slots.
-        PMEMORY_SLOT pSlot = (PMEMORY_SLOT)pBlock + 1;
-        pBlock->pFree = NULL;
+        // Mark all the slots but the block info unused.
+        memset(pBlock->freeMap, 0xFF, sizeof(pBlock->freeMap));
+        pBlock->freeMap[0] &= ~1u;
         pBlock->usedCount = 0;
-        do
-        {
-            pSlot->pNext = pBlock->pFree;
-            pBlock->pFree = pSlot;
-            pSlot++;
-        } while ((ULONG_PTR)pSlot - (ULONG_PTR)pBlock <= MEMORY_BLOCK_SIZE - MEMORY_SLOT_SIZE);
 
-        pBlock->pNext = g_pMemoryBlocks;
-        g_pMemoryBlocks = pBlock;
+        LinkBlock(&g_pMemoryBlocks, pBlock);
     }
 
     return pBlock;
@@ -246,15 +405,35 @@ static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
 //-------------------------------------------------------------------------
 LPVOID AllocateBuffer(LPVOID pOrigin)
 {
-    PMEMORY_SLOT  pSlot;
+    PMEMORY_SLOT  pSlot = NULL;
     PMEMORY_BLOCK pBlock = GetMemoryBlock(pOrigin);
+    UINT i;
+
     if (pBlock == NULL)
         return NULL;
 
-    // Remove an unused slot from the list.
-    pSlot = pBlock->pFree;
-    pBlock->pFree = pSlot->pNext;
+    // Take the lowest unused slot.
+    for (i = 0; i < ARRAYSIZE(pBlock->freeMap); ++i)
+    {
+        if (pBlock->freeMap[i] != 0)
+        {
+            DWORD bit;
+            BitScanForward(&bit, pBlock->freeMap[i]);
+            pBlock->freeMap[i] &= pBlock->freeMap[i] - 1;
+            pSlot = (PMEMORY_SLOT)pBlock + (i * 32 + bit);
+            break;
+        }
+    }
+
     pBlock->usedCount++;
+    if (pBlock->usedCount == MEMORY_SLOTS_PER_BLOCK - 1)
+    {
+        UnlinkBlock(&g_pMemoryBlocks, pBlock);
+        LinkBlock(&g_pFullBlocks, pBlock);
+    }
+
+    g_pLastBlock = pBlock;
+
 #ifdef _DEBUG
     // Fill the slot with INT3 for debugging.
     memset(pSlot, 0xCC, sizeof(MEMORY_SLOT));
@@ -265,40 +444,33 @@ LPVOID AllocateBuffer(LPVOID pOrigin)
 //-------------------------------------------------------------------------
 VOID FreeBuffer(LPVOID pBuffer)
 {
-    PMEMORY_BLOCK pBlock = g_pMemoryBlocks;
-    PMEMORY_BLOCK pPrev = NULL;
-    ULONG_PTR pTargetBlock = ((ULONG_PTR)pBuffer / MEMORY_BLOCK_SIZE) * MEMORY_BLOCK_SIZE;
+    // Blocks are aligned to their size, so the block info is found directly.
+    PMEMORY_BLOCK pBlock = (PMEMORY_BLOCK)((ULONG_PTR)pBuffer & ~(ULONG_PTR)(MEMORY_BLOCK_SIZE - 1));
+    UINT slot = (UINT)(((ULONG_PTR)pBuffer - (ULONG_PTR)pBlock) / MEMORY_SLOT_SIZE);
+    BOOL wasFull = (pBlock->usedCount == MEMORY_SLOTS_PER_BLOCK - 1);
 
-    while (pBlock != NULL)
-    {
-        if ((ULONG_PTR)pBlock == pTargetBlock)
-        {
-            PMEMORY_SLOT pSlot = (PMEMORY_SLOT)pBuffer;
 #ifdef _DEBUG
-            // Clear the released slot for debugging.
-            memset(pSlot, 0x00, sizeof(MEMORY_SLOT));
+    // Clear the released slot for debugging.
+    memset(pBuffer, 0x00, sizeof(MEMORY_SLOT));
 #endif
-            // Restore the released slot to the list.
-            pSlot->pNext = pBlock->pFree;
-            pBlock->pFree = pSlot;
-            pBlock->usedCount--;
-
-            // Free if unused.
-            if (pBlock->usedCount == 0)
-            {
-                if (pPrev)
-                    pPrev->pNext = pBlock->pNext;
-                else
-                    g_pMemoryBlocks = pBlock->pNext;
-
-                VirtualFree(pBlock, 0, MEM_RELEASE);
-            }
+    // Mark the released slot unused.
+    pBlock->freeMap[slot / 32] |= 1u << (slot % 32);
+    pBlock->usedCount--;
 
-            break;
-        }
+    // Free if unused.
+    if (pBlock->usedCount == 0)
+    {
+        UnlinkBlock(wasFull ? &g_pFullBlocks : &g_pMemoryBlocks, pBlock);
+
+        if (g_pLastBlock == pBlock)
+            g_pLastBlock = NULL;
 
-        pPrev = pBlock;
-        pBlock = pBlock->pNext;
+        g_pBackend->pVirtualFree(pBlock, 0, MEM_RELEASE);
+    }
+    else if (wasFull)
+    {
+        UnlinkBlock(&g_pFullBlocks, pBlock);
+        LinkBlock(&g_pMemoryBlocks, pBlock);
     }
 }
 
@@ -306,7 +478,7 @@ VOID FreeBuffer(LPVOID pBuffer)
 BOOL IsExecutableAddress(LPVOID pAddress)
 {
     MEMORY_BASIC_INFORMATION mi;
-    VirtualQuery(pAddress, &mi, sizeof(mi));
+    g_pBackend->pVirtualQuery(pAddress, &mi, sizeof(mi));
 
     return (mi.State == MEM_COMMIT && (mi.Protect & PAGE_EXECUTE_FLAGS));
 }
@@ -35,6 +35,19 @@
     #define MEMORY_SLOT_SIZE 32
 #endif
 
+// OS functions used by the buffer. Can be replaced by a model of the
+// address space, e.g. to exercise the allocator off Windows.
+typedef struct _BUFFER_BACKEND
+{
+    LPVOID (WINAPI *pVirtualAlloc)(LPVOID lpAddress, SIZE_T dwSize, DWORD flAllocationType, DWORD flProtect);
+    BOOL   (WINAPI *pVirtualFree)(LPVOID lpAddress, SIZE_T dwSize, DWORD dwFreeType);
+    SIZE_T (WINAPI *pVirtualQuery)(LPCVOID lpAddress, PMEMORY_BASIC_INFORMATION lpBuffer, SIZE_T dwLength);
+    VOID   (WINAPI *pGetSystemInfo)(LPSYSTEM_INFO lpSystemInfo);
+} BUFFER_BACKEND;
+
+// Must be called before InitializeBuffer(). NULL restores the default.
+VOID   SetBufferBackend(const BUFFER_BACKEND *pBackend);
+
 VOID   InitializeBuffer(VOID);
 VOID   UninitializeBuffer(VOID);
 LPVOID AllocateBuffer(LPVOID pOrigin);
@@ -15,39 +15,26 @@ unsigned int hde32_disasm(const void *code, hde32s *hs)
 {
     uint8_t x, c, *p = (uint8_t *)code, cflags, opcode, pref = 0;
     uint8_t *ht = hde32_table, m_mod, m_reg, m_rm, disp_size = 0;
+    uint16_t map = 0;
 
     memset(hs, 0, sizeof(hde32s));
 
-    for (x = 16; x; x--)
-        switch (c = *p++) {
-            case 0xf3:
-                hs->p_rep = c;
-                pref |= PRE_F3;
-                break;
-            case 0xf2:
-                hs->p_rep = c;
-                pref |= PRE_F2;
-                break;
-            case 0xf0:
-                hs->p_lock = c;
-                pref |= PRE_LOCK;
-                break;
-            case 0x26: case 0x2e: case 0x36:
-            case 0x3e: case 0x64: case 0x65:
-                hs->p_seg = c;
-                pref |= PRE_SEG;
-                break;
-            case 0x66:
-                hs->p_66 = c;
-                pref |= PRE_66;
-                break;
-            case 0x67:
-                hs->p_67 = c;
-                pref |= PRE_67;
-                break;
-            default:
-                goto pref_done;
-        }
+    for (x = 16; x; x--) {
+        uint8_t f = hde32_prefixes[c = *p++];
+        if (!f)
+            goto pref_done;
+        pref |= f;
+        if (f & (PRE_F2 | PRE_F3))
+            hs->p_rep = c;
+        else if (f & PRE_LOCK)
+            hs->p_lock = c;
+        else if (f & PRE_SEG)
+            hs->p_seg = c;
+        else if (f & PRE_66)
+            hs->p_66 = c;
+        else
+            hs->p_67 = c;
+    }
   pref_done:
 
     hs->flags = (uint32_t)pref << 23;
@@ -58,6 +45,7 @@ unsigned int hde32_disasm(const void *code, hde32s *hs)
     if ((hs->opcode = c) == 0x0f) {
         hs->opcode2 = c = *p++;
         ht += DELTA_OPCODES;
+        map = 0x100;
     } else if (c >= 0xa0 && c <= 0xa3) {
         if (pref & PRE_67)
             pref |= PRE_66;
@@ -66,7 +54,7 @@ unsigned int hde32_disasm(const void *code, hde32s *hs)
     }
 
     opcode = c;
-    cflags = ht[ht[opcode / 4] + (opcode % 4)];
+    cflags = hde32_cflags[map + opcode];
 
     if (cflags == C_ERROR) {
         hs->flags |= F_ERROR | F_ERROR_OPCODE;
@@ -83,11 +71,8 @@ unsigned int hde32_disasm(const void *code, hde32s *hs)
         x = (uint8_t)(t >> 8);
     }
 
-    if (hs->opcode2) {
-        ht = hde32_table + DELTA_PREFIXES;
-        if (ht[ht[opcode / 4] + (opcode % 4)] & pref)
-            hs->flags |= F_ERROR | F_ERROR_OPCODE;
-    }
+    if (hs->opcode2 && (hde32_prefix_errors[opcode] & pref))
+        hs->flags |= F_ERROR | F_ERROR_OPCODE;
 
     if (cflags & C_MODRM) {
         hs->flags |= F_MODRM;
@@ -169,21 +154,10 @@ unsigned int hde32_disasm(const void *code, hde32s *hs)
         }
 
         if (m_mod == 3) {
-            uint8_t *table_end;
-            if (hs->opcode2) {
-                ht = hde32_table + DELTA_OP2_ONLY_MEM;
-                table_end = ht + sizeof(hde32_table) - DELTA_OP2_ONLY_MEM;
-            } else {
-                ht = hde32_table + DELTA_OP_ONLY_MEM;
-                table_end = ht + DELTA_OP2_ONLY_MEM - DELTA_OP_ONLY_MEM;
-            }
-            for (; ht != table_end; ht += 2)
-                if (*ht++ == opcode) {
-                    if ((*ht++ & pref) && !((*ht << m_reg) & 0x80))
-                        goto error_operand;
-                    else
-                        break;
-                }
+            uint16_t i = (hs->opcode2 ? 0x100 : 0) + opcode;
+            if ((hde32_only_mem_prefixes[i] & pref)
+                && !((hde32_only_mem_regs[i] << m_reg) & 0x80))
+                goto error_operand;
             goto no_error_operand;
         } else if (hs->opcode2) {
             switch (opcode) {
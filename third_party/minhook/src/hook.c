@@ -32,6 +32,7 @@
 
 #include "../include/MinHook.h"
 #include "buffer.h"
+#include "hook.h"
 #include "trampoline.h"
 
 #ifndef ARRAYSIZE
@@ -41,9 +42,20 @@
 // Initial capacity of the HOOK_ENTRY buffer.
 #define INITIAL_HOOK_CAPACITY   32
 
-// Initial capacity of the thread IDs buffer.
+// Number of hash index slots per HOOK_ENTRY capacity. Keeps the load factor <= 0.5.
+#define HOOK_INDEX_SLOTS_PER_ITEM 2
+
+// Initial capacity of the thread handles buffer.
 #define INITIAL_THREAD_CAPACITY 128
 
+// Spin iterations before EnterSpinLock() waits in the kernel.
+#define LOCK_SPIN_COUNT 4000
+
+// g_isLocked states.
+#define LOCK_FREE      0
+#define LOCK_HELD      1
+#define LOCK_CONTENDED 2    // Held, and other threads may be waiting.
+
 // Special hook position values.
 #define INVALID_HOOK_POS UINT_MAX
 #define ALL_HOOKS_POS    UINT_MAX
@@ -57,6 +69,20 @@
 #define THREAD_ACCESS \
     (THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION | THREAD_SET_CONTEXT)
 
+// kernelbase!WaitOnAddress/WakeByAddressSingle (Windows 8+).
+typedef BOOL (WINAPI *WAITONADDRESS)(
+    volatile VOID *Address, PVOID CompareAddress, SIZE_T AddressSize, DWORD dwMilliseconds);
+typedef VOID (WINAPI *WAKEBYADDRESSSINGLE)(PVOID Address);
+
+// NTSTATUS values returned by NtGetNextThread().
+#define STATUS_NO_MORE_ENTRIES_MH ((LONG)0x8000001A)
+#define STATUS_NO_MEMORY_MH       ((LONG)0xC0000017)
+
+// ntdll!NtGetNextThread (Vista+). Enumerates the threads of one process only.
+typedef LONG (NTAPI *NTGETNEXTTHREAD)(
+    HANDLE ProcessHandle, HANDLE ThreadHandle, ACCESS_MASK DesiredAccess,
+    ULONG HandleAttributes, ULONG Flags, PHANDLE NewThreadHandle);
+
 // Hook information.
 typedef struct _HOOK_ENTRY
 {
@@ -77,17 +103,43 @@ typedef struct _HOOK_ENTRY
 // Suspended threads for Freeze()/Unfreeze().
 typedef struct _FROZEN_THREADS
 {
-    LPDWORD pItems;         // Data heap
+    LPHANDLE pItems;        // Data heap (opened thread handles, NULL if not suspended)
     UINT    capacity;       // Size of allocated data heap, items
     UINT    size;           // Actual number of data items
 } FROZEN_THREADS, *PFROZEN_THREADS;
 
+// Bounds of the IPs that Freeze() may have to move.
+typedef struct _IP_RANGE
+{
+    DWORD_PTR lo;
+    DWORD_PTR hi;
+} IP_RANGE, *PIP_RANGE;
+
 //-------------------------------------------------------------------------
 // Global Variables:
 //-------------------------------------------------------------------------
 
-// Spin lock flag for EnterSpinLock()/LeaveSpinLock().
-volatile LONG g_isLocked = FALSE;
+// Lock state for EnterSpinLock()/LeaveSpinLock().
+volatile LONG g_isLocked = LOCK_FREE;
+
+// Kernel wait functions for the lock. NULL if not available.
+volatile LONG       g_lockApiResolved      = FALSE;
+WAITONADDRESS       g_pWaitOnAddress       = NULL;
+WAKEBYADDRESSSINGLE g_pWakeByAddressSingle = NULL;
+
+#ifdef MH_ENABLE_LOCK_STATS
+// Lock counters. Updated only by the lock owner.
+MH_LOCK_STATS g_lockStats;
+#endif
+
+// OS functions used to manage the threads of the process.
+const THREAD_BACKEND g_defaultThreadBackend =
+{
+    GetProcAddress, CreateToolhelp32Snapshot, Thread32First, Thread32Next,
+    OpenThread, GetThreadId, SuspendThread, ResumeThread,
+    GetThreadContext, SetThreadContext, CloseHandle
+};
+const THREAD_BACKEND *g_pThreadBackend = &g_defaultThreadBackend;
 
 // Private heap handle. If not NULL, this library is initialized.
 HANDLE g_hHeap = NULL;
@@ -100,23 +152,152 @@ struct
     UINT        size;       // Actual number of data items
 } g_hooks;
 
+// Hash index of g_hooks.pItems keyed by pTarget. (open addressing, linear probing)
+struct
+{
+    UINT *pSlots;           // Positions in g_hooks.pItems, INVALID_HOOK_POS if empty
+    UINT  mask;             // Number of slots - 1 (power of two)
+} g_hookIndex;
+
+// Thread handles buffer kept between Freeze() calls.
+struct
+{
+    LPHANDLE pItems;
+    UINT     capacity;
+} g_threadCache;
+
+// NULL if NtGetNextThread() is not available.
+NTGETNEXTTHREAD g_pNtGetNextThread = NULL;
+
+//-------------------------------------------------------------------------
+static UINT HashTarget(LPVOID pTarget)
+{
+    ULONG_PTR key = (ULONG_PTR)pTarget;
+    UINT32    h;
+
+#if defined(_M_X64) || defined(__x86_64__)
+    key ^= key >> 32;
+#endif
+    // Code addresses share their high bits and are often aligned, so mix well.
+    h  = (UINT32)key;
+    h ^= h >> 16;
+    h *= 0x45D9F3B;
+    h ^= h >> 16;
+
+    return h & g_hookIndex.mask;
+}
+
+//-------------------------------------------------------------------------
+static VOID IndexHookEntry(UINT pos)
+{
+    UINT i = HashTarget(g_hooks.pItems[pos].pTarget);
+    while (g_hookIndex.pSlots[i] != INVALID_HOOK_POS)
+        i = (i + 1) & g_hookIndex.mask;
+
+    g_hookIndex.pSlots[i] = pos;
+}
+
+//-------------------------------------------------------------------------
+// Returns the slot holding pos, or INVALID_HOOK_POS if not indexed.
+static UINT FindIndexSlot(UINT pos)
+{
+    UINT i = HashTarget(g_hooks.pItems[pos].pTarget);
+    while (g_hookIndex.pSlots[i] != INVALID_HOOK_POS)
+    {
+        if (g_hookIndex.pSlots[i] == pos)
+            return i;
+
+        i = (i + 1) & g_hookIndex.mask;
+    }
+
+    return INVALID_HOOK_POS;
+}
+
+//-------------------------------------------------------------------------
+static VOID UnindexHookEntry(UINT pos)
+{
+    UINT i = FindIndexSlot(pos);
+    UINT j;
+
+    if (i == INVALID_HOOK_POS)
+        return;
+
+    g_hookIndex.pSlots[i] = INVALID_HOOK_POS;
+
+    // Shift the following entries of the cluster back, so that lookups
+    // don't stop at the hole we just made.
+    for (j = (i + 1) & g_hookIndex.mask;
+        g_hookIndex.pSlots[j] != INVALID_HOOK_POS;
+        j = (j + 1) & g_hookIndex.mask)
+    {
+        UINT k = HashTarget(g_hooks.pItems[g_hookIndex.pSlots[j]].pTarget);
+
+        // Leave the entry if its home slot k lies cyclically in (i, j].
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+
+        g_hookIndex.pSlots[i] = g_hookIndex.pSlots[j];
+        g_hookIndex.pSlots[j] = INVALID_HOOK_POS;
+        i = j;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Grows the index to fit the current capacity of g_hooks and rehashes it.
+static BOOL ReserveHookIndex(VOID)
+{
+    UINT  slotCount = g_hooks.capacity * HOOK_INDEX_SLOTS_PER_ITEM;
+    UINT *pSlots;
+    UINT  i;
+
+    if (g_hookIndex.pSlots != NULL && slotCount <= g_hookIndex.mask + 1)
+        return TRUE;
+
+    pSlots = (UINT *)HeapAlloc(g_hHeap, 0, slotCount * sizeof(UINT));
+    if (pSlots == NULL)
+        return FALSE;
+
+    for (i = 0; i < slotCount; ++i)
+        pSlots[i] = INVALID_HOOK_POS;
+
+    if (g_hookIndex.pSlots != NULL)
+        HeapFree(g_hHeap, 0, g_hookIndex.pSlots);
+
+    g_hookIndex.pSlots = pSlots;
+    g_hookIndex.mask   = slotCount - 1;
+
+    for (i = 0; i < g_hooks.size; ++i)
+        IndexHookEntry(i);
+
+    return TRUE;
+}
+
 //-------------------------------------------------------------------------
 // Returns INVALID_HOOK_POS if not found.
 static UINT FindHookEntry(LPVOID pTarget)
 {
     UINT i;
-    for (i = 0; i < g_hooks.size; ++i)
+
+    if (g_hookIndex.pSlots == NULL)
+        return INVALID_HOOK_POS;
+
+    for (i = HashTarget(pTarget);
+        g_hookIndex.pSlots[i] != INVALID_HOOK_POS;
+        i = (i + 1) & g_hookIndex.mask)
     {
-        if ((ULONG_PTR)pTarget == (ULONG_PTR)g_hooks.pItems[i].pTarget)
-            return i;
+        UINT pos = g_hookIndex.pSlots[i];
+        if ((ULONG_PTR)pTarget == (ULONG_PTR)g_hooks.pItems[pos].pTarget)
+            return pos;
     }
 
     return INVALID_HOOK_POS;
 }
 
 //-------------------------------------------------------------------------
-static PHOOK_ENTRY AddHookEntry()
+static PHOOK_ENTRY AddHookEntry(LPVOID pTarget)
 {
+    PHOOK_ENTRY pHook;
+
     if (g_hooks.pItems == NULL)
     {
         g_hooks.capacity = INITIAL_HOOK_CAPACITY;
@@ -136,14 +317,32 @@ static PHOOK_ENTRY AddHookEntry()
         g_hooks.pItems = p;
     }
 
-    return &g_hooks.pItems[g_hooks.size++];
+    if (!ReserveHookIndex())
+        return NULL;
+
+    pHook = &g_hooks.pItems[g_hooks.size];
+    pHook->pTarget = pTarget;
+    IndexHookEntry(g_hooks.size);
+    g_hooks.size++;
+
+    return pHook;
 }
 
 //-------------------------------------------------------------------------
 static VOID DeleteHookEntry(UINT pos)
 {
+    UnindexHookEntry(pos);
+
     if (pos < g_hooks.size - 1)
-        g_hooks.pItems[pos] = g_hooks.pItems[g_hooks.size - 1];
+    {
+        // Move the last entry into the hole and repoint its index slot.
+        UINT last = g_hooks.size - 1;
+        UINT slot = FindIndexSlot(last);
+
+        g_hooks.pItems[pos] = g_hooks.pItems[last];
+        if (slot != INVALID_HOOK_POS)
+            g_hookIndex.pSlots[slot] = pos;
+    }
 
     g_hooks.size--;
 
@@ -196,7 +395,87 @@ static DWORD_PTR FindNewIP(PHOOK_ENTRY pHook, DWORD_PTR ip)
 }
 
 //-------------------------------------------------------------------------
-static VOID ProcessThreadIPs(HANDLE hThread, UINT pos, UINT action)
+static VOID ExtendIPRange(PIP_RANGE pRange, DWORD_PTR ip)
+{
+    if (ip < pRange->lo)
+        pRange->lo = ip;
+    if (ip > pRange->hi)
+        pRange->hi = ip;
+}
+
+//-------------------------------------------------------------------------
+// Returns TRUE if the action changes the state of the hook.
+static BOOL IsHookAffected(PHOOK_ENTRY pHook, UINT action, BOOL *pEnable)
+{
+    switch (action)
+    {
+    case ACTION_DISABLE:
+        *pEnable = FALSE;
+        break;
+
+    case ACTION_ENABLE:
+        *pEnable = TRUE;
+        break;
+
+    default: // ACTION_APPLY_QUEUED
+        *pEnable = pHook->queueEnable;
+        break;
+    }
+
+    return pHook->isEnabled != *pEnable;
+}
+
+//-------------------------------------------------------------------------
+// Collects the bounds of every IP that FindOldIP()/FindNewIP() could move,
+// so that threads running elsewhere are skipped with a single compare.
+static VOID GetAffectedIPRange(UINT pos, UINT action, PIP_RANGE pRange)
+{
+    UINT count;
+
+    pRange->lo = (DWORD_PTR)-1;
+    pRange->hi = 0;
+
+    if (pos == ALL_HOOKS_POS)
+    {
+        pos = 0;
+        count = g_hooks.size;
+    }
+    else
+    {
+        count = pos + 1;
+    }
+
+    for (; pos < count; ++pos)
+    {
+        PHOOK_ENTRY pHook = &g_hooks.pItems[pos];
+        BOOL        enable;
+        UINT        i;
+
+        if (!IsHookAffected(pHook, action, &enable))
+            continue;
+
+        if (enable)
+        {
+            for (i = 0; i < pHook->nIP; ++i)
+                ExtendIPRange(pRange, (DWORD_PTR)pHook->pTarget + pHook->oldIPs[i]);
+        }
+        else
+        {
+            if (pHook->patchAbove)
+                ExtendIPRange(pRange, (DWORD_PTR)pHook->pTarget - sizeof(JMP_REL));
+
+            for (i = 0; i < pHook->nIP; ++i)
+                ExtendIPRange(pRange, (DWORD_PTR)pHook->pTrampoline + pHook->newIPs[i]);
+
+#if defined(_M_X64) || defined(__x86_64__)
+            ExtendIPRange(pRange, (DWORD_PTR)pHook->pDetour);
+#endif
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+static VOID ProcessThreadIPs(HANDLE hThread, UINT pos, UINT action, const IP_RANGE *pRange)
 {
     // If the thread suspended in the overwritten area,
     // move IP to the proper address.
@@ -209,8 +488,15 @@ static VOID ProcessThreadIPs(HANDLE hThread, UINT pos, UINT action)
 #endif
     UINT count;
 
+    // No hook changes its state, so no IP can need to move.
+    if (pRange->lo > pRange->hi)
+        return;
+
     c.ContextFlags = CONTEXT_CONTROL;
-    if (!GetThreadContext(hThread, &c))
+    if (!g_pThreadBackend->pGetThreadContext(hThread, &c))
+        return;
+
+    if ((DWORD_PTR)*pIP < pRange->lo || (DWORD_PTR)*pIP > pRange->hi)
         return;
 
     if (pos == ALL_HOOKS_POS)
@@ -229,21 +515,7 @@ static VOID ProcessThreadIPs(HANDLE hThread, UINT pos, UINT action)
         BOOL        enable;
         DWORD_PTR   ip;
 
-        switch (action)
-        {
-        case ACTION_DISABLE:
-            enable = FALSE;
-            break;
-
-        case ACTION_ENABLE:
-            enable = TRUE;
-            break;
-
-        default: // ACTION_APPLY_QUEUED
-            enable = pHook->queueEnable;
-            break;
-        }
-        if (pHook->isEnabled == enable)
+        if (!IsHookAffected(pHook, action, &enable))
             continue;
 
         if (enable)
@@ -251,25 +523,124 @@ static VOID ProcessThreadIPs(HANDLE hThread, UINT pos, UINT action)
         else
             ip = FindOldIP(pHook, *pIP);
 
+        // An IP belongs to at most one hook, so one fix-up is all there is.
         if (ip != 0)
         {
             *pIP = ip;
-            SetThreadContext(hThread, &c);
+            g_pThreadBackend->pSetThreadContext(hThread, &c);
+            break;
         }
     }
 }
 
 //-------------------------------------------------------------------------
-static BOOL EnumerateThreads(PFROZEN_THREADS pThreads)
+VOID SetThreadBackend(const THREAD_BACKEND *pBackend)
+{
+    g_pThreadBackend = (pBackend != NULL) ? pBackend : &g_defaultThreadBackend;
+}
+
+//-------------------------------------------------------------------------
+static BOOL AppendThread(PFROZEN_THREADS pThreads, HANDLE hThread)
+{
+    if (pThreads->pItems == NULL)
+    {
+        pThreads->capacity = INITIAL_THREAD_CAPACITY;
+        pThreads->pItems
+            = (LPHANDLE)HeapAlloc(g_hHeap, 0, pThreads->capacity * sizeof(HANDLE));
+        if (pThreads->pItems == NULL)
+            return FALSE;
+    }
+    else if (pThreads->size >= pThreads->capacity)
+    {
+        LPHANDLE p = (LPHANDLE)HeapReAlloc(
+            g_hHeap, 0, pThreads->pItems, (pThreads->capacity * 2) * sizeof(HANDLE));
+        if (p == NULL)
+            return FALSE;
+
+        pThreads->capacity *= 2;
+        pThreads->pItems = p;
+    }
+
+    pThreads->pItems[pThreads->size++] = hThread;
+    return TRUE;
+}
+
+//-------------------------------------------------------------------------
+static VOID CloseThreads(PFROZEN_THREADS pThreads)
+{
+    UINT i;
+    for (i = 0; i < pThreads->size; ++i)
+    {
+        if (pThreads->pItems[i] != NULL)
+            g_pThreadBackend->pCloseHandle(pThreads->pItems[i]);
+    }
+
+    pThreads->size = 0;
+}
+
+//-------------------------------------------------------------------------
+// Walks only the threads of this process and gets them already opened.
+static BOOL EnumerateThreadsNt(PFROZEN_THREADS pThreads)
+{
+    HANDLE hThread = NULL;
+    HANDLE hSelf   = NULL;
+    DWORD  selfId  = GetCurrentThreadId();
+    LONG   ntStatus;
+
+    for (;;)
+    {
+        HANDLE hNext = NULL;
+        ntStatus = g_pNtGetNextThread(
+            GetCurrentProcess(), hThread, THREAD_ACCESS, 0, 0, &hNext);
+        if (ntStatus < 0)
+            break;
+
+        // The previous handle is the cursor of the walk, so the calling
+        // thread is closed only after the walk moved past it.
+        if (hSelf != NULL && hSelf == hThread)
+        {
+            g_pThreadBackend->pCloseHandle(hSelf);
+            hSelf = NULL;
+        }
+
+        hThread = hNext;
+        if (g_pThreadBackend->pGetThreadId(hNext) == selfId)
+        {
+            hSelf = hNext;
+        }
+        else if (!AppendThread(pThreads, hNext))
+        {
+            g_pThreadBackend->pCloseHandle(hNext);
+            ntStatus = STATUS_NO_MEMORY_MH;
+            break;
+        }
+    }
+
+    if (hSelf != NULL)
+        g_pThreadBackend->pCloseHandle(hSelf);
+
+    // Any other status means some thread could not be opened, and the
+    // caller has to fall back to the snapshot walk.
+    if (ntStatus != STATUS_NO_MORE_ENTRIES_MH)
+    {
+        CloseThreads(pThreads);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//-------------------------------------------------------------------------
+static BOOL EnumerateThreadsToolhelp(PFROZEN_THREADS pThreads)
 {
     BOOL succeeded = FALSE;
 
-    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    HANDLE hSnapshot = g_pThreadBackend->pCreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
     if (hSnapshot != INVALID_HANDLE_VALUE)
     {
         THREADENTRY32 te;
         te.dwSize = sizeof(THREADENTRY32);
-        if (Thread32First(hSnapshot, &te))
+        if (g_pThreadBackend->pThread32First(hSnapshot, &te))
         {
             succeeded = TRUE;
             do
@@ -278,86 +649,79 @@ static BOOL EnumerateThreads(PFROZEN_THREADS pThreads)
                     && te.th32OwnerProcessID == GetCurrentProcessId()
                     && te.th32ThreadID != GetCurrentThreadId())
                 {
-                    if (pThreads->pItems == NULL)
-                    {
-                        pThreads->capacity = INITIAL_THREAD_CAPACITY;
-                        pThreads->pItems
-                            = (LPDWORD)HeapAlloc(g_hHeap, 0, pThreads->capacity * sizeof(DWORD));
-                        if (pThreads->pItems == NULL)
-                        {
-                            succeeded = FALSE;
-                            break;
-                        }
-                    }
-                    else if (pThreads->size >= pThreads->capacity)
+                    // Threads that can't be opened can't be suspended either.
+                    HANDLE hThread = g_pThreadBackend->pOpenThread(THREAD_ACCESS, FALSE, te.th32ThreadID);
+                    if (hThread != NULL && !AppendThread(pThreads, hThread))
                     {
-                        LPDWORD p;
-                        pThreads->capacity *= 2;
-                        p = (LPDWORD)HeapReAlloc(
-                            g_hHeap, 0, pThreads->pItems, pThreads->capacity * sizeof(DWORD));
-                        if (p == NULL)
-                        {
-                            succeeded = FALSE;
-                            break;
-                        }
-
-                        pThreads->pItems = p;
+                        g_pThreadBackend->pCloseHandle(hThread);
+                        succeeded = FALSE;
+                        break;
                     }
-                    pThreads->pItems[pThreads->size++] = te.th32ThreadID;
                 }
 
                 te.dwSize = sizeof(THREADENTRY32);
-            } while (Thread32Next(hSnapshot, &te));
+            } while (g_pThreadBackend->pThread32Next(hSnapshot, &te));
 
             if (succeeded && GetLastError() != ERROR_NO_MORE_FILES)
                 succeeded = FALSE;
 
-            if (!succeeded && pThreads->pItems != NULL)
-            {
-                HeapFree(g_hHeap, 0, pThreads->pItems);
-                pThreads->pItems = NULL;
-            }
+            if (!succeeded)
+                CloseThreads(pThreads);
         }
-        CloseHandle(hSnapshot);
+        g_pThreadBackend->pCloseHandle(hSnapshot);
     }
 
     return succeeded;
 }
 
+//-------------------------------------------------------------------------
+static BOOL EnumerateThreads(PFROZEN_THREADS pThreads)
+{
+    if (g_pNtGetNextThread != NULL && EnumerateThreadsNt(pThreads))
+        return TRUE;
+
+    return EnumerateThreadsToolhelp(pThreads);
+}
+
+//-------------------------------------------------------------------------
+static VOID Unfreeze(PFROZEN_THREADS pThreads);
+
 //-------------------------------------------------------------------------
 static MH_STATUS Freeze(PFROZEN_THREADS pThreads, UINT pos, UINT action)
 {
     MH_STATUS status = MH_OK;
 
-    pThreads->pItems   = NULL;
-    pThreads->capacity = 0;
+    // Reuse the list buffer of the last Freeze(). Safe under the lock.
+    pThreads->pItems   = g_threadCache.pItems;
+    pThreads->capacity = g_threadCache.capacity;
     pThreads->size     = 0;
+    g_threadCache.pItems   = NULL;
+    g_threadCache.capacity = 0;
+
     if (!EnumerateThreads(pThreads))
     {
         status = MH_ERROR_MEMORY_ALLOC;
+        Unfreeze(pThreads);
     }
-    else if (pThreads->pItems != NULL)
+    else
     {
-        UINT i;
+        IP_RANGE range;
+        UINT     i;
+
+        GetAffectedIPRange(pos, action, &range);
+
         for (i = 0; i < pThreads->size; ++i)
         {
-            HANDLE hThread = OpenThread(THREAD_ACCESS, FALSE, pThreads->pItems[i]);
-            BOOL suspended = FALSE;
-            if (hThread != NULL)
+            HANDLE hThread = pThreads->pItems[i];
+            if (g_pThreadBackend->pSuspendThread(hThread) != 0xFFFFFFFF)
             {
-                DWORD result = SuspendThread(hThread);
-                if (result != 0xFFFFFFFF)
-                {
-                    suspended = TRUE;
-                    ProcessThreadIPs(hThread, pos, action);
-                }
-                CloseHandle(hThread);
+                ProcessThreadIPs(hThread, pos, action, &range);
             }
-
-            if (!suspended)
+            else
             {
                 // Mark thread as not suspended, so it's not resumed later on.
-                pThreads->pItems[i] = 0;
+                g_pThreadBackend->pCloseHandle(hThread);
+                pThreads->pItems[i] = NULL;
             }
         }
     }
@@ -373,19 +737,31 @@ static VOID Unfreeze(PFROZEN_THREADS pThreads)
         UINT i;
         for (i = 0; i < pThreads->size; ++i)
         {
-            DWORD threadId = pThreads->pItems[i];
-            if (threadId != 0)
+            HANDLE hThread = pThreads->pItems[i];
+            if (hThread != NULL)
             {
-                HANDLE hThread = OpenThread(THREAD_ACCESS, FALSE, threadId);
-                if (hThread != NULL)
-                {
-                    ResumeThread(hThread);
-                    CloseHandle(hThread);
-                }
+                g_pThreadBackend->pResumeThread(hThread);
+                g_pThreadBackend->pCloseHandle(hThread);
             }
         }
 
-        HeapFree(g_hHeap, 0, pThreads->pItems);
+        // Keep the larger buffer for the next Freeze().
+        if (g_threadCache.pItems == NULL || g_threadCache.capacity < pThreads->capacity)
+        {
+            if (g_threadCache.pItems != NULL)
+                HeapFree(g_hHeap, 0, g_threadCache.pItems);
+
+            g_threadCache.pItems   = pThreads->pItems;
+            g_threadCache.capacity = pThreads->capacity;
+        }
+        else
+        {
+            HeapFree(g_hHeap, 0, pThreads->pItems);
+        }
+
+        pThreads->pItems   = NULL;
+        pThreads->capacity = 0;
+        pThreads->size     = 0;
     }
 }
 
@@ -476,25 +852,105 @@ static MH_STATUS EnableAllHooksLL(BOOL enable)
     return status;
 }
 
+//-------------------------------------------------------------------------
+static VOID ResolveLockApi(VOID)
+{
+    HMODULE hModule;
+
+    if (InterlockedCompareExchange(&g_lockApiResolved, FALSE, FALSE) != FALSE)
+        return;
+
+    // Windows 8+. Resolved at run time so that MinHook still loads on older
+    // systems and needs no extra import library.
+    hModule = GetModuleHandleW(L"kernelbase.dll");
+    if (hModule != NULL)
+    {
+        WAITONADDRESS       pWait = (WAITONADDRESS)GetProcAddress(hModule, "WaitOnAddress");
+        WAKEBYADDRESSSINGLE pWake = (WAKEBYADDRESSSINGLE)GetProcAddress(hModule, "WakeByAddressSingle");
+        if (pWait != NULL && pWake != NULL)
+        {
+            g_pWaitOnAddress       = pWait;
+            g_pWakeByAddressSingle = pWake;
+        }
+    }
+
+    InterlockedExchange(&g_lockApiResolved, TRUE);
+}
+
+//-------------------------------------------------------------------------
+// Blocks while g_isLocked is LOCK_CONTENDED, or at least gives up the CPU.
+static VOID WaitForLock(SIZE_T round)
+{
+    if (g_pWaitOnAddress != NULL)
+    {
+        LONG contended = LOCK_CONTENDED;
+        g_pWaitOnAddress(&g_isLocked, &contended, sizeof(LONG), INFINITE);
+    }
+    else if (round < 32)
+    {
+        if (!SwitchToThread())
+            YieldProcessor();
+    }
+    else
+    {
+        Sleep(1);
+    }
+}
+
 //-------------------------------------------------------------------------
 static VOID EnterSpinLock(VOID)
 {
-    SIZE_T spinCount = 0;
+    SIZE_T spinCount;
+#ifdef MH_ENABLE_LOCK_STATS
+    LARGE_INTEGER waitStart, waitEnd;
+#endif
 
-    // Wait until the flag is FALSE.
-    while (InterlockedCompareExchange(&g_isLocked, TRUE, FALSE) != FALSE)
+    if (InterlockedCompareExchange(&g_isLocked, LOCK_HELD, LOCK_FREE) == LOCK_FREE)
     {
-        // No need to generate a memory barrier here, since InterlockedCompareExchange()
-        // generates a full memory barrier itself.
+#ifdef MH_ENABLE_LOCK_STATS
+        g_lockStats.acquisitions++;
+#endif
+        return;
+    }
 
-        // Prevent the loop from being too busy.
-        if (spinCount < 32)
-            Sleep(0);
-        else
-            Sleep(1);
+#ifdef MH_ENABLE_LOCK_STATS
+    QueryPerformanceCounter(&waitStart);
+#endif
+
+    // The lock is usually held for a short time, so spin a little first.
+    for (spinCount = 0; spinCount < LOCK_SPIN_COUNT; ++spinCount)
+    {
+        YieldProcessor();
+
+        if (g_isLocked == LOCK_FREE
+            && InterlockedCompareExchange(&g_isLocked, LOCK_HELD, LOCK_FREE) == LOCK_FREE)
+            break;
+    }
+
+    if (spinCount == LOCK_SPIN_COUNT)
+    {
+        // Mark the lock as contended, so that LeaveSpinLock() wakes us up.
+        // Once set, it stays so until we own it, even if that over-wakes.
+        ResolveLockApi();
 
-        spinCount++;
+        for (spinCount = 0;
+            InterlockedExchange(&g_isLocked, LOCK_CONTENDED) != LOCK_FREE;
+            ++spinCount)
+        {
+            WaitForLock(spinCount);
+        }
+
+#ifdef MH_ENABLE_LOCK_STATS
+        g_lockStats.kernelWaits += spinCount;
+#endif
     }
+
+#ifdef MH_ENABLE_LOCK_STATS
+    QueryPerformanceCounter(&waitEnd);
+    g_lockStats.acquisitions++;
+    g_lockStats.contentions++;
+    g_lockStats.waitTicks += (ULONGLONG)(waitEnd.QuadPart - waitStart.QuadPart);
+#endif
 }
 
 //-------------------------------------------------------------------------
@@ -503,7 +959,12 @@ static VOID LeaveSpinLock(VOID)
     // No need to generate a memory barrier here, since InterlockedExchange()
     // generates a full memory barrier itself.
 
-    InterlockedExchange(&g_isLocked, FALSE);
+    if (InterlockedExchange(&g_isLocked, LOCK_FREE) == LOCK_CONTENDED)
+    {
+        ResolveLockApi();
+        if (g_pWakeByAddressSingle != NULL)
+            g_pWakeByAddressSingle((PVOID)&g_isLocked);
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -520,6 +981,9 @@ MH_STATUS WINAPI MH_Initialize(VOID)
         {
             // Initialize the internal function buffer.
             InitializeBuffer();
+
+            g_pNtGetNextThread = (NTGETNEXTTHREAD)g_pThreadBackend->pGetProcAddress(
+                GetModuleHandleW(L"ntdll.dll"), "NtGetNextThread");
         }
         else
         {
@@ -556,6 +1020,8 @@ MH_STATUS WINAPI MH_Uninitialize(VOID)
             UninitializeBuffer();
 
             HeapFree(g_hHeap, 0, g_hooks.pItems);
+            HeapFree(g_hHeap, 0, g_hookIndex.pSlots);
+            HeapFree(g_hHeap, 0, g_threadCache.pItems);
             HeapDestroy(g_hHeap);
 
             g_hHeap = NULL;
@@ -563,6 +1029,12 @@ MH_STATUS WINAPI MH_Uninitialize(VOID)
             g_hooks.pItems   = NULL;
             g_hooks.capacity = 0;
             g_hooks.size     = 0;
+
+            g_hookIndex.pSlots = NULL;
+            g_hookIndex.mask   = 0;
+
+            g_threadCache.pItems   = NULL;
+            g_threadCache.capacity = 0;
         }
     }
     else
@@ -599,10 +1071,9 @@ MH_STATUS WINAPI MH_CreateHook(LPVOID pTarget, LPVOID pDetour, LPVOID *ppOrigina
                     ct.pTrampoline = pBuffer;
                     if (CreateTrampolineFunction(&ct))
                     {
-                        PHOOK_ENTRY pHook = AddHookEntry();
+                        PHOOK_ENTRY pHook = AddHookEntry(ct.pTarget);
                         if (pHook != NULL)
                         {
-                            pHook->pTarget     = ct.pTarget;
 #if defined(_M_X64) || defined(__x86_64__)
                             pHook->pDetour     = ct.pRelay;
 #else
@@ -739,7 +1210,7 @@ static MH_STATUS EnableHook(LPVOID pTarget, BOOL enable)
                 if (g_hooks.pItems[pos].isEnabled != enable)
                 {
                     FROZEN_THREADS threads;
-                    status = Freeze(&threads, pos, ACTION_ENABLE);
+                    status = Freeze(&threads, pos, enable ? ACTION_ENABLE : ACTION_DISABLE);
                     if (status == MH_OK)
                     {
                         status = EnableHookLL(pos, enable);
@@ -880,6 +1351,23 @@ MH_STATUS WINAPI MH_ApplyQueued(VOID)
     return status;
 }
 
+#ifdef MH_ENABLE_LOCK_STATS
+//-------------------------------------------------------------------------
+MH_STATUS WINAPI MH_GetLockStats(MH_LOCK_STATS *pStats)
+{
+    if (pStats == NULL)
+        return MH_ERROR_INVALID_ARGUMENT;
+
+    EnterSpinLock();
+
+    *pStats = g_lockStats;
+
+    LeaveSpinLock();
+
+    return MH_OK;
+}
+#endif
+
 //-------------------------------------------------------------------------
 MH_STATUS WINAPI MH_CreateHookApiEx(
     LPCWSTR pszModule, LPCSTR pszProcName, LPVOID pDetour,
@@ -931,6 +1419,7 @@ const char *WINAPI MH_StatusToString(MH_STATUS status)
         MH_ST2STR(MH_ERROR_MEMORY_PROTECT)
         MH_ST2STR(MH_ERROR_MODULE_NOT_FOUND)
         MH_ST2STR(MH_ERROR_FUNCTION_NOT_FOUND)
+        MH_ST2STR(MH_ERROR_INVALID_ARGUMENT)
     }
 
 #undef MH_ST2STR
@@ -0,0 +1,53 @@
+﻿/*
+ *  MinHook - The Minimalistic API Hooking Library for x64/x86
+ *  Copyright (C) 2009-2017 Tsuda Kageyu.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ *  PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ *  OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <tlhelp32.h>
+
+// OS functions used to find, suspend and resume the other threads of the
+// process. Can be replaced by a model of the threads, e.g. to exercise
+// Freeze()/Unfreeze() off Windows.
+typedef struct _THREAD_BACKEND
+{
+    // Resolves ntdll!NtGetNextThread. May return NULL.
+    FARPROC (WINAPI *pGetProcAddress)(HMODULE hModule, LPCSTR lpProcName);
+    HANDLE  (WINAPI *pCreateToolhelp32Snapshot)(DWORD dwFlags, DWORD th32ProcessID);
+    BOOL    (WINAPI *pThread32First)(HANDLE hSnapshot, LPTHREADENTRY32 lpte);
+    BOOL    (WINAPI *pThread32Next)(HANDLE hSnapshot, LPTHREADENTRY32 lpte);
+    HANDLE  (WINAPI *pOpenThread)(DWORD dwDesiredAccess, BOOL bInheritHandle, DWORD dwThreadId);
+    DWORD   (WINAPI *pGetThreadId)(HANDLE Thread);
+    DWORD   (WINAPI *pSuspendThread)(HANDLE hThread);
+    DWORD   (WINAPI *pResumeThread)(HANDLE hThread);
+    BOOL    (WINAPI *pGetThreadContext)(HANDLE hThread, LPCONTEXT lpContext);
+    BOOL    (WINAPI *pSetThreadContext)(HANDLE hThread, const CONTEXT *lpContext);
+    BOOL    (WINAPI *pCloseHandle)(HANDLE hObject);
+} THREAD_BACKEND;
+
+// Must be called before MH_Initialize(). NULL restores the default.
+VOID SetThreadBackend(const THREAD_BACKEND *pBackend);
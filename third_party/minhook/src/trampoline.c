@@ -57,8 +57,20 @@
     #define TRAMPOLINE_MAX_SIZE MEMORY_SLOT_SIZE
 #endif
 
+// Most bytes HDE reads from one instruction before it decides: 16 prefixes,
+// REX, two opcode bytes, ModR/M, SIB, disp32 and imm64.
+#define HDE_MAX_READ (16 + 1 + 2 + 1 + 1 + 4 + 8)
+
+// Every instruction copied starts below sizeof(JMP_REL) and is at most 15
+// bytes long, and the one after it is decoded too.
+typedef char TRAMPOLINE_CODE_FITS_DECODE[
+    (sizeof(JMP_REL) - 1 + 15 + HDE_MAX_READ <= TRAMPOLINE_CODE_SIZE) ? 1 : -1];
+
+// Smallest page size of x86/x64 Windows.
+#define TRAMPOLINE_PAGE_SIZE 0x1000
+
 //-------------------------------------------------------------------------
-static BOOL IsCodePadding(LPBYTE pInst, UINT size)
+static BOOL IsCodePadding(const BYTE *pInst, UINT size)
 {
     UINT i;
 
@@ -74,7 +86,8 @@ static BOOL IsCodePadding(LPBYTE pInst, UINT size)
 }
 
 //-------------------------------------------------------------------------
-BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
+BOOL BuildTrampolineFunction(
+    PTRAMPOLINE ct, const BYTE *pCode, const BYTE *pAbove, LPBYTE pOut)
 {
 #if defined(_M_X64) || defined(__x86_64__)
     CALL_ABS call = {
@@ -121,15 +134,20 @@ BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
     {
         HDE       hs;
         UINT      copySize;
-        LPVOID    pCopySrc;
+        LPCVOID   pCopySrc;
         ULONG_PTR pOldInst = (ULONG_PTR)ct->pTarget     + oldPos;
         ULONG_PTR pNewInst = (ULONG_PTR)ct->pTrampoline + newPos;
 
-        copySize = HDE_DISASM((LPVOID)pOldInst, &hs);
+        // Decode from the buffer, but compute addresses as seen at run time.
+        copySize = HDE_DISASM(pCode + oldPos, &hs);
         if (hs.flags & F_ERROR)
             return FALSE;
 
-        pCopySrc = (LPVOID)pOldInst;
+        // Every copy of target bytes below stays inside pCode.
+        if (oldPos + hs.len > TRAMPOLINE_CODE_SIZE)
+            return FALSE;
+
+        pCopySrc = pCode + oldPos;
         if (oldPos >= sizeof(JMP_REL))
         {
             // The trampoline function is long enough.
@@ -154,9 +172,9 @@ BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
 
             // Avoid using memcpy to reduce the footprint.
 #ifndef ALLOW_INTRINSICS
-            memcpy(instBuf, (LPBYTE)pOldInst, copySize);
+            memcpy(instBuf, pCode + oldPos, copySize);
 #else
-            __movsb(instBuf, (LPBYTE)pOldInst, copySize);
+            __movsb(instBuf, pCode + oldPos, copySize);
 #endif
             pCopySrc = instBuf;
 
@@ -279,9 +297,9 @@ BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
 
         // Avoid using memcpy to reduce the footprint.
 #ifndef ALLOW_INTRINSICS
-        memcpy((LPBYTE)ct->pTrampoline + newPos, pCopySrc, copySize);
+        memcpy(pOut + newPos, pCopySrc, copySize);
 #else
-        __movsb((LPBYTE)ct->pTrampoline + newPos, (LPBYTE)pCopySrc, copySize);
+        __movsb(pOut + newPos, (const BYTE *)pCopySrc, copySize);
 #endif
         newPos += copySize;
         oldPos += hs.len;
@@ -289,32 +307,49 @@ BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
 
     // Is there enough place for a long jump?
     if (oldPos < sizeof(JMP_REL)
-        && !IsCodePadding((LPBYTE)ct->pTarget + oldPos, sizeof(JMP_REL) - oldPos))
+        && !IsCodePadding(pCode + oldPos, sizeof(JMP_REL) - oldPos))
     {
         // Is there enough place for a short jump?
         if (oldPos < sizeof(JMP_REL_SHORT)
-            && !IsCodePadding((LPBYTE)ct->pTarget + oldPos, sizeof(JMP_REL_SHORT) - oldPos))
+            && !IsCodePadding(pCode + oldPos, sizeof(JMP_REL_SHORT) - oldPos))
         {
             return FALSE;
         }
 
         // Can we place the long jump above the function?
-        if (!IsExecutableAddress((LPBYTE)ct->pTarget - sizeof(JMP_REL)))
+        if (pAbove == NULL)
             return FALSE;
 
-        if (!IsCodePadding((LPBYTE)ct->pTarget - sizeof(JMP_REL), sizeof(JMP_REL)))
+        if (!IsCodePadding(pAbove, sizeof(JMP_REL)))
             return FALSE;
 
         ct->patchAbove = TRUE;
     }
 
 #if defined(_M_X64) || defined(__x86_64__)
-    // Create a relay function.
+    // Create a relay function. TRAMPOLINE_MAX_SIZE leaves room for it.
     jmp.address = (ULONG_PTR)ct->pDetour;
 
     ct->pRelay = (LPBYTE)ct->pTrampoline + newPos;
-    memcpy(ct->pRelay, &jmp, sizeof(jmp));
+    memcpy(pOut + newPos, &jmp, sizeof(jmp));
 #endif
 
     return TRUE;
 }
+
+//-------------------------------------------------------------------------
+BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
+{
+    LPBYTE pAbove = (LPBYTE)ct->pTarget - sizeof(JMP_REL);
+
+    // The target itself is known to be executable, so only ask the OS
+    // about the hot patch area if it starts on the previous page.
+    if (((ULONG_PTR)ct->pTarget & (TRAMPOLINE_PAGE_SIZE - 1)) < sizeof(JMP_REL)
+        && !IsExecutableAddress(pAbove))
+    {
+        pAbove = NULL;
+    }
+
+    return BuildTrampolineFunction(
+        ct, (const BYTE *)ct->pTarget, pAbove, (LPBYTE)ct->pTrampoline);
+}
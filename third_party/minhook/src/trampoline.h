@@ -102,4 +102,22 @@ typedef struct _TRAMPOLINE
     UINT8  newIPs[8];       // [Out] Instruction boundaries of the trampoline function.
 } TRAMPOLINE, *PTRAMPOLINE;
 
+// Bytes of target code that BuildTrampolineFunction() may read, whatever the
+// code holds: trampoline.c checks at compile time that they cover the longest
+// prologue it copies plus the decoder's read of the next instruction, and the
+// builder fails rather than copy past them.
+#define TRAMPOLINE_CODE_SIZE 64
+
+// Builds the trampoline from plain buffers, without touching the target or
+// the OS. Addresses in ct are only used as the run-time locations.
+// Parameters:
+//   ct     [in/out] As for CreateTrampolineFunction().
+//   pCode  [in]  Copy of the target code, TRAMPOLINE_CODE_SIZE bytes.
+//   pAbove [in]  Copy of the sizeof(JMP_REL) bytes above the target, or NULL
+//                if they are not executable.
+//   pOut   [out] Receives the trampoline and relay, MEMORY_SLOT_SIZE bytes.
+BOOL BuildTrampolineFunction(
+    PTRAMPOLINE ct, const BYTE *pCode, const BYTE *pAbove, LPBYTE pOut);
+
+// Builds the trampoline in place at ct->pTrampoline.
 BOOL CreateTrampolineFunction(PTRAMPOLINE ct);